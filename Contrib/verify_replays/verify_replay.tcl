@@ -0,0 +1,30 @@
+# verify_replay -- helper script for verify_replays.py
+#
+# This script should NOT be installed in the ~/.openmsx/share/scripts directory.
+# Instead it's activated via the openMSX command line, e.g.:
+#   openmsx -script verify_replay.tcl -command "verify_replay game.omr result.txt"
+# (verify_replays.py does this for you).
+#
+# It loads the given replay, emulates (as fast as possible) until the end of
+# the replay and then writes a single line to the result file:
+#   <state-hash> <wall-clock time in ms>
+# or, in case of an error:
+#   error <message>
+# After that openMSX exits.
+
+proc verify_replay {replay result_file} {
+	set start [clock milliseconds]
+	set f [open $result_file w]
+	if {[catch {
+		reverse loadreplay -viewonly $replay
+		reverse goto -novideo [dict get [reverse status] end]
+		set hash [machine_info state_hash]
+	} err]} {
+		puts $f "error $err"
+		close $f
+		exit 1
+	}
+	puts $f "$hash [expr {[clock milliseconds] - $start}]"
+	close $f
+	exit 0
+}
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+# verify_replays -- verify a set of openMSX replays (.omr files) in parallel.
+#
+# Each replay is run in its own (headless) openMSX process until the end of
+# the replay. Then the hash of the final machine state is printed, together
+# with the wall-clock time it took. When a file with expected hashes is given
+# (the output of an earlier run), the hashes are compared.
+#
+# Several openMSX processes run in parallel, by default one per CPU core.
+# (A single openMSX process is not able to emulate multiple machines
+# concurrently.)
+#
+# Output, one line per replay (tab separated):
+#   <hash> <time> <status> <replay>
+# where status is one of 'ok', 'new' (no expected hash), 'MISMATCH' or
+# 'ERROR'. The exit code is 0 iff there were no mismatches or errors.
+
+from argparse import ArgumentParser
+from concurrent.futures import ThreadPoolExecutor
+from os import close, cpu_count, rmdir, unlink
+from os.path import abspath, dirname, join
+from subprocess import DEVNULL, PIPE, TimeoutExpired, run
+from sys import exit, stderr
+from tempfile import mkdtemp, mkstemp
+from time import monotonic
+
+SETTINGS = """<?xml version="1.0"?>
+<!DOCTYPE settings SYSTEM 'settings.dtd'>
+<settings>
+  <settings>
+    <setting id="renderer">none</setting>
+    <setting id="sound_driver">null</setting>
+    <setting id="save_settings_on_exit">false</setting>
+  </settings>
+</settings>
+"""
+
+def tclQuote(s):
+	return '{' + s + '}'
+
+def verifyReplay(openmsx, script, settings, replay, timeout):
+	fd, resultFile = mkstemp(suffix='.txt')
+	close(fd)
+	start = monotonic()
+	try:
+		command = 'verify_replay %s %s' % (
+			tclQuote(abspath(replay)), tclQuote(resultFile))
+		proc = run(
+			[openmsx, '-setting', settings, '-script', script,
+			 '-command', command],
+			stdin=DEVNULL, stdout=DEVNULL, stderr=PIPE, timeout=timeout
+			)
+		with open(resultFile) as f:
+			result = f.read().strip()
+		if not result:
+			msg = proc.stderr.decode(errors='replace').strip()
+			return None, monotonic() - start, msg or 'no result'
+		if result.startswith('error '):
+			return None, monotonic() - start, result[6:]
+		hashValue, ms = result.split()
+		return hashValue, int(ms) / 1000.0, None
+	except TimeoutExpired:
+		return None, monotonic() - start, 'timeout'
+	finally:
+		unlink(resultFile)
+
+def readExpected(filename):
+	expected = {}
+	with open(filename) as f:
+		for line in f:
+			fields = line.rstrip('\n').split('\t')
+			if len(fields) == 4:
+				expected[fields[3]] = fields[0]
+	return expected
+
+def main():
+	parser = ArgumentParser(description='Verify openMSX replays in parallel.')
+	parser.add_argument('replays', nargs='*', help='replay files (.omr)')
+	parser.add_argument('-l', '--list', help='file with replay filenames, one per line')
+	parser.add_argument('-e', '--expected', help='expected hashes (output of an earlier run)')
+	parser.add_argument('-j', '--jobs', type=int, default=cpu_count(), help='number of parallel openMSX processes')
+	parser.add_argument('--openmsx', default='openmsx', help='openMSX executable')
+	parser.add_argument('--timeout', type=float, default=None, help='timeout per replay in seconds')
+	args = parser.parse_args()
+
+	replays = list(args.replays)
+	if args.list:
+		with open(args.list) as f:
+			replays += [line.strip() for line in f if line.strip()]
+	if not replays:
+		parser.error('no replays given')
+	expected = readExpected(args.expected) if args.expected else {}
+
+	script = join(dirname(abspath(__file__)), 'verify_replay.tcl')
+	tmpDir = mkdtemp()
+	settings = join(tmpDir, 'settings.xml')
+	with open(settings, 'w') as f:
+		f.write(SETTINGS)
+
+	failures = 0
+	try:
+		with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+			futures = [
+				(replay, pool.submit(verifyReplay, args.openmsx, script,
+				                     settings, replay, args.timeout))
+				for replay in replays
+				]
+			for replay, future in futures:
+				hashValue, seconds, error = future.result()
+				if error is not None:
+					status = 'ERROR'
+					print('%s: %s' % (replay, error), file=stderr)
+				elif replay not in expected:
+					status = 'new'
+				elif expected[replay] == hashValue:
+					status = 'ok'
+				else:
+					status = 'MISMATCH'
+				if status in ('ERROR', 'MISMATCH'):
+					failures += 1
+				print('%s\t%.2f\t%s\t%s' % (
+					hashValue or '-', seconds, status, replay), flush=True)
+	finally:
+		unlink(settings)
+		rmdir(tmpDir)
+
+	exit(1 if failures else 0)
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,237 @@
+#include "BinarySavestate.hh"
+#include "MSXMotherBoard.hh"
+#include "DeltaBlock.hh"
+#include "File.hh"
+#include "FileException.hh"
+#include "MSXException.hh"
+#include "MemBuffer.hh"
+#include "Version.hh"
+#include "lz4.hh"
+#include "serialize.hh"
+#include "xrange.hh"
+#include "xxhash.hh"
+#include "build-info.hh"
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace openmsx::BinarySavestate {
+
+// File layout (all integers in native byte order):
+//   Header
+//   platform string, version string (not zero terminated)
+//   Section[numSections]
+//   section data
+constexpr char MAGIC[8] = {'o', 'M', 'S', 'X', 'b', 'i', 'n', '\x1a'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+enum Compression : uint32_t { NONE = 0, LZ4 = 1 };
+
+struct Header {
+	char magic[8];
+	uint32_t formatVersion;
+	uint32_t byteOrderMark;
+	uint32_t platformLen;
+	uint32_t versionLen;
+	uint64_t numSections;
+};
+
+struct Section {
+	uint64_t offset;     // from start of file
+	uint64_t storedSize; // size in the file
+	uint64_t size;       // uncompressed size
+	uint32_t compression;
+	uint32_t hash;       // xxhash of the stored data
+};
+
+// A memory block that lives in the (memory mapped) file.
+class MappedDeltaBlock final : public DeltaBlock
+{
+public:
+	explicit MappedDeltaBlock(span<const uint8_t> data_)
+		: DeltaBlock(data_.size()), data(data_) {}
+	void apply(uint8_t* dst, size_t size) const override {
+		assert(size == data.size());
+		memcpy(dst, data.data(), size);
+	}
+	[[nodiscard]] size_t getAllocSize() const override { return 0; }
+private:
+	span<const uint8_t> data;
+};
+
+static uint32_t hashOf(span<const uint8_t> data)
+{
+	XXHash32 h;
+	h.update(data.data(), data.size());
+	return h.digest();
+}
+
+bool detect(const std::string& filename)
+{
+	try {
+		File file(filename);
+		if (file.getSize() < sizeof(Header)) return false;
+		char magic[sizeof(MAGIC)];
+		file.read(magic, sizeof(magic));
+		return memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+	} catch (FileException&) {
+		return false;
+	}
+}
+
+void save(const std::string& filename, MSXMotherBoard& board)
+{
+	LastDeltaBlocks lastDeltaBlocks;
+	std::vector<std::shared_ptr<DeltaBlock>> deltaBlocks;
+	MemOutputArchive out(lastDeltaBlocks, deltaBlocks, false);
+	out.serialize("machine", board);
+	size_t streamSize;
+	auto stream = out.releaseBuffer(streamSize);
+
+	// Collect (and possibly compress) the content of all sections.
+	struct Data {
+		MemBuffer<uint8_t> buf;
+		Section section;
+	};
+	auto numSections = 1 + deltaBlocks.size();
+	std::vector<Data> sections;
+	sections.reserve(numSections);
+	auto addSection = [&](MemBuffer<uint8_t>&& raw, size_t size) {
+		Data d;
+		d.section.size = size;
+		MemBuffer<uint8_t> buf(LZ4::compressBound(int(size)));
+		auto len = size_t(LZ4::compress(raw.data(), buf.data(), int(size)));
+		if (len < size) {
+			buf.resize(len);
+			d.buf = std::move(buf);
+			d.section.compression = LZ4;
+			d.section.storedSize = len;
+		} else {
+			d.buf = std::move(raw);
+			d.section.compression = NONE;
+			d.section.storedSize = size;
+		}
+		d.section.hash = hashOf({d.buf.data(), d.section.storedSize});
+		sections.push_back(std::move(d));
+	};
+	addSection(std::move(stream), streamSize);
+	for (const auto& block : deltaBlocks) {
+		auto size = block->getSize();
+		MemBuffer<uint8_t> raw(size);
+		block->apply(raw.data(), size);
+		addSection(std::move(raw), size);
+	}
+
+	std::string_view platform = TARGET_PLATFORM;
+	const auto& version = Version::full();
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.formatVersion = FORMAT_VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.platformLen = uint32_t(platform.size());
+	header.versionLen = uint32_t(version.size());
+	header.numSections = numSections;
+
+	uint64_t offset = sizeof(Header) + platform.size() + version.size()
+	                + numSections * sizeof(Section);
+	for (auto& d : sections) {
+		d.section.offset = offset;
+		offset += d.section.storedSize;
+	}
+
+	try {
+		File file(filename, File::TRUNCATE);
+		file.write(&header, sizeof(header));
+		file.write(platform.data(), platform.size());
+		file.write(version.data(), version.size());
+		for (const auto& d : sections) {
+			file.write(&d.section, sizeof(d.section));
+		}
+		for (const auto& d : sections) {
+			file.write(d.buf.data(), d.section.storedSize);
+		}
+	} catch (FileException& e) {
+		throw MSXException("Couldn't write savestate: ", e.getMessage());
+	}
+}
+
+void load(const std::string& filename, MSXMotherBoard& board)
+{
+	File file(filename);
+	auto data = file.mmap();
+	auto corrupt = [] {
+		return MSXException("Corrupt binary savestate.");
+	};
+
+	Header header;
+	if (data.size() < sizeof(header)) throw corrupt();
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw corrupt();
+	if (header.formatVersion != FORMAT_VERSION) {
+		throw MSXException("Unsupported binary savestate format version: ",
+		                   header.formatVersion);
+	}
+
+	size_t pos = sizeof(header);
+	auto getString = [&](size_t len) {
+		if ((data.size() - pos) < len) throw corrupt();
+		std::string_view result(reinterpret_cast<const char*>(data.data() + pos), len);
+		pos += len;
+		return result;
+	};
+	auto platform = getString(header.platformLen);
+	auto version  = getString(header.versionLen);
+	if ((header.byteOrderMark != BYTE_ORDER_MARK) ||
+	    (platform != TARGET_PLATFORM) || (version != Version::full())) {
+		throw MSXException(
+			"This binary savestate was created by a different openMSX "
+			"version or platform (", version, " on ", platform,
+			"). Binary savestates are not portable, use the XML "
+			"savestate format to exchange savestates.");
+	}
+
+	if (header.numSections == 0) throw corrupt();
+	if (((data.size() - pos) / sizeof(Section)) < header.numSections) throw corrupt();
+	std::vector<Section> table(header.numSections);
+	memcpy(table.data(), data.data() + pos, header.numSections * sizeof(Section));
+
+	// Uncompressed sections are used directly from the file mapping.
+	std::vector<MemBuffer<uint8_t>> buffers; // decompressed sections
+	std::vector<span<const uint8_t>> contents;
+	contents.reserve(table.size());
+	for (const auto& s : table) {
+		if ((s.offset > data.size()) ||
+		    (s.storedSize > (data.size() - s.offset))) {
+			throw corrupt();
+		}
+		auto stored = data.subspan(s.offset, s.storedSize);
+		// The data is not further validated (also not by the lz4
+		// decompression), so at least check it's not damaged.
+		if (hashOf(stored) != s.hash) throw corrupt();
+		if (s.compression == NONE) {
+			if (s.size != s.storedSize) throw corrupt();
+			contents.push_back(stored);
+		} else if (s.compression == LZ4) {
+			auto& buf = buffers.emplace_back(s.size);
+			int len = LZ4::decompress(stored.data(), buf.data(),
+			                          int(s.storedSize), int(s.size));
+			if (size_t(len) != s.size) throw corrupt();
+			contents.emplace_back(buf.data(), s.size);
+		} else {
+			throw corrupt();
+		}
+	}
+
+	std::vector<std::shared_ptr<DeltaBlock>> deltaBlocks;
+	deltaBlocks.reserve(contents.size() - 1);
+	for (auto i : xrange(size_t(1), contents.size())) {
+		deltaBlocks.push_back(std::make_shared<MappedDeltaBlock>(contents[i]));
+	}
+	MemInputArchive in(contents[0].data(), contents[0].size(), deltaBlocks);
+	in.serialize("machine", board);
+}
+
+} // namespace openmsx::BinarySavestate
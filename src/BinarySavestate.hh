@@ -0,0 +1,39 @@
+#ifndef BINARYSAVESTATE_HH
+#define BINARYSAVESTATE_HH
+
+#include <string>
+
+namespace openmsx {
+
+class MSXMotherBoard;
+
+/** Binary savestate file format.
+  *
+  * This is the (in memory) MemOutputArchive stream, the same as used for
+  * reverse snapshots, written to a file. The file consists of a header, a
+  * section table and the sections themselves. The first section is the
+  * archive stream, the other sections are the content of the big memory
+  * blocks (RAM, VRAM, ...) in the order they were serialized. Each section
+  * is optionally lz4-compressed (only when that makes it smaller).
+  *
+  * Loading memory-maps the file, uncompressed sections are used directly
+  * from that mapping. This makes loading a lot faster than for XML
+  * savestates. On the other hand, like MemOutputArchive itself, this format
+  * is not portable: it can only be loaded by the exact same openMSX version
+  * on the same platform. Use the XML format to exchange savestates.
+  */
+namespace BinarySavestate {
+
+	/** Does the given file start with the binary savestate signature? */
+	[[nodiscard]] bool detect(const std::string& filename);
+
+	/** @throws MSXException */
+	void save(const std::string& filename, MSXMotherBoard& board);
+
+	/** @throws MSXException */
+	void load(const std::string& filename, MSXMotherBoard& board);
+
+} // namespace BinarySavestate
+} // namespace openmsx
+
+#endif
@@ -42,7 +42,15 @@ GlobalSettings::GlobalSettings(GlobalCommandController& commandController_)
 		EnumSetting<ResampledSoundDevice::ResampleType>::Map{
 			{"hq",   ResampledSoundDevice::RESAMPLE_HQ},
 			{"fast", ResampledSoundDevice::RESAMPLE_LQ},
-			{"blip", ResampledSoundDevice::RESAMPLE_BLIP}})
+			{"blip", ResampledSoundDevice::RESAMPLE_BLIP},
+			{"poly", ResampledSoundDevice::RESAMPLE_POLY}})
+	, savestateFormatSetting(commandController, "savestate_format",
+		"File format for new savestates: the portable xml format or "
+		"the faster to load (but not portable) binary format",
+		SavestateFormat::XML,
+		EnumSetting<SavestateFormat>::Map{
+			{"xml",    SavestateFormat::XML},
+			{"binary", SavestateFormat::BINARY}})
 	, speedManager(commandController)
 	, throttleManager(commandController)
 {
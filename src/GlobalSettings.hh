@@ -16,6 +16,8 @@ namespace openmsx {
 
 class GlobalCommandController;
 
+enum class SavestateFormat { XML, BINARY };
+
 /**
  * This class contains settings that are used by several other class
  * (including some singletons). This class was introduced to solve
@@ -48,6 +50,9 @@ public:
 	[[nodiscard]] EnumSetting<ResampledSoundDevice::ResampleType>& getResampleSetting() {
 		return resampleSetting;
 	}
+	[[nodiscard]] EnumSetting<SavestateFormat>& getSavestateFormatSetting() {
+		return savestateFormatSetting;
+	}
 	[[nodiscard]] IntegerSetting& getJoyDeadzoneSetting(int i) {
 		return *deadzoneSettings[i];
 	}
@@ -72,6 +77,7 @@ private:
 	StringSetting  invalidPsgDirectionsSetting;
 	StringSetting  invalidPpiModeSetting;
 	EnumSetting<ResampledSoundDevice::ResampleType> resampleSetting;
+	EnumSetting<SavestateFormat> savestateFormatSetting;
 	std::vector<std::unique_ptr<IntegerSetting>> deadzoneSettings;
 	SpeedManager speedManager;
 	ThrottleManager throttleManager;
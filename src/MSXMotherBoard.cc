@@ -41,18 +41,23 @@
 #include "serialize.hh"
 #include "serialize_stl.hh"
 #include "ScopedAssign.hh"
+#include "enumerate.hh"
 #include "one_of.hh"
 #include "ranges.hh"
 #include "stl.hh"
 #include "unreachable.hh"
 #include "view.hh"
+#include "xrange.hh"
+#include <array>
 #include <cassert>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <sstream>
 
 using std::make_unique;
 using std::string;
+using namespace std::literals;
 
 namespace openmsx {
 
@@ -145,6 +150,29 @@ private:
 	MSXMotherBoard& motherBoard;
 };
 
+class MachineStateHashInfo final : public InfoTopic
+{
+public:
+	explicit MachineStateHashInfo(MSXMotherBoard& motherBoard);
+	void execute(span<const TclObject> tokens,
+	             TclObject& result) const override;
+	[[nodiscard]] string help(span<const TclObject> tokens) const override;
+private:
+	MSXMotherBoard& motherBoard;
+};
+
+class SchedulerProfileInfo final : public InfoTopic
+{
+public:
+	explicit SchedulerProfileInfo(MSXMotherBoard& motherBoard);
+	void execute(span<const TclObject> tokens,
+	             TclObject& result) const override;
+	[[nodiscard]] string help(span<const TclObject> tokens) const override;
+	void tabCompletion(std::vector<string>& tokens) const override;
+private:
+	MSXMotherBoard& motherBoard;
+};
+
 class DeviceInfo final : public InfoTopic
 {
 public:
@@ -220,6 +248,8 @@ MSXMotherBoard::MSXMotherBoard(Reactor& reactor_)
 	machineNameInfo = make_unique<MachineNameInfo>(*this);
 	machineTypeInfo = make_unique<MachineTypeInfo>(*this);
 	machineExtensionInfo = make_unique<MachineExtensionInfo>(*this);
+	machineStateHashInfo = make_unique<MachineStateHashInfo>(*this);
+	schedulerProfileInfo = make_unique<SchedulerProfileInfo>(*this);
 	deviceInfo = make_unique<DeviceInfo>(*this);
 	debugger = make_unique<Debugger>(*this);
 
@@ -941,6 +971,171 @@ string MachineNameInfo::help(span<const TclObject> /*tokens*/) const
 	return "Returns the configuration name for this machine.";
 }
 
+// MachineStateHashInfo
+
+MachineStateHashInfo::MachineStateHashInfo(MSXMotherBoard& motherBoard_)
+	: InfoTopic(motherBoard_.getMachineInfoCommand(), "state_hash")
+	, motherBoard(motherBoard_)
+{
+}
+
+static TclObject hashTreeToTcl(const HashOutputArchive::Node& node)
+{
+	TclObject result = makeTclDict(
+		"tag",  node.tag,
+		"hash", strCat(hex_string<8>(node.hash)));
+	if (!node.type.empty()) result.addDictKeyValue("type", node.type);
+	if (!node.name.empty()) result.addDictKeyValue("name", node.name);
+	if (!node.children.empty()) {
+		TclObject children;
+		children.addListElements(view::transform(node.children, hashTreeToTcl));
+		result.addDictKeyValue("children", children);
+	}
+	return result;
+}
+
+void MachineStateHashInfo::execute(span<const TclObject> tokens,
+                                   TclObject& result) const
+{
+	// Hash all data that would go into a savestate (the same data as a
+	// non-reverse snapshot) without actually creating that savestate.
+	checkNumArgs(tokens, Between{2, 3}, Prefix{2}, "?depth?");
+	if (tokens.size() == 2) {
+		HashOutputArchive out;
+		out.serialize("machine", motherBoard);
+		result = strCat(hex_string<8>(out.getHash()));
+	} else {
+		int depth = tokens[2].getInt(getInterpreter());
+		if (depth < 0) {
+			throw CommandException("depth must be non-negative");
+		}
+		// +1 for the 'machine' tag itself
+		HashOutputArchive out(unsigned(depth) + 1);
+		out.serialize("machine", motherBoard);
+		auto tree = out.releaseTree();
+		assert(tree.children.size() == 1);
+		result = hashTreeToTcl(tree.children.front());
+	}
+}
+
+string MachineStateHashInfo::help(span<const TclObject> /*tokens*/) const
+{
+	return "Returns a hash of the complete state of this machine. Two "
+	       "machines with the same hash are (very likely) in the exact "
+	       "same state, e.g. useful to verify a replay.\n"
+	       "With a depth argument, returns a tree (as a dict with keys "
+	       "tag, hash, type, name and children) with a hash for each "
+	       "part of the machine state up to that depth. Comparing two "
+	       "such trees shows which device (or even which part of a "
+	       "device) is different.";
+}
+
+// SchedulerProfileInfo
+
+SchedulerProfileInfo::SchedulerProfileInfo(MSXMotherBoard& motherBoard_)
+	: InfoTopic(motherBoard_.getMachineInfoCommand(), "scheduler_profile")
+	, motherBoard(motherBoard_)
+{
+}
+
+static string counterName(SchedulerCounter c)
+{
+	std::ostringstream os;
+	os << EnumValueName{c};
+	return os.str();
+}
+
+static string jsonString(std::string_view str)
+{
+	string result = "\"";
+	for (char c : str) {
+		if ((c == '"') || (c == '\\')) result += '\\';
+		result += c;
+	}
+	result += '"';
+	return result;
+}
+
+void SchedulerProfileInfo::execute(span<const TclObject> tokens,
+                                   TclObject& result) const
+{
+	if constexpr (!PROFILE_SCHEDULER) {
+		throw CommandException(
+			"Scheduler profiling is not enabled in this build, "
+			"see PROFILE_SCHEDULER in Scheduler.hh.");
+	}
+	checkNumArgs(tokens, Between{2, 3}, Prefix{2}, "?json|reset?");
+	auto& scheduler = motherBoard.getScheduler();
+	std::string_view format = (tokens.size() == 3) ? tokens[2].getString() : "";
+	if (format == "reset") {
+		scheduler.resetProfile();
+		return;
+	}
+	auto counters = xrange(size_t(SchedulerCounter::NUM));
+	auto types = scheduler.getProfile();
+	if (format == "json") {
+		std::ostringstream json;
+		json << "{\"counters\": {";
+		for (auto i : counters) {
+			auto c = SchedulerCounter(i);
+			json << (i ? ", " : "") << jsonString(counterName(c))
+			     << ": " << scheduler.getCount(c);
+		}
+		json << "}, \"types\": [";
+		for (auto [i, p] : enumerate(types)) {
+			json << (i ? ", " : "")
+			     << "{\"name\": " << jsonString(p.name)
+			     << ", \"execute_until\": " << p.executeUntil
+			     << ", \"host_ns\": " << p.hostNs
+			     << ", \"set_sync_point\": " << p.setSyncPoint
+			     << ", \"remove_sync_point\": " << p.removeSyncPoint
+			     << ", \"lead_time\": " << p.leadTime.toDouble() << '}';
+		}
+		json << "]}";
+		result = json.str();
+	} else if (format.empty()) {
+		TclObject counterDict;
+		for (auto i : counters) {
+			auto c = SchedulerCounter(i);
+			counterDict.addDictKeyValue(counterName(c), scheduler.getCount(c));
+		}
+		TclObject typeList;
+		typeList.addListElements(view::transform(types, [](const auto& p) {
+			return makeTclDict(
+				"name",              p.name,
+				"execute_until",     int64_t(p.executeUntil),
+				"host_ns",           int64_t(p.hostNs),
+				"set_sync_point",    int64_t(p.setSyncPoint),
+				"remove_sync_point", int64_t(p.removeSyncPoint),
+				"lead_time",         p.leadTime.toDouble());
+		}));
+		result = makeTclDict("counters", counterDict, "types", typeList);
+	} else {
+		throw CommandException("Unknown option: ", format);
+	}
+}
+
+string SchedulerProfileInfo::help(span<const TclObject> /*tokens*/) const
+{
+	return "Returns scheduler profile data (only available when openMSX "
+	       "was built with PROFILE_SCHEDULER enabled): the total number "
+	       "of setSyncPoint(), removeSyncPoint(), removeSyncPoints() and "
+	       "executeUntil() calls, and per Schedulable type the number of "
+	       "calls, the host time spent in executeUntil() (in ns) and the "
+	       "total emulated time (in s) between setting a sync point and "
+	       "its due time. Types are sorted on decreasing host time.\n"
+	       "With 'json' the same data is returned as a JSON string, "
+	       "'reset' clears all collected data.";
+}
+
+void SchedulerProfileInfo::tabCompletion(std::vector<string>& tokens) const
+{
+	if (tokens.size() == 3) {
+		static constexpr std::array options = {"json"sv, "reset"sv};
+		completeString(tokens, options);
+	}
+}
+
 // MachineTypeInfo
 
 MachineTypeInfo::MachineTypeInfo(MSXMotherBoard& motherBoard_)
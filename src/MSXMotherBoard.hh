@@ -35,7 +35,9 @@ class ListExtCmd;
 class LoadMachineCmd;
 class MachineExtensionInfo;
 class MachineNameInfo;
+class MachineStateHashInfo;
 class MachineTypeInfo;
+class SchedulerProfileInfo;
 class MSXCliComm;
 class MSXCommandController;
 class MSXCPU;
@@ -263,6 +265,8 @@ private:
 	std::unique_ptr<MachineNameInfo> machineNameInfo;
 	std::unique_ptr<MachineTypeInfo> machineTypeInfo;
 	std::unique_ptr<MachineExtensionInfo> machineExtensionInfo;
+	std::unique_ptr<MachineStateHashInfo> machineStateHashInfo;
+	std::unique_ptr<SchedulerProfileInfo> schedulerProfileInfo;
 	std::unique_ptr<DeviceInfo>   deviceInfo;
 	friend class DeviceInfo;
 
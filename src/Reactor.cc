@@ -1,4 +1,5 @@
 #include "Reactor.hh"
+#include "BinarySavestate.hh"
 #include "CommandLineParser.hh"
 #include "RTScheduler.hh"
 #include "EventDistributor.hh"
@@ -25,6 +26,7 @@
 #include "VideoSystem.hh"
 #include "Mixer.hh"
 #include "AviRecorder.hh"
+#include "FrameCapture.hh"
 #include "GlobalSettings.hh"
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
@@ -258,6 +260,7 @@ void Reactor::init()
 	setClipboardCommand = make_unique<SetClipboardCommand>(
 		*globalCommandController, *this);
 	aviRecordCommand = make_unique<AviRecorder>(*this);
+	frameCaptureCommand = make_unique<FrameCapture>(*this);
 	extensionInfo = make_unique<ConfigInfo>(
 		getOpenMSXInfoCommand(), "extensions");
 	machineInfo   = make_unique<ConfigInfo>(
@@ -885,16 +888,19 @@ StoreMachineCommand::StoreMachineCommand(
 void StoreMachineCommand::execute(span<const TclObject> tokens, TclObject& result)
 {
 	checkNumArgs(tokens, Between{1, 3}, Prefix{1}, "?id? ?filename?");
+	bool binary = reactor.getGlobalSettings().getSavestateFormatSetting().getEnum() ==
+	              SavestateFormat::BINARY;
+	const char* extension = binary ? ".oms" : ".xml.gz";
 	string filename;
 	string_view machineID;
 	switch (tokens.size()) {
 	case 1:
 		machineID = reactor.getMachineID();
-		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", ".xml.gz");
+		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", extension);
 		break;
 	case 2:
 		machineID = tokens[1].getString();
-		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", ".xml.gz");
+		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", extension);
 		break;
 	case 3:
 		machineID = tokens[1].getString();
@@ -904,9 +910,13 @@ void StoreMachineCommand::execute(span<const TclObject> tokens, TclObject& resul
 
 	auto& board = *reactor.getMachine(machineID);
 
-	XmlOutputArchive out(filename);
-	out.serialize("machine", board);
-	out.close();
+	if (binary) {
+		BinarySavestate::save(filename, board);
+	} else {
+		XmlOutputArchive out(filename);
+		out.serialize("machine", board);
+		out.close();
+	}
 	result = filename;
 }
 
@@ -917,6 +927,8 @@ string StoreMachineCommand::help(span<const TclObject> /*tokens*/) const
 		"store_machine machineID             Save state of machine \"machineID\" to file \"openmsxNNNN.xml.gz\"\n"
 		"store_machine machineID <filename>  Save state of machine \"machineID\" to indicated file\n"
 		"\n"
+		"The 'savestate_format' setting selects the file format (for the binary format\n"
+		"the default filename is \"openmsxNNNN.oms\").\n"
 		"This is a low-level command, the 'savestate' script is easier to use.";
 }
 
@@ -968,8 +980,14 @@ void RestoreMachineCommand::execute(span<const TclObject> tokens,
 
 	//std::cerr << "Loading " << filename << '\n';
 	try {
-		XmlInputArchive in(filename);
-		in.serialize("machine", *newBoard);
+		// The format is detected from the file content, not from
+		// the 'savestate_format' setting.
+		if (BinarySavestate::detect(filename)) {
+			BinarySavestate::load(filename, *newBoard);
+		} else {
+			XmlInputArchive in(filename);
+			in.serialize("machine", *newBoard);
+		}
 	} catch (XMLException& e) {
 		throw CommandException("Cannot load state, bad file format: ",
 		                       e.getMessage());
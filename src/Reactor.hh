@@ -49,6 +49,7 @@ class RestoreMachineCommand;
 class GetClipboardCommand;
 class SetClipboardCommand;
 class AviRecorder;
+class FrameCapture;
 class ConfigInfo;
 class RealTimeInfo;
 class SoftwareInfoTopic;
@@ -173,6 +174,7 @@ private:
 	std::unique_ptr<GetClipboardCommand> getClipboardCommand;
 	std::unique_ptr<SetClipboardCommand> setClipboardCommand;
 	std::unique_ptr<AviRecorder> aviRecordCommand;
+	std::unique_ptr<FrameCapture> frameCaptureCommand;
 	std::unique_ptr<ConfigInfo> extensionInfo;
 	std::unique_ptr<ConfigInfo> machineInfo;
 	std::unique_ptr<RealTimeInfo> realTimeInfo;
@@ -19,12 +19,14 @@
 #include "Display.hh"
 #include "Reactor.hh"
 #include "CommandException.hh"
+#include "FileException.hh"
 #include "MemBuffer.hh"
 #include "one_of.hh"
 #include "ranges.hh"
 #include "serialize.hh"
 #include "serialize_meta.hh"
 #include "view.hh"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iomanip>
@@ -43,8 +45,24 @@ constexpr auto MIN_PARTITION_LENGTH = EmuDuration(60.0);
 // Max distance of one before last snapshot before the end time in replay file (in seconds)
 constexpr auto MAX_DIST_1_BEFORE_LAST_SNAPSHOT = EmuDuration(30.0);
 
+// When jumping to a point in time that is far away from the nearest
+// snapshot, take a snapshot each SNAPSHOT_PERIOD in this window (in seconds)
+// before the target. This speeds up further jumps around that target.
+constexpr double SCRUB_WINDOW = 10.0;
+
 constexpr const char* const REPLAY_DIR = "replays";
 
+// Snapshots that were moved to disk (see 'reverse_memory_budget') may in
+// total take this many times the memory budget. When more is needed, the
+// spilled snapshots are thinned out.
+constexpr size_t SPILL_BUDGET_FACTOR = 4;
+
+// Moving a snapshot to disk (expanding and compressing all its blocks)
+// happens on the emulation thread. To limit the pause, move at most this
+// many snapshots after each new snapshot. Snapshots are added one at a
+// time, so this still catches up with a (lowered) budget.
+constexpr unsigned MAX_SPILLS_PER_SNAPSHOT = 2;
+
 // A replay is a struct that contains a vector of motherboards and an MSX event
 // log. Those combined are a replay, because you can replay the events from an
 // existing motherboard state: the vector has to have at least one motherboard
@@ -103,6 +121,7 @@ void ReverseManager::ReverseHistory::swap(ReverseHistory& other) noexcept
 {
 	std::swap(chunks, other.chunks);
 	std::swap(events, other.events);
+	spillFile.swap(other.spillFile);
 }
 
 void ReverseManager::ReverseHistory::clear()
@@ -110,6 +129,103 @@ void ReverseManager::ReverseHistory::clear()
 	// clear() and free storage capacity
 	Chunks().swap(chunks);
 	Events().swap(events);
+	spillFile.clear();
+}
+
+void ReverseManager::ReverseHistory::restore(
+	const ReverseChunk& chunk, MSXMotherBoard& board)
+{
+	if (chunk.spilled) {
+		MemBuffer<uint8_t> savestate;
+		std::vector<std::shared_ptr<DeltaBlock>> deltaBlocks;
+		spillFile.load(*chunk.spilled, savestate, deltaBlocks);
+		MemInputArchive in(savestate.data(), chunk.size, deltaBlocks);
+		in.serialize("machine", board);
+	} else {
+		MemInputArchive in(chunk.savestate.data(), chunk.size,
+		                   chunk.deltaBlocks);
+		in.serialize("machine", board);
+	}
+}
+
+ReverseManager::ReverseChunk& ReverseManager::ReverseHistory::findSnapshot(
+	EmuTime::param time)
+{
+	// Sequence numbers are derived from the snapshot time, so the order
+	// of the keys matches the order in time. All snapshots with a
+	// bigger sequence number are newer, at most one snapshot (the one
+	// with the same sequence number) must be checked explicitly.
+	assert(!chunks.empty());
+	assert(begin(chunks)->second.time <= time);
+	auto it = chunks.upper_bound(getNextSeqNum(time));
+	do {
+		assert(it != begin(chunks));
+		--it;
+	} while (it->second.time > time);
+	return it->second;
+}
+
+bool ReverseManager::ReverseHistory::hasSnapshot(EmuTime::param time) const
+{
+	return chunks.find(getNextSeqNum(time)) != end(chunks);
+}
+
+size_t ReverseManager::ReverseHistory::getResidentSize() const
+{
+	// DeltaBlocks are shared between snapshots, only count them once.
+	size_t result = 0;
+	std::vector<const DeltaBlock*> blocks;
+	for (const auto& [idx, chunk] : chunks) {
+		if (chunk.spilled) continue;
+		result += chunk.size;
+		for (const auto& b : chunk.deltaBlocks) {
+			blocks.push_back(b.get());
+			if (const auto* diff = dynamic_cast<const DeltaBlockDiff*>(b.get())) {
+				blocks.push_back(&diff->getPrev());
+			}
+		}
+	}
+	ranges::sort(blocks);
+	blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+	for (const auto* b : blocks) {
+		result += b->getAllocSize();
+	}
+	return result;
+}
+
+// Move the given snapshot to the spill file. Returns (an estimate of) the
+// amount of memory that was freed, so the caller doesn't have to recalculate
+// getResidentSize().
+size_t ReverseManager::ReverseHistory::spill(ReverseChunk& chunk)
+{
+	assert(!chunk.spilled);
+	chunk.spilled = spillFile.store(
+		{chunk.savestate.data(), chunk.size}, chunk.deltaBlocks);
+
+	// DeltaBlocks that are still shared with other snapshots (or with the
+	// background compressor) remain in memory.
+	size_t freed = chunk.size;
+	for (const auto& b : chunk.deltaBlocks) {
+		if (b.use_count() != 1) continue;
+		freed += b->getAllocSize();
+		if (const auto* diff = dynamic_cast<const DeltaBlockDiff*>(b.get())) {
+			if (!diff->isPrevShared()) {
+				freed += diff->getPrev().getAllocSize();
+			}
+		}
+	}
+	chunk.savestate.clear();
+	std::vector<std::shared_ptr<DeltaBlock>>().swap(chunk.deltaBlocks);
+	return freed;
+}
+
+size_t ReverseManager::ReverseHistory::getSpilledSize() const
+{
+	size_t result = 0;
+	for (const auto& [idx, chunk] : chunks) {
+		if (chunk.spilled) result += chunk.spilled->size;
+	}
+	return result;
 }
 
 
@@ -137,6 +253,12 @@ ReverseManager::ReverseManager(MSXMotherBoard& motherBoard_)
 	, motherBoard(motherBoard_)
 	, eventDistributor(motherBoard.getReactor().getEventDistributor())
 	, reverseCmd(motherBoard.getCommandController())
+	, memoryBudgetSetting(motherBoard.getCommandController(),
+		"reverse_memory_budget",
+		"Maximum amount of memory (in MB) used by the reverse history, "
+		"older snapshots are moved to disk when it is exceeded. "
+		"0 means no limit.",
+		0, 0, 1024 * 1024)
 	, keyboard(nullptr)
 	, eventDelay(nullptr)
 	, replayIndex(0)
@@ -233,6 +355,9 @@ void ReverseManager::status(TclObject& result) const
 	}
 	EmuTime le(isCollecting() && (lastEvent != rend(history.events)) ? (*lastEvent)->getTime() : EmuTime::zero());
 	result.addDictKeyValue("last_event", (le - EmuTime::zero()).toDouble());
+
+	result.addDictKeyValue("resident_bytes", int64_t(history.getResidentSize()));
+	result.addDictKeyValue("spilled_bytes",  int64_t(history.getSpilledSize()));
 }
 
 void ReverseManager::debugInfo(TclObject& result) const
@@ -241,15 +366,26 @@ void ReverseManager::debugInfo(TclObject& result) const
 	// information means nothing. We should remove this later.
 	std::string res;
 	size_t totalSize = 0;
+	uint64_t totalPause = 0;
+	uint64_t maxPause = 0;
 	for (const auto& [idx, chunk] : history.chunks) {
 		strAppend(res, idx, ' ',
 		          (chunk.time - EmuTime::zero()).toDouble(), ' ',
 		          ((chunk.time - EmuTime::zero()).toDouble() / (getCurrentTime() - EmuTime::zero()).toDouble()) * 100, "%"
 		          " (", chunk.size, ")"
-		          " (next event index: ", chunk.eventCount, ")\n");
+		          " (next event index: ", chunk.eventCount, ")"
+		          " (pause: ", chunk.pauseTime, "us)",
+		          (chunk.spilled ? " (spilled)\n" : "\n"));
 		totalSize += chunk.size;
+		totalPause += chunk.pauseTime;
+		maxPause = std::max(maxPause, chunk.pauseTime);
 	}
 	strAppend(res, "total size: ", totalSize, '\n');
+	if (!history.chunks.empty()) {
+		strAppend(res, "snapshot pause: average ",
+		          totalPause / history.chunks.size(), "us, max ",
+		          maxPause, "us\n");
+	}
 	result = res;
 }
 
@@ -352,18 +488,7 @@ void ReverseManager::goTo(
 		                  : firstTime;
 
 		// find oldest snapshot that is not newer than requested time
-		// TODO ATM we do a linear search, could be improved to do a binary search.
-		assert(it->second.time <= preTarget); // first one is not newer
-		assert(it != end(hist.chunks)); // there are snapshots
-		do {
-			++it;
-		} while (it != end(hist.chunks) &&
-			 it->second.time <= preTarget);
-		// We found the first one that's newer, previous one is last
-		// one that's not newer (thus older or equal).
-		assert(it != begin(hist.chunks));
-		--it;
-		ReverseChunk& chunk = it->second;
+		ReverseChunk& chunk = hist.findSnapshot(preTarget);
 		EmuTime snapshotTime = chunk.time;
 		assert(snapshotTime <= preTarget);
 
@@ -389,10 +514,7 @@ void ReverseManager::goTo(
 			// -- restore old snapshot --
 			newBoard_ = reactor.createEmptyMotherBoard();
 			newBoard = newBoard_.get();
-			MemInputArchive in(chunk.savestate.data(),
-					   chunk.size,
-					   chunk.deltaBlocks);
-			in.serialize("machine", *newBoard);
+			hist.restore(chunk, *newBoard);
 
 			if (eventDelay) {
 				// Handle all events that are scheduled, but not yet
@@ -426,11 +548,18 @@ void ReverseManager::goTo(
 		// Fast forward 2 frames before target time.
 		// If we're short on snapshots, create them at intervals that are
 		// at least the usual interval, but the later, the more: each
-		// time divide the remaining time in half and make a snapshot
-		// there.
+		// time divide the remaining time (till the start of the scrub
+		// window) in half and make a snapshot there. Within the scrub
+		// window, right before the target, take a snapshot each
+		// interval. So when the user then jumps around close to this
+		// target (e.g. repeatedly goes back a few seconds) there's
+		// always a nearby snapshot and little needs to be re-emulated.
 		auto lastProgress = Timer::getTime();
 		auto startMSXTime = newBoard->getCurrentTime();
 		auto lastSnapshotTarget = startMSXTime;
+		auto scrubStart = ((preTarget - startMSXTime) > EmuDuration(SCRUB_WINDOW))
+		                ? preTarget - EmuDuration(SCRUB_WINDOW)
+		                : startMSXTime;
 		bool everShowedProgress = false;
 		syncNewSnapshot.removeSyncPoint(); // don't schedule new snapshot takings during fast forward
 		while (true) {
@@ -439,7 +568,9 @@ void ReverseManager::goTo(
 				preTarget,
 				lastSnapshotTarget + std::max(
 					EmuDuration(SNAPSHOT_PERIOD),
-					(preTarget - lastSnapshotTarget) / 2
+					(lastSnapshotTarget < scrubStart)
+						? (scrubStart - lastSnapshotTarget) / 2
+						: EmuDuration::zero()
 					));
 			auto nextTarget = std::min(nextSnapshotTarget, currentTimeNewBoard + EmuDuration::sec(1));
 			newBoard->fastForward(nextTarget, true);
@@ -460,7 +591,12 @@ void ReverseManager::goTo(
 				// processing of hotkeys, which can cause things like the machine
 				// being deleted, causing a crash. TODO: find a better way to support
 				// live updates of the UI whilst being in a reverse action...
-				newBoard->getReverseManager().takeSnapshot(currentTimeNewBoard);
+				// A snapshot from an earlier visit of this part of
+				// the time-line can be reused.
+				auto& newManager = newBoard->getReverseManager();
+				if (!newManager.history.hasSnapshot(currentTimeNewBoard)) {
+					newManager.takeSnapshot(currentTimeNewBoard);
+				}
 				lastSnapshotTarget = nextSnapshotTarget;
 			}
 		}
@@ -553,10 +689,7 @@ void ReverseManager::saveReplay(
 
 	// restore first snapshot to be able to serialize it to a file
 	auto initialBoard = reactor.createEmptyMotherBoard();
-	MemInputArchive in(begin(chunks)->second.savestate.data(),
-	                   begin(chunks)->second.size,
-			   begin(chunks)->second.deltaBlocks);
-	in.serialize("machine", *initialBoard);
+	history.restore(begin(chunks)->second, *initialBoard);
 	replay.motherBoards.push_back(std::move(initialBoard));
 
 	if (maxNofExtraSnapshots > 0) {
@@ -582,10 +715,7 @@ void ReverseManager::saveReplay(
 				if (it != lastAddedIt) {
 					// this is a new one, add it to the list of snapshots
 					Reactor::Board board = reactor.createEmptyMotherBoard();
-					MemInputArchive in2(it->second.savestate.data(),
-							    it->second.size,
-							    it->second.deltaBlocks);
-					in2.serialize("machine", *board);
+					history.restore(it->second, *board);
 					replay.motherBoards.push_back(std::move(board));
 					lastAddedIt = it;
 				}
@@ -856,6 +986,7 @@ void ReverseManager::takeSnapshot(EmuTime::param time)
 	// the same moment in time).
 
 	// actually create new snapshot
+	auto startTime = Timer::getTime();
 	ReverseChunk& newChunk = history.chunks[seqNum];
 	newChunk.deltaBlocks.clear();
 	MemOutputArchive out(history.lastDeltaBlocks, newChunk.deltaBlocks, true);
@@ -863,6 +994,13 @@ void ReverseManager::takeSnapshot(EmuTime::param time)
 	newChunk.time = time;
 	newChunk.savestate = out.releaseBuffer(newChunk.size);
 	newChunk.eventCount = replayIndex;
+	newChunk.spilled.reset();
+
+	// Free the uncompressed versions of the blocks that were compressed in
+	// the background, also before checking the memory budget.
+	history.lastDeltaBlocks.installCompressed();
+	applyMemoryBudget();
+	newChunk.pauseTime = Timer::getTime() - startTime;
 }
 
 void ReverseManager::replayNextEvent()
@@ -925,6 +1063,74 @@ void ReverseManager::dropOldSnapshots(unsigned count)
 	}
 }
 
+void ReverseManager::applyMemoryBudget()
+{
+	size_t budget = size_t(memoryBudgetSetting.getInt()) * 1024 * 1024;
+	if (budget == 0) return;
+	auto& chunks = history.chunks;
+	assert(!chunks.empty());
+	const auto* newest = &rbegin(chunks)->second;
+
+	// First move the oldest snapshots to disk (but keep the most recent
+	// one in memory). Because DeltaBlocks are shared with later snapshots,
+	// this doesn't always immediately free memory.
+	size_t resident = history.getResidentSize();
+	unsigned numSpills = 0;
+	try {
+		for (auto& [idx, chunk] : chunks) {
+			if (&chunk == newest) break;
+			if (resident <= budget) break;
+			if (numSpills == MAX_SPILLS_PER_SNAPSHOT) break;
+			if (chunk.spilled) continue;
+			resident -= std::min(resident, history.spill(chunk));
+			++numSpills;
+		}
+	} catch (FileException& e) {
+		motherBoard.getMSXCliComm().printWarning(
+			"Couldn't move reverse snapshot to disk: ", e.getMessage());
+	}
+
+	// Then thin out the spilled snapshots, drop every other one (but
+	// never the very first snapshot).
+	while (history.getSpilledSize() > SPILL_BUDGET_FACTOR * budget) {
+		bool dropNext = true;
+		bool dropped = false;
+		for (auto it = std::next(begin(chunks)); it != end(chunks); /**/) {
+			if (!it->second.spilled) {
+				++it;
+			} else if (dropNext) {
+				it = chunks.erase(it);
+				dropNext = false;
+				dropped = true;
+			} else {
+				++it;
+				dropNext = true;
+			}
+		}
+		if (!dropped) break;
+	}
+
+	// The spill file only grows, rewrite it when it contains mostly
+	// dropped snapshots.
+	if (history.spillFile.getFileSize() > 2 * history.getSpilledSize() + budget) {
+		try {
+			ReverseSpillFile newFile;
+			std::vector<std::pair<ReverseChunk*, ReverseSpillFile::Pos>> newPos;
+			for (auto& [idx, chunk] : chunks) {
+				if (!chunk.spilled) continue;
+				newPos.emplace_back(&chunk, newFile.copyFrom(
+					history.spillFile, *chunk.spilled));
+			}
+			for (auto& [chunk, pos] : newPos) chunk->spilled = pos;
+			history.spillFile.swap(newFile);
+		} catch (FileException& e) {
+			// keep using the old file
+			motherBoard.getMSXCliComm().printWarning(
+				"Couldn't compact reverse spill file: ", e.getMessage());
+		}
+	}
+}
+
 void ReverseManager::schedule(EmuTime::param time)
 {
 	syncNewSnapshot.setSyncPoint(time + EmuDuration(SNAPSHOT_PERIOD));
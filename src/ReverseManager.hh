@@ -5,14 +5,17 @@
 #include "EventListener.hh"
 #include "Command.hh"
 #include "EmuTime.hh"
+#include "IntegerSetting.hh"
 #include "MemBuffer.hh"
 #include "DeltaBlock.hh"
+#include "ReverseSpillFile.hh"
 #include "span.hh"
 #include "outer.hh"
 #include <cstdint>
 #include <deque>
 #include <map>
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace openmsx {
@@ -75,6 +78,14 @@ private:
 		// snapshot was created. So when going back replay should
 		// start at this index.
 		unsigned eventCount;
+
+		// Time (in us) the emulation thread was blocked while
+		// creating this snapshot. Only for 'reverse debug'.
+		uint64_t pauseTime = 0;
+
+		// When set, 'savestate' and 'deltaBlocks' are moved to the
+		// spill file (see ReverseHistory).
+		std::optional<ReverseSpillFile::Pos> spilled;
 	};
 	using Chunks = std::map<unsigned, ReverseChunk>;
 	using Events = std::deque<std::unique_ptr<StateChange>>;
@@ -83,10 +94,17 @@ private:
 		void swap(ReverseHistory& other) noexcept;
 		void clear();
 		[[nodiscard]] unsigned getNextSeqNum(EmuTime::param time) const;
+		[[nodiscard]] ReverseChunk& findSnapshot(EmuTime::param time);
+		[[nodiscard]] bool hasSnapshot(EmuTime::param time) const;
+		void restore(const ReverseChunk& chunk, MSXMotherBoard& board);
+		[[nodiscard]] size_t getResidentSize() const;
+		size_t spill(ReverseChunk& chunk);
+		[[nodiscard]] size_t getSpilledSize() const;
 
 		Chunks chunks;
 		Events events;
 		LastDeltaBlocks lastDeltaBlocks;
+		ReverseSpillFile spillFile;
 	};
 
 	[[nodiscard]] bool isCollecting() const { return collecting; }
@@ -114,6 +132,7 @@ private:
 	void schedule(EmuTime::param time);
 	void replayNextEvent();
 	template<unsigned N> void dropOldSnapshots(unsigned count);
+	void applyMemoryBudget();
 
 	// Schedulable
 	struct SyncNewSnapshot final : Schedulable {
@@ -151,6 +170,8 @@ private:
 		void tabCompletion(std::vector<std::string>& tokens) const override;
 	} reverseCmd;
 
+	IntegerSetting memoryBudgetSetting; // in MB, 0 means unlimited
+
 	Keyboard* keyboard;
 	EventDelay* eventDelay;
 	ReverseHistory history;
@@ -0,0 +1,140 @@
+#include "ReverseSpillFile.hh"
+#include "DeltaBlock.hh"
+#include "FileException.hh"
+#include "FileOperations.hh"
+#include "lz4.hh"
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace openmsx {
+
+ReverseSpillFile::~ReverseSpillFile()
+{
+	clear();
+}
+
+void ReverseSpillFile::swap(ReverseSpillFile& other) noexcept
+{
+	std::swap(file, other.file);
+	std::swap(filename, other.filename);
+	std::swap(fileSize, other.fileSize);
+}
+
+void ReverseSpillFile::clear()
+{
+	if (filename.empty()) return;
+	file.close();
+	FileOperations::unlink(filename);
+	filename.clear();
+	fileSize = 0;
+}
+
+void ReverseSpillFile::prepareWrite()
+{
+	if (filename.empty()) {
+		auto fp = FileOperations::openUniqueFile(
+			FileOperations::getTempDir(), filename);
+		if (!fp) {
+			throw FileException("Couldn't create reverse spill file");
+		}
+		fp.reset();
+		file = File(filename, "wb+");
+		fileSize = 0;
+	}
+	// the file grows, so an existing mapping would become too small
+	file.munmap();
+	file.seek(fileSize);
+}
+
+span<const uint8_t> ReverseSpillFile::map(Pos pos)
+{
+	auto data = file.mmap();
+	assert((pos.offset + pos.size) <= data.size());
+	return data.subspan(pos.offset, pos.size);
+}
+
+// The lz4 routines don't do any safety checks while decompressing. That's OK
+// here because we only read back data that we wrote ourselves.
+static void writeCompressed(File& file, const uint8_t* data, size_t size)
+{
+	MemBuffer<uint8_t> buf(LZ4::compressBound(int(size)));
+	uint64_t len = LZ4::compress(data, buf.data(), int(size));
+	uint64_t sz = size;
+	file.write(&sz, sizeof(sz));
+	file.write(&len, sizeof(len));
+	file.write(buf.data(), len);
+}
+
+template<typename T> static T readValue(const uint8_t*& p)
+{
+	T result;
+	memcpy(&result, p, sizeof(result));
+	p += sizeof(result);
+	return result;
+}
+
+static size_t readCompressed(const uint8_t*& p, MemBuffer<uint8_t>& buf)
+{
+	auto size = readValue<uint64_t>(p);
+	auto len  = readValue<uint64_t>(p);
+	buf.resize(size);
+	LZ4::decompress(p, buf.data(), int(len), int(size));
+	p += len;
+	return size;
+}
+
+ReverseSpillFile::Pos ReverseSpillFile::store(
+	span<const uint8_t> savestate,
+	span<const std::shared_ptr<DeltaBlock>> deltaBlocks)
+{
+	prepareWrite();
+	Pos pos{fileSize, 0};
+
+	writeCompressed(file, savestate.data(), savestate.size());
+	uint64_t num = deltaBlocks.size();
+	file.write(&num, sizeof(num));
+	MemBuffer<uint8_t> buf;
+	for (const auto& block : deltaBlocks) {
+		auto size = block->getSize();
+		buf.resize(size);
+		block->apply(buf.data(), size);
+		writeCompressed(file, buf.data(), size);
+	}
+	file.flush();
+
+	fileSize = file.getPos();
+	pos.size = fileSize - pos.offset;
+	return pos;
+}
+
+ReverseSpillFile::Pos ReverseSpillFile::copyFrom(ReverseSpillFile& other, Pos pos)
+{
+	auto data = other.map(pos);
+	prepareWrite();
+	Pos result{fileSize, pos.size};
+	file.write(data.data(), data.size());
+	file.flush();
+	fileSize += pos.size;
+	return result;
+}
+
+void ReverseSpillFile::load(Pos pos, MemBuffer<uint8_t>& savestate,
+                            std::vector<std::shared_ptr<DeltaBlock>>& deltaBlocks)
+{
+	auto data = map(pos);
+	const uint8_t* p = data.data();
+
+	readCompressed(p, savestate);
+	auto num = readValue<uint64_t>(p);
+	deltaBlocks.clear();
+	deltaBlocks.reserve(num);
+	MemBuffer<uint8_t> buf;
+	for (uint64_t i = 0; i < num; ++i) {
+		auto size = readCompressed(p, buf);
+		deltaBlocks.push_back(std::make_shared<DeltaBlockCopy>(buf.data(), size));
+	}
+	assert(p == data.data() + data.size());
+}
+
+} // namespace openmsx
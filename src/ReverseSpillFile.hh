@@ -0,0 +1,75 @@
+#ifndef REVERSESPILLFILE_HH
+#define REVERSESPILLFILE_HH
+
+#include "File.hh"
+#include "MemBuffer.hh"
+#include "span.hh"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openmsx {
+
+class DeltaBlock;
+
+/** Temporary file that holds reverse snapshots which were moved out of
+  * memory (see the 'reverse_memory_budget' setting).
+  *
+  * A snapshot is stored as its savestate buffer plus the content of all its
+  * DeltaBlocks, each lz4-compressed. Stored snapshots are never modified, the
+  * file only grows. Reading back happens via a memory mapping of the file.
+  * The file is private to this process and it is removed again when this
+  * object is destroyed or cleared.
+  */
+class ReverseSpillFile
+{
+public:
+	struct Pos {
+		size_t offset = 0;
+		size_t size = 0;
+	};
+
+	ReverseSpillFile() = default;
+	ReverseSpillFile(const ReverseSpillFile&) = delete;
+	ReverseSpillFile& operator=(const ReverseSpillFile&) = delete;
+	~ReverseSpillFile();
+
+	void swap(ReverseSpillFile& other) noexcept;
+
+	/** Remove the file (invalidates all stored positions). */
+	void clear();
+
+	/** Store a snapshot, returns its position in the file.
+	  * @throws FileException
+	  */
+	[[nodiscard]] Pos store(span<const uint8_t> savestate,
+	                        span<const std::shared_ptr<DeltaBlock>> deltaBlocks);
+
+	/** Copy a snapshot that was stored in a different file.
+	  * @throws FileException
+	  */
+	[[nodiscard]] Pos copyFrom(ReverseSpillFile& other, Pos pos);
+
+	/** Read back a previously stored snapshot.
+	  * @throws FileException
+	  */
+	void load(Pos pos, MemBuffer<uint8_t>& savestate,
+	          std::vector<std::shared_ptr<DeltaBlock>>& deltaBlocks);
+
+	/** Total size of the file. */
+	[[nodiscard]] size_t getFileSize() const { return fileSize; }
+
+private:
+	void prepareWrite();
+	[[nodiscard]] span<const uint8_t> map(Pos pos);
+
+private:
+	File file;
+	std::string filename;
+	size_t fileSize = 0;
+};
+
+} // namespace openmsx
+
+#endif
@@ -5,11 +5,34 @@
 #include "ranges.hh"
 #include "serialize.hh"
 #include "stl.hh"
+#include "view.hh"
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
 #include <iterator> // for back_inserter
+#include <typeinfo>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
 
 namespace openmsx {
 
+std::ostream& operator<<(std::ostream& os, EnumTypeName<SchedulerCounter>)
+{
+	return os << "SchedulerCounter";
+}
+std::ostream& operator<<(std::ostream& os, EnumValueName<SchedulerCounter> evn)
+{
+	std::string_view names[size_t(SchedulerCounter::NUM)] = {
+		"SetSyncPoint",
+		"RemoveSyncPoint",
+		"RemoveSyncPoints",
+		"ExecuteUntil",
+	};
+	return os << names[size_t(evn.e)];
+}
+
 struct EqualSchedulable {
 	explicit EqualSchedulable(const Schedulable& schedulable_)
 		: schedulable(schedulable_) {}
@@ -23,7 +46,11 @@ struct EqualSchedulable {
 Scheduler::~Scheduler()
 {
 	assert(!cpu);
+#ifdef USE_SCHEDULER_HEAP
+	auto copy = queue.getAll();
+#else
 	auto copy = to_vector(queue);
+#endif
 	for (auto& s : copy) {
 		s.getDevice()->schedulerDeleted();
 	}
@@ -36,11 +63,22 @@ void Scheduler::setSyncPoint(EmuTime::param time, Schedulable& device)
 	assert(Thread::isMainThread());
 	assert(time >= scheduleTime);
 
+	if constexpr (PROFILE_SCHEDULER) {
+		tick(SchedulerCounter::SetSyncPoint);
+		auto& p = getTypeProfile(device);
+		++p.setSyncPoint;
+		p.leadTime = p.leadTime + (time - scheduleTime);
+	}
+
 	// Push sync point into queue.
+#ifdef USE_SCHEDULER_HEAP
+	queue.insert(SynchronizationPoint(time, &device));
+#else
 	queue.insert(SynchronizationPoint(time, &device),
 	             [](SynchronizationPoint& sp) { sp.setTime(EmuTime::infinity()); },
 	             [](const SynchronizationPoint& x, const SynchronizationPoint& y) {
 	                     return x.getTime() < y.getTime(); });
+#endif
 
 	if (!scheduleInProgress && cpu) {
 		// only when scheduleHelper() is not being executed
@@ -52,32 +90,58 @@ void Scheduler::setSyncPoint(EmuTime::param time, Schedulable& device)
 
 Scheduler::SyncPoints Scheduler::getSyncPoints(const Schedulable& device) const
 {
+#ifdef USE_SCHEDULER_HEAP
+	return queue.getAll(device);
+#else
 	SyncPoints result;
 	ranges::copy_if(queue, back_inserter(result), EqualSchedulable(device));
 	return result;
+#endif
 }
 
 bool Scheduler::removeSyncPoint(Schedulable& device)
 {
 	assert(Thread::isMainThread());
+	if constexpr (PROFILE_SCHEDULER) {
+		tick(SchedulerCounter::RemoveSyncPoint);
+		++getTypeProfile(device).removeSyncPoint;
+	}
+#ifdef USE_SCHEDULER_HEAP
+	return queue.remove(device);
+#else
 	return queue.remove(EqualSchedulable(device));
+#endif
 }
 
 void Scheduler::removeSyncPoints(Schedulable& device)
 {
 	assert(Thread::isMainThread());
+	if constexpr (PROFILE_SCHEDULER) {
+		tick(SchedulerCounter::RemoveSyncPoints);
+	}
+#ifdef USE_SCHEDULER_HEAP
+	queue.remove_all(device);
+#else
 	queue.remove_all(EqualSchedulable(device));
+#endif
 }
 
 bool Scheduler::pendingSyncPoint(const Schedulable& device,
                                  EmuTime& result) const
 {
 	assert(Thread::isMainThread());
+#ifdef USE_SCHEDULER_HEAP
+	if (const auto* sp = queue.find(device)) {
+		result = sp->getTime();
+		return true;
+	}
+#else
 	if (auto it = ranges::find(queue, &device, &SynchronizationPoint::getDevice);
 	    it != std::end(queue)) {
 		result = it->getTime();
 		return true;
 	}
+#endif
 	return false;
 }
 
@@ -100,7 +164,18 @@ void Scheduler::scheduleHelper(EmuTime::param limit, EmuTime next)
 
 		queue.remove_front();
 
-		device->executeUntil(next);
+		if constexpr (PROFILE_SCHEDULER) {
+			tick(SchedulerCounter::ExecuteUntil);
+			auto& p = getTypeProfile(*device);
+			auto start = std::chrono::steady_clock::now();
+			device->executeUntil(next);
+			auto stop = std::chrono::steady_clock::now();
+			++p.executeUntil;
+			p.hostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				stop - start).count();
+		} else {
+			device->executeUntil(next);
+		}
 
 		next = getNext();
 		if (likely(next > limit)) break;
@@ -110,6 +185,40 @@ void Scheduler::scheduleHelper(EmuTime::param limit, EmuTime next)
 	cpu->setNextSyncPoint(next);
 }
 
+static std::string demangledName(const std::type_info& info)
+{
+#ifdef __GNUC__
+	int status;
+	if (char* name = abi::__cxa_demangle(info.name(), nullptr, nullptr, &status)) {
+		std::string result = name;
+		free(name);
+		return result;
+	}
+#endif
+	return info.name();
+}
+
+Scheduler::TypeProfile& Scheduler::getTypeProfile(const Schedulable& device)
+{
+	const auto& info = typeid(device);
+	auto [it, inserted] = profile.try_emplace(std::type_index(info));
+	if (inserted) it->second.name = demangledName(info);
+	return it->second;
+}
+
+std::vector<Scheduler::TypeProfile> Scheduler::getProfile() const
+{
+	auto result = to_vector<TypeProfile>(view::values(profile));
+	ranges::sort(result, std::greater<>{}, &TypeProfile::hostNs);
+	return result;
+}
+
+void Scheduler::resetProfile()
+{
+	resetCounters();
+	profile.clear();
+}
+
 
 template<typename Archive>
 void SynchronizationPoint::serialize(Archive& ar, unsigned /*version*/)
@@ -2,15 +2,44 @@
 #define SCHEDULER_HH
 
 #include "EmuTime.hh"
-#include "SchedulerQueue.hh"
+#include "ProfileCounters.hh"
 #include "likely.hh"
+#include <cstdint>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
 #include <vector>
 
+// The pending sync points are by default stored in a SchedulerQueue (a sorted
+// array). Define USE_SCHEDULER_HEAP to instead use a SyncPointHeap (an
+// indexed heap), that one scales better for a large number of sync points.
+// See src/unittest/SchedulerQueue_bench.cc to compare both.
+#ifdef USE_SCHEDULER_HEAP
+#include "SyncPointHeap.hh"
+#else
+#include "SchedulerQueue.hh"
+#endif
+
 namespace openmsx {
 
 class Schedulable;
 class MSXCPU;
 
+// Set to true to collect (per Schedulable type) statistics on how the
+// scheduler is used, see the 'machine_info scheduler_profile' command. When
+// false, all profiling code is optimized away.
+constexpr bool PROFILE_SCHEDULER = false;
+
+enum class SchedulerCounter {
+	SetSyncPoint,
+	RemoveSyncPoint,
+	RemoveSyncPoints,
+	ExecuteUntil,
+	NUM // must be last
+};
+std::ostream& operator<<(std::ostream& os, EnumTypeName<SchedulerCounter>);
+std::ostream& operator<<(std::ostream& os, EnumValueName<SchedulerCounter> evn);
+
 class SynchronizationPoint
 {
 public:
@@ -30,11 +59,26 @@ private:
 };
 
 
-class Scheduler
+class Scheduler : public ProfileCounters<PROFILE_SCHEDULER, SchedulerCounter>
 {
 public:
 	using SyncPoints = std::vector<SynchronizationPoint>;
 
+	/** Profile data for all Schedulables of the same (dynamic) type.
+	  * Only collected when PROFILE_SCHEDULER is true.
+	  */
+	struct TypeProfile {
+		std::string name;
+		uint64_t setSyncPoint = 0;
+		uint64_t removeSyncPoint = 0;
+		uint64_t executeUntil = 0;
+		// Sum of (sync point time - current time) in setSyncPoint(),
+		// IOW how far ahead in emulated time this type schedules.
+		EmuDuration leadTime = EmuDuration::zero();
+		// Host time spent in executeUntil(), in nanoseconds.
+		uint64_t hostNs = 0;
+	};
+
 	Scheduler() = default;
 	~Scheduler();
 
@@ -68,6 +112,12 @@ public:
 		scheduleTime = limit;
 	}
 
+	/** Profile data, sorted on decreasing host time. Empty when
+	  * PROFILE_SCHEDULER is false.
+	  */
+	[[nodiscard]] std::vector<TypeProfile> getProfile() const;
+	void resetProfile();
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -107,15 +157,23 @@ private: // -> intended for Schedulable
 
 private:
 	void scheduleHelper(EmuTime::param limit, EmuTime next);
+	[[nodiscard]] TypeProfile& getTypeProfile(const Schedulable& device);
 
 private:
-	/** Vector used as heap, not a priority queue because that
-	  * doesn't allow removal of non-top element.
+	/** Pending sync points, ordered on time. Either a sorted array or an
+	  * indexed heap (see USE_SCHEDULER_HEAP above). Not a priority queue
+	  * because that doesn't allow removal of non-top elements.
 	  */
+#ifdef USE_SCHEDULER_HEAP
+	SyncPointHeap<SynchronizationPoint> queue{
+		SynchronizationPoint(EmuTime::infinity(), nullptr)};
+#else
 	SchedulerQueue<SynchronizationPoint> queue;
+#endif
 	EmuTime scheduleTime = EmuTime::zero();
 	MSXCPU* cpu = nullptr;
 	bool scheduleInProgress = false;
+	std::unordered_map<std::type_index, TypeProfile> profile;
 };
 
 } // namespace openmsx
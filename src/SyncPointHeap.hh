@@ -0,0 +1,269 @@
+#ifndef SYNCPOINTHEAP_HH
+#define SYNCPOINTHEAP_HH
+
+#include "hash_map.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace openmsx {
+
+// Alternative for SchedulerQueue, specialized for the Scheduler sync points.
+//
+// This is an indexed 4-ary min-heap. Next to the heap itself it keeps, per
+// device, a (doubly linked) list of the sync points of that device. So
+// finding or removing the sync point(s) of a specific device doesn't require
+// a linear scan over all sync points. Inserting and removing is O(log(N)).
+//
+// SchedulerQueue is (for small N) often faster, so this is only used when
+// USE_SCHEDULER_HEAP is defined, see Scheduler.hh.
+//
+// The element type SP must have the methods 'getTime()' and 'getDevice()',
+// the latter returns a pointer to the device (the key for the lookups).
+// Elements with equal time keep their insertion order (same as in
+// SchedulerQueue): internally each element gets a sequence number that is
+// used as tie-breaker.
+template<typename SP> class SyncPointHeap
+{
+	using Device = std::remove_pointer_t<decltype(std::declval<SP>().getDevice())>;
+	static constexpr unsigned D = 4; // arity of the heap
+	static constexpr unsigned NONE = unsigned(-1);
+	static constexpr unsigned SENTINEL = 0; // index in 'nodes'
+
+	struct Node {
+		SP sp;
+		uint64_t seq;
+		unsigned heapIdx; // position of this node in 'heap'
+		unsigned prev;    // previous/next node of the same device,
+		unsigned next;    //   or next free node (only 'next')
+	};
+
+public:
+	// The given element must compare bigger than any element that is
+	// ever inserted. It's returned by front() when the heap is empty.
+	explicit SyncPointHeap(const SP& sentinel)
+	{
+		nodes.push_back(Node{sentinel, uint64_t(-1), 0, NONE, NONE});
+		heap.push_back(SENTINEL);
+	}
+
+	[[nodiscard]] size_t size()  const { return heap.size() - 1; }
+	[[nodiscard]] bool   empty() const { return size() == 0; }
+
+	// Returns the smallest element, or the sentinel if empty.
+	[[nodiscard]] const SP& front() const { return nodes[heap[0]].sp; }
+
+	void insert(const SP& sp)
+	{
+		unsigned idx = allocNode();
+		auto n = unsigned(size());
+		auto& node = nodes[idx];
+		node.sp = sp;
+		node.seq = seqCounter++;
+		node.heapIdx = n;
+		link(idx);
+
+		heap.back() = idx; // overwrite sentinel
+		heap.push_back(SENTINEL);
+		siftUp(n);
+	}
+
+	// Remove the smallest element.
+	void remove_front()
+	{
+		assert(!empty());
+		removeAt(0);
+	}
+
+	// Remove the earliest element of the given device.
+	bool remove(const Device& device)
+	{
+		unsigned idx = findEarliest(device);
+		if (idx == NONE) return false;
+		removeAt(nodes[idx].heapIdx);
+		return true;
+	}
+
+	// Remove all elements of the given device.
+	void remove_all(const Device& device)
+	{
+		auto it = heads.find(&device);
+		if (it == heads.end()) return;
+		while (it->second != NONE) {
+			removeAt(nodes[it->second].heapIdx);
+		}
+		heads.erase(it);
+	}
+
+	// Returns the earliest element of the given device, or nullptr.
+	[[nodiscard]] const SP* find(const Device& device) const
+	{
+		unsigned idx = findEarliest(device);
+		return (idx != NONE) ? &nodes[idx].sp : nullptr;
+	}
+
+	// Returns all elements of the given device, sorted.
+	[[nodiscard]] std::vector<SP> getAll(const Device& device) const
+	{
+		std::vector<unsigned> idxs;
+		if (const auto* head = lookup(heads, &device)) {
+			for (unsigned i = *head; i != NONE; i = nodes[i].next) {
+				idxs.push_back(i);
+			}
+		}
+		return toSorted(std::move(idxs));
+	}
+
+	// Returns all elements, sorted.
+	[[nodiscard]] std::vector<SP> getAll() const
+	{
+		return toSorted(std::vector<unsigned>(heap.begin(), heap.end() - 1));
+	}
+
+private:
+	[[nodiscard]] bool less(unsigned x, unsigned y) const
+	{
+		const auto& nx = nodes[x];
+		const auto& ny = nodes[y];
+		if (nx.sp.getTime() < ny.sp.getTime()) return true;
+		if (ny.sp.getTime() < nx.sp.getTime()) return false;
+		return nx.seq < ny.seq;
+	}
+
+	void place(unsigned pos, unsigned idx)
+	{
+		heap[pos] = idx;
+		nodes[idx].heapIdx = pos;
+	}
+
+	void siftUp(unsigned pos)
+	{
+		unsigned idx = heap[pos];
+		while (pos != 0) {
+			unsigned parent = (pos - 1) / D;
+			if (!less(idx, heap[parent])) break;
+			place(pos, heap[parent]);
+			pos = parent;
+		}
+		place(pos, idx);
+	}
+
+	void siftDown(unsigned pos)
+	{
+		auto n = unsigned(size());
+		unsigned idx = heap[pos];
+		while (true) {
+			unsigned first = D * pos + 1;
+			if (first >= n) break;
+			unsigned last = std::min(first + D, n);
+			unsigned best = first;
+			for (unsigned c = first + 1; c < last; ++c) {
+				if (less(heap[c], heap[best])) best = c;
+			}
+			if (!less(heap[best], idx)) break;
+			place(pos, heap[best]);
+			pos = best;
+		}
+		place(pos, idx);
+	}
+
+	void removeAt(unsigned pos)
+	{
+		unsigned idx = heap[pos];
+		unsigned last = unsigned(size()) - 1;
+		unsigned lastIdx = heap[last];
+		heap.pop_back();
+		heap.back() = SENTINEL;
+		if (pos != last) {
+			// move the last element into the hole and restore the heap
+			place(pos, lastIdx);
+			if ((pos != 0) && less(lastIdx, heap[(pos - 1) / D])) {
+				siftUp(pos);
+			} else {
+				siftDown(pos);
+			}
+		}
+		unlink(idx);
+		freeNode(idx);
+	}
+
+	[[nodiscard]] unsigned findEarliest(const Device& device) const
+	{
+		const auto* head = lookup(heads, &device);
+		if (!head) return NONE;
+		unsigned best = *head;
+		if (best == NONE) return NONE;
+		for (unsigned i = nodes[best].next; i != NONE; i = nodes[i].next) {
+			if (less(i, best)) best = i;
+		}
+		return best;
+	}
+
+	[[nodiscard]] std::vector<SP> toSorted(std::vector<unsigned> idxs) const
+	{
+		std::sort(idxs.begin(), idxs.end(),
+		          [&](unsigned x, unsigned y) { return less(x, y); });
+		std::vector<SP> result;
+		result.reserve(idxs.size());
+		for (auto i : idxs) result.push_back(nodes[i].sp);
+		return result;
+	}
+
+	void link(unsigned idx)
+	{
+		auto& head = heads.try_emplace(nodes[idx].sp.getDevice(), NONE).first->second;
+		auto& node = nodes[idx];
+		node.prev = NONE;
+		node.next = head;
+		if (head != NONE) nodes[head].prev = idx;
+		head = idx;
+	}
+
+	void unlink(unsigned idx)
+	{
+		auto& node = nodes[idx];
+		if (node.prev != NONE) {
+			nodes[node.prev].next = node.next;
+		} else {
+			auto* head = lookup(heads, node.sp.getDevice());
+			assert(head && (*head == idx));
+			*head = node.next;
+		}
+		if (node.next != NONE) {
+			nodes[node.next].prev = node.prev;
+		}
+	}
+
+	[[nodiscard]] unsigned allocNode()
+	{
+		if (freeList != NONE) {
+			unsigned idx = freeList;
+			freeList = nodes[idx].next;
+			return idx;
+		}
+		nodes.emplace_back();
+		return unsigned(nodes.size() - 1);
+	}
+
+	void freeNode(unsigned idx)
+	{
+		nodes[idx].next = freeList;
+		freeList = idx;
+	}
+
+private:
+	std::vector<Node> nodes; // nodes[0] is the sentinel
+	std::vector<unsigned> heap; // invariant: heap.back() == SENTINEL
+	// Per device the first node of its list, or NONE. Entries are only
+	// removed by remove_all() (called when the device is destroyed).
+	hash_map<const Device*, unsigned> heads;
+	unsigned freeList = NONE;
+	uint64_t seqCounter = 0;
+};
+
+} // namespace openmsx
+
+#endif // SYNCPOINTHEAP_HH
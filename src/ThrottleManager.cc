@@ -11,7 +11,7 @@ ThrottleManager::ThrottleManager(CommandController& commandController)
 	, fullSpeedLoadingSetting(
 		commandController, "fullspeedwhenloading",
 		"sets openMSX to full speed when the MSX is loading", false)
-	, loading(0), throttle(true)
+	, loading(0), offline(0), throttle(true)
 {
 	throttleSetting        .attach(*this);
 	fullSpeedLoadingSetting.attach(*this);
@@ -25,7 +25,7 @@ ThrottleManager::~ThrottleManager()
 
 void ThrottleManager::updateStatus()
 {
-	bool newThrottle = throttleSetting.getBoolean() &&
+	bool newThrottle = throttleSetting.getBoolean() && !offline &&
 	                   (!loading || !fullSpeedLoadingSetting.getBoolean());
 	if (throttle != newThrottle) {
 		throttle = newThrottle;
@@ -44,6 +44,17 @@ void ThrottleManager::indicateLoadingState(bool state)
 	updateStatus();
 }
 
+void ThrottleManager::indicateOfflineState(bool state)
+{
+	if (state) {
+		++offline;
+	} else {
+		--offline;
+	}
+	assert(offline >= 0);
+	updateStatus();
+}
+
 void ThrottleManager::update(const Setting& /*setting*/) noexcept
 {
 	updateStatus();
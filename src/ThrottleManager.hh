@@ -28,6 +28,15 @@ public:
 	 */
 	[[nodiscard]] bool isThrottled() const { return throttle; }
 
+	/**
+	 * Use to indicate that sound/video is being rendered offline (see
+	 * 'record start -offline'). As long as there is at least one such
+	 * request, emulation runs at full speed regardless of the throttle
+	 * setting. Calls must be balanced, same as for indicateLoadingState().
+	 * @param state true to start, false to stop offline rendering
+	 */
+	void indicateOfflineState(bool state);
+
 private:
 	friend class LoadingIndicator;
 
@@ -49,6 +58,7 @@ private:
 	BooleanSetting throttleSetting;
 	BooleanSetting fullSpeedLoadingSetting;
 	int loading;
+	int offline;
 	bool throttle;
 };
 
@@ -216,6 +216,9 @@ private:
 	[[nodiscard]] static Tcl_Obj* newObj(unsigned u) {
 		return Tcl_NewIntObj(u);
 	}
+	[[nodiscard]] static Tcl_Obj* newObj(int64_t i) {
+		return Tcl_NewWideIntObj(i);
+	}
 	[[nodiscard]] static Tcl_Obj* newObj(float f) {
 		return Tcl_NewDoubleObj(double(f));
 	}
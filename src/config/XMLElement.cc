@@ -391,7 +391,8 @@ void XMLDocument::serialize(MemInputArchive& ar, unsigned /*version*/)
 	root = loadElement(ar);
 }
 
-static void saveElement(MemOutputArchive& ar, const XMLElement& elem)
+template<typename Archive> // MemOutputArchive or HashOutputArchive
+static void saveElement(Archive& ar, const XMLElement& elem)
 {
 	ar.save(elem.getName());
 
@@ -412,7 +413,8 @@ static void saveElement(MemOutputArchive& ar, const XMLElement& elem)
 	}
 }
 
-void XMLDocument::serialize(MemOutputArchive& ar, unsigned /*version*/)
+template<typename Archive>
+static void saveDocument(Archive& ar, const XMLElement* root)
 {
 	if (root) {
 		saveElement(ar, *root);
@@ -422,6 +424,16 @@ void XMLDocument::serialize(MemOutputArchive& ar, unsigned /*version*/)
 	}
 }
 
+void XMLDocument::serialize(MemOutputArchive& ar, unsigned /*version*/)
+{
+	saveDocument(ar, root);
+}
+
+void XMLDocument::serialize(HashOutputArchive& ar, unsigned /*version*/)
+{
+	saveDocument(ar, root);
+}
+
 XMLElement* XMLDocument::clone(const XMLElement& inElem)
 {
 	auto* outElem = allocateElement(allocateString(inElem.getName()));
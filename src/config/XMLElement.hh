@@ -297,6 +297,7 @@ public:
 
 	void serialize(MemInputArchive&  ar, unsigned version);
 	void serialize(MemOutputArchive& ar, unsigned version);
+	void serialize(HashOutputArchive& ar, unsigned version);
 	void serialize(XmlInputArchive&  ar, unsigned version);
 	void serialize(XmlOutputArchive& ar, unsigned version);
 
@@ -195,6 +195,20 @@
 // Probably the easiest way to enable this, is to pass the -DUSE_COMPUTED_GOTO
 // flag to the compiler. This is for example done in the super-opt flavour.
 // See build/flavour-super-opt.mk
+//
+// Why there is no pre-decoded basic-block (translation) cache:
+// - Opcode fetches already read directly from the per-slot memory cache
+//   (readCacheLine[], shadowed per slot/page mapping in MSXCPU). Decoding a
+//   (prefixed) opcode is only a single (indirect) jump per fetched byte.
+// - The work per instruction that remains is mostly dictated by accuracy
+//   requirements: advancing the clock, T::limitReached() so that sync points
+//   are handled at the exact instruction boundary, R800 page-break and
+//   refresh timing, and incrementing the R register. A block cache would
+//   still have to do all of this per instruction, so in an interpreter (as
+//   opposed to a JIT) it would mainly add invalidation bookkeeping on every
+//   bank switch and on every write into a cached line.
+// So the supported way to speed up instruction dispatch (e.g. for
+// fast-forward) is enabling USE_COMPUTED_GOTO, see above.
 
 namespace openmsx {
 
@@ -2,6 +2,7 @@
 #define TRACKED_RAM_HH
 
 #include "Ram.hh"
+#include "DirtyPages.hh"
 
 namespace openmsx {
 
@@ -12,10 +13,10 @@ public:
 	// Most methods simply delegate to the internal 'ram' object.
 	TrackedRam(const DeviceConfig& config, const std::string& name,
 	           static_string_view description, unsigned size)
-		: ram(config, name, description, size) {}
+		: ram(config, name, description, size), dirty(size) {}
 
 	TrackedRam(const XMLElement& xml, unsigned size)
-		: ram(xml, size) {}
+		: ram(xml, size), dirty(size) {}
 
 	[[nodiscard]] unsigned getSize() const {
 		return ram.getSize();
@@ -36,21 +37,21 @@ public:
 
 	// Only allow write/clear via an explicit method.
 	void write(unsigned addr, byte value) {
-		writeSinceLastReverseSnapshot = true;
+		dirty.set(addr);
 		ram[addr] = value;
 	}
 
 	void clear(byte c = 0xff) {
-		writeSinceLastReverseSnapshot = true;
+		dirty.setAll();
 		ram.clear(c);
 	}
 
 	// Some write operations are more efficient in bulk. For those this
-	// method can be used. It will mark the ram as dirty on each
+	// method can be used. It will mark the whole ram as dirty on each
 	// invocation, so the resulting pointer (although the same each time)
 	// should not be reused for multiple (distinct) bulk write operations.
 	[[nodiscard]] byte* getWriteBackdoor() {
-		writeSinceLastReverseSnapshot = true;
+		dirty.setAll();
 		return &ram[0];
 	}
 
@@ -59,7 +60,7 @@ public:
 
 private:
 	Ram ram;
-	bool writeSinceLastReverseSnapshot = true;
+	DirtyPages dirty; // written pages since last reverse snapshot
 };
 
 } // namespace openmsx
@@ -12,6 +12,7 @@
 #include "Date.hh"
 #include "one_of.hh"
 #include "stl.hh"
+#include "view.hh"
 #include "build-info.hh"
 #include "cstdiop.hh" // for dup()
 #include <cstring>
@@ -30,6 +31,7 @@ void ArchiveBase<Derived>::attribute(const char* name, const char* value)
 	self().attribute(name, valueStr);
 }
 template class ArchiveBase<MemOutputArchive>;
+template class ArchiveBase<HashOutputArchive>;
 template class ArchiveBase<XmlOutputArchive>;
 
 ////
@@ -108,6 +110,7 @@ void OutputArchiveBase<Derived>::serialize_blob(
 }
 
 template class OutputArchiveBase<MemOutputArchive>;
+template class OutputArchiveBase<HashOutputArchive>;
 template class OutputArchiveBase<XmlOutputArchive>;
 
 ////
@@ -234,6 +237,20 @@ void MemOutputArchive::serialize_blob(const char* /*tag*/, const void* data,
 
 }
 
+void MemOutputArchive::serialize_blob(const char* tag, const void* data,
+                                      size_t len, const DirtyPages& dirty)
+{
+	// Same as above, but let the delta calculation skip the clean pages.
+	if (len > SMALL_SIZE) {
+		auto deltaBlockIdx = unsigned(deltaBlocks.size());
+		save(deltaBlockIdx);
+		deltaBlocks.push_back(lastDeltaBlocks.createNew(
+			data, static_cast<const uint8_t*>(data), len, dirty));
+	} else {
+		serialize_blob(tag, data, len, dirty.any());
+	}
+}
+
 void MemInputArchive::serialize_blob(const char* /*tag*/, void* data,
                                      size_t len, bool /*diff*/)
 {
@@ -256,6 +273,85 @@ void MemInputArchive::serialize_blob(const char* /*tag*/, void* data,
 
 ////
 
+HashOutputArchive::HashOutputArchive(unsigned maxDepth_)
+	: maxDepth(maxDepth_)
+{
+	openNodes.push_back(&root);
+	hashers.emplace_back();
+}
+
+void HashOutputArchive::save(std::string_view s)
+{
+	auto size = s.size();
+	put(&size, sizeof(size));
+	put(s.data(), size);
+
+	// Label polymorphic objects (e.g. the MSXDevices) with their name,
+	// that makes it a lot easier to locate a difference in the tree.
+	if (currentTag && (strcmp(currentTag, "name") == 0)) {
+		for (auto* node : view::reverse(openNodes)) {
+			if (!node->type.empty()) {
+				if (node->name.empty()) node->name = s;
+				break;
+			}
+		}
+	}
+}
+
+void HashOutputArchive::attribute(const char* name, const char* value)
+{
+	save(std::string_view(value));
+	if ((depth <= maxDepth) && (strcmp(name, "type") == 0)) {
+		openNodes.back()->type = value;
+	}
+}
+
+void HashOutputArchive::serialize_blob(const char* tag, const void* data,
+                                       size_t len, bool /*diff*/)
+{
+	beginTag(tag);
+	put(data, len);
+	endTag(tag);
+}
+
+void HashOutputArchive::beginTag(const char* tag)
+{
+	currentTag = tag;
+	++depth;
+	if (depth <= maxDepth) {
+		auto& node = openNodes.back()->children.emplace_back();
+		node.tag = tag;
+		openNodes.push_back(&node);
+		hashers.emplace_back();
+	}
+}
+
+void HashOutputArchive::endTag(const char* /*tag*/)
+{
+	if (depth <= maxDepth) {
+		assert(openNodes.size() > 1);
+		openNodes.back()->hash = hashers.back().digest();
+		openNodes.pop_back();
+		hashers.pop_back();
+	}
+	--depth;
+	currentTag = nullptr;
+}
+
+uint32_t HashOutputArchive::getHash() const
+{
+	assert(openNodes.size() == 1);
+	return hashers.front().digest();
+}
+
+HashOutputArchive::Node HashOutputArchive::releaseTree()
+{
+	root.hash = getHash();
+	return std::move(root);
+}
+
+////
+
 XmlOutputArchive::XmlOutputArchive(zstring_view filename_)
 	: filename(filename_)
 	, writer(*this)
@@ -6,12 +6,14 @@
 #include "StringOp.hh"
 #include "XMLElement.hh"
 #include "XMLOutputStream.hh"
+#include "DirtyPages.hh"
 #include "MemBuffer.hh"
 #include "hash_map.hh"
 #include "inline.hh"
 #include "span.hh"
 #include "strCat.hh"
 #include "unreachable.hh"
+#include "xxhash.hh"
 #include "zstring_view.hh"
 #include <zlib.h>
 #include <cassert>
@@ -64,6 +66,14 @@ template<typename T> struct SerializeClassVersion;
 //      is not a design goal (e.g. simply changing a value will probably work,
 //      but swapping the position of two tag or adding or removing tags can
 //      easily break the stream).
+//   - Hash
+//      Doesn't store the stream at all, instead it calculates a hash of all
+//      the data that would be stored (so this backing stream only has an
+//      output variant). Optionally it also calculates a hash of each subtree
+//      (up to a certain depth). This is much cheaper than creating a full
+//      (in memory) savestate and hashing that. The main use case is to
+//      quickly check whether two emulator runs are still in the same
+//      state, and if not, which part of the machine is different.
 //   - Text
 //      This stores to stream in a flat ascii file (one item per line). This
 //      format is only written as a proof-of-concept to test the design. It's
@@ -150,6 +160,14 @@ public:
 	//   type).
 	//
 	//
+	// void serialize_blob(const char* tag, const void* data, size_t len,
+	//                     const DirtyPages& dirty)
+	//
+	//   Same as above, but 'dirty' tells which pages of the blob were
+	//   written since the previous reverse snapshot. This is only
+	//   available in output archives.
+	//
+	//
 	// template<typename T> void serialize(const char* tag, const T& t)
 	//
 	//   This is much like the serializeWithID() method above, but it doesn't
@@ -465,6 +483,14 @@ public:
 	// the resulting string. But memory archives will memcpy the blob.
 	void serialize_blob(const char* tag, const void* data, size_t len,
 	                    bool diff = true);
+	// Variant where the caller tracks which pages of the blob were
+	// modified since the previous reverse snapshot. Only memory archives
+	// make use of this, others simply store the whole blob.
+	void serialize_blob(const char* tag, const void* data, size_t len,
+	                    const DirtyPages& dirty)
+	{
+		this->self().serialize_blob(tag, data, len, dirty.any());
+	}
 
 	template<typename T> void serialize(const char* tag, const T& t)
 	{
@@ -671,6 +697,8 @@ public:
 	void save(std::string_view s);
 	void serialize_blob(const char* tag, const void* data, size_t len,
 	                    bool diff = true);
+	void serialize_blob(const char* tag, const void* data, size_t len,
+	                    const DirtyPages& dirty);
 
 	using OutputArchiveBase<MemOutputArchive>::serialize;
 	template<typename T, typename ...Args>
@@ -842,6 +870,108 @@ private:
 
 ////
 
+class HashOutputArchive final : public OutputArchiveBase<HashOutputArchive>
+{
+public:
+	/** Hash of the data within one tag. For the root node this is the
+	  * hash of the whole stream. The hash of a node only depends on the
+	  * data within that node (so not on the tree depth).
+	  */
+	struct Node {
+		std::string tag;
+		std::string type; // for polymorphic objects (e.g. MSXDevices)
+		std::string name; // first 'name' string within a polymorphic object
+		uint32_t hash = 0;
+		std::vector<Node> children;
+	};
+
+	/** @param maxDepth_ Also calculate a hash for each tag up to this
+	  *        nesting depth. 0 means only the hash of the whole stream.
+	  */
+	explicit HashOutputArchive(unsigned maxDepth_ = 0);
+	HashOutputArchive(const HashOutputArchive&) = delete;
+	HashOutputArchive& operator=(const HashOutputArchive&) = delete;
+
+	~HashOutputArchive()
+	{
+		assert(openNodes.size() == 1);
+	}
+
+	static constexpr bool NEED_VERSION = false;
+
+	template<typename T> void save(const T& t)
+	{
+		put(&t, sizeof(t));
+	}
+	inline void saveChar(char c)
+	{
+		save(c);
+	}
+	void save(const std::string& s) { save(std::string_view(s)); }
+	void save(std::string_view s);
+	void serialize_blob(const char* tag, const void* data, size_t len,
+	                    bool diff = true);
+	void serialize_blob(const char* tag, const void* data, size_t len,
+	                    const DirtyPages& /*dirty*/)
+	{
+		serialize_blob(tag, data, len);
+	}
+
+	using OutputArchiveBase<HashOutputArchive>::serialize;
+	template<typename T, typename ...Args>
+	ALWAYS_INLINE void serialize(const char* tag, const T& t, Args&& ...args)
+	{
+		this->self().serialize(tag, t);
+		this->self().serialize(std::forward<Args>(args)...);
+	}
+	template<typename T, size_t N>
+	ALWAYS_INLINE void serialize(const char* tag, const T(&t)[N],
+		std::enable_if_t<SerializeAsMemcpy<T>::value>* = nullptr)
+	{
+		beginTag(tag);
+		put(&t[0], N * sizeof(T));
+		endTag(tag);
+	}
+
+	// Attributes don't get their own node (like in XML archives).
+	template<typename T> void attribute(const char* /*name*/, const T& t)
+	{
+		save(t);
+	}
+	void attribute(const char* name, const char* value);
+
+	void beginSection() { /*nothing*/ }
+	void endSection()   { /*nothing*/ }
+
+	void beginTag(const char* tag);
+	void endTag(const char* tag);
+
+	/** Hash of the whole stream. */
+	[[nodiscard]] uint32_t getHash() const;
+
+	/** Hashes of all tags up to 'maxDepth'. Can only be called once. */
+	[[nodiscard]] Node releaseTree();
+
+private:
+	void put(const void* data, size_t len)
+	{
+		for (auto& h : hashers) h.update(data, len);
+	}
+
+private:
+	Node root;
+	// Nodes (up to 'maxDepth') for the currently open tags, innermost
+	// last, and their (not yet finished) hashes. Only the innermost node
+	// gets new children, so these pointers remain valid.
+	std::vector<Node*> openNodes;
+	std::vector<XXHash32> hashers;
+	const char* currentTag = nullptr;
+	unsigned depth = 0; // of the current tag
+	const unsigned maxDepth;
+};
+
+////
+
 class XmlOutputArchive final : public OutputArchiveBase<XmlOutputArchive>
 {
 public:
@@ -1009,6 +1139,7 @@ private:
 #define INSTANTIATE_SERIALIZE_METHODS(CLASS) \
 template void CLASS::serialize(MemInputArchive&,   unsigned); \
 template void CLASS::serialize(MemOutputArchive&,  unsigned); \
+template void CLASS::serialize(HashOutputArchive&, unsigned); \
 template void CLASS::serialize(XmlInputArchive&,   unsigned); \
 template void CLASS::serialize(XmlOutputArchive&,  unsigned);
 
@@ -52,6 +52,7 @@ void PolymorphicSaverRegistry<Archive>::save(
 
 template class PolymorphicSaverRegistry<MemOutputArchive>;
 template class PolymorphicSaverRegistry<XmlOutputArchive>;
+template class PolymorphicSaverRegistry<HashOutputArchive>;
 
 ////
 
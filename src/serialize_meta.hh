@@ -287,6 +287,7 @@ template<> struct PolymorphicConstructorArgs<C> \
 
 class MemInputArchive;
 class MemOutputArchive;
+class HashOutputArchive;
 class XmlInputArchive;
 class XmlOutputArchive;
 
@@ -304,6 +305,7 @@ static RegisterLoaderHelper<MemInputArchive,  C> registerHelper3##C(N); \
 static RegisterSaverHelper <MemOutputArchive, C> registerHelper4##C(N); \
 static RegisterLoaderHelper<XmlInputArchive,  C> registerHelper5##C(N); \
 static RegisterSaverHelper <XmlOutputArchive, C> registerHelper6##C(N); \
+static RegisterSaverHelper <HashOutputArchive, C> registerHelper7##C(N); \
 template<> struct PolymorphicBaseClass<C> { using type = B; };
 
 #define REGISTER_POLYMORPHIC_INITIALIZER_HELPER(B,C,N) \
@@ -312,6 +314,7 @@ static RegisterInitializerHelper<MemInputArchive,  C> registerHelper3##C(N); \
 static RegisterSaverHelper      <MemOutputArchive, C> registerHelper4##C(N); \
 static RegisterInitializerHelper<XmlInputArchive,  C> registerHelper5##C(N); \
 static RegisterSaverHelper      <XmlOutputArchive, C> registerHelper6##C(N); \
+static RegisterSaverHelper      <HashOutputArchive, C> registerHelper7##C(N); \
 template<> struct PolymorphicBaseClass<C> { using type = B; };
 
 #define REGISTER_BASE_NAME_HELPER(B,N) \
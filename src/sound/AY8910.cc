@@ -21,6 +21,7 @@
 #include "one_of.hh"
 #include "outer.hh"
 #include "random.hh"
+#include "ranges.hh"
 #include "xrange.hh"
 #include <cassert>
 #include <cstring>
@@ -108,12 +109,12 @@ static float noiseValue(float x)
 
 // Generator:
 
-inline void AY8910::Generator::reset()
+inline void AY8910Core::Generator::reset()
 {
 	count = 0;
 }
 
-inline void AY8910::Generator::setPeriod(int value)
+inline void AY8910Core::Generator::setPeriod(int value)
 {
 	// Careful studies of the chip output prove that it instead counts up from
 	// 0 until the counter becomes greater or equal to the period. This is an
@@ -126,13 +127,13 @@ inline void AY8910::Generator::setPeriod(int value)
 	count = std::min(count, period - 1);
 }
 
-inline unsigned AY8910::Generator::getNextEventTime() const
+inline unsigned AY8910Core::Generator::getNextEventTime() const
 {
 	assert(count < period);
 	return period - count;
 }
 
-inline void AY8910::Generator::advanceFast(unsigned duration)
+inline void AY8910Core::Generator::advanceFast(unsigned duration)
 {
 	count += duration;
 	assert(count < period);
@@ -141,35 +142,33 @@ inline void AY8910::Generator::advanceFast(unsigned duration)
 
 // ToneGenerator:
 
-AY8910::ToneGenerator::ToneGenerator()
+AY8910Core::ToneGenerator::ToneGenerator()
 {
 	reset();
 }
 
-inline void AY8910::ToneGenerator::reset()
+inline void AY8910Core::ToneGenerator::reset()
 {
 	Generator::reset();
 	output = false;
 }
 
-int AY8910::ToneGenerator::getDetune(AY8910& ay8910)
+int AY8910Core::ToneGenerator::getDetune(const AY8910Core& core)
 {
 	int result = 0;
-	float vibPerc = ay8910.vibratoPercent.getDouble();
+	float vibPerc = core.vibratoPercent;
 	if (vibPerc != 0.0f) {
 		int vibratoPeriod = int(
-			NATIVE_FREQ_FLOAT /
-			float(ay8910.vibratoFrequency.getDouble()));
+			NATIVE_FREQ_FLOAT / core.vibratoFrequency);
 		vibratoCount += period;
 		vibratoCount %= vibratoPeriod;
 		result += int(
 			sinf((float(2 * M_PI) * vibratoCount) / vibratoPeriod)
 			* vibPerc * 0.01f * period);
 	}
-	float detunePerc = ay8910.detunePercent.getDouble();
+	float detunePerc = core.detunePercent;
 	if (detunePerc != 0.0f) {
-		float detunePeriod = NATIVE_FREQ_FLOAT /
-			float(ay8910.detuneFrequency.getDouble());
+		float detunePeriod = NATIVE_FREQ_FLOAT / core.detuneFrequency;
 		detuneCount += period;
 		float noiseIdx = detuneCount / detunePeriod;
 		float detuneNoise = noiseValue(       noiseIdx)
@@ -179,7 +178,7 @@ int AY8910::ToneGenerator::getDetune(AY8910& ay8910)
 	return std::min(result, period - 1);
 }
 
-inline void AY8910::ToneGenerator::advance(int duration)
+inline void AY8910Core::ToneGenerator::advance(int duration)
 {
 	assert(count < period);
 	count += duration;
@@ -191,10 +190,10 @@ inline void AY8910::ToneGenerator::advance(int duration)
 	}
 }
 
-inline void AY8910::ToneGenerator::doNextEvent(AY8910& ay8910)
+inline void AY8910Core::ToneGenerator::doNextEvent(const AY8910Core& core)
 {
-	if (unlikely(ay8910.doDetune)) {
-		count = getDetune(ay8910);
+	if (unlikely(core.doDetune)) {
+		count = getDetune(core);
 	} else {
 		count = 0;
 	}
@@ -204,18 +203,18 @@ inline void AY8910::ToneGenerator::doNextEvent(AY8910& ay8910)
 
 // NoiseGenerator:
 
-AY8910::NoiseGenerator::NoiseGenerator()
+AY8910Core::NoiseGenerator::NoiseGenerator()
 {
 	reset();
 }
 
-inline void AY8910::NoiseGenerator::reset()
+inline void AY8910Core::NoiseGenerator::reset()
 {
 	Generator::reset();
 	random = 1;
 }
 
-inline void AY8910::NoiseGenerator::doNextEvent()
+inline void AY8910Core::NoiseGenerator::doNextEvent()
 {
 	count = 0;
 
@@ -233,7 +232,7 @@ inline void AY8910::NoiseGenerator::doNextEvent()
 	random = (random >> 1) ^ ((random & 1) << 13) ^ ((random & 1) << 16);
 }
 
-inline void AY8910::NoiseGenerator::advance(int duration)
+inline void AY8910Core::NoiseGenerator::advance(int duration)
 {
 	assert(count < period);
 	count += duration;
@@ -291,8 +290,8 @@ static bool checkAY8910(const DeviceConfig& config)
 	throw FatalError("Unknown PSG type: ", type);
 }
 
-AY8910::Amplitude::Amplitude(const DeviceConfig& config)
-	: isAY8910(checkAY8910(config))
+AY8910Core::Amplitude::Amplitude(bool isAY8910_)
+	: isAY8910(isAY8910_)
 {
 	vol[0] = vol[1] = vol[2] = 0.0f;
 	envChan[0] = false;
@@ -317,24 +316,24 @@ AY8910::Amplitude::Amplitude(const DeviceConfig& config)
 	}
 }
 
-const float* AY8910::Amplitude::getEnvVolTable() const
+const float* AY8910Core::Amplitude::getEnvVolTable() const
 {
 	return envVolTable;
 }
 
-inline float AY8910::Amplitude::getVolume(unsigned chan) const
+inline float AY8910Core::Amplitude::getVolume(unsigned chan) const
 {
 	assert(!followsEnvelope(chan));
 	return vol[chan];
 }
 
-inline void AY8910::Amplitude::setChannelVolume(unsigned chan, unsigned value)
+inline void AY8910Core::Amplitude::setChannelVolume(unsigned chan, unsigned value)
 {
 	envChan[chan] = (value & 0x10) != 0;
 	vol[chan] = volumeTab[value & 0x0F];
 }
 
-inline bool AY8910::Amplitude::followsEnvelope(unsigned chan) const
+inline bool AY8910Core::Amplitude::followsEnvelope(unsigned chan) const
 {
 	return envChan[chan];
 }
@@ -347,7 +346,7 @@ inline bool AY8910::Amplitude::followsEnvelope(unsigned chan) const
 //  we implement the YM2149 behaviour, but to get the AY8910 behaviour we
 //  repeat every level twice in the envVolTable
 
-inline AY8910::Envelope::Envelope(const float* envVolTable_)
+inline AY8910Core::Envelope::Envelope(const float* envVolTable_)
 	: envVolTable(envVolTable_)
 	, period(1)
 	, count(0)
@@ -359,12 +358,12 @@ inline AY8910::Envelope::Envelope(const float* envVolTable_)
 {
 }
 
-inline void AY8910::Envelope::reset()
+inline void AY8910Core::Envelope::reset()
 {
 	count = 0;
 }
 
-inline void AY8910::Envelope::setPeriod(int value)
+inline void AY8910Core::Envelope::setPeriod(int value)
 {
 	// twice as fast as AY8910
 	//  see also Generator::setPeriod()
@@ -372,12 +371,12 @@ inline void AY8910::Envelope::setPeriod(int value)
 	count = std::min(count, period - 1);
 }
 
-inline float AY8910::Envelope::getVolume() const
+inline float AY8910Core::Envelope::getVolume() const
 {
 	return envVolTable[step ^ attack];
 }
 
-inline void AY8910::Envelope::setShape(unsigned shape)
+inline void AY8910Core::Envelope::setShape(unsigned shape)
 {
 	// do 32 steps for both AY8910 and YM2149
 	/*
@@ -409,12 +408,12 @@ inline void AY8910::Envelope::setShape(unsigned shape)
 	holding = false;
 }
 
-inline bool AY8910::Envelope::isChanging() const
+inline bool AY8910Core::Envelope::isChanging() const
 {
 	return !holding;
 }
 
-inline void AY8910::Envelope::doSteps(int steps)
+inline void AY8910Core::Envelope::doSteps(int steps)
 {
 	// For best performance callers should check upfront whether
 	//    isChanging() == true
@@ -442,7 +441,7 @@ inline void AY8910::Envelope::doSteps(int steps)
 	}
 }
 
-inline void AY8910::Envelope::advance(int duration)
+inline void AY8910Core::Envelope::advance(int duration)
 {
 	assert(count < period);
 	count += duration * 2;
@@ -453,19 +452,19 @@ inline void AY8910::Envelope::advance(int duration)
 	}
 }
 
-inline void AY8910::Envelope::doNextEvent()
+inline void AY8910Core::Envelope::doNextEvent()
 {
 	count = 0;
 	doSteps(period == 1 ? 2 : 1);
 }
 
-inline unsigned AY8910::Envelope::getNextEventTime() const
+inline unsigned AY8910Core::Envelope::getNextEventTime() const
 {
 	assert(count < period);
 	return (period - count + 1) / 2;
 }
 
-inline void AY8910::Envelope::advanceFast(unsigned duration)
+inline void AY8910Core::Envelope::advanceFast(unsigned duration)
 {
 	count += 2 * duration;
 	assert(count < period);
@@ -473,138 +472,33 @@ inline void AY8910::Envelope::advanceFast(unsigned duration)
 
 
 
-// AY8910 main class:
+// AY8910Core main class:
 
-AY8910::AY8910(const std::string& name_, AY8910Periphery& periphery_,
-               const DeviceConfig& config, EmuTime::param time)
-	: ResampledSoundDevice(config.getMotherBoard(), name_, "PSG", 3, NATIVE_FREQ_INT, false)
-	, periphery(periphery_)
-	, debuggable(config.getMotherBoard(), getName())
-	, vibratoPercent(
-		config.getCommandController(), tmpStrCat(getName(), "_vibrato_percent"),
-		"controls strength of vibrato effect", 0.0, 0.0, 10.0)
-	, vibratoFrequency(
-		config.getCommandController(), tmpStrCat(getName(), "_vibrato_frequency"),
-		"frequency of vibrato effect in Hertz", 5, 1.0, 10.0)
-	, detunePercent(
-		config.getCommandController(), tmpStrCat(getName(), "_detune_percent"),
-		"controls strength of detune effect", 0.0, 0.0, 10.0)
-	, detuneFrequency(
-		config.getCommandController(), tmpStrCat(getName(), "_detune_frequency"),
-		"frequency of detune effect in Hertz", 5.0, 1.0, 100.0)
-	, directionsCallback(
-		config.getGlobalSettings().getInvalidPsgDirectionsSetting())
-	, amplitude(config)
+AY8910Core::AY8910Core(bool isAY8910)
+	: amplitude(isAY8910)
 	, envelope(amplitude.getEnvVolTable())
-	, isAY8910(checkAY8910(config))
-	, ignorePortDirections(config.getChildDataAsBool("ignorePortDirections", true))
-	, detuneInitialized(false) // (lazily) initialize detune stuff
 {
-	update(vibratoPercent);
-
 	// make valgrind happy
-	memset(regs, 0, sizeof(regs));
+	memset(soundRegs, 0, sizeof(soundRegs));
 
-	reset(time);
-	registerSound(config);
-
-	// only attach once all initialization is successful
-	vibratoPercent.attach(*this);
-	detunePercent .attach(*this);
-}
-
-AY8910::~AY8910()
-{
-	vibratoPercent.detach(*this);
-	detunePercent .detach(*this);
-
-	unregisterSound();
+	reset();
 }
 
-void AY8910::reset(EmuTime::param time)
+void AY8910Core::reset()
 {
-	// Reset generators and envelope.
 	for (auto& t : tone) t.reset();
 	noise.reset();
 	envelope.reset();
-	// Reset registers and values derived from them.
-	for (auto reg : xrange(16)) {
-		wrtReg(reg, 0, time);
+	regLog.clear();
+	for (auto reg : xrange(unsigned(AY_PORTA))) {
+		writeRegister(reg, 0);
 	}
 }
 
-
-byte AY8910::readRegister(unsigned reg, EmuTime::param time)
+void AY8910Core::writeRegister(unsigned reg, byte value)
 {
-	if (reg >= 16) return 255;
-	switch (reg) {
-	case AY_PORTA:
-		if (!(regs[AY_ENABLE] & PORT_A_DIRECTION)) { // input
-			regs[reg] = periphery.readA(time);
-		}
-		break;
-	case AY_PORTB:
-		if (!(regs[AY_ENABLE] & PORT_B_DIRECTION)) { // input
-			regs[reg] = periphery.readB(time);
-		}
-		break;
-	}
-
-	// TODO some AY8910 models have 1F as mask for registers 1, 3, 5
-	static constexpr byte regMask[16] = {
-		0xff, 0x0f, 0xff, 0x0f, 0xff, 0x0f, 0x1f, 0xff,
-		0x1f, 0x1f ,0x1f, 0xff, 0xff, 0x0f, 0xff, 0xff
-	};
-	return isAY8910 ? regs[reg] & regMask[reg]
-	                : regs[reg];
-}
-
-byte AY8910::peekRegister(unsigned reg, EmuTime::param time) const
-{
-	if (reg >= 16) return 255;
-	switch (reg) {
-	case AY_PORTA:
-		if (!(regs[AY_ENABLE] & PORT_A_DIRECTION)) { // input
-			return periphery.readA(time);
-		}
-		break;
-	case AY_PORTB:
-		if (!(regs[AY_ENABLE] & PORT_B_DIRECTION)) { // input
-			return periphery.readB(time);
-		}
-		break;
-	}
-	return regs[reg];
-}
-
-
-void AY8910::writeRegister(unsigned reg, byte value, EmuTime::param time)
-{
-	if (reg >= 16) return;
-	if ((reg < AY_PORTA) && (reg == AY_ESHAPE || regs[reg] != value)) {
-		// Update the output buffer before changing the register.
-		updateStream(time);
-	}
-	wrtReg(reg, value, time);
-}
-void AY8910::wrtReg(unsigned reg, byte value, EmuTime::param time)
-{
-	// Warn/force port directions
-	if (reg == AY_ENABLE) {
-		if (value & PORT_A_DIRECTION) {
-			directionsCallback.execute();
-		}
-		if (ignorePortDirections)
-		{
-			// portA -> input
-			// portB -> output
-			value = (value & ~PORT_A_DIRECTION) | PORT_B_DIRECTION;
-		}
-	}
-
-	// Note: unused bits are stored as well; they can be read back.
-	byte diff = regs[reg] ^ value;
-	regs[reg] = value;
+	assert(reg < AY_PORTA);
+	soundRegs[reg] = value;
 
 	switch (reg) {
 	case AY_AFINE:
@@ -613,7 +507,7 @@ void AY8910::wrtReg(unsigned reg, byte value, EmuTime::param time)
 	case AY_BCOARSE:
 	case AY_CFINE:
 	case AY_CCOARSE:
-		tone[reg / 2].setPeriod(regs[reg & ~1] + 256 * (regs[reg | 1] & 0x0F));
+		tone[reg / 2].setPeriod(soundRegs[reg & ~1] + 256 * (soundRegs[reg | 1] & 0x0F));
 		break;
 	case AY_NOISEPER:
 		// Half the frequency of tone generation.
@@ -635,51 +529,67 @@ void AY8910::wrtReg(unsigned reg, byte value, EmuTime::param time)
 	case AY_ECOARSE:
 		// also half the frequency of tone generation, but handled
 		// inside Envelope::setPeriod()
-		envelope.setPeriod(regs[AY_EFINE] + 256 * regs[AY_ECOARSE]);
+		envelope.setPeriod(soundRegs[AY_EFINE] + 256 * soundRegs[AY_ECOARSE]);
 		break;
 	case AY_ESHAPE:
 		envelope.setShape(value);
 		break;
-	case AY_ENABLE:
-		if (diff & PORT_A_DIRECTION) {
-			// port A changed
-			if (value & PORT_A_DIRECTION) {
-				// from input to output
-				periphery.writeA(regs[AY_PORTA], time);
-			} else {
-				// from output to input
-				periphery.writeA(0xff, time);
-			}
-		}
-		if (diff & PORT_B_DIRECTION) {
-			// port B changed
-			if (value & PORT_B_DIRECTION) {
-				// from input to output
-				periphery.writeB(regs[AY_PORTB], time);
-			} else {
-				// from output to input
-				periphery.writeB(0xff, time);
-			}
-		}
-		break;
-	case AY_PORTA:
-		if (regs[AY_ENABLE] & PORT_A_DIRECTION) { // output
-			periphery.writeA(value, time);
-		}
-		break;
-	case AY_PORTB:
-		if (regs[AY_ENABLE] & PORT_B_DIRECTION) { // output
-			periphery.writeB(value, time);
+	}
+}
+
+void AY8910Core::restoreRegisters(const byte* regs)
+{
+	regLog.clear();
+	for (auto reg : xrange(unsigned(AY_ESHAPE))) {
+		writeRegister(reg, regs[reg]);
+	}
+	soundRegs[AY_ESHAPE] = regs[AY_ESHAPE];
+}
+
+void AY8910Core::setDetune(float vibratoPercent_, float vibratoFrequency_,
+                           float detunePercent_, float detuneFrequency_)
+{
+	vibratoPercent   = vibratoPercent_;
+	vibratoFrequency = vibratoFrequency_;
+	detunePercent    = detunePercent_;
+	detuneFrequency  = detuneFrequency_;
+	doDetune = (vibratoPercent != 0.0f) || (detunePercent != 0.0f);
+	if (doDetune) {
+		// (lazily) initialize detune stuff
+		static bool detuneInitialized = false;
+		if (!detuneInitialized) {
+			detuneInitialized = true;
+			initDetune();
 		}
-		break;
 	}
 }
 
-void AY8910::generateChannels(float** bufs, unsigned num)
+void AY8910Core::generateChannels(float** bufs, unsigned num, const DynamicClock& clock)
+{
+	// Generate the block in fragments, with the logged register writes
+	// applied in between.
+	float* used[3] = {nullptr, nullptr, nullptr};
+	regLog.render(clock, num,
+		[&](unsigned offset, unsigned length) {
+			float* fragBufs[3];
+			for (auto chan : xrange(3)) {
+				fragBufs[chan] = bufs[chan] + offset;
+			}
+			generateFragment(fragBufs, length);
+			for (auto chan : xrange(3)) {
+				if (fragBufs[chan]) used[chan] = bufs[chan];
+			}
+		},
+		[&](unsigned reg, byte value) { writeRegister(reg, value); });
+	// Channels that were silent in all fragments still contain all zeros.
+	ranges::copy(used, bufs);
+}
+
+void AY8910Core::generateFragment(float** bufs, unsigned num)
 {
 	// Disable channels with volume 0: since the sample value doesn't matter,
 	// we can use the fastest path.
-	unsigned chanEnable = regs[AY_ENABLE];
+	unsigned chanEnable = soundRegs[AY_ENABLE];
 	for (auto chan : xrange(3)) {
 		if ((!amplitude.followsEnvelope(chan) &&
 		     (amplitude.getVolume(chan) == 0.0f)) ||
@@ -724,14 +634,14 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextT = t.getNextEventTime();
 				while ((nextT <= remaining) || (nextE <= remaining)) {
 					if (nextT < nextE) {
-						addFill(buf, val, nextT);
+						SoundDevice::addFill(buf, val, nextT);
 						remaining -= nextT;
 						nextE -= nextT;
 						envelope.advanceFast(nextT);
 						t.doNextEvent(*this);
 						nextT = t.getNextEventTime();
 					} else if (nextE < nextT) {
-						addFill(buf, val, nextE);
+						SoundDevice::addFill(buf, val, nextE);
 						remaining -= nextE;
 						nextT -= nextE;
 						t.advanceFast(nextE);
@@ -739,7 +649,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						nextE = envelope.getNextEventTime();
 					} else {
 						assert(nextT == nextE);
-						addFill(buf, val, nextT);
+						SoundDevice::addFill(buf, val, nextT);
 						remaining -= nextT;
 						t.doNextEvent(*this);
 						nextT = t.getNextEventTime();
@@ -750,7 +660,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					SoundDevice::addFill(buf, val, remaining);
 					t.advanceFast(remaining);
 					envelope.advanceFast(remaining);
 				}
@@ -761,7 +671,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned remaining = num;
 				unsigned next = envelope.getNextEventTime();
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					SoundDevice::addFill(buf, val, next);
 					remaining -= next;
 					envelope.doNextEvent();
 					val = envelope.getVolume();
@@ -769,7 +679,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					SoundDevice::addFill(buf, val, remaining);
 					envelope.advanceFast(remaining);
 				}
 				t.advance(num);
@@ -784,7 +694,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextE = envelope.getNextEventTime();
 				unsigned next = std::min(std::min(nextT, nextN), nextE);
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					SoundDevice::addFill(buf, val, next);
 					remaining -= next;
 					nextT -= next;
 					nextN -= next;
@@ -812,7 +722,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					SoundDevice::addFill(buf, val, remaining);
 					t.advanceFast(remaining);
 					noise.advanceFast(remaining);
 					envelope.advanceFast(remaining);
@@ -827,14 +737,14 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextN = noise.getNextEventTime();
 				while ((nextN <= remaining) || (nextE <= remaining)) {
 					if (nextN < nextE) {
-						addFill(buf, val, nextN);
+						SoundDevice::addFill(buf, val, nextN);
 						remaining -= nextN;
 						nextE -= nextN;
 						envelope.advanceFast(nextN);
 						noise.doNextEvent();
 						nextN = noise.getNextEventTime();
 					} else if (nextE < nextN) {
-						addFill(buf, val, nextE);
+						SoundDevice::addFill(buf, val, nextE);
 						remaining -= nextE;
 						nextN -= nextE;
 						noise.advanceFast(nextE);
@@ -842,7 +752,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						nextE = envelope.getNextEventTime();
 					} else {
 						assert(nextN == nextE);
-						addFill(buf, val, nextN);
+						SoundDevice::addFill(buf, val, nextN);
 						remaining -= nextN;
 						noise.doNextEvent();
 						nextN = noise.getNextEventTime();
@@ -853,7 +763,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					SoundDevice::addFill(buf, val, remaining);
 					noise.advanceFast(remaining);
 					envelope.advanceFast(remaining);
 				}
@@ -870,7 +780,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned remaining = num;
 				unsigned next = t.getNextEventTime();
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					SoundDevice::addFill(buf, val, next);
 					val = volume - val;
 					remaining -= next;
 					t.doNextEvent(*this);
@@ -878,13 +788,13 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					SoundDevice::addFill(buf, val, remaining);
 					t.advanceFast(remaining);
 				}
 
 			} else if ((chanEnable & 0x09) == 0x09) {
 				// no noise, channel disabled: always 1.
-				addFill(buf, volume, num);
+				SoundDevice::addFill(buf, volume, num);
 				t.advance(num);
 
 			} else if ((chanEnable & 0x09) == 0x00) {
@@ -897,7 +807,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextT = t.getNextEventTime();
 				while ((nextN <= remaining) || (nextT <= remaining)) {
 					if (nextT < nextN) {
-						addFill(buf, val2, nextT);
+						SoundDevice::addFill(buf, val2, nextT);
 						remaining -= nextT;
 						nextN -= nextT;
 						noise.advanceFast(nextT);
@@ -906,7 +816,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						val1 = volume - val1;
 						val2 = val1 * noise.getOutput();
 					} else if (nextN < nextT) {
-						addFill(buf, val2, nextN);
+						SoundDevice::addFill(buf, val2, nextN);
 						remaining -= nextN;
 						nextT -= nextN;
 						t.advanceFast(nextN);
@@ -915,7 +825,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						val2 = val1 * noise.getOutput();
 					} else {
 						assert(nextT == nextN);
-						addFill(buf, val2, nextT);
+						SoundDevice::addFill(buf, val2, nextT);
 						remaining -= nextT;
 						t.doNextEvent(*this);
 						nextT = t.getNextEventTime();
@@ -927,7 +837,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val2, remaining);
+					SoundDevice::addFill(buf, val2, remaining);
 					t.advanceFast(remaining);
 					noise.advanceFast(remaining);
 				}
@@ -939,7 +849,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				auto val = noise.getOutput() * volume;
 				unsigned next = noise.getNextEventTime();
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					SoundDevice::addFill(buf, val, next);
 					remaining -= next;
 					noise.doNextEvent();
 					val = noise.getOutput() * volume;
@@ -947,7 +857,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					SoundDevice::addFill(buf, val, remaining);
 					noise.advanceFast(remaining);
 				}
 				t.advance(num);
@@ -961,6 +871,184 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 	}
 }
 
+
+// AY8910 main class:
+
+AY8910::AY8910(const std::string& name_, AY8910Periphery& periphery_,
+               const DeviceConfig& config, EmuTime::param time)
+	: ResampledSoundDevice(config.getMotherBoard(), name_, "PSG", 3, NATIVE_FREQ_INT, false)
+	, periphery(periphery_)
+	, debuggable(config.getMotherBoard(), getName())
+	, vibratoPercent(
+		config.getCommandController(), tmpStrCat(getName(), "_vibrato_percent"),
+		"controls strength of vibrato effect", 0.0, 0.0, 10.0)
+	, vibratoFrequency(
+		config.getCommandController(), tmpStrCat(getName(), "_vibrato_frequency"),
+		"frequency of vibrato effect in Hertz", 5, 1.0, 10.0)
+	, detunePercent(
+		config.getCommandController(), tmpStrCat(getName(), "_detune_percent"),
+		"controls strength of detune effect", 0.0, 0.0, 10.0)
+	, detuneFrequency(
+		config.getCommandController(), tmpStrCat(getName(), "_detune_frequency"),
+		"frequency of detune effect in Hertz", 5.0, 1.0, 100.0)
+	, directionsCallback(
+		config.getGlobalSettings().getInvalidPsgDirectionsSetting())
+	, core(checkAY8910(config))
+	, isAY8910(checkAY8910(config))
+	, ignorePortDirections(config.getChildDataAsBool("ignorePortDirections", true))
+{
+	update(vibratoPercent);
+
+	// make valgrind happy
+	memset(regs, 0, sizeof(regs));
+
+	reset(time);
+	registerSound(config);
+
+	// only attach once all initialization is successful
+	vibratoPercent  .attach(*this);
+	vibratoFrequency.attach(*this);
+	detunePercent   .attach(*this);
+	detuneFrequency .attach(*this);
+}
+
+AY8910::~AY8910()
+{
+	vibratoPercent  .detach(*this);
+	vibratoFrequency.detach(*this);
+	detunePercent   .detach(*this);
+	detuneFrequency .detach(*this);
+
+	unregisterSound();
+}
+
+void AY8910::reset(EmuTime::param time)
+{
+	// Reset generators, envelope and the sound registers.
+	core.reset();
+	// Reset registers and values derived from them.
+	for (auto reg : xrange(16)) {
+		wrtReg(reg, 0, time);
+	}
+}
+
+
+byte AY8910::readRegister(unsigned reg, EmuTime::param time)
+{
+	if (reg >= 16) return 255;
+	switch (reg) {
+	case AY_PORTA:
+		if (!(regs[AY_ENABLE] & PORT_A_DIRECTION)) { // input
+			regs[reg] = periphery.readA(time);
+		}
+		break;
+	case AY_PORTB:
+		if (!(regs[AY_ENABLE] & PORT_B_DIRECTION)) { // input
+			regs[reg] = periphery.readB(time);
+		}
+		break;
+	}
+
+	// TODO some AY8910 models have 1F as mask for registers 1, 3, 5
+	static constexpr byte regMask[16] = {
+		0xff, 0x0f, 0xff, 0x0f, 0xff, 0x0f, 0x1f, 0xff,
+		0x1f, 0x1f ,0x1f, 0xff, 0xff, 0x0f, 0xff, 0xff
+	};
+	return isAY8910 ? regs[reg] & regMask[reg]
+	                : regs[reg];
+}
+
+byte AY8910::peekRegister(unsigned reg, EmuTime::param time) const
+{
+	if (reg >= 16) return 255;
+	switch (reg) {
+	case AY_PORTA:
+		if (!(regs[AY_ENABLE] & PORT_A_DIRECTION)) { // input
+			return periphery.readA(time);
+		}
+		break;
+	case AY_PORTB:
+		if (!(regs[AY_ENABLE] & PORT_B_DIRECTION)) { // input
+			return periphery.readB(time);
+		}
+		break;
+	}
+	return regs[reg];
+}
+
+
+void AY8910::writeRegister(unsigned reg, byte value, EmuTime::param time)
+{
+	if (reg >= 16) return;
+	if ((reg < AY_PORTA) && (reg == AY_ESHAPE || regs[reg] != value)) {
+		// Instead of updating the output buffer before changing the
+		// register, log the write. It's applied at the exact sample
+		// position while generating sound (see generateChannels()).
+		core.logWrite(time, reg, value);
+	}
+	wrtReg(reg, value, time);
+}
+
+void AY8910::wrtReg(unsigned reg, byte value, EmuTime::param time)
+{
+	// Warn/force port directions
+	if (reg == AY_ENABLE) {
+		if (value & PORT_A_DIRECTION) {
+			directionsCallback.execute();
+		}
+		if (ignorePortDirections)
+		{
+			// portA -> input
+			// portB -> output
+			value = (value & ~PORT_A_DIRECTION) | PORT_B_DIRECTION;
+		}
+	}
+
+	// Note: unused bits are stored as well; they can be read back.
+	byte diff = regs[reg] ^ value;
+	regs[reg] = value;
+
+	switch (reg) {
+	case AY_ENABLE:
+		if (diff & PORT_A_DIRECTION) {
+			// port A changed
+			if (value & PORT_A_DIRECTION) {
+				// from input to output
+				periphery.writeA(regs[AY_PORTA], time);
+			} else {
+				// from output to input
+				periphery.writeA(0xff, time);
+			}
+		}
+		if (diff & PORT_B_DIRECTION) {
+			// port B changed
+			if (value & PORT_B_DIRECTION) {
+				// from input to output
+				periphery.writeB(regs[AY_PORTB], time);
+			} else {
+				// from output to input
+				periphery.writeB(0xff, time);
+			}
+		}
+		break;
+	case AY_PORTA:
+		if (regs[AY_ENABLE] & PORT_A_DIRECTION) { // output
+			periphery.writeA(value, time);
+		}
+		break;
+	case AY_PORTB:
+		if (regs[AY_ENABLE] & PORT_B_DIRECTION) { // output
+			periphery.writeB(value, time);
+		}
+		break;
+	}
+}
+
+void AY8910::generateChannels(float** bufs, unsigned num)
+{
+	core.generateChannels(bufs, num, getInputClock());
+}
+
 float AY8910::getAmplificationFactorImpl() const
 {
 	return 1.0f;
@@ -968,13 +1056,12 @@ float AY8910::getAmplificationFactorImpl() const
 
 void AY8910::update(const Setting& setting) noexcept
 {
-	if (&setting == one_of(&vibratoPercent, &detunePercent)) {
-		doDetune = (vibratoPercent.getDouble() != 0) ||
-			   (detunePercent .getDouble() != 0);
-		if (doDetune && !detuneInitialized) {
-			detuneInitialized = true;
-			initDetune();
-		}
+	if (&setting == one_of(&vibratoPercent, &vibratoFrequency,
+	                       &detunePercent, &detuneFrequency)) {
+		core.setDetune(float(vibratoPercent  .getDouble()),
+		               float(vibratoFrequency.getDouble()),
+		               float(detunePercent   .getDouble()),
+		               float(detuneFrequency .getDouble()));
 	} else {
 		ResampledSoundDevice::update(setting);
 	}
@@ -1001,37 +1088,60 @@ void AY8910::Debuggable::write(unsigned address, byte value, EmuTime::param time
 }
 
 
+// version 1: initial version
+// version 2: also store the sound registers and the pending (logged)
+//            register writes, see AY8910Core
 template<typename Archive>
-void AY8910::serialize(Archive& ar, unsigned /*version*/)
+void AY8910::serialize(Archive& ar, unsigned version)
 {
-	ar.serialize("toneGenerators", tone,
-	             "noiseGenerator", noise,
-	             "envelope",       envelope,
-	             "registers",      regs);
+	core.serialize(ar, version);
+	ar.serialize("registers", regs);
 
-	// amplitude
 	if constexpr (Archive::IS_LOADER) {
-		for (auto i : xrange(3)) {
-			amplitude.setChannelVolume(i, regs[i + AY_AVOL]);
+		if (ar.versionBelow(version, 2)) {
+			// Older versions didn't log register writes, so the
+			// sound generation state follows from the registers.
+			core.restoreRegisters(regs);
 		}
 	}
 }
 INSTANTIATE_SERIALIZE_METHODS(AY8910);
 
+template<typename Archive>
+void AY8910Core::serialize(Archive& ar, unsigned version)
+{
+	ar.serialize("toneGenerators", tone,
+	             "noiseGenerator", noise,
+	             "envelope",       envelope);
+	if (ar.versionAtLeast(version, 2)) {
+		// The pending writes are applied later, at their own time.
+		// Until then the sound registers can differ from the (MSX
+		// visible) registers in AY8910.
+		ar.serialize("soundRegisters", soundRegs,
+		             "pendingWrites",  regLog);
+		if constexpr (Archive::IS_LOADER) {
+			for (auto chan : xrange(3)) {
+				amplitude.setChannelVolume(chan, soundRegs[AY_AVOL + chan]);
+			}
+		}
+	}
+}
+INSTANTIATE_SERIALIZE_METHODS(AY8910Core);
+
 // version 1: initial version
 // version 2: removed 'output' member variable
 template<typename Archive>
-void AY8910::Generator::serialize(Archive& ar, unsigned /*version*/)
+void AY8910Core::Generator::serialize(Archive& ar, unsigned /*version*/)
 {
 	ar.serialize("period", period,
 	             "count", count);
 }
-INSTANTIATE_SERIALIZE_METHODS(AY8910::Generator);
+INSTANTIATE_SERIALIZE_METHODS(AY8910Core::Generator);
 
 // version 1: initial version
 // version 2: moved 'output' variable from base class to here
 template<typename Archive>
-void AY8910::ToneGenerator::serialize(Archive& ar, unsigned version)
+void AY8910Core::ToneGenerator::serialize(Archive& ar, unsigned version)
 {
 	ar.template serializeInlinedBase<Generator>(*this, version);
 	ar.serialize("vibratoCount", vibratoCount,
@@ -1044,21 +1154,21 @@ void AY8910::ToneGenerator::serialize(Archive& ar, unsigned version)
 		// difference in generated sound will likely be inaudible
 	}
 }
-INSTANTIATE_SERIALIZE_METHODS(AY8910::ToneGenerator);
+INSTANTIATE_SERIALIZE_METHODS(AY8910Core::ToneGenerator);
 
 // version 1: initial version
 // version 2: removed 'output' variable from base class, not stored here but
 //            instead it's calculated from 'random' when needed
 template<typename Archive>
-void AY8910::NoiseGenerator::serialize(Archive& ar, unsigned version)
+void AY8910Core::NoiseGenerator::serialize(Archive& ar, unsigned version)
 {
 	ar.template serializeInlinedBase<Generator>(*this, version);
 	ar.serialize("random", random);
 }
-INSTANTIATE_SERIALIZE_METHODS(AY8910::NoiseGenerator);
+INSTANTIATE_SERIALIZE_METHODS(AY8910Core::NoiseGenerator);
 
 template<typename Archive>
-void AY8910::Envelope::serialize(Archive& ar, unsigned /*version*/)
+void AY8910Core::Envelope::serialize(Archive& ar, unsigned /*version*/)
 {
 	ar.serialize("period",    period,
 	             "count",     count,
@@ -1068,6 +1178,6 @@ void AY8910::Envelope::serialize(Archive& ar, unsigned /*version*/)
 	             "alternate", alternate,
 	             "holding",   holding);
 }
-INSTANTIATE_SERIALIZE_METHODS(AY8910::Envelope);
+INSTANTIATE_SERIALIZE_METHODS(AY8910Core::Envelope);
 
 } // namespace openmsx
@@ -2,6 +2,7 @@
 #define AY8910_HH
 
 #include "ResampledSoundDevice.hh"
+#include "SoundRegisterLog.hh"
 #include "FloatSetting.hh"
 #include "SimpleDebuggable.hh"
 #include "TclCallback.hh"
@@ -12,22 +13,54 @@ namespace openmsx {
 class AY8910Periphery;
 class DeviceConfig;
 
-/** This class implements the AY-3-8910 sound chip.
-  * Only the AY-3-8910 is emulated, no surrounding hardware,
-  * use the class AY8910Periphery to connect peripherals.
+/** The sound generation part of the AY-3-8910: the tone, noise and envelope
+  * generators and the mixing of their outputs. It only knows about the sound
+  * registers (not about the I/O ports) and it doesn't depend on a
+  * motherboard, so it can also be used standalone (e.g. in unit tests).
   */
-class AY8910 final : public ResampledSoundDevice
+class AY8910Core
 {
 public:
-	AY8910(const std::string& name, AY8910Periphery& periphery,
-	       const DeviceConfig& config, EmuTime::param time);
-	~AY8910();
-
-	[[nodiscard]] byte readRegister(unsigned reg, EmuTime::param time);
-	[[nodiscard]] byte peekRegister(unsigned reg, EmuTime::param time) const;
-	void writeRegister(unsigned reg, byte value, EmuTime::param time);
-	void reset(EmuTime::param time);
-
+	explicit AY8910Core(bool isAY8910);
+
+	/** Reset the generators, set all sound registers to zero and discard
+	  * all pending writes.
+	  */
+	void reset();
+
+	/** Write a sound register (0-13). The write is logged, it's applied
+	  * right before the first sample after 'time' in a later call to
+	  * generateChannels().
+	  */
+	void logWrite(EmuTime::param time, unsigned reg, byte value) {
+		regLog.push(time, reg, value);
+	}
+
+	/** Write a sound register (0-13), immediately. */
+	void writeRegister(unsigned reg, byte value);
+
+	/** Re-derive the sound generation state from the given register
+	  * values, pending writes are discarded. Unlike a sequence of
+	  * writeRegister() calls this doesn't restart the envelope. Only used
+	  * for old savestates, those don't store the sound registers.
+	  */
+	void restoreRegisters(const byte* regs);
+
+	/** Generate 'num' samples for each of the 3 channels, like
+	  * SoundDevice::generateChannels().
+	  * @param clock Time of the sample right before the first sample of
+	  *              this block, ticks once per sample. Used to position
+	  *              the logged writes.
+	  */
+	void generateChannels(float** bufs, unsigned num, const DynamicClock& clock);
+
+	void setDetune(float vibratoPercent, float vibratoFrequency,
+	               float detunePercent, float detuneFrequency);
+
+	/** Stores the generators, the sound registers and the pending
+	  * writes. This is serialized inline in AY8910, so 'version' is the
+	  * version of AY8910.
+	  */
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -69,7 +102,7 @@ private:
 		  */
 		inline void advance(int duration);
 
-		inline void doNextEvent(AY8910& ay8910);
+		inline void doNextEvent(const AY8910Core& core);
 
 		/** Gets the current output of this generator.
 		  */
@@ -79,7 +112,7 @@ private:
 		void serialize(Archive& ar, unsigned version);
 
 	private:
-		[[nodiscard]] int getDetune(AY8910& ay8910);
+		[[nodiscard]] int getDetune(const AY8910Core& core);
 
 	private:
 		/** Time passed since start of vibrato cycle.
@@ -117,7 +150,7 @@ private:
 
 	class Amplitude {
 	public:
-		explicit Amplitude(const DeviceConfig& config);
+		explicit Amplitude(bool isAY8910);
 		[[nodiscard]] const float* getEnvVolTable() const;
 		[[nodiscard]] inline float getVolume(unsigned chan) const;
 		inline void setChannelVolume(unsigned chan, unsigned value);
@@ -159,6 +192,42 @@ private:
 		bool hold, alternate, holding;
 	};
 
+	void generateFragment(float** bufs, unsigned num);
+
+private:
+	ToneGenerator tone[3];
+	NoiseGenerator noise;
+	Amplitude amplitude;
+	Envelope envelope;
+	SoundRegisterLog regLog;
+	byte soundRegs[14]; // registers as seen by the sound generation
+	float vibratoPercent = 0.0f;
+	float vibratoFrequency = 5.0f;
+	float detunePercent = 0.0f;
+	float detuneFrequency = 5.0f;
+	bool doDetune = false;
+};
+
+/** This class implements the AY-3-8910 sound chip.
+  * Only the AY-3-8910 is emulated, no surrounding hardware,
+  * use the class AY8910Periphery to connect peripherals.
+  */
+class AY8910 final : public ResampledSoundDevice
+{
+public:
+	AY8910(const std::string& name, AY8910Periphery& periphery,
+	       const DeviceConfig& config, EmuTime::param time);
+	~AY8910();
+
+	[[nodiscard]] byte readRegister(unsigned reg, EmuTime::param time);
+	[[nodiscard]] byte peekRegister(unsigned reg, EmuTime::param time) const;
+	void writeRegister(unsigned reg, byte value, EmuTime::param time);
+	void reset(EmuTime::param time);
+
+	template<typename Archive>
+	void serialize(Archive& ar, unsigned version);
+
+private:
 	// SoundDevice
 	void generateChannels(float** bufs, unsigned num) override;
 	[[nodiscard]] float getAmplificationFactorImpl() const override;
@@ -182,20 +251,16 @@ private:
 	FloatSetting detunePercent;
 	FloatSetting detuneFrequency;
 	TclCallback directionsCallback;
-	ToneGenerator tone[3];
-	NoiseGenerator noise;
-	Amplitude amplitude;
-	Envelope envelope;
+	AY8910Core core;
 	byte regs[16];
 	const bool isAY8910;
 	const bool ignorePortDirections;
-	bool doDetune;
-	bool detuneInitialized;
 };
 
-SERIALIZE_CLASS_VERSION(AY8910::Generator, 2);
-SERIALIZE_CLASS_VERSION(AY8910::ToneGenerator, 2);
-SERIALIZE_CLASS_VERSION(AY8910::NoiseGenerator, 2);
+SERIALIZE_CLASS_VERSION(AY8910, 2);
+SERIALIZE_CLASS_VERSION(AY8910Core::Generator, 2);
+SERIALIZE_CLASS_VERSION(AY8910Core::ToneGenerator, 2);
+SERIALIZE_CLASS_VERSION(AY8910Core::NoiseGenerator, 2);
 
 } // namespace openmsx
 
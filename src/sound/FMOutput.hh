@@ -0,0 +1,66 @@
+#ifndef FMOUTPUT_HH
+#define FMOUTPUT_HH
+
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Helpers for the FM sound chips (YMF262, Y8950) to add a block of (integer)
+// channel output to the (float) output buffer of that channel.
+//
+// The chips first calculate a block of samples for all channels (one sample
+// at a time, the operators of a channel depend on each other), and then these
+// routines convert and add the block per channel. Compared to converting and
+// adding each sample directly to the (up to 18 different) channel buffers this
+// is more cache friendly and it allows to process 4 samples at once with
+// SSE2. For each output element the additions still happen in the same order
+// and int->float conversion is exact for these values, so the result is
+// bit-identical to the straightforward scalar loop.
+
+namespace openmsx::FMOutput {
+
+// out[2*i + 0] += float(in[i] & maskL)
+// out[2*i + 1] += float(in[i] & maskR)
+inline void addStereo(float* out, const int* in, unsigned num,
+                      unsigned maskL, unsigned maskR)
+{
+	unsigned i = 0;
+#ifdef __SSE2__
+	__m128i mL = _mm_set1_epi32(int(maskL));
+	__m128i mR = _mm_set1_epi32(int(maskR));
+	for (/**/; (i + 4) <= num; i += 4) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128 l = _mm_cvtepi32_ps(_mm_and_si128(x, mL));
+		__m128 r = _mm_cvtepi32_ps(_mm_and_si128(x, mR));
+		__m128 lo = _mm_add_ps(_mm_loadu_ps(out + 2 * i + 0), _mm_unpacklo_ps(l, r));
+		__m128 hi = _mm_add_ps(_mm_loadu_ps(out + 2 * i + 4), _mm_unpackhi_ps(l, r));
+		_mm_storeu_ps(out + 2 * i + 0, lo);
+		_mm_storeu_ps(out + 2 * i + 4, hi);
+	}
+#endif
+	for (/**/; i < num; ++i) {
+		out[2 * i + 0] += int(in[i] & maskL);
+		out[2 * i + 1] += int(in[i] & maskR);
+	}
+}
+
+// out[i] += float(in[i])
+inline void addMono(float* out, const int* in, unsigned num)
+{
+	unsigned i = 0;
+#ifdef __SSE2__
+	for (/**/; (i + 4) <= num; i += 4) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_cvtepi32_ps(x)));
+	}
+#endif
+	for (/**/; i < num; ++i) {
+		out[i] += in[i];
+	}
+}
+
+} // namespace openmsx::FMOutput
+
+#endif
@@ -1,6 +1,7 @@
 #include "MSXMixer.hh"
 #include "Mixer.hh"
 #include "SoundDevice.hh"
+#include "WorkerPool.hh"
 #include "MSXMotherBoard.hh"
 #include "MSXCommandController.hh"
 #include "TclObject.hh"
@@ -10,11 +11,13 @@
 #include "StringSetting.hh"
 #include "BooleanSetting.hh"
 #include "CommandException.hh"
+#include "Timer.hh"
 #include "AviRecorder.hh"
 #include "Filename.hh"
 #include "FileOperations.hh"
 #include "CliComm.hh"
 #include "stl.hh"
+#include "strCat.hh"
 #include "aligned.hh"
 #include "enumerate.hh"
 #include "one_of.hh"
@@ -47,6 +50,8 @@ MSXMixer::MSXMixer(Mixer& mixer_, MSXMotherBoard& motherBoard_,
 	, throttleManager(globalSettings.getThrottleManager())
 	, prevTime(getCurrentTime(), 44100)
 	, soundDeviceInfo(commandController.getMachineInfoCommand())
+	, soundProfileInfo(commandController.getMachineInfoCommand())
+	, profileStart(PROFILE_SOUND ? Timer::getTimeNs() : 0)
 	, recorder(nullptr)
 	, synchronousCounter(0)
 {
@@ -173,7 +178,7 @@ void MSXMixer::updateStream(EmuTime::param time)
 	// call generate() even if count==0 and even if muted
 	generate(mixBuffer, time, count);
 
-	if (!muteCount && fragmentSize) {
+	if (!muteCount && fragmentSize && !offline) {
 		mixer.uploadBuffer(*this, mixBuffer, count);
 	}
 
@@ -407,6 +412,21 @@ static bool approxEqual(float x, float y)
 	return std::abs(x - y) < threshold;
 }
 
+// Call 'f()' and, only when PROFILE_SOUND is enabled, add the host time it
+// took to 'total'.
+template<typename F> static auto profiled(uint64_t& total, F f)
+{
+	if constexpr (PROFILE_SOUND) {
+		auto t0 = Timer::getTimeNs();
+		auto result = f();
+		total += Timer::getTimeNs() - t0;
+		return result;
+	} else {
+		(void)total;
+		return f();
+	}
+}
+
 void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 {
 	// The code below is specialized for a lot of cases (before this
@@ -437,32 +457,70 @@ void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 	constexpr unsigned HAS_STEREO_FLAG = 2;
 	unsigned usedBuffers = 0;
 
+	// Optionally let all sound devices render in parallel, each into its
+	// own buffer. The results are mixed below in the same order as in the
+	// serial case, so the output is bit-identical. For small numbers of
+	// samples the overhead of waking the worker threads isn't worth it.
+	constexpr unsigned MIN_PARALLEL_SAMPLES = 64;
+	auto* pool = mixer.getWorkerPool();
+	bool parallel = pool && (infos.size() > 1) && (samples >= MIN_PARALLEL_SAMPLES);
+	unsigned pitch = (2 * samples + 3) & ~3; // keep each buffer SSE aligned
+	VLA(bool, rendered, infos.size());
+	if (parallel) {
+		if (renderBufferSize < infos.size() * pitch) {
+			renderBufferSize = infos.size() * pitch;
+			renderBuffer.resize(renderBufferSize);
+		}
+		pool->run(unsigned(infos.size()), [&](unsigned i) {
+			rendered[i] = profiled(infos[i].updateTime, [&] {
+				return infos[i].device->updateBuffer(
+					samples, &renderBuffer[i * pitch], time);
+			});
+		});
+	}
+	auto render = [&](size_t i, float* buf) {
+		auto& device = *infos[i].device;
+		if (!parallel) {
+			return profiled(infos[i].updateTime, [&] {
+				return device.updateBuffer(samples, buf, time);
+			});
+		}
+		if (!rendered[i]) return false;
+		unsigned num = device.isStereo() ? 2 * samples : samples;
+		memcpy(buf, &renderBuffer[i * pitch], num * sizeof(float));
+		return true;
+	};
+
 	// FIXME: The Infos should be ordered such that all the mono
 	// devices are handled first
-	for (auto& info : infos) {
+	for (auto [i, info] : enumerate(infos)) {
+		// everything in this iteration, except for updateBuffer(), is
+		// accounted as mixing time
+		auto mixStart = PROFILE_SOUND ? Timer::getTimeNs() : 0;
+		auto updateBefore = info.updateTime;
 		SoundDevice& device = *info.device;
 		auto l1 = info.left1;
 		auto r1 = info.right1;
 		if (!device.isStereo()) {
 			if (l1 == r1) {
 				if (!(usedBuffers & HAS_MONO_FLAG)) {
-					if (device.updateBuffer(samples, monoBuf, time)) {
+					if (render(i, monoBuf)) {
 						usedBuffers |= HAS_MONO_FLAG;
 						mul(monoBuf, samples, l1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (render(i, tmpBuf)) {
 						mulAcc(monoBuf, tmpBuf, samples, l1);
 					}
 				}
 			} else {
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (render(i, stereoBuf)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mulExpand(stereoBuf, samples, l1, r1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (render(i, tmpBuf)) {
 						mulExpandAcc(stereoBuf, tmpBuf, samples, l1, r1);
 					}
 				}
@@ -474,28 +532,32 @@ void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 				assert(l2 == 0.0f);
 				assert(r1 == 0.0f);
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (render(i, stereoBuf)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mul(stereoBuf, 2 * samples, l1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (render(i, tmpBuf)) {
 						mulAcc(stereoBuf, tmpBuf, 2 * samples, l1);
 					}
 				}
 			} else {
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (render(i, stereoBuf)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mulMix2(stereoBuf, samples, l1, l2, r1, r2);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (render(i, tmpBuf)) {
 						mulMix2Acc(stereoBuf, tmpBuf, samples, l1, l2, r1, r2);
 					}
 				}
 			}
 		}
+		if constexpr (PROFILE_SOUND) {
+			info.mixTime += (Timer::getTimeNs() - mixStart) -
+			                (info.updateTime - updateBefore);
+		}
 	}
 
 	// DC removal filter
@@ -535,6 +597,35 @@ void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 	default: // mono + stereo
 		std::tie(tl0, tr0) = filterBothStereo(tl0, tr0, monoBuf, stereoBuf, output, samples);
 	}
+
+	if constexpr (PROFILE_SOUND) {
+		auto now = Timer::getTimeNs();
+		if ((now - profileStart) >= 1'000'000'000) {
+			updateProfile(now);
+		}
+	}
+}
+
+void MSXMixer::updateProfile(uint64_t now)
+{
+	// Scale the measurements of the past period (roughly 1 second) to
+	// exactly 1 second. So the results are in ns per second, 1e9 means one
+	// host core is fully occupied.
+	double scale = 1e9 / double(now - profileStart);
+	auto scaled = [&](uint64_t t) { return uint64_t(double(t) * scale); };
+	for (auto& info : infos) {
+		auto& p = info.history[profilePeriods % PROFILE_PERIODS];
+		auto generate = info.device->takeGenerateTime();
+		// the resampler calls generateChannels() from within updateBuffer()
+		auto resample = (info.updateTime > generate) ? (info.updateTime - generate) : 0;
+		p.generate = scaled(generate);
+		p.resample = scaled(resample);
+		p.mix      = scaled(info.mixTime);
+		info.updateTime = 0;
+		info.mixTime = 0;
+	}
+	++profilePeriods;
+	profileStart = now;
 }
 
 bool MSXMixer::needStereoRecording() const
@@ -593,12 +684,13 @@ void MSXMixer::setMixerParams(unsigned newFragmentSize, unsigned newSampleRate)
 	}
 }
 
-void MSXMixer::setRecorder(AviRecorder* newRecorder)
+void MSXMixer::setRecorder(AviRecorder* newRecorder, bool newOffline)
 {
 	if ((recorder != nullptr) != (newRecorder != nullptr)) {
 		setSynchronousMode(newRecorder != nullptr);
 	}
 	recorder = newRecorder;
+	offline = newRecorder && newOffline;
 }
 
 void MSXMixer::update(const Setting& setting) noexcept
@@ -795,4 +887,83 @@ void MSXMixer::SoundDeviceInfoTopic::tabCompletion(std::vector<std::string>& tok
 	}
 }
 
+
+// Sound profile info
+
+MSXMixer::SoundProfileInfoTopic::SoundProfileInfoTopic(
+		InfoCommand& machineInfoCommand)
+	: InfoTopic(machineInfoCommand, "sound_profile")
+{
+}
+
+void MSXMixer::SoundProfileInfoTopic::execute(
+	span<const TclObject> tokens, TclObject& result) const
+{
+	if constexpr (!PROFILE_SOUND) {
+		throw CommandException(
+			"Sound profiling is not enabled in this build, "
+			"see PROFILE_SOUND in SoundDevice.hh.");
+	}
+	auto& msxMixer = OUTER(MSXMixer, soundProfileInfo);
+	// rolling average over the last (up to) PROFILE_PERIODS periods
+	auto n = std::min(msxMixer.profilePeriods, PROFILE_PERIODS);
+	auto profile = [&](const SoundDeviceInfo& info) {
+		uint64_t generate = 0, resample = 0, mix = 0;
+		for (auto i : xrange(n)) {
+			const auto& p = info.history[i];
+			generate += p.generate;
+			resample += p.resample;
+			mix      += p.mix;
+		}
+		auto average = [&](uint64_t t) { return int64_t(n ? (t / n) : 0); };
+		return makeTclDict(
+			"generate", average(generate),
+			"resample", average(resample),
+			"mix",      average(mix));
+	};
+	switch (tokens.size()) {
+	case 2:
+		for (const auto& info : msxMixer.infos) {
+			result.addDictKeyValue(info.device->getName(), profile(info));
+		}
+		break;
+	case 3: {
+		auto it = ranges::find(msxMixer.infos, tokens[2].getString(),
+			[](auto& i) { return i.device->getName(); });
+		if (it == end(msxMixer.infos)) {
+			throw CommandException("Unknown sound device");
+		}
+		result = profile(*it);
+		break;
+	}
+	default:
+		throw CommandException("Too many parameters");
+	}
+}
+
+std::string MSXMixer::SoundProfileInfoTopic::help(span<const TclObject> /*tokens*/) const
+{
+	return strCat(
+	       "Shows how much host time is spent on each sound device. The "
+	       "measurements themselves cost time, so this is disabled by "
+	       "default: it only works when openMSX was built with PROFILE_SOUND "
+	       "(in SoundDevice.hh) set to true. The values are a rolling "
+	       "average over the last ", PROFILE_PERIODS, " seconds, updated "
+	       "once per second. For each device the time (in nanoseconds per "
+	       "second) is split in:\n"
+	       "  generate  the emulation of the sound device itself\n"
+	       "  resample  converting to the host sample rate\n"
+	       "  mix       mixing the output of the device with the other devices\n"
+	       "Optionally takes the name of a sound device as argument.\n");
+}
+
+void MSXMixer::SoundProfileInfoTopic::tabCompletion(std::vector<std::string>& tokens) const
+{
+	if (tokens.size() == 3) {
+		completeString(tokens, view::transform(
+			OUTER(MSXMixer, soundProfileInfo).infos,
+			[](auto& info) -> std::string_view { return info.device->getName(); }));
+	}
+}
+
 } // namespace openmsx
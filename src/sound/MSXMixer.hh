@@ -6,7 +6,11 @@
 #include "InfoTopic.hh"
 #include "EmuTime.hh"
 #include "DynamicClock.hh"
+#include "MemBuffer.hh"
+#include "aligned.hh"
 #include "dynarray.hh"
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <memory>
 
@@ -111,7 +115,11 @@ public:
 
 	// Called by AviRecorder
 	[[nodiscard]] bool needStereoRecording() const;
-	void setRecorder(AviRecorder* recorder);
+	/** Set (or with nullptr remove) the recorder.
+	  * In offline mode the generated sound only goes to the recorder, it
+	  * isn't passed to the sound driver.
+	  */
+	void setRecorder(AviRecorder* recorder, bool offline = false);
 
 	// Returns the nominal host sample rate (not adjusted for speed setting)
 	[[nodiscard]] unsigned getSampleRate() const { return hostSampleRate; }
@@ -121,6 +129,10 @@ public:
 	void reInit();
 
 private:
+	// 'sound_profile' reports the average over this many periods (of
+	// roughly one second each)
+	static constexpr unsigned PROFILE_PERIODS = 10;
+
 	struct SoundDeviceInfo {
 		SoundDeviceInfo(unsigned numChannels);
 
@@ -134,6 +146,18 @@ private:
 		dynarray<ChannelSettings> channelSettings;
 		float defaultVolume = 0.f;
 		float left1 = 0.f, right1 = 0.f, left2 = 0.f, right2 = 0.f;
+
+		// host time (in ns) spent on this device, see 'sound_profile'
+		// (only measured when PROFILE_SOUND is true)
+		struct Profile {
+			uint64_t generate = 0; // in SoundDevice::generateChannels()
+			uint64_t resample = 0; // rest of SoundDevice::updateBuffer()
+			uint64_t mix = 0;      // mixing into the output (mulAcc(), ...)
+		};
+		uint64_t updateTime = 0; // updateBuffer() in current period
+		uint64_t mixTime = 0;    // mixing in current period
+		// the last completed periods (circular), each scaled to 1 second
+		std::array<Profile, PROFILE_PERIODS> history;
 	};
 
 	void updateVolumeParams(SoundDeviceInfo& info);
@@ -141,6 +165,7 @@ private:
 	void reschedule();
 	void reschedule2();
 	void generate(float* output, EmuTime::param time, unsigned samples);
+	void updateProfile(uint64_t now);
 
 	// Schedulable
 	void executeUntil(EmuTime::param time) override;
@@ -161,6 +186,9 @@ private:
 	                         // not compensated for speed
 
 	std::vector<SoundDeviceInfo> infos;
+	// per device output when sound devices are rendered in parallel
+	MemBuffer<float, SSE_ALIGNMENT> renderBuffer;
+	size_t renderBufferSize = 0;
 
 	Mixer& mixer;
 	MSXMotherBoard& motherBoard;
@@ -180,8 +208,19 @@ private:
 		void tabCompletion(std::vector<std::string>& tokens) const override;
 	} soundDeviceInfo;
 
+	struct SoundProfileInfoTopic final : InfoTopic {
+		explicit SoundProfileInfoTopic(InfoCommand& machineInfoCommand);
+		void execute(span<const TclObject> tokens,
+			     TclObject& result) const override;
+		[[nodiscard]] std::string help(span<const TclObject> tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} soundProfileInfo;
+	uint64_t profileStart; // host time (ns) of the start of current period
+	unsigned profilePeriods = 0; // number of completed periods
+
 	AviRecorder* recorder;
 	unsigned synchronousCounter;
+	bool offline = false;
 
 	unsigned muteCount;
 	float tl0, tr0; // internal DC-filter state
@@ -2,10 +2,14 @@
 #include "MSXMixer.hh"
 #include "NullSoundDriver.hh"
 #include "SDLSoundDriver.hh"
+#include "Reactor.hh"
+#include "WorkerPool.hh"
 #include "CommandController.hh"
 #include "CliComm.hh"
 #include "MSXException.hh"
+#include "TclObject.hh"
 #include "one_of.hh"
+#include "outer.hh"
 #include "stl.hh"
 #include "unreachable.hh"
 #include "build-info.hh"
@@ -47,17 +51,25 @@ Mixer::Mixer(Reactor& reactor_, CommandController& commandController_)
 	, samplesSetting(
 		commandController, "samples",
 		"mixer samples", defaultsamples, 64, 8192)
+	, soundThreadsSetting(
+		commandController, "sound_threads",
+		"number of extra threads used to render the sound devices in "
+		"parallel, 0 means all sound devices are rendered on the "
+		"emulation thread", 0, 0, 16)
+	, soundBufferInfo(reactor.getOpenMSXInfoCommand())
 	, muteCount(0)
 {
-	muteSetting       .attach(*this);
-	frequencySetting  .attach(*this);
-	samplesSetting    .attach(*this);
-	soundDriverSetting.attach(*this);
+	muteSetting        .attach(*this);
+	frequencySetting   .attach(*this);
+	samplesSetting     .attach(*this);
+	soundDriverSetting .attach(*this);
+	soundThreadsSetting.attach(*this);
 
 	// Set correct initial mute state.
 	if (muteSetting.getBoolean()) ++muteCount;
 
 	reloadDriver();
+	recreateWorkerPool();
 }
 
 Mixer::~Mixer()
@@ -65,10 +77,11 @@ Mixer::~Mixer()
 	assert(msxMixers.empty());
 	driver.reset();
 
-	soundDriverSetting.detach(*this);
-	samplesSetting    .detach(*this);
-	frequencySetting  .detach(*this);
-	muteSetting       .detach(*this);
+	soundThreadsSetting.detach(*this);
+	soundDriverSetting .detach(*this);
+	samplesSetting     .detach(*this);
+	frequencySetting   .detach(*this);
+	muteSetting        .detach(*this);
 }
 
 void Mixer::reloadDriver()
@@ -100,6 +113,15 @@ void Mixer::reloadDriver()
 	muteHelper();
 }
 
+void Mixer::recreateWorkerPool()
+{
+	// Only called from the main thread, so not while an MSXMixer is
+	// using the old pool.
+	auto num = unsigned(soundThreadsSetting.getInt());
+	workerPool.reset();
+	if (num) workerPool = std::make_unique<WorkerPool>(num);
+}
+
 void Mixer::registerMixer(MSXMixer& mixer)
 {
 	assert(!contains(msxMixers, &mixer));
@@ -163,9 +185,39 @@ void Mixer::update(const Setting& setting) noexcept
 		}
 	} else if (&setting == one_of(&samplesSetting, &soundDriverSetting, &frequencySetting)) {
 		reloadDriver();
+	} else if (&setting == &soundThreadsSetting) {
+		recreateWorkerPool();
 	} else {
 		UNREACHABLE;
 	}
 }
 
+
+// class SoundBufferInfoTopic
+
+Mixer::SoundBufferInfoTopic::SoundBufferInfoTopic(InfoCommand& openMSXInfoCommand)
+	: InfoTopic(openMSXInfoCommand, "sound_buffer")
+{
+}
+
+void Mixer::SoundBufferInfoTopic::execute(span<const TclObject> /*tokens*/,
+                                          TclObject& result) const
+{
+	auto& mixer = OUTER(Mixer, soundBufferInfo);
+	auto stats = mixer.driver->getBufferStats();
+	result.addDictKeyValues("capacity",  int(stats.capacity),
+	                        "target",    int(stats.target),
+	                        "filled",    int(stats.filled),
+	                        "underruns", int64_t(stats.underruns),
+	                        "dropped",   int64_t(stats.dropped));
+}
+
+std::string Mixer::SoundBufferInfoTopic::help(span<const TclObject> /*tokens*/) const
+{
+	return "Returns a dict with the fill level statistics of the buffer "
+	       "between the emulation and the audio output (all sizes in "
+	       "samples): capacity, target (current maximum fill level, this "
+	       "is adjusted automatically), filled, underruns and dropped.";
+}
+
 } // namespace openmsx
@@ -5,12 +5,14 @@
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
 #include "IntegerSetting.hh"
+#include "InfoTopic.hh"
 #include <vector>
 #include <memory>
 
 namespace openmsx {
 
 class SoundDriver;
+class WorkerPool;
 class Reactor;
 class CommandController;
 class MSXMixer;
@@ -47,9 +49,16 @@ public:
 
 	[[nodiscard]] IntegerSetting& getMasterVolume() { return masterVolume; }
 
+	/** Threads to render sound devices in parallel, or nullptr when
+	  * sound devices should be rendered serially (see 'sound_threads'
+	  * setting).
+	  */
+	[[nodiscard]] WorkerPool* getWorkerPool() { return workerPool.get(); }
+
 private:
 	void reloadDriver();
 	void muteHelper();
+	void recreateWorkerPool();
 
 	// Observer<Setting>
 	void update(const Setting& setting) noexcept override;
@@ -58,6 +67,7 @@ private:
 	std::vector<MSXMixer*> msxMixers; // unordered
 
 	std::unique_ptr<SoundDriver> driver;
+	std::unique_ptr<WorkerPool> workerPool;
 	Reactor& reactor;
 	CommandController& commandController;
 
@@ -66,6 +76,14 @@ private:
 	IntegerSetting masterVolume;
 	IntegerSetting frequencySetting;
 	IntegerSetting samplesSetting;
+	IntegerSetting soundThreadsSetting;
+
+	struct SoundBufferInfoTopic final : InfoTopic {
+		explicit SoundBufferInfoTopic(InfoCommand& openMSXInfoCommand);
+		void execute(span<const TclObject> tokens,
+		             TclObject& result) const override;
+		[[nodiscard]] std::string help(span<const TclObject> tokens) const override;
+	} soundBufferInfo;
 
 	int muteCount;
 };
@@ -24,4 +24,9 @@ void NullSoundDriver::uploadBuffer(float* /*buffer*/, unsigned /*len*/)
 {
 }
 
+SoundDriver::BufferStats NullSoundDriver::getBufferStats() const
+{
+	return {};
+}
+
 } // namespace openmsx
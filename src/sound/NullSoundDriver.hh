@@ -15,6 +15,7 @@ public:
 	[[nodiscard]] unsigned getSamples() const override;
 
 	void uploadBuffer(float* buffer, unsigned len) override;
+	[[nodiscard]] BufferStats getBufferStats() const override;
 };
 
 } // namespace openmsx
@@ -0,0 +1,26 @@
+#ifndef RESAMPLEFILTER_HH
+#define RESAMPLEFILTER_HH
+
+#include <iterator>
+
+// The low-pass filter that is shared by the HQ and the polyphase resamplers.
+// Only the right half of the (symmetric) impulse response is stored. There
+// are INDEX_INC coefficients per input sample period (this is for the case
+// without downsampling, when downsampling the filter gets stretched).
+
+namespace openmsx {
+
+// Note: without appending 'f' to the values in ResampleCoeffs.ii,
+// this will generate thousands of C4305 warnings in VC++
+// E.g. warning C4305: 'initializing' : truncation from 'double' to 'const float'
+inline constexpr float coeffs[] = {
+	#include "ResampleCoeffs.ii"
+};
+
+constexpr int INDEX_INC = 128;
+constexpr int COEFF_LEN = int(std::size(coeffs));
+constexpr int COEFF_HALF_LEN = COEFF_LEN - 1;
+
+} // namespace openmsx
+
+#endif
@@ -11,6 +11,7 @@
 
 #include "ResampleHQ.hh"
 #include "ResampledSoundDevice.hh"
+#include "ResampleFilter.hh"
 #include "FixedPoint.hh"
 #include "MemBuffer.hh"
 #include "aligned.hh"
@@ -31,18 +32,8 @@
 
 namespace openmsx {
 
-// Note: without appending 'f' to the values in ResampleCoeffs.ii,
-// this will generate thousands of C4305 warnings in VC++
-// E.g. warning C4305: 'initializing' : truncation from 'double' to 'const float'
-constexpr float coeffs[] = {
-	#include "ResampleCoeffs.ii"
-};
-
 using FilterIndex = FixedPoint<16>;
 
-constexpr int INDEX_INC = 128;
-constexpr int COEFF_LEN = int(std::size(coeffs));
-constexpr int COEFF_HALF_LEN = COEFF_LEN - 1;
 constexpr unsigned TAB_LEN = 4096;
 constexpr unsigned HALF_TAB_LEN = TAB_LEN / 2;
 
@@ -0,0 +1,363 @@
+#include "ResamplePoly.hh"
+#include "ResampledSoundDevice.hh"
+#include "ResampleFilter.hh"
+#include "MemBuffer.hh"
+#include "likely.hh"
+#include "ranges.hh"
+#include "stl.hh"
+#include "vla.hh"
+#include "xrange.hh"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace openmsx {
+
+// Number of precomputed filter phases (per input sample period). The
+// coefficients for positions in between two phases are linearly
+// interpolated, so this can be a lot smaller than the number of rows in the
+// ResampleHQ table (that one uses the nearest row).
+constexpr unsigned PHASES = 256;
+
+// Row lengths (in floats) are a multiple of this, so that the inner loop
+// doesn't need a tail (8 floats = one AVX register).
+constexpr unsigned ROW_GRANULARITY = 8;
+constexpr size_t BANK_ALIGNMENT = 32;
+
+// When downsampling, stretch the filter (lower its cutoff frequency).
+static double getFloatIncr(double ratio)
+{
+	return (ratio > 1.0) ? INDEX_INC / ratio : INDEX_INC;
+}
+
+// Half the width of the filter, in input samples.
+static unsigned getHalfLen(double ratio)
+{
+	return unsigned(std::ceil(COEFF_HALF_LEN / getFloatIncr(ratio)));
+}
+
+// Each row of the bank contains 'filterLen * CHANNELS' coefficients for
+// phase 'p', directly followed by the same number of differences with
+// the coefficients of phase 'p + 1'.
+template<unsigned CHANNELS>
+class PolyphaseBanks
+{
+public:
+	PolyphaseBanks(const PolyphaseBanks&) = delete;
+	PolyphaseBanks& operator=(const PolyphaseBanks&) = delete;
+
+	static PolyphaseBanks& instance();
+	const float* getBank(double ratio, unsigned& filterLen);
+	void releaseBank(double ratio);
+
+private:
+	using Bank = MemBuffer<float, BANK_ALIGNMENT>;
+
+	PolyphaseBanks() = default;
+	~PolyphaseBanks();
+
+	static Bank calcBank(double ratio, unsigned& filterLen);
+
+	struct Element {
+		double ratio;
+		Bank bank;
+		unsigned filterLen;
+		unsigned count;
+	};
+	std::vector<Element> cache; // typically 1-4 entries -> unsorted vector
+};
+
+template<unsigned CHANNELS>
+PolyphaseBanks<CHANNELS>::~PolyphaseBanks()
+{
+	assert(cache.empty());
+}
+
+template<unsigned CHANNELS>
+PolyphaseBanks<CHANNELS>& PolyphaseBanks<CHANNELS>::instance()
+{
+	static PolyphaseBanks banks;
+	return banks;
+}
+
+template<unsigned CHANNELS>
+const float* PolyphaseBanks<CHANNELS>::getBank(double ratio, unsigned& filterLen)
+{
+	if (auto it = ranges::find(cache, ratio, &Element::ratio);
+	    it != end(cache)) {
+		filterLen = it->filterLen;
+		it->count++;
+		return it->bank.data();
+	}
+	Element elem;
+	elem.ratio = ratio;
+	elem.count = 1;
+	elem.bank = calcBank(ratio, elem.filterLen);
+	filterLen = elem.filterLen;
+	const float* result = elem.bank.data();
+	cache.push_back(std::move(elem));
+	return result;
+}
+
+template<unsigned CHANNELS>
+void PolyphaseBanks<CHANNELS>::releaseBank(double ratio)
+{
+	auto it = rfind_unguarded(cache, ratio, &Element::ratio);
+	it->count--;
+	if (it->count == 0) {
+		move_pop_back(cache, it);
+	}
+}
+
+template<unsigned CHANNELS>
+typename PolyphaseBanks<CHANNELS>::Bank PolyphaseBanks<CHANNELS>::calcBank(
+	double ratio, unsigned& filterLen)
+{
+	double floatIncr = getFloatIncr(ratio);
+	double normFactor = floatIncr / INDEX_INC;
+	auto filter = [&](double dist) {
+		double index = std::abs(dist) * floatIncr;
+		if (index >= COEFF_HALF_LEN) return 0.0;
+		int i = int(index);
+		double fraction = index - i;
+		return (double(coeffs[i]) +
+		        fraction * (double(coeffs[i + 1]) - double(coeffs[i]))) * normFactor;
+	};
+
+	unsigned halfLen = getHalfLen(ratio);
+	constexpr unsigned gran = ROW_GRANULARITY / CHANNELS;
+	filterLen = (2 * halfLen + gran - 1) & ~(gran - 1);
+	unsigned len = filterLen * CHANNELS;
+
+	// Row 'p' is for an output position that lies 'p / PHASES' past the
+	// first input sample, and (because only past input is available) with
+	// a delay of 'halfLen - 1' input samples.
+	auto calcRow = [&](unsigned p, float* row) {
+		double frac = double(p) / PHASES;
+		for (auto j : xrange(filterLen)) {
+			float c = (j < 2 * halfLen)
+			        ? float(filter(double(j) - (halfLen - 1) - frac))
+			        : 0.0f;
+			for (auto ch : xrange(CHANNELS)) {
+				row[j * CHANNELS + ch] = c;
+			}
+		}
+	};
+
+	Bank bank(PHASES * 2 * len);
+	std::vector<float> next(len);
+	calcRow(0, bank.data());
+	for (auto p : xrange(PHASES)) {
+		float* curr = &bank[p * 2 * len];
+		calcRow(p + 1, next.data());
+		for (auto i : xrange(len)) {
+			curr[len + i] = next[i] - curr[i];
+		}
+		if ((p + 1) < PHASES) {
+			memcpy(curr + 2 * len, next.data(), len * sizeof(float));
+		}
+	}
+	return bank;
+}
+
+
+#ifdef __SSE2__
+// Horizontal sum of the 4 lanes (mono) or of the even and odd lanes (stereo).
+template<unsigned CHANNELS>
+static inline void storeSum(__m128 a, float* out)
+{
+	__m128 t = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	if constexpr (CHANNELS == 1) {
+		_mm_store_ss(out, _mm_add_ss(t, _mm_shuffle_ps(t, t, 1)));
+	} else {
+		_mm_store_ss(&out[0], t);
+		_mm_store_ss(&out[1], _mm_shuffle_ps(t, t, 0x55));
+	}
+}
+#endif
+
+// out = sum(buf[i] * (row[i] + frac * row[len + i])), summed per channel
+template<unsigned CHANNELS>
+static inline void calcRowOutput(const float* __restrict buf, const float* __restrict row,
+                              unsigned len, float frac, float* __restrict out)
+{
+	assert((len % ROW_GRANULARITY) == 0);
+	assert((uintptr_t(row) % BANK_ALIGNMENT) == 0);
+#if defined(__AVX__) && defined(__FMA__)
+	__m256 c = _mm256_setzero_ps();
+	__m256 d = _mm256_setzero_ps();
+	for (unsigned i = 0; i < len; i += 8) {
+		__m256 b = _mm256_loadu_ps(buf + i);
+		c = _mm256_fmadd_ps(b, _mm256_load_ps(row + i), c);
+		d = _mm256_fmadd_ps(b, _mm256_load_ps(row + len + i), d);
+	}
+	__m256 a = _mm256_fmadd_ps(d, _mm256_set1_ps(frac), c);
+	storeSum<CHANNELS>(_mm_add_ps(_mm256_castps256_ps128(a),
+	                              _mm256_extractf128_ps(a, 1)), out);
+#elif defined(__SSE2__)
+	__m128 c0 = _mm_setzero_ps();
+	__m128 c1 = _mm_setzero_ps();
+	__m128 d0 = _mm_setzero_ps();
+	__m128 d1 = _mm_setzero_ps();
+	for (unsigned i = 0; i < len; i += 8) {
+		__m128 b0 = _mm_loadu_ps(buf + i + 0);
+		__m128 b1 = _mm_loadu_ps(buf + i + 4);
+		c0 = _mm_add_ps(c0, _mm_mul_ps(b0, _mm_load_ps(row + i + 0)));
+		c1 = _mm_add_ps(c1, _mm_mul_ps(b1, _mm_load_ps(row + i + 4)));
+		d0 = _mm_add_ps(d0, _mm_mul_ps(b0, _mm_load_ps(row + len + i + 0)));
+		d1 = _mm_add_ps(d1, _mm_mul_ps(b1, _mm_load_ps(row + len + i + 4)));
+	}
+	__m128 c = _mm_add_ps(c0, c1);
+	__m128 d = _mm_add_ps(d0, d1);
+	storeSum<CHANNELS>(_mm_add_ps(c, _mm_mul_ps(d, _mm_set1_ps(frac))), out);
+#else
+	// c++ version, both mono and stereo
+	float c[CHANNELS] = {};
+	float d[CHANNELS] = {};
+	for (unsigned i = 0; i < len; i += CHANNELS) {
+		for (auto ch : xrange(CHANNELS)) {
+			c[ch] += buf[i + ch] * row[i + ch];
+			d[ch] += buf[i + ch] * row[len + i + ch];
+		}
+	}
+	for (auto ch : xrange(CHANNELS)) {
+		out[ch] = c[ch] + frac * d[ch];
+	}
+#endif
+}
+
+template<unsigned CHANNELS>
+PolyphaseFilter<CHANNELS>::PolyphaseFilter(double ratio_)
+	: ratio(ratio_)
+	, halfLen(getHalfLen(ratio))
+{
+	bank = PolyphaseBanks<CHANNELS>::instance().getBank(ratio, filterLen);
+}
+
+template<unsigned CHANNELS>
+PolyphaseFilter<CHANNELS>::~PolyphaseFilter()
+{
+	PolyphaseBanks<CHANNELS>::instance().releaseBank(ratio);
+}
+
+template<unsigned CHANNELS>
+void PolyphaseFilter<CHANNELS>::calcOutput(
+	const float* buf, double frac, float* out) const
+{
+	assert((0.0 <= frac) && (frac < 1.0));
+	double phase = frac * PHASES;
+	auto p = unsigned(phase);
+	assert(p < PHASES);
+	unsigned len = filterLen * CHANNELS;
+	calcRowOutput<CHANNELS>(buf, &bank[p * 2 * len], len, float(phase - p), out);
+}
+
+
+template<unsigned CHANNELS>
+ResamplePoly<CHANNELS>::ResamplePoly(
+		ResampledSoundDevice& input_, const DynamicClock& hostClock_)
+	: ResampleAlgo(input_)
+	, hostClock(hostClock_)
+	, ratio(hostClock.getPeriod().toDouble() / getEmuClock().getPeriod().toDouble())
+	, filter(ratio)
+{
+	// fill buffer with 'enough' zero's
+	unsigned extra = int(filter.getLength() + 1 + ratio + 1);
+	bufStart = 0;
+	bufEnd   = extra;
+	nonzeroSamples = 0;
+	unsigned initialSize = 4000; // buffer grows dynamically if this is too small
+	buffer.resize((initialSize + extra) * CHANNELS); // zero-initialized
+}
+
+template<unsigned CHANNELS>
+ResamplePoly<CHANNELS>::~ResamplePoly() = default;
+
+template<unsigned CHANNELS>
+void ResamplePoly<CHANNELS>::prepareData(unsigned emuNum)
+{
+	// Still enough free space at end of buffer?
+	unsigned free = unsigned(buffer.size() / CHANNELS) - bufEnd;
+	if (free < emuNum) {
+		// No, then move everything to the start
+		// (data needs to be in a contiguous memory block)
+		unsigned available = bufEnd - bufStart;
+		memmove(&buffer[0], &buffer[bufStart * CHANNELS],
+			available * CHANNELS * sizeof(float));
+		bufStart = 0;
+		bufEnd = available;
+
+		free = unsigned(buffer.size() / CHANNELS) - bufEnd;
+		int missing = emuNum - free;
+		if (unlikely(missing > 0)) {
+			// Still not enough room: grow the buffer.
+			buffer.resize(buffer.size() + missing * CHANNELS);
+		}
+	}
+	VLA_SSE_ALIGNED(float, tmpBuf, emuNum * CHANNELS + 3);
+	if (input.generateInput(tmpBuf, emuNum)) {
+		memcpy(&buffer[bufEnd * CHANNELS], tmpBuf,
+		       emuNum * CHANNELS * sizeof(float));
+		bufEnd += emuNum;
+		nonzeroSamples = bufEnd - bufStart;
+	} else {
+		memset(&buffer[bufEnd * CHANNELS], 0,
+		       emuNum * CHANNELS * sizeof(float));
+		bufEnd += emuNum;
+	}
+
+	assert(bufStart <= bufEnd);
+	assert(bufEnd <= (buffer.size() / CHANNELS));
+}
+
+template<unsigned CHANNELS>
+bool ResamplePoly<CHANNELS>::generateOutputImpl(
+	float* __restrict dataOut, unsigned hostNum, EmuTime::param time)
+{
+	auto& emuClk = getEmuClock();
+	unsigned emuNum = emuClk.getTicksTill(time);
+	if (emuNum > 0) {
+		prepareData(emuNum);
+	}
+
+	bool notMuted = nonzeroSamples > 0;
+	if (notMuted) {
+		// main processing loop, all output samples in one go
+		EmuTime host1 = hostClock.getFastAdd(1);
+		assert(host1 > emuClk.getTime());
+		double pos = emuClk.getTicksTillDouble(host1);
+		assert(pos <= (ratio + 2));
+		const float* buf = &buffer[bufStart * CHANNELS];
+		for (auto i : xrange(hostNum)) {
+			auto n = unsigned(pos);
+			assert((bufStart + n + filter.getLength()) <= bufEnd);
+			filter.calcOutput(&buf[n * CHANNELS], pos - n, &dataOut[i * CHANNELS]);
+			pos += ratio;
+		}
+	}
+	emuClk += emuNum;
+	bufStart += emuNum;
+	nonzeroSamples = std::max<int>(0, nonzeroSamples - emuNum);
+
+	assert(bufStart <= bufEnd);
+	unsigned available = bufEnd - bufStart;
+	unsigned extra = int(filter.getLength() + 1 + ratio + 1);
+	assert(available == extra); (void)available; (void)extra;
+
+	return notMuted;
+}
+
+// Force template instantiation.
+template class PolyphaseFilter<1>;
+template class PolyphaseFilter<2>;
+template class ResamplePoly<1>;
+template class ResamplePoly<2>;
+
+} // namespace openmsx
@@ -0,0 +1,87 @@
+#ifndef RESAMPLEPOLY_HH
+#define RESAMPLEPOLY_HH
+
+#include "ResampleAlgo.hh"
+#include <vector>
+
+namespace openmsx {
+
+class DynamicClock;
+class ResampledSoundDevice;
+
+/** The polyphase filter bank for one resample ratio. Banks are shared
+  * between all instances with the same ratio (and number of channels).
+  * This class doesn't need a sound device, so it can also be used
+  * standalone (e.g. in unit tests).
+  */
+template<unsigned CHANNELS>
+class PolyphaseFilter
+{
+public:
+	/** @param ratio Input sample rate divided by output sample rate. */
+	explicit PolyphaseFilter(double ratio);
+	~PolyphaseFilter();
+	PolyphaseFilter(const PolyphaseFilter&) = delete;
+	PolyphaseFilter& operator=(const PolyphaseFilter&) = delete;
+
+	/** The number of input samples that are needed for one output
+	  * sample. */
+	[[nodiscard]] unsigned getLength() const { return filterLen; }
+
+	/** The output for input position 'x' is centered around input sample
+	  * 'x + getDelay()' (only past input samples are available). */
+	[[nodiscard]] unsigned getDelay() const { return halfLen - 1; }
+
+	/** Calculate one output sample.
+	  * @param buf getLength() input samples (interleaved when stereo).
+	  * @param frac Position in between buf[0] and buf[1], in range [0, 1).
+	  * @param out CHANNELS output values.
+	  */
+	void calcOutput(const float* buf, double frac, float* out) const;
+
+private:
+	const double ratio;
+	const float* bank;
+	unsigned filterLen; // in input samples, per row
+	unsigned halfLen;
+};
+
+/** Resampler based on a polyphase filter bank.
+  *
+  * Uses the same low-pass filter as ResampleHQ, but it's evaluated
+  * differently: the filter is precomputed for a (small) number of phases
+  * (fractional input positions) and the coefficients for positions in
+  * between are linearly interpolated. Each row in the bank is stored in
+  * the order it's needed (no folding) and already expanded for stereo, so
+  * that producing one output sample is a single straight dot product.
+  * That inner loop uses FMA instructions when available (AVX+FMA builds),
+  * otherwise SSE2 or plain C++.
+  */
+template<unsigned CHANNELS>
+class ResamplePoly final : public ResampleAlgo
+{
+public:
+	ResamplePoly(ResampledSoundDevice& input, const DynamicClock& hostClock);
+	~ResamplePoly() override;
+	ResamplePoly(const ResamplePoly&) = delete;
+	ResamplePoly& operator=(const ResamplePoly&) = delete;
+
+	bool generateOutputImpl(float* dataOut, unsigned num,
+	                        EmuTime::param time) override;
+
+private:
+	void prepareData(unsigned emuNum);
+
+private:
+	const DynamicClock& hostClock;
+	const double ratio;
+	const PolyphaseFilter<CHANNELS> filter;
+	unsigned bufStart;
+	unsigned bufEnd;
+	unsigned nonzeroSamples;
+	std::vector<float> buffer;
+};
+
+} // namespace openmsx
+
+#endif
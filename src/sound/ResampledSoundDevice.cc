@@ -3,6 +3,7 @@
 #include "ResampleHQ.hh"
 #include "ResampleLQ.hh"
 #include "ResampleBlip.hh"
+#include "ResamplePoly.hh"
 #include "MSXMotherBoard.hh"
 #include "Reactor.hh"
 #include "GlobalSettings.hh"
@@ -21,6 +22,7 @@ ResampledSoundDevice::ResampledSoundDevice(
 	              channels, inputSampleRate_, stereo_)
 	, resampleSetting(motherBoard.getReactor().getGlobalSettings().getResampleSetting())
 	, emuClock(EmuTime::zero())
+	, inputClock(EmuTime::zero())
 {
 	resampleSetting.attach(*this);
 }
@@ -44,7 +46,9 @@ bool ResampledSoundDevice::updateBuffer(unsigned length, float* buffer,
 
 bool ResampledSoundDevice::generateInput(float* buffer, unsigned num)
 {
-	return mixChannels(buffer, num);
+	bool result = mixChannels(buffer, num);
+	inputClock += num;
+	return result;
 }
 
 
@@ -62,6 +66,8 @@ void ResampledSoundDevice::createResampler()
 	EmuDuration inputPeriod(getEffectiveSpeed() / double(getInputRate()));
 	emuClock.reset(hostClock.getTime());
 	emuClock.setPeriod(inputPeriod);
+	inputClock.reset(hostClock.getTime());
+	inputClock.setPeriod(inputPeriod);
 
 	if (outputPeriod == inputPeriod) {
 		algo = std::make_unique<ResampleTrivial>(*this);
@@ -88,6 +94,13 @@ void ResampledSoundDevice::createResampler()
 				algo = std::make_unique<ResampleBlip<2>>(*this, hostClock);
 			}
 			break;
+		case RESAMPLE_POLY:
+			if (!isStereo()) {
+				algo = std::make_unique<ResamplePoly<1>>(*this, hostClock);
+			} else {
+				algo = std::make_unique<ResamplePoly<2>>(*this, hostClock);
+			}
+			break;
 		default:
 			UNREACHABLE;
 		}
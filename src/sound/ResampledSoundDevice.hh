@@ -16,7 +16,7 @@ template<typename T> class EnumSetting;
 class ResampledSoundDevice : public SoundDevice, protected Observer<Setting>
 {
 public:
-	enum ResampleType { RESAMPLE_HQ, RESAMPLE_LQ, RESAMPLE_BLIP };
+	enum ResampleType { RESAMPLE_HQ, RESAMPLE_LQ, RESAMPLE_BLIP, RESAMPLE_POLY };
 
 	/** Note: To enable various optimizations (like SSE), this method is
 	  * allowed to generate up to 3 extra sample.
@@ -26,6 +26,14 @@ public:
 
 	[[nodiscard]] DynamicClock& getEmuClock() { return emuClock; }
 
+	/** Time of the last sample that was generated by generateInput().
+	  * While generateChannels() is running, this is the time of the
+	  * sample right before the first sample in the current block. This is
+	  * usually the same as getEmuClock(), except for resamplers that
+	  * generate input ahead of time.
+	  */
+	[[nodiscard]] const DynamicClock& getInputClock() const { return inputClock; }
+
 protected:
 	ResampledSoundDevice(MSXMotherBoard& motherBoard, std::string_view name,
 	                     static_string_view description, unsigned channels,
@@ -47,6 +55,8 @@ private:
 	std::unique_ptr<ResampleAlgo> algo;
 	DynamicClock emuClock; // time of the last produced emu-sample,
 	                       //    ticks once per emu-sample
+	DynamicClock inputClock; // time of the last generated input sample,
+	                         //    ticks once per emu-sample
 };
 
 } // namespace openmsx
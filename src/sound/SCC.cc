@@ -106,6 +106,8 @@
 #include "serialize.hh"
 #include "unreachable.hh"
 #include "xrange.hh"
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 
 namespace openmsx {
@@ -359,10 +361,12 @@ void SCC::writeWave(unsigned channel, unsigned address, byte value)
 		unsigned p = address & 0x1F;
 		wave[channel][p] = value;
 		volAdjustedWave[channel][p] = adjust(value, volume[channel]);
+		cycleCache[channel].invalidate();
 		if ((currentChipMode != SCC_plusmode) && (channel == 3)) {
 			// copy waveform 4 -> waveform 5
 			wave[4][p] = wave[3][p];
 			volAdjustedWave[4][p] = adjust(value, volume[4]);
+			cycleCache[4].invalidate();
 		}
 	}
 }
@@ -396,6 +400,7 @@ void SCC::setFreqVol(unsigned address, byte value, EmuTime::param time)
 		}
 		// after a freq change, update the output
 		out[channel] = volAdjustedWave[channel][pos[channel]];
+		cycleCache[channel].invalidate();
 	} else if (address < 0x0F) {
 		// change volume
 		unsigned channel = address - 0x0A;
@@ -404,6 +409,7 @@ void SCC::setFreqVol(unsigned address, byte value, EmuTime::param time)
 			volAdjustedWave[channel][i] =
 				adjust(wave[channel][i], volume[channel]);
 		}
+		cycleCache[channel].invalidate();
 	} else {
 		// change enable-bits
 		ch_enable = value;
@@ -459,30 +465,94 @@ void SCC::setDeformRegHelper(byte value)
 	}
 }
 
+void SCCCycleCache::build(const float* wave, unsigned period2,
+                          unsigned count, unsigned pos, float out)
+{
+	// Precondition: incr is 32, count < period2 and out equals the
+	// current wave sample. Then after exactly 'period2' samples the
+	// counter has wrapped 32 times, so (count, pos, out) are back at
+	// their initial values and the output repeats.
+	unsigned count2 = count;
+	unsigned pos2 = pos;
+	auto out2 = out;
+	cycle.resize(period2);
+	for (auto& s : cycle) {
+		s = out2;
+		count2 += 32;
+		while (count2 >= period2) {
+			count2 -= period2;
+			pos2 = (pos2 + 1) % 32;
+			out2 = wave[pos2];
+		}
+	}
+	assert(count2 == count);
+	assert(pos2 == pos);
+	cyclePos = 0;
+}
+
+void SCCCycleCache::generate(float* buf, unsigned num, const float* wave,
+                             unsigned period2, unsigned incr,
+                             unsigned& count, unsigned& pos, float& out)
+{
+	if (dirty) {
+		// Something changed since the previous fragment, don't (yet)
+		// spend time on building a new cycle.
+		dirty = false;
+		cycle.clear();
+	} else if (cycle.empty() && (incr != 0) && (count < period2) &&
+	           (out == wave[pos])) {
+		build(wave, period2, count, pos, out);
+	}
+
+	if (incr == 0) {
+		// (very) small period, output doesn't change
+		SoundDevice::addFill(buf, out, num);
+	} else if (!cycle.empty()) {
+		// fast path: copy from the precomputed cycle
+		unsigned cp = cyclePos;
+		unsigned remaining = num;
+		while (remaining) {
+			unsigned len = std::min(remaining, period2 - cp);
+			SoundDevice::addSamples(buf, &cycle[cp], len);
+			remaining -= len;
+			cp += len;
+			if (cp == period2) cp = 0;
+		}
+		cyclePos = cp;
+		// same calculation as for a muted channel (see SCC)
+		unsigned newCount = count + num * 32;
+		count = newCount % period2;
+		pos = (pos + newCount / period2) % 32;
+		out = wave[pos];
+	} else {
+		auto out2 = out;
+		unsigned count2 = count;
+		unsigned pos2 = pos;
+		for (auto j : xrange(num)) {
+			buf[j] += out2;
+			count2 += incr;
+			// Note: only for very small periods
+			//       this will take more than 1 iteration
+			while (unlikely(count2 >= period2)) {
+				count2 -= period2;
+				pos2 = (pos2 + 1) % 32;
+				out2 = wave[pos2];
+			}
+		}
+		out = out2;
+		count = count2;
+		pos = pos2;
+	}
+}
+
 void SCC::generateChannels(float** bufs, unsigned num)
 {
 	unsigned enable = ch_enable;
 	for (unsigned i = 0; i < 5; ++i, enable >>= 1) {
 		if ((enable & 1) && (volume[i] || out[i])) {
-			auto out2 = out[i];
-			unsigned count2 = count[i];
-			unsigned pos2 = pos[i];
-			unsigned incr2 = incr[i];
-			unsigned period2 = period[i] + 1;
-			for (auto j : xrange(num)) {
-				bufs[i][j] += out2;
-				count2 += incr2;
-				// Note: only for very small periods
-				//       this will take more than 1 iteration
-				while (unlikely(count2 >= period2)) {
-					count2 -= period2;
-					pos2 = (pos2 + 1) % 32;
-					out2 = volAdjustedWave[i][pos2];
-				}
-			}
-			out[i] = out2;
-			count[i] = count2;
-			pos[i] = pos2;
+			cycleCache[i].generate(bufs[i], num, volAdjustedWave[i],
+			                       period[i] + 1, incr[i],
+			                       count[i], pos[i], out[i]);
 		} else {
 			bufs[i] = nullptr; // channel muted
 			// Update phase counter.
@@ -491,6 +561,7 @@ void SCC::generateChannels(float** bufs, unsigned num)
 			pos[i] = (pos[i] + newCount / (period[i] + 1)) % 32;
 			// Channel stays off until next waveform index.
 			out[i] = 0.0f;
+			cycleCache[i].invalidate();
 		}
 	}
 }
@@ -593,6 +664,9 @@ void SCC::serialize(Archive& ar, unsigned /*version*/)
 	ar.serialize("count", count,
 	             "pos",   pos,
 	             "out",   out); // note: changed int->float, but no need to bump serialize-version
+	if constexpr (Archive::IS_LOADER) {
+		for (auto& c : cycleCache) c.invalidate();
+	}
 }
 INSTANTIATE_SERIALIZE_METHODS(SCC);
 
@@ -5,9 +5,41 @@
 #include "SimpleDebuggable.hh"
 #include "Clock.hh"
 #include "openmsx.hh"
+#include <vector>
 
 namespace openmsx {
 
+/** Generates the output of one (enabled) SCC channel. While the waveform,
+  * volume and frequency of the channel don't change its output is periodic,
+  * then one full period is cached and replayed. This class doesn't need a
+  * sound device, so it can also be used standalone (e.g. in unit tests).
+  */
+class SCCCycleCache
+{
+public:
+	/** Must be called when the wave, volume or frequency of the channel
+	  * changed (or when the channel was muted). */
+	void invalidate() { dirty = true; }
+
+	/** Add 'num' samples of the channel output to 'buf' and advance the
+	  * channel state ('count', 'pos' and 'out') accordingly.
+	  * @param wave The (volume adjusted) waveform, 32 samples.
+	  * @param period2 The period register value plus one.
+	  * @param incr The phase counter increment, 0 or 32.
+	  */
+	void generate(float* buf, unsigned num, const float* wave,
+	              unsigned period2, unsigned incr,
+	              unsigned& count, unsigned& pos, float& out);
+
+private:
+	void build(const float* wave, unsigned period2,
+	           unsigned count, unsigned pos, float out);
+
+	std::vector<float> cycle; // one full period of the output
+	unsigned cyclePos = 0;
+	bool dirty = true;
+};
+
 class SCC final : public ResampledSoundDevice
 {
 public:
@@ -60,6 +92,7 @@ private:
 	unsigned period[5];
 	unsigned orgPeriod[5];
 	float out[5]; // ints stored as floats
+	SCCCycleCache cycleCache[5];
 	byte volume[5];
 	byte ch_enable;
 
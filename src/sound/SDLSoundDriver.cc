@@ -14,9 +14,18 @@
 
 namespace openmsx {
 
+// Adaptive latency: when there were no underruns for a while, the amount of
+// buffered audio is reduced in steps of a quarter fragment. An underrun
+// immediately increases it again by a full fragment, and also doubles the
+// time before the next reduction is attempted. So when the host can't keep up
+// with a lower latency, the (audible) underruns become exponentially rarer.
+constexpr unsigned INITIAL_STABLE_SECONDS = 2;
+constexpr unsigned MAX_STABLE_SECONDS = 64;
+
 SDLSoundDriver::SDLSoundDriver(Reactor& reactor_,
                                unsigned wantedFreq, unsigned wantedSamples)
 	: reactor(reactor_)
+	, underruns(0)
 	, muted(true)
 {
 	SDL_AudioSpec desired;
@@ -36,9 +45,13 @@ SDLSoundDriver::SDLSoundDriver(Reactor& reactor_,
 
 	frequency = obtained.freq;
 	fragmentSize = obtained.samples;
+	// sleep at most a quarter fragment while waiting for free space
+	sleepTime = std::min(5000u, unsigned(250000ull * fragmentSize / frequency));
 
-	mixBufferSize = 3 * (obtained.size / sizeof(float)) + 2;
-	mixBuffer.resize(mixBufferSize);
+	// Same maximum latency as before there was adaptive latency control.
+	maxTarget = 3 * fragmentSize;
+	minTarget = fragmentSize;
+	ringBuffer.resize(2 * maxTarget);
 	reInit();
 }
 
@@ -49,10 +62,19 @@ SDLSoundDriver::~SDLSoundDriver()
 
 void SDLSoundDriver::reInit()
 {
+	// The callback is not running (device is paused or the lock is taken),
+	// so it's safe to reset the ring buffer.
 	SDL_LockAudioDevice(deviceID);
-	readIdx  = 0;
-	writeIdx = 0;
+	ringBuffer.clear();
+	primed = false;
+	inUnderrun = false;
 	SDL_UnlockAudioDevice(deviceID);
+
+	target = maxTarget;
+	stableSamples = 0;
+	stableThreshold = INITIAL_STABLE_SECONDS * frequency;
+	seenUnderruns = underruns.load(std::memory_order_relaxed);
+	dropped = 0;
 }
 
 void SDLSoundDriver::mute()
@@ -82,6 +104,17 @@ unsigned SDLSoundDriver::getSamples() const
 	return fragmentSize;
 }
 
+SoundDriver::BufferStats SDLSoundDriver::getBufferStats() const
+{
+	BufferStats result;
+	result.capacity = unsigned(ringBuffer.capacity() / 2);
+	result.target = target;
+	result.filled = unsigned(ringBuffer.size() / 2);
+	result.underruns = underruns.load(std::memory_order_relaxed);
+	result.dropped = dropped;
+	return result;
+}
+
 void SDLSoundDriver::audioCallbackHelper(void* userdata, uint8_t* strm, int len)
 {
 	assert((len & 7) == 0); // stereo, 32 bit float
@@ -89,81 +122,67 @@ void SDLSoundDriver::audioCallbackHelper(void* userdata, uint8_t* strm, int len)
 		audioCallback(reinterpret_cast<float*>(strm), len / sizeof(float));
 }
 
-unsigned SDLSoundDriver::getBufferFilled() const
-{
-	int result = writeIdx - readIdx;
-	if (result < 0) result += mixBufferSize;
-	assert((0 <= result) && (unsigned(result) < mixBufferSize));
-	return result;
-}
-
-unsigned SDLSoundDriver::getBufferFree() const
+void SDLSoundDriver::audioCallback(float* stream, unsigned len)
 {
-	// we can't distinguish completely filled from completely empty
-	// (in both cases readIx would be equal to writeIdx), so instead
-	// we define full as '(writeIdx + 2) == readIdx' (note that index
-	// increases in steps of 2 (stereo)).
-	int result = mixBufferSize - 2 - getBufferFilled();
-	assert((0 <= result) && (unsigned(result) < mixBufferSize));
-	return result;
+	// Runs on the SDL audio thread. Doesn't take any locks, only reads
+	// from the ring buffer.
+	assert((len & 1) == 0); // stereo
+	auto num = unsigned(ringBuffer.read(stream, len));
+	if (num) primed = true;
+	bool underrun = num < len;
+	if (underrun) {
+		memset(&stream[num], 0, (len - num) * sizeof(float));
+		// Only count the start of an underrun, and not before the
+		// emulation started producing samples.
+		if (primed && !inUnderrun) {
+			underruns.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	inUnderrun = underrun;
 }
 
-void SDLSoundDriver::audioCallback(float* stream, unsigned len)
+void SDLSoundDriver::adjustTarget(unsigned len)
 {
-	assert((len & 1) == 0); // stereo
-	unsigned available = getBufferFilled();
-	unsigned num = std::min(len, available);
-	if ((readIdx + num) < mixBufferSize) {
-		memcpy(stream, &mixBuffer[readIdx], num * sizeof(float));
-		readIdx += num;
+	uint64_t u = underruns.load(std::memory_order_relaxed);
+	if (u != seenUnderruns) {
+		seenUnderruns = u;
+		target = std::min(maxTarget, target + fragmentSize);
+		stableThreshold = std::min(2 * stableThreshold,
+		                           MAX_STABLE_SECONDS * frequency);
+		stableSamples = 0;
 	} else {
-		unsigned len1 = mixBufferSize - readIdx;
-		memcpy(stream, &mixBuffer[readIdx], len1 * sizeof(float));
-		unsigned len2 = num - len1;
-		memcpy(&stream[len1], &mixBuffer[0], len2 * sizeof(float));
-		readIdx = len2;
-	}
-	int missing = len - available;
-	if (missing > 0) {
-		// buffer underrun
-		memset(&stream[available], 0, missing * sizeof(float));
+		stableSamples += len;
+		if (stableSamples >= stableThreshold) {
+			stableSamples = 0;
+			target = std::max(minTarget, target - fragmentSize / 4);
+		}
 	}
 }
 
 void SDLSoundDriver::uploadBuffer(float* buffer, unsigned len)
 {
-	SDL_LockAudioDevice(deviceID);
-	len *= 2; // stereo
-	unsigned free = getBufferFree();
-	if (len > free) {
-		auto* board = reactor.getMotherBoard();
-		if (board && !board->getMSXMixer().isSynchronousMode() && // when not recording
-		    reactor.getGlobalSettings().getThrottleManager().isThrottled()) {
-			do {
-				SDL_UnlockAudioDevice(deviceID);
-				Timer::sleep(5000); // 5ms
-				SDL_LockAudioDevice(deviceID);
-				board->getRealTime().resync();
-				free = getBufferFree();
-			} while (len > free);
-		} else {
-			// drop excess samples
-			len = free;
+	adjustTarget(len);
+
+	// Wait while the buffer is filled above the target level (but never
+	// wait for an empty buffer). This is also how the emulation speed is
+	// synchronized to the audio output.
+	auto mustWait = [&] {
+		auto filled = unsigned(ringBuffer.size() / 2);
+		return (filled > 0) && ((filled + len) > target);
+	};
+	auto* board = reactor.getMotherBoard();
+	if (board && !board->getMSXMixer().isSynchronousMode() && // when not recording
+	    reactor.getGlobalSettings().getThrottleManager().isThrottled()) {
+		while (mustWait()) {
+			Timer::sleep(sleepTime);
+			board->getRealTime().resync();
 		}
 	}
-	assert(len <= free);
-	if ((writeIdx + len) < mixBufferSize) {
-		memcpy(&mixBuffer[writeIdx], buffer, len * sizeof(float));
-		writeIdx += len;
-	} else {
-		unsigned len1 = mixBufferSize - writeIdx;
-		memcpy(&mixBuffer[writeIdx], buffer, len1 * sizeof(float));
-		unsigned len2 = len - len1;
-		memcpy(&mixBuffer[0], &buffer[len1], len2 * sizeof(float));
-		writeIdx = len2;
-	}
 
-	SDL_UnlockAudioDevice(deviceID);
+	// drop excess samples (e.g. when not throttled)
+	len *= 2; // stereo
+	auto written = unsigned(ringBuffer.write(buffer, len));
+	dropped += (len - written) / 2;
 }
 
 } // namespace openmsx
@@ -3,8 +3,10 @@
 
 #include "SoundDriver.hh"
 #include "SDLSurfacePtr.hh"
-#include "MemBuffer.hh"
+#include "SPSCRingBuffer.hh"
 #include <SDL.h>
+#include <atomic>
+#include <cstdint>
 
 namespace openmsx {
 
@@ -27,21 +29,39 @@ public:
 
 	void uploadBuffer(float* buffer, unsigned len) override;
 
+	[[nodiscard]] BufferStats getBufferStats() const override;
+
 private:
 	void reInit();
-	[[nodiscard]] unsigned getBufferFilled() const;
-	[[nodiscard]] unsigned getBufferFree() const;
+	void adjustTarget(unsigned len);
 	static void audioCallbackHelper(void* userdata, uint8_t* strm, int len);
 	void audioCallback(float* stream, unsigned len);
 
 private:
 	Reactor& reactor;
 	SDL_AudioDeviceID deviceID;
-	MemBuffer<float> mixBuffer;
-	unsigned mixBufferSize;
+	// Filled by the emulation thread (uploadBuffer()), drained by the SDL
+	// audio thread (audioCallback()). Contains interleaved stereo samples.
+	SPSCRingBuffer<float> ringBuffer;
 	unsigned frequency;
 	unsigned fragmentSize;
-	unsigned readIdx, writeIdx;
+	unsigned sleepTime; // in us
+
+	// Adaptive latency control, only accessed by the emulation thread.
+	// All sizes in stereo samples.
+	unsigned maxTarget;
+	unsigned minTarget;
+	unsigned target;
+	unsigned stableSamples;   // samples uploaded since last adjustment
+	unsigned stableThreshold; // decrease target after this many samples
+	uint64_t seenUnderruns;
+	uint64_t dropped;
+
+	// Written by the audio thread.
+	std::atomic<uint64_t> underruns;
+	bool primed;        // received any samples since reInit()
+	bool inUnderrun;    // previous callback was an underrun
+
 	bool muted;
 	SDLSubSystemInitializer<SDL_INIT_AUDIO> audioInitializer;
 };
@@ -4,6 +4,7 @@
 #include "XMLElement.hh"
 #include "Filename.hh"
 #include "StringOp.hh"
+#include "Timer.hh"
 #include "MemoryOps.hh"
 #include "MemBuffer.hh"
 #include "MSXException.hh"
@@ -16,10 +17,16 @@
 #include <cassert>
 #include <memory>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace openmsx {
 
-static MemBuffer<float, SSE_ALIGNMENT> mixBuffer;
-static unsigned mixBufferSize = 0;
+// thread_local because sound devices can be rendered in parallel (see
+// MSXMixer::generate())
+static thread_local MemBuffer<float, SSE_ALIGNMENT> mixBuffer;
+static thread_local unsigned mixBufferSize = 0;
 
 static void allocateMixBuffer(unsigned size)
 {
@@ -49,9 +56,33 @@ void SoundDevice::addFill(float*& buf, float val, unsigned num)
 	// method can also be called in the middle of a buffer (so multiple
 	// times per buffer), in such case it does go wrong.
 	assert(num > 0);
+#ifdef __SSE2__
+	// (unaligned) groups of 4 samples, the remainder is done below
+	__m128 v = _mm_set1_ps(val);
+	for (/**/; num >= 4; num -= 4, buf += 4) {
+		_mm_storeu_ps(buf, _mm_add_ps(_mm_loadu_ps(buf), v));
+	}
+	for (/**/; num; --num) {
+		*buf++ += val;
+	}
+#else
 	do {
 		*buf++ += val;
 	} while (--num);
+#endif
+}
+
+void SoundDevice::addSamples(float*& buf, const float* samples, unsigned num)
+{
+	// same remark as in addFill(): don't write beyond 'num'
+#ifdef __SSE2__
+	for (/**/; num >= 4; num -= 4, buf += 4, samples += 4) {
+		_mm_storeu_ps(buf, _mm_add_ps(_mm_loadu_ps(buf), _mm_loadu_ps(samples)));
+	}
+#endif
+	for (/**/; num; --num) {
+		*buf++ += *samples++;
+	}
 }
 
 SoundDevice::SoundDevice(MSXMixer& mixer_, std::string_view name_, static_string_view description_,
@@ -188,12 +219,26 @@ void SoundDevice::muteChannel(unsigned channel, bool muted)
 	channelMuted[channel] = muted;
 }
 
+bool SoundDevice::isChannelIdle(unsigned /*channel*/) const
+{
+	return false;
+}
+
 bool SoundDevice::mixChannels(float* dataOut, unsigned samples)
 {
 #ifdef __SSE2__
 	assert((uintptr_t(dataOut) & 15) == 0); // must be 16-byte aligned
 #endif
 	if (samples == 0) return true;
+
+	if (ranges::all_of(xrange(numChannels),
+	                   [&](auto i) { return isChannelIdle(i); })) {
+		// nothing to generate, only record the silence
+		for (auto i : xrange(numChannels)) {
+			if (writer[i]) writer[i]->writeSilence(stereo, samples);
+		}
+		return false;
+	}
 	unsigned outputStereo = isStereo() ? 2 : 1;
 
 	float* bufs[MAX_CHANNELS];
@@ -238,7 +283,13 @@ bool SoundDevice::mixChannels(float* dataOut, unsigned samples)
 		assert(count == separateChannels);
 	}
 
-	generateChannels(bufs, samples);
+	if constexpr (PROFILE_SOUND) {
+		auto t0 = Timer::getTimeNs();
+		generateChannels(bufs, samples);
+		generateTime += Timer::getTimeNs() - t0;
+	} else {
+		generateChannels(bufs, samples);
+	}
 
 	if (separateChannels == 0) {
 		return ranges::any_of(xrange(numChannels),
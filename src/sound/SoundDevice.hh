@@ -4,9 +4,11 @@
 #include "EmuTime.hh"
 #include "WavWriter.hh"
 #include "static_string_view.hh"
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 
 namespace openmsx {
 
@@ -15,6 +17,11 @@ class DynamicClock;
 class Filename;
 class MSXMixer;
 
+// Set to true to measure the host time spent on each sound device, see the
+// 'machine_info sound_profile' command. When false, all profiling code is
+// optimized away.
+constexpr bool PROFILE_SOUND = false;
+
 class SoundDevice
 {
 public:
@@ -75,6 +82,14 @@ public:
 	void recordChannel(unsigned channel, const Filename& filename);
 	void muteChannel  (unsigned channel, bool muted);
 
+	/** Returns the host time (in ns) spent in generateChannels() since
+	  * the previous call to this method. Used by MSXMixer for profiling,
+	  * always zero when PROFILE_SOUND is false.
+	  */
+	[[nodiscard]] uint64_t takeGenerateTime() {
+		return std::exchange(generateTime, 0);
+	}
+
 protected:
 	/** Constructor.
 	  * @param mixer The Mixer object
@@ -147,7 +162,9 @@ public: // Will be called by Mixer:
 	[[nodiscard]] virtual bool updateBuffer(unsigned length, float* buffer,
 	                                        EmuTime::param time) = 0;
 
-protected:
+	// The following two are public so that sound generation code outside
+	// of a SoundDevice subclass (e.g. AY8910Core) can use them.
+
 	/** Adds a number of samples that all have the same value.
 	  * Can be used to synthesize segments of a square wave.
 	  * @param buffer Pointer to the position in a sample buffer where the
@@ -158,6 +175,16 @@ protected:
 	  */
 	static void addFill(float*& buffer, float value, unsigned num);
 
+	/** Adds a block of precomputed samples.
+	  * @param buffer Pointer to the position in a sample buffer where the
+	  *               samples should be added. This pointer is updated to
+	  *               the position right after the written samples.
+	  * @param samples The samples to add.
+	  * @param num The number of samples.
+	  */
+	static void addSamples(float*& buffer, const float* samples, unsigned num);
+
+protected:
 	/** Abstract method to generate the actual sound data.
 	  * @param buffers An array of pointer to buffers. Each buffer must
 	  *                be big enough to hold 'num' samples.
@@ -173,6 +200,22 @@ protected:
 	  */
 	virtual void generateChannels(float** buffers, unsigned num) = 0;
 
+	/** Is the given channel idle? An idle channel doesn't produce any
+	  * sound and it stays idle until the state of the device changes
+	  * (e.g. a register write, like a key-on). Typically these are the
+	  * channels for which the envelope generator is off.
+	  *
+	  * When all channels are idle, generateChannels() is not called at
+	  * all (so then that method can skip updating the internal state of
+	  * the device, like LFO or noise generators). Devices can also use
+	  * this in their generateChannels() method to skip the calculations
+	  * for individual idle channels (and set the buffer pointer for those
+	  * channels to nullptr).
+	  *
+	  * The default implementation returns false (never idle).
+	  */
+	[[nodiscard]] virtual bool isChannelIdle(unsigned channel) const;
+
 	/** Calls generateChannels() and combines the output to a single
 	  * channel.
 	  * @param dataOut Output buffer, must be big enough to hold
@@ -198,6 +241,7 @@ private:
 
 	std::optional<Wav16Writer> writer[MAX_CHANNELS];
 
+	uint64_t generateTime = 0;
 	float softwareVolumeLeft = 1.0f;
 	float softwareVolumeRight = 1.0f;
 	unsigned inputSampleRate;
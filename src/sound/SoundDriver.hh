@@ -1,6 +1,8 @@
 #ifndef SOUNDDRIVER_HH
 #define SOUNDDRIVER_HH
 
+#include <cstdint>
+
 namespace openmsx {
 
 class SoundDriver
@@ -28,6 +30,18 @@ public:
 
 	virtual void uploadBuffer(float* buffer, unsigned len) = 0;
 
+	/** Fill level statistics of the buffer between the emulation and the
+	  * audio output. All sizes are in (stereo) samples.
+	  */
+	struct BufferStats {
+		unsigned capacity = 0;  // maximum size of the buffer
+		unsigned target = 0;    // current maximum fill level (adaptive)
+		unsigned filled = 0;    // current fill level
+		uint64_t underruns = 0; // audio output ran out of samples
+		uint64_t dropped = 0;   // samples dropped because buffer was full
+	};
+	[[nodiscard]] virtual BufferStats getBufferStats() const = 0;
+
 protected:
 	SoundDriver() = default;
 };
@@ -0,0 +1,114 @@
+#ifndef SOUNDREGISTERLOG_HH
+#define SOUNDREGISTERLOG_HH
+
+#include "DynamicClock.hh"
+#include "EmuTime.hh"
+#include "openmsx.hh"
+#include "serialize_stl.hh"
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace openmsx {
+
+/** Log of timestamped register writes for a sound device.
+  *
+  * Traditionally a sound device first calls updateStream() on each register
+  * write, so that all sound up to that moment is rendered with the old
+  * register values. When software rapidly writes registers (e.g. sample
+  * playback via the PSG volume registers) this renders sound in many tiny
+  * fragments, and each of those fragments involves all sound devices, the
+  * mixer and the resamplers.
+  *
+  * Instead a device can append the write to this log. Later, when the device
+  * generates a block of samples, render() splits that block at the positions
+  * of the logged writes and applies each write right before the first sample
+  * that comes after the time of the write. That's the same sample position as
+  * with the updateStream() approach.
+  */
+class SoundRegisterLog
+{
+public:
+	struct Entry {
+		EmuTime time = EmuTime::zero();
+		unsigned reg;
+		byte value;
+
+		template<typename Archive>
+		void serialize(Archive& ar, unsigned /*version*/)
+		{
+			ar.serialize("time",  time,
+			             "reg",   reg,
+			             "value", value);
+		}
+	};
+
+	void push(EmuTime::param time, unsigned reg, byte value) {
+		assert(empty() || (entries.back().time <= time));
+		entries.push_back({time, reg, value});
+	}
+
+	void clear() {
+		entries.clear();
+		first = 0;
+	}
+
+	[[nodiscard]] bool empty() const { return first == entries.size(); }
+
+	/** Generate 'num' samples, while applying the logged writes at the
+	  * correct sample positions.
+	  * @param clock Time of the sample right before the first sample of
+	  *              this block, ticks once per sample.
+	  * @param num Number of samples to generate.
+	  * @param generate Called as 'generate(offset, length)' to generate
+	  *                 a fragment of the block. Not called for empty
+	  *                 fragments.
+	  * @param apply Called as 'apply(reg, value)' to apply a register
+	  *              write to the sound generation state.
+	  * Writes that belong to later samples remain in the log.
+	  */
+	template<typename Generate, typename Apply>
+	void render(const DynamicClock& clock, unsigned num,
+	            Generate generate, Apply apply)
+	{
+		unsigned pos = 0;
+		while (!empty()) {
+			const auto& e = entries[first];
+			// number of samples (of this block) before this write
+			unsigned idx = (e.time <= clock.getTime())
+			             ? 0
+			             : std::min(clock.getTicksTill(e.time), num);
+			if (idx == num) break;
+			if (idx > pos) {
+				generate(pos, idx - pos);
+				pos = idx;
+			}
+			apply(e.reg, e.value);
+			++first;
+		}
+		if (pos < num) generate(pos, num - pos);
+		// Drop the applied writes. Usually there are none or only a few
+		// writes left, so this is cheap. (Only clearing the log when it's
+		// completely empty isn't enough: with a continuous stream of
+		// writes there's always one pending, and the log would keep
+		// growing.)
+		entries.erase(entries.begin(), entries.begin() + first);
+		first = 0;
+	}
+
+	/** Stores the pending writes. */
+	template<typename Archive>
+	void serialize(Archive& ar, unsigned /*version*/)
+	{
+		assert(first == 0); // only non-zero during render()
+		ar.serialize("entries", entries);
+	}
+
+private:
+	std::vector<Entry> entries;
+	size_t first = 0; // entries before this index are already applied
+};
+
+} // namespace openmsx
+
+#endif
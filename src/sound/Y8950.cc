@@ -9,7 +9,9 @@
 #include "MSXAudio.hh"
 #include "DeviceConfig.hh"
 #include "MSXMotherBoard.hh"
+#include "FMOutput.hh"
 #include "Math.hh"
+#include "aligned.hh"
 #include "cstd.hh"
 #include "enumerate.hh"
 #include "outer.hh"
@@ -23,8 +25,8 @@
 
 namespace openmsx {
 
-constexpr unsigned EG_MUTE = 1 << Y8950::EG_BITS;
-constexpr Y8950::EnvPhaseIndex EG_DP_MAX = Y8950::EnvPhaseIndex(EG_MUTE);
+constexpr unsigned EG_MUTE = 1 << Y8950Core::EG_BITS;
+constexpr Y8950Core::EnvPhaseIndex EG_DP_MAX = Y8950Core::EnvPhaseIndex(EG_MUTE);
 
 constexpr unsigned MOD = 0;
 constexpr unsigned CAR = 1;
@@ -284,14 +286,14 @@ constexpr auto tllTable = [] {
 
 // Phase incr table for Attack.
 constexpr auto dPhaseArTable = [] {
-	std::array<std::array<Y8950::EnvPhaseIndex, 16>, 16> result = {};
+	std::array<std::array<Y8950Core::EnvPhaseIndex, 16>, 16> result = {};
 	for (auto Rks : xrange(16)) {
-		result[Rks][0] = Y8950::EnvPhaseIndex(0);
+		result[Rks][0] = Y8950Core::EnvPhaseIndex(0);
 		for (auto AR : xrange(1, 15)) {
 			unsigned RM = std::min(AR + (Rks >> 2), 15);
 			unsigned RL = Rks & 3;
 			result[Rks][AR] =
-				Y8950::EnvPhaseIndex(12 * (RL + 4)) >> (15 - RM);
+				Y8950Core::EnvPhaseIndex(12 * (RL + 4)) >> (15 - RM);
 		}
 		result[Rks][15] = EG_DP_MAX;
 	}
@@ -300,28 +302,28 @@ constexpr auto dPhaseArTable = [] {
 
 // Phase incr table for Decay and Release.
 constexpr auto dPhaseDrTable = [] {
-	std::array<std::array<Y8950::EnvPhaseIndex, 16>, 16> result = {};
+	std::array<std::array<Y8950Core::EnvPhaseIndex, 16>, 16> result = {};
 	for (auto Rks : xrange(16)) {
-		result[Rks][0] = Y8950::EnvPhaseIndex(0);
+		result[Rks][0] = Y8950Core::EnvPhaseIndex(0);
 		for (auto DR : xrange(1, 16)) {
 			unsigned RM = std::min(DR + (Rks >> 2), 15);
 			unsigned RL = Rks & 3;
 			result[Rks][DR] =
-				Y8950::EnvPhaseIndex(RL + 4) >> (15 - RM);
+				Y8950Core::EnvPhaseIndex(RL + 4) >> (15 - RM);
 		}
 	}
 	return result;
 }();
 
 
-// class Y8950::Patch
+// class Y8950Core::Patch
 
-Y8950::Patch::Patch()
+Y8950Core::Patch::Patch()
 {
 	reset();
 }
 
-void Y8950::Patch::reset()
+void Y8950Core::Patch::reset()
 {
 	AM = false;
 	PM = false;
@@ -338,9 +340,9 @@ void Y8950::Patch::reset()
 }
 
 
-// class Y8950::Slot
+// class Y8950Core::Slot
 
-void Y8950::Slot::reset()
+void Y8950Core::Slot::reset()
 {
 	phase = 0;
 	output = 0;
@@ -355,7 +357,7 @@ void Y8950::Slot::reset()
 	updateAll(0);
 }
 
-void Y8950::Slot::updatePG(unsigned freq)
+void Y8950Core::Slot::updatePG(unsigned freq)
 {
 	static constexpr int mlTable[16] = {
 		  1, 1*2,  2*2,  3*2,  4*2,  5*2,  6*2 , 7*2,
@@ -367,12 +369,12 @@ void Y8950::Slot::updatePG(unsigned freq)
 	dPhase = ((fnum * mlTable[patch.ML]) << block) >> (21 - DP_BITS);
 }
 
-void Y8950::Slot::updateTLL(unsigned freq)
+void Y8950Core::Slot::updateTLL(unsigned freq)
 {
 	tll = tllTable[freq >> 6][patch.KL] + patch.TL * TL_PER_EG;
 }
 
-void Y8950::Slot::updateRKS(unsigned freq)
+void Y8950Core::Slot::updateRKS(unsigned freq)
 {
 	unsigned rks = freq >> patch.KR;
 	assert(rks < 16);
@@ -380,7 +382,7 @@ void Y8950::Slot::updateRKS(unsigned freq)
 	dPhaseDRTableRks = dPhaseDrTable[rks].data();
 }
 
-void Y8950::Slot::updateEG()
+void Y8950Core::Slot::updateEG()
 {
 	switch (eg_mode) {
 	case ATTACK:
@@ -394,12 +396,12 @@ void Y8950::Slot::updateEG()
 		eg_dPhase = dPhaseDRTableRks[patch.RR];
 		break;
 	case FINISH:
-		eg_dPhase = Y8950::EnvPhaseIndex(0);
+		eg_dPhase = Y8950Core::EnvPhaseIndex(0);
 		break;
 	}
 }
 
-void Y8950::Slot::updateAll(unsigned freq)
+void Y8950Core::Slot::updateAll(unsigned freq)
 {
 	updatePG(freq);
 	updateTLL(freq);
@@ -407,30 +409,30 @@ void Y8950::Slot::updateAll(unsigned freq)
 	updateEG(); // EG should be last
 }
 
-bool Y8950::Slot::isActive() const
+bool Y8950Core::Slot::isActive() const
 {
 	return eg_mode != FINISH;
 }
 
 // Slot key on
-void Y8950::Slot::slotOn(KeyPart part)
+void Y8950Core::Slot::slotOn(KeyPart part)
 {
 	if (!key) {
 		eg_mode = ATTACK;
 		phase = 0;
-		eg_phase = Y8950::EnvPhaseIndex(adjustRA[eg_phase.toInt()]);
+		eg_phase = Y8950Core::EnvPhaseIndex(adjustRA[eg_phase.toInt()]);
 	}
 	key |= part;
 }
 
 // Slot key off
-void Y8950::Slot::slotOff(KeyPart part)
+void Y8950Core::Slot::slotOff(KeyPart part)
 {
 	if (key) {
 		key &= ~part;
 		if (!key) {
 			if (eg_mode == ATTACK) {
-				eg_phase = Y8950::EnvPhaseIndex(adjustAR[eg_phase.toInt()]);
+				eg_phase = Y8950Core::EnvPhaseIndex(adjustAR[eg_phase.toInt()]);
 			}
 			eg_mode = RELEASE;
 		}
@@ -438,14 +440,14 @@ void Y8950::Slot::slotOff(KeyPart part)
 }
 
 
-// class Y8950::Channel
+// class Y8950Core::Channel
 
-Y8950::Channel::Channel()
+Y8950Core::Channel::Channel()
 {
 	reset();
 }
 
-void Y8950::Channel::reset()
+void Y8950Core::Channel::reset()
 {
 	setFreq(0);
 	slot[MOD].reset();
@@ -454,18 +456,18 @@ void Y8950::Channel::reset()
 }
 
 // Set frequency (combined F-Number (10bit) and Block (3bit))
-void Y8950::Channel::setFreq(unsigned freq_)
+void Y8950Core::Channel::setFreq(unsigned freq_)
 {
 	freq = freq_;
 }
 
-void Y8950::Channel::keyOn(KeyPart part)
+void Y8950Core::Channel::keyOn(KeyPart part)
 {
 	slot[MOD].slotOn(part);
 	slot[CAR].slotOn(part);
 }
 
-void Y8950::Channel::keyOff(KeyPart part)
+void Y8950Core::Channel::keyOff(KeyPart part)
 {
 	slot[MOD].slotOff(part);
 	slot[CAR].slotOff(part);
@@ -473,19 +475,7 @@ void Y8950::Channel::keyOff(KeyPart part)
 
 constexpr auto INPUT_RATE = unsigned(cstd::round(Y8950::CLOCK_FREQ / double(Y8950::CLOCK_FREQ_DIV)));
 
-Y8950::Y8950(const std::string& name_, const DeviceConfig& config,
-             unsigned sampleRam, EmuTime::param time, MSXAudio& audio)
-	: ResampledSoundDevice(config.getMotherBoard(), name_, "MSX-AUDIO", 9 + 5 + 1, INPUT_RATE, false)
-	, motherBoard(config.getMotherBoard())
-	, periphery(audio.createPeriphery(getName()))
-	, adpcm(*this, config, name_, sampleRam)
-	, connector(motherBoard.getPluggingController())
-	, dac13(name_ + " DAC", "MSX-AUDIO 13-bit DAC", config)
-	, debuggable(motherBoard, getName())
-	, timer1(EmuTimer::createOPL3_1(motherBoard.getScheduler(), *this))
-	, timer2(EmuTimer::createOPL3_2(motherBoard.getScheduler(), *this))
-	, irq(motherBoard, getName() + ".IRQ")
-	, enabled(true)
+Y8950Core::Y8950Core()
 {
 	// For debugging: print out tables to be able to compare before/after
 	// when the calculation changes.
@@ -533,6 +523,23 @@ Y8950::Y8950(const std::string& name_, const DeviceConfig& config,
 		std::cout << '\n';
 	}
 
+	reset();
+}
+
+Y8950::Y8950(const std::string& name_, const DeviceConfig& config,
+             unsigned sampleRam, EmuTime::param time, MSXAudio& audio)
+	: ResampledSoundDevice(config.getMotherBoard(), name_, "MSX-AUDIO", 9 + 5 + 1, INPUT_RATE, false)
+	, motherBoard(config.getMotherBoard())
+	, periphery(audio.createPeriphery(getName()))
+	, adpcm(*this, config, name_, sampleRam)
+	, connector(motherBoard.getPluggingController())
+	, dac13(name_ + " DAC", "MSX-AUDIO 13-bit DAC", config)
+	, debuggable(motherBoard, getName())
+	, timer1(EmuTimer::createOPL3_1(motherBoard.getScheduler(), *this))
+	, timer2(EmuTimer::createOPL3_2(motherBoard.getScheduler(), *this))
+	, irq(motherBoard, getName() + ".IRQ")
+	, enabled(true)
+{
 	reset(time);
 	registerSound(config);
 }
@@ -548,7 +555,7 @@ void Y8950::clearRam()
 }
 
 // Reset whole of opl except patch data.
-void Y8950::reset(EmuTime::param time)
+void Y8950Core::reset()
 {
 	for (auto& c : ch) c.reset();
 
@@ -563,12 +570,19 @@ void Y8950::reset(EmuTime::param time)
 	noiseA_dPhase = 0;
 	noiseB_dPhase = 0;
 
+	ranges::fill(reg, 0x00);
+}
+
+void Y8950::reset(EmuTime::param time)
+{
+	// TODO the output buffer should be updated before the channels are reset
+	core.reset();
+
 	// update the output buffer before changing the register
 	updateStream(time);
-	ranges::fill(reg, 0x00);
 
-	reg[0x04] = 0x18;
-	reg[0x19] = 0x0F; // fixes 'Thunderbirds are Go'
+	core.writeReg(0x04, 0x18);
+	core.writeReg(0x19, 0x0F); // fixes 'Thunderbirds are Go'
 	status = 0x00;
 	statusMask = 0;
 	irq.reset();
@@ -578,21 +592,21 @@ void Y8950::reset(EmuTime::param time)
 
 
 // Drum key on
-void Y8950::keyOn_BD()  { ch[6].keyOn(KEY_RHYTHM); }
-void Y8950::keyOn_HH()  { ch[7].slot[MOD].slotOn(KEY_RHYTHM); }
-void Y8950::keyOn_SD()  { ch[7].slot[CAR].slotOn(KEY_RHYTHM); }
-void Y8950::keyOn_TOM() { ch[8].slot[MOD].slotOn(KEY_RHYTHM); }
-void Y8950::keyOn_CYM() { ch[8].slot[CAR].slotOn(KEY_RHYTHM); }
+void Y8950Core::keyOn_BD()  { ch[6].keyOn(KEY_RHYTHM); }
+void Y8950Core::keyOn_HH()  { ch[7].slot[MOD].slotOn(KEY_RHYTHM); }
+void Y8950Core::keyOn_SD()  { ch[7].slot[CAR].slotOn(KEY_RHYTHM); }
+void Y8950Core::keyOn_TOM() { ch[8].slot[MOD].slotOn(KEY_RHYTHM); }
+void Y8950Core::keyOn_CYM() { ch[8].slot[CAR].slotOn(KEY_RHYTHM); }
 
 // Drum key off
-void Y8950::keyOff_BD() { ch[6].keyOff(KEY_RHYTHM); }
-void Y8950::keyOff_HH() { ch[7].slot[MOD].slotOff(KEY_RHYTHM); }
-void Y8950::keyOff_SD() { ch[7].slot[CAR].slotOff(KEY_RHYTHM); }
-void Y8950::keyOff_TOM(){ ch[8].slot[MOD].slotOff(KEY_RHYTHM); }
-void Y8950::keyOff_CYM(){ ch[8].slot[CAR].slotOff(KEY_RHYTHM); }
+void Y8950Core::keyOff_BD() { ch[6].keyOff(KEY_RHYTHM); }
+void Y8950Core::keyOff_HH() { ch[7].slot[MOD].slotOff(KEY_RHYTHM); }
+void Y8950Core::keyOff_SD() { ch[7].slot[CAR].slotOff(KEY_RHYTHM); }
+void Y8950Core::keyOff_TOM(){ ch[8].slot[MOD].slotOff(KEY_RHYTHM); }
+void Y8950Core::keyOff_CYM(){ ch[8].slot[CAR].slotOff(KEY_RHYTHM); }
 
 // Change Rhythm Mode
-void Y8950::setRythmMode(int data)
+void Y8950Core::setRythmMode(int data)
 {
 	bool newMode = (data & 32) != 0;
 	if (rythm_mode != newMode) {
@@ -609,7 +623,7 @@ void Y8950::setRythmMode(int data)
 }
 
 // recalculate 'key' from register settings
-void Y8950::update_key_status()
+void Y8950Core::update_key_status()
 {
 	for (auto [i, c] : enumerate(ch)) {
 		int main = (reg[0xb0 + i] & 0x20) ? KEY_MAIN : 0;
@@ -638,7 +652,7 @@ static constexpr int wave2_8pi(int e)
 	return (shift > 0) ? (e >> shift) : (e << -shift);
 }
 
-unsigned Y8950::Slot::calc_phase(int lfo_pm)
+unsigned Y8950Core::Slot::calc_phase(int lfo_pm)
 {
 	if (patch.PM) {
 		phase += (dPhase * lfo_pm) >> PM_AMP_BITS;
@@ -649,13 +663,13 @@ unsigned Y8950::Slot::calc_phase(int lfo_pm)
 }
 
 static constexpr auto S2E(int x) {
-	return Y8950::EnvPhaseIndex(int(x / EG_STEP));
+	return Y8950Core::EnvPhaseIndex(int(x / EG_STEP));
 }
-constexpr Y8950::EnvPhaseIndex SL[16] = {
+constexpr Y8950Core::EnvPhaseIndex SL[16] = {
 	S2E( 0), S2E( 3), S2E( 6), S2E( 9), S2E(12), S2E(15), S2E(18), S2E(21),
 	S2E(24), S2E(27), S2E(30), S2E(33), S2E(36), S2E(39), S2E(42), S2E(93)
 };
-unsigned Y8950::Slot::calc_envelope(int lfo_am)
+unsigned Y8950Core::Slot::calc_envelope(int lfo_am)
 {
 	unsigned egOut = 0;
 	switch (eg_mode) {
@@ -663,7 +677,7 @@ unsigned Y8950::Slot::calc_envelope(int lfo_am)
 		eg_phase += eg_dPhase;
 		if (eg_phase >= EG_DP_MAX) {
 			egOut = 0;
-			eg_phase = Y8950::EnvPhaseIndex(0);
+			eg_phase = Y8950Core::EnvPhaseIndex(0);
 			eg_mode = DECAY;
 			updateEG();
 		} else {
@@ -715,14 +729,14 @@ unsigned Y8950::Slot::calc_envelope(int lfo_am)
 	return std::min<unsigned>(egOut, DB_MUTE - 1);
 }
 
-int Y8950::Slot::calc_slot_car(int lfo_pm, int lfo_am, int fm)
+int Y8950Core::Slot::calc_slot_car(int lfo_pm, int lfo_am, int fm)
 {
 	unsigned egOut = calc_envelope(lfo_am);
 	int pgout = calc_phase(lfo_pm) + wave2_8pi(fm);
 	return dB2LinTab[sinTable[pgout & PG_MASK] + egOut];
 }
 
-int Y8950::Slot::calc_slot_mod(int lfo_pm, int lfo_am)
+int Y8950Core::Slot::calc_slot_mod(int lfo_pm, int lfo_am)
 {
 	unsigned egOut = calc_envelope(lfo_am);
 	unsigned pgout = calc_phase(lfo_pm);
@@ -736,14 +750,14 @@ int Y8950::Slot::calc_slot_mod(int lfo_pm, int lfo_am)
 	return feedback;
 }
 
-int Y8950::Slot::calc_slot_tom(int lfo_pm, int lfo_am)
+int Y8950Core::Slot::calc_slot_tom(int lfo_pm, int lfo_am)
 {
 	unsigned egOut = calc_envelope(lfo_am);
 	unsigned pgout = calc_phase(lfo_pm);
 	return dB2LinTab[sinTable[pgout & PG_MASK] + egOut];
 }
 
-int Y8950::Slot::calc_slot_snare(int lfo_pm, int lfo_am, int whitenoise)
+int Y8950Core::Slot::calc_slot_snare(int lfo_pm, int lfo_am, int whitenoise)
 {
 	unsigned egOut = calc_envelope(lfo_am);
 	unsigned pgout = calc_phase(lfo_pm);
@@ -751,14 +765,14 @@ int Y8950::Slot::calc_slot_snare(int lfo_pm, int lfo_am, int whitenoise)
 	return (dB2LinTab[tmp + egOut] + dB2LinTab[egOut + whitenoise]) >> 1;
 }
 
-int Y8950::Slot::calc_slot_cym(int lfo_am, int a, int b)
+int Y8950Core::Slot::calc_slot_cym(int lfo_am, int a, int b)
 {
 	unsigned egOut = calc_envelope(lfo_am);
 	return (dB2LinTab[egOut + a] + dB2LinTab[egOut + b]) >> 1;
 }
 
 // HI-HAT
-int Y8950::Slot::calc_slot_hat(int lfo_am, int a, int b, int whitenoise)
+int Y8950Core::Slot::calc_slot_hat(int lfo_am, int a, int b, int whitenoise)
 {
 	unsigned egOut = calc_envelope(lfo_am);
 	return (dB2LinTab[egOut + whitenoise] +
@@ -777,115 +791,147 @@ void Y8950::setEnabled(bool enabled_, EmuTime::param time)
 	enabled = enabled_;
 }
 
-bool Y8950::checkMuteHelper()
+bool Y8950::isChannelIdle(unsigned i) const
 {
-	if (!enabled) {
-		return true;
-	}
-	for (auto i : xrange(6)) {
-		if (ch[i].slot[CAR].isActive()) return false;
+	if (!enabled) return true;
+	if (i < 14) return core.isChannelIdle(i);
+	return adpcm.isMuted();
+}
+
+bool Y8950Core::isChannelIdle(unsigned i) const
+{
+	// same conditions as used in generateChannels() to skip a channel
+	assert(i < 9 + 5);
+	if (i < 9) {
+		return (rythm_mode && (i >= 6)) || !ch[i].slot[CAR].isActive();
 	}
-	if (!rythm_mode) {
-		for (auto i : xrange(6, 9)) {
-			if (ch[i].slot[CAR].isActive()) return false;
-		}
-	} else {
-		if (ch[6].slot[CAR].isActive()) return false;
-		if (ch[7].slot[MOD].isActive()) return false;
-		if (ch[7].slot[CAR].isActive()) return false;
-		if (ch[8].slot[MOD].isActive()) return false;
-		if (ch[8].slot[CAR].isActive()) return false;
+	if (!rythm_mode) return true;
+	switch (i) {
+		case  9: return !ch[6].slot[CAR].isActive();
+		case 10: return !ch[7].slot[CAR].isActive();
+		case 11: return !ch[8].slot[CAR].isActive();
+		case 12: return !ch[7].slot[MOD].isActive();
+		default: return !ch[8].slot[MOD].isActive();
 	}
-
-	return adpcm.isMuted();
 }
 
+// Calculate a block of samples for all channels, then add that block per
+// channel to the output buffers (see FMOutput.hh).
+constexpr unsigned BLOCK = 32;
+
 void Y8950::generateChannels(float** bufs, unsigned num)
 {
-	// TODO implement per-channel mute (instead of all-or-nothing)
-	if (checkMuteHelper()) {
-		// TODO update internal state even when muted
-		// during mute pm_phase, am_phase, noiseA_phase, noiseB_phase
-		// and noise_seed aren't updated, probably ok
-		std::fill_n(bufs, 9 + 5 + 1, nullptr);
-		return;
+	// Note: when all channels are idle this method isn't called at all.
+	// TODO update internal state even then
+	// during mute pm_phase, am_phase, noiseA_phase, noiseB_phase
+	// and noise_seed aren't updated, probably ok
+	assert(enabled);
+
+	core.generateChannels(bufs, num);
+
+	// The ADPCM samples are also calculated (to advance the ADPCM state)
+	// when the ADPCM output is muted.
+	if (adpcm.isMuted()) bufs[14] = nullptr;
+	ALIGNAS_SSE int out[BLOCK];
+	for (unsigned start = 0; start < num; start += BLOCK) {
+		unsigned n = std::min(BLOCK, num - start);
+		for (auto j : xrange(n)) {
+			out[j] = adpcm.calcSample();
+		}
+		if (bufs[14]) {
+			FMOutput::addMono(&bufs[14][start], out, n);
+		}
 	}
+}
 
-	for (auto sample : xrange(num)) {
-		// Amplitude modulation: 27 output levels (triangle waveform);
-		// 1 level takes one of: 192, 256 or 448 samples
-		// One entry from LFO_AM_TABLE lasts for 64 samples
-		// lfo_am_table is 210 elements long
-		++am_phase;
-		if (am_phase == (LFO_AM_TAB_ELEMENTS * 64)) am_phase = 0;
-		unsigned tmp = lfo_am_table[am_phase / 64];
-		int lfo_am = am_mode ? tmp : tmp / 4;
-
-		pm_phase = (pm_phase + PM_DPHASE) & (PM_DP_WIDTH - 1);
-		int lfo_pm = pmTable[pm_mode][pm_phase >> (PM_DP_BITS - PM_PG_BITS)];
-
-		if (noise_seed & 1) {
-			noise_seed ^= 0x24000;
-		}
-		noise_seed >>= 1;
-		int whitenoise = noise_seed & 1 ? DB_POS(6) : DB_NEG(6);
+void Y8950Core::generateChannels(float** bufs, unsigned num)
+{
+	// An idle channel can only become active again via a register write,
+	// so it won't produce any output during this call.
+	for (auto i : xrange(9 + 5)) {
+		if (isChannelIdle(i)) bufs[i] = nullptr;
+	}
 
-		noiseA_phase += noiseA_dPhase;
-		noiseA_phase &= (0x40 << 11) - 1;
-		if ((noiseA_phase >> 11) == 0x3f) {
-			noiseA_phase = 0;
-		}
-		int noiseA = noiseA_phase & (0x03 << 11) ? DB_POS(6) : DB_NEG(6);
-
-		noiseB_phase += noiseB_dPhase;
-		noiseB_phase &= (0x10 << 11) - 1;
-		int noiseB = noiseB_phase & (0x0A << 11) ? DB_POS(6) : DB_NEG(6);
-
-		for (auto i : xrange(rythm_mode ? 6 : 9)) {
-			if (ch[i].slot[CAR].isActive()) {
-				bufs[i][sample] += ch[i].alg
-					? ch[i].slot[CAR].calc_slot_car(lfo_pm, lfo_am, 0) +
-					       ch[i].slot[MOD].calc_slot_mod(lfo_pm, lfo_am)
-					: ch[i].slot[CAR].calc_slot_car(lfo_pm, lfo_am,
-					       ch[i].slot[MOD].calc_slot_mod(lfo_pm, lfo_am));
+	// Channels that didn't produce any output in a block are skipped.
+	ALIGNAS_SSE int out[9 + 5][BLOCK];
+	for (unsigned start = 0; start < num; start += BLOCK) {
+		unsigned n = std::min(BLOCK, num - start);
+		unsigned used = 0;
+		auto output = [&](unsigned i, unsigned j, bool active, auto calc) {
+			if (active) {
+				out[i][j] = calc();
+				used |= 1 << i;
 			} else {
-				//bufs[i][sample] += 0;
+				out[i][j] = 0;
+			}
+		};
+		for (auto j : xrange(n)) {
+			// Amplitude modulation: 27 output levels (triangle waveform);
+			// 1 level takes one of: 192, 256 or 448 samples
+			// One entry from LFO_AM_TABLE lasts for 64 samples
+			// lfo_am_table is 210 elements long
+			++am_phase;
+			if (am_phase == (LFO_AM_TAB_ELEMENTS * 64)) am_phase = 0;
+			unsigned tmp = lfo_am_table[am_phase / 64];
+			int lfo_am = am_mode ? tmp : tmp / 4;
+
+			pm_phase = (pm_phase + PM_DPHASE) & (PM_DP_WIDTH - 1);
+			int lfo_pm = pmTable[pm_mode][pm_phase >> (PM_DP_BITS - PM_PG_BITS)];
+
+			if (noise_seed & 1) {
+				noise_seed ^= 0x24000;
+			}
+			noise_seed >>= 1;
+			int whitenoise = noise_seed & 1 ? DB_POS(6) : DB_NEG(6);
+
+			noiseA_phase += noiseA_dPhase;
+			noiseA_phase &= (0x40 << 11) - 1;
+			if ((noiseA_phase >> 11) == 0x3f) {
+				noiseA_phase = 0;
+			}
+			int noiseA = noiseA_phase & (0x03 << 11) ? DB_POS(6) : DB_NEG(6);
+
+			noiseB_phase += noiseB_dPhase;
+			noiseB_phase &= (0x10 << 11) - 1;
+			int noiseB = noiseB_phase & (0x0A << 11) ? DB_POS(6) : DB_NEG(6);
+
+			for (auto i : xrange(rythm_mode ? 6 : 9)) {
+				output(i, j, ch[i].slot[CAR].isActive(), [&] {
+					return ch[i].alg
+						? ch[i].slot[CAR].calc_slot_car(lfo_pm, lfo_am, 0) +
+						       ch[i].slot[MOD].calc_slot_mod(lfo_pm, lfo_am)
+						: ch[i].slot[CAR].calc_slot_car(lfo_pm, lfo_am,
+						       ch[i].slot[MOD].calc_slot_mod(lfo_pm, lfo_am));
+				});
+			}
+			if (rythm_mode) {
+				// TODO wasn't in original source either
+				(void)ch[7].slot[MOD].calc_phase(lfo_pm);
+				(void)ch[8].slot[CAR].calc_phase(lfo_pm);
+
+				output(9, j, ch[6].slot[CAR].isActive(), [&] {
+					return 2 * ch[6].slot[CAR].calc_slot_car(lfo_pm, lfo_am,
+					               ch[6].slot[MOD].calc_slot_mod(lfo_pm, lfo_am));
+				});
+				output(10, j, ch[7].slot[CAR].isActive(), [&] {
+					return 2 * ch[7].slot[CAR].calc_slot_snare(lfo_pm, lfo_am, whitenoise);
+				});
+				output(11, j, ch[8].slot[CAR].isActive(), [&] {
+					return 2 * ch[8].slot[CAR].calc_slot_cym(lfo_am, noiseA, noiseB);
+				});
+				output(12, j, ch[7].slot[MOD].isActive(), [&] {
+					return 2 * ch[7].slot[MOD].calc_slot_hat(lfo_am, noiseA, noiseB, whitenoise);
+				});
+				output(13, j, ch[8].slot[MOD].isActive(), [&] {
+					return 2 * ch[8].slot[MOD].calc_slot_tom(lfo_pm, lfo_am);
+				});
 			}
 		}
-		if (rythm_mode) {
-			//bufs[6][sample] += 0;
-			//bufs[7][sample] += 0;
-			//bufs[8][sample] += 0;
-
-			// TODO wasn't in original source either
-			(void)ch[7].slot[MOD].calc_phase(lfo_pm);
-			(void)ch[8].slot[CAR].calc_phase(lfo_pm);
-
-			bufs[ 9][sample] += (ch[6].slot[CAR].isActive())
-				? 2 * ch[6].slot[CAR].calc_slot_car(lfo_pm, lfo_am,
-						    ch[6].slot[MOD].calc_slot_mod(lfo_pm, lfo_am))
-				: 0;
-			bufs[10][sample] += (ch[7].slot[CAR].isActive())
-				? 2 * ch[7].slot[CAR].calc_slot_snare(lfo_pm, lfo_am, whitenoise)
-				: 0;
-			bufs[11][sample] += (ch[8].slot[CAR].isActive())
-				? 2 * ch[8].slot[CAR].calc_slot_cym(lfo_am, noiseA, noiseB)
-				: 0;
-			bufs[12][sample] += (ch[7].slot[MOD].isActive())
-				? 2 * ch[7].slot[MOD].calc_slot_hat(lfo_am, noiseA, noiseB, whitenoise)
-				: 0;
-			bufs[13][sample] += (ch[8].slot[MOD].isActive())
-				? 2 * ch[8].slot[MOD].calc_slot_tom(lfo_pm, lfo_am)
-				: 0;
-		} else {
-			//bufs[ 9] += 0;
-			//bufs[10] += 0;
-			//bufs[11] += 0;
-			//bufs[12] += 0;
-			//bufs[13] += 0;
+		for (auto i : xrange(9 + 5)) {
+			if ((used & (1 << i)) && bufs[i]) {
+				FMOutput::addMono(&bufs[i][start], out[i], n);
+			}
 		}
-
-		bufs[14][sample] += adpcm.calcSample();
 	}
 }
 
@@ -895,13 +941,6 @@ void Y8950::generateChannels(float** bufs, unsigned num)
 
 void Y8950::writeReg(byte rg, byte data, EmuTime::param time)
 {
-	int sTbl[32] = {
-		 0,  2,  4,  1,  3,  5, -1, -1,
-		 6,  8, 10,  7,  9, 11, -1, -1,
-		12, 14, 16, 13, 15, 17, -1, -1,
-		-1, -1, -1, -1, -1, -1, -1, -1
-	};
-
 	// TODO only for registers that influence sound
 	// TODO also ADPCM
 	//if (rg >= 0x20) {
@@ -909,118 +948,134 @@ void Y8950::writeReg(byte rg, byte data, EmuTime::param time)
 		updateStream(time);
 	//}
 
-	switch (rg & 0xe0) {
-	case 0x00: {
-		switch (rg) {
-		case 0x01: // TEST
-			// TODO
-			// Y8950 MSX-AUDIO Test register $01 (write only)
-			//
-			// Bit Description
-			//
-			//  7  Reset LFOs - seems to force the LFOs to their initial
-			//     values (eg. maximum amplitude, zero phase deviation)
-			//
-			//  6  something to do with ADPCM - bit 0 of the status
-			//     register is affected by setting this bit (PCM BSY)
-			//
-			//  5  No effect? - Waveform select enable in YM3812 OPL2 so seems
-			//     reasonable that this bit wouldn't have been used in OPL
-			//
-			//  4  No effect?
-			//
-			//  3  Faster LFOs - increases the frequencies of the LFOs and
-			//     (maybe) the timers (cf. YM2151 test register)
-			//
-			//  2  Reset phase generators - No phase generator output, but
-			//     envelope generators still work (can hear a transient
-			//     when they are gated)
-			//
-			//  1  No effect?
-			//
-			//  0  Reset envelopes - Envelope generator outputs forced
-			//     to maximum, so all enabled voices sound at maximum
-			reg[rg] = data;
-			break;
+	if (rg >= 0x20) {
+		core.writeReg(rg, data);
+		return;
+	}
+	switch (rg) {
+	case 0x01: // TEST
+		// TODO
+		// Y8950 MSX-AUDIO Test register $01 (write only)
+		//
+		// Bit Description
+		//
+		//  7  Reset LFOs - seems to force the LFOs to their initial
+		//     values (eg. maximum amplitude, zero phase deviation)
+		//
+		//  6  something to do with ADPCM - bit 0 of the status
+		//     register is affected by setting this bit (PCM BSY)
+		//
+		//  5  No effect? - Waveform select enable in YM3812 OPL2 so seems
+		//     reasonable that this bit wouldn't have been used in OPL
+		//
+		//  4  No effect?
+		//
+		//  3  Faster LFOs - increases the frequencies of the LFOs and
+		//     (maybe) the timers (cf. YM2151 test register)
+		//
+		//  2  Reset phase generators - No phase generator output, but
+		//     envelope generators still work (can hear a transient
+		//     when they are gated)
+		//
+		//  1  No effect?
+		//
+		//  0  Reset envelopes - Envelope generator outputs forced
+		//     to maximum, so all enabled voices sound at maximum
+		core.writeReg(rg, data);
+		break;
 
-		case 0x02: // TIMER1 (resolution 80us)
-			timer1->setValue(data);
-			reg[rg] = data;
-			break;
+	case 0x02: // TIMER1 (resolution 80us)
+		timer1->setValue(data);
+		core.writeReg(rg, data);
+		break;
 
-		case 0x03: // TIMER2 (resolution 320us)
-			timer2->setValue(data);
-			reg[rg] = data;
-			break;
+	case 0x03: // TIMER2 (resolution 320us)
+		timer2->setValue(data);
+		core.writeReg(rg, data);
+		break;
 
-		case 0x04: // FLAG CONTROL
-			if (data & Y8950::R04_IRQ_RESET) {
-				resetStatus(0x78);	// reset all flags
-			} else {
-				changeStatusMask((~data) & 0x78);
-				timer1->setStart((data & Y8950::R04_ST1) != 0, time);
-				timer2->setStart((data & Y8950::R04_ST2) != 0, time);
-				reg[rg] = data;
-			}
-			adpcm.resetStatus();
-			break;
+	case 0x04: // FLAG CONTROL
+		if (data & Y8950::R04_IRQ_RESET) {
+			resetStatus(0x78);	// reset all flags
+		} else {
+			changeStatusMask((~data) & 0x78);
+			timer1->setStart((data & Y8950::R04_ST1) != 0, time);
+			timer2->setStart((data & Y8950::R04_ST2) != 0, time);
+			core.writeReg(rg, data);
+		}
+		adpcm.resetStatus();
+		break;
 
-		case 0x06: // (KEYBOARD OUT)
-			connector.write(data, time);
-			reg[rg] = data;
-			break;
+	case 0x06: // (KEYBOARD OUT)
+		connector.write(data, time);
+		core.writeReg(rg, data);
+		break;
 
-		case 0x07: // START/REC/MEM DATA/REPEAT/SP-OFF/-/-/RESET
-			periphery.setSPOFF((data & 8) != 0, time); // bit 3
-			[[fallthrough]];
-
-		case 0x08: // CSM/KEY BOARD SPLIT/-/-/SAMPLE/DA AD/64K/ROM
-		case 0x09: // START ADDRESS (L)
-		case 0x0A: // START ADDRESS (H)
-		case 0x0B: // STOP ADDRESS (L)
-		case 0x0C: // STOP ADDRESS (H)
-		case 0x0D: // PRESCALE (L)
-		case 0x0E: // PRESCALE (H)
-		case 0x0F: // ADPCM-DATA
-		case 0x10: // DELTA-N (L)
-		case 0x11: // DELTA-N (H)
-		case 0x12: // ENVELOP CONTROL
-		case 0x1A: // PCM-DATA
-			reg[rg] = data;
-			adpcm.writeReg(rg, data, time);
-			break;
+	case 0x07: // START/REC/MEM DATA/REPEAT/SP-OFF/-/-/RESET
+		periphery.setSPOFF((data & 8) != 0, time); // bit 3
+		[[fallthrough]];
+
+	case 0x08: // CSM/KEY BOARD SPLIT/-/-/SAMPLE/DA AD/64K/ROM
+	case 0x09: // START ADDRESS (L)
+	case 0x0A: // START ADDRESS (H)
+	case 0x0B: // STOP ADDRESS (L)
+	case 0x0C: // STOP ADDRESS (H)
+	case 0x0D: // PRESCALE (L)
+	case 0x0E: // PRESCALE (H)
+	case 0x0F: // ADPCM-DATA
+	case 0x10: // DELTA-N (L)
+	case 0x11: // DELTA-N (H)
+	case 0x12: // ENVELOP CONTROL
+	case 0x1A: // PCM-DATA
+		core.writeReg(rg, data);
+		adpcm.writeReg(rg, data, time);
+		break;
 
-		case 0x15: // DAC-DATA  (bit9-2)
-			reg[rg] = data;
-			if (reg[0x08] & 0x04) {
-				int tmp = static_cast<signed char>(reg[0x15]) * 256
-				        + reg[0x16];
-				tmp = (tmp * 4) >> (7 - reg[0x17]);
-				tmp = Math::clipIntToShort(tmp);
-				dac13.writeDAC(tmp, time);
-			}
-			break;
-		case 0x16: //           (bit1-0)
-			reg[rg] = data & 0xC0;
-			break;
-		case 0x17: //           (exponent)
-			reg[rg] = data & 0x07;
-			break;
+	case 0x15: // DAC-DATA  (bit9-2)
+		core.writeReg(rg, data);
+		if (core.peekReg(0x08) & 0x04) {
+			int tmp = static_cast<signed char>(core.peekReg(0x15)) * 256
+			        + core.peekReg(0x16);
+			tmp = (tmp * 4) >> (7 - core.peekReg(0x17));
+			tmp = Math::clipIntToShort(tmp);
+			dac13.writeDAC(tmp, time);
+		}
+		break;
+	case 0x16: //           (bit1-0)
+		core.writeReg(rg, data & 0xC0);
+		break;
+	case 0x17: //           (exponent)
+		core.writeReg(rg, data & 0x07);
+		break;
 
-		case 0x18: // I/O-CONTROL (bit3-0)
-			// 0 -> input
-			// 1 -> output
-			reg[rg] = data;
-			periphery.write(reg[0x18], reg[0x19], time);
-			break;
+	case 0x18: // I/O-CONTROL (bit3-0)
+		// 0 -> input
+		// 1 -> output
+		core.writeReg(rg, data);
+		periphery.write(core.peekReg(0x18), core.peekReg(0x19), time);
+		break;
 
-		case 0x19: // I/O-DATA (bit3-0)
-			reg[rg] = data;
-			periphery.write(reg[0x18], reg[0x19], time);
-			break;
-		}
+	case 0x19: // I/O-DATA (bit3-0)
+		core.writeReg(rg, data);
+		periphery.write(core.peekReg(0x18), core.peekReg(0x19), time);
 		break;
 	}
+}
+
+void Y8950Core::writeReg(byte rg, byte data)
+{
+	int sTbl[32] = {
+		 0,  2,  4,  1,  3,  5, -1, -1,
+		 6,  8, 10,  7,  9, 11, -1, -1,
+		12, 14, 16, 13, 15, 17, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1
+	};
+
+	switch (rg & 0xe0) {
+	case 0x00:
+		// control registers, handled by Y8950
+		reg[rg] = data;
+		break;
 	case 0x20: {
 		int s = sTbl[rg & 0x1f];
 		if (s >= 0) {
@@ -1166,12 +1221,12 @@ byte Y8950::peekReg(byte rg, EmuTime::param time) const
 
 		case 0x19: { // I/O DATA
 			byte input = periphery.read(time);
-			byte output = reg[0x19];
-			byte enable = reg[0x18];
+			byte output = core.peekReg(0x19);
+			byte enable = core.peekReg(0x18);
 			return (output & enable) | (input & ~enable) | 0xF0;
 		}
 		default:
-			return reg[rg];
+			return core.peekReg(rg);
 	}
 }
 
@@ -1228,7 +1283,7 @@ void Y8950::changeStatusMask(byte newMask)
 
 
 template<typename Archive>
-void Y8950::Patch::serialize(Archive& ar, unsigned /*version*/)
+void Y8950Core::Patch::serialize(Archive& ar, unsigned /*version*/)
 {
 	ar.serialize("AM", AM,
 	             "PM", PM,
@@ -1244,14 +1299,14 @@ void Y8950::Patch::serialize(Archive& ar, unsigned /*version*/)
 	             "RR", RR);
 }
 
-static constexpr std::initializer_list<enum_string<Y8950::EnvelopeState>> envelopeStateInfo = {
-	{ "ATTACK",  Y8950::ATTACK  },
-	{ "DECAY",   Y8950::DECAY   },
-	{ "SUSTAIN", Y8950::SUSTAIN },
-	{ "RELEASE", Y8950::RELEASE },
-	{ "FINISH",  Y8950::FINISH  }
+static constexpr std::initializer_list<enum_string<Y8950Core::EnvelopeState>> envelopeStateInfo = {
+	{ "ATTACK",  Y8950Core::ATTACK  },
+	{ "DECAY",   Y8950Core::DECAY   },
+	{ "SUSTAIN", Y8950Core::SUSTAIN },
+	{ "RELEASE", Y8950Core::RELEASE },
+	{ "FINISH",  Y8950Core::FINISH  }
 };
-SERIALIZE_ENUM(Y8950::EnvelopeState, envelopeStateInfo);
+SERIALIZE_ENUM(Y8950Core::EnvelopeState, envelopeStateInfo);
 
 // version 1: initial version
 // version 2: 'slotStatus' is replaced with 'key' and no longer serialized
@@ -1259,7 +1314,7 @@ SERIALIZE_ENUM(Y8950::EnvelopeState, envelopeStateInfo);
 // version 3: serialize 'eg_mode' as an enum instead of an int, also merged
 //            the 2 enum values SUSHOLD and SUSTINE into SUSTAIN
 template<typename Archive>
-void Y8950::Slot::serialize(Archive& ar, unsigned version)
+void Y8950Core::Slot::serialize(Archive& ar, unsigned version)
 {
 	ar.serialize("feedback", feedback,
 	             "output",   output,
@@ -1282,14 +1337,14 @@ void Y8950::Slot::serialize(Archive& ar, unsigned version)
 		}
 	}
 
-	// These are restored by call to updateAll() in Y8950::Channel::serialize()
+	// These are restored by call to updateAll() in Y8950Core::Channel::serialize()
 	//  dPhase, tll, dPhaseARTableRks, dPhaseDRTableRks, eg_dPhase
 	// These are restored by update_key_status():
 	//  key
 }
 
 template<typename Archive>
-void Y8950::Channel::serialize(Archive& ar, unsigned /*version*/)
+void Y8950Core::Channel::serialize(Archive& ar, unsigned /*version*/)
 {
 	ar.serialize("mod",  slot[MOD],
 	             "car",  slot[CAR],
@@ -1303,13 +1358,8 @@ void Y8950::Channel::serialize(Archive& ar, unsigned /*version*/)
 }
 
 template<typename Archive>
-void Y8950::serialize(Archive& ar, unsigned /*version*/)
+void Y8950Core::serialize(Archive& ar, unsigned /*version*/)
 {
-	ar.serialize("keyboardConnector", connector,
-	             "adpcm",             adpcm,
-	             "timer1",            *timer1,
-	             "timer2",            *timer2,
-	             "irq",               irq);
 	ar.serialize_blob("registers", reg, sizeof(reg));
 	ar.serialize("pm_phase",      pm_phase,
 	             "am_phase",      am_phase,
@@ -1319,12 +1369,28 @@ void Y8950::serialize(Archive& ar, unsigned /*version*/)
 	             "noiseA_dphase", noiseA_dPhase,
 	             "noiseB_dphase", noiseB_dPhase,
 	             "channels",      ch,
-	             "status",        status,
-	             "statusMask",    statusMask,
 	             "rythm_mode",    rythm_mode,
 	             "am_mode",       am_mode,
-	             "pm_mode",       pm_mode,
-	             "enabled",       enabled);
+	             "pm_mode",       pm_mode);
+
+	if constexpr (Archive::IS_LOADER) {
+		update_key_status();
+	}
+}
+INSTANTIATE_SERIALIZE_METHODS(Y8950Core);
+
+template<typename Archive>
+void Y8950::serialize(Archive& ar, unsigned version)
+{
+	ar.serialize("keyboardConnector", connector,
+	             "adpcm",             adpcm,
+	             "timer1",            *timer1,
+	             "timer2",            *timer2,
+	             "irq",               irq);
+	core.serialize(ar, version);
+	ar.serialize("status",     status,
+	             "statusMask", statusMask,
+	             "enabled",    enabled);
 
 	if constexpr (Archive::IS_LOADER) {
 		// TODO restore more state from registers
@@ -1333,10 +1399,9 @@ void Y8950::serialize(Archive& ar, unsigned /*version*/)
 			15,      // dac13
 		};
 
-		update_key_status();
 		EmuTime::param time = motherBoard.getCurrentTime();
 		for (auto r : rewriteRegs) {
-			writeReg(r, reg[r], time);
+			writeReg(r, core.peekReg(r), time);
 		}
 	}
 }
@@ -1363,6 +1428,6 @@ void Y8950::Debuggable::write(unsigned address, byte value, EmuTime::param time)
 }
 
 INSTANTIATE_SERIALIZE_METHODS(Y8950);
-SERIALIZE_CLASS_VERSION(Y8950::Slot, 3);
+SERIALIZE_CLASS_VERSION(Y8950Core::Slot, 3);
 
 } // namespace openmsx
@@ -20,82 +20,39 @@ class MSXAudio;
 class DeviceConfig;
 class Y8950Periphery;
 
-class Y8950 final : private ResampledSoundDevice, private EmuTimerCallback
+/** The FM sound generation part of the Y8950: the operators, the channels,
+  * the LFOs and the rhythm section. It doesn't contain the ADPCM unit, the
+  * timers, the status register and the I/O ports, and it doesn't depend on a
+  * motherboard, so it can also be used standalone (e.g. in unit tests).
+  */
+class Y8950Core
 {
 public:
-	static constexpr int CLOCK_FREQ     = 3579545;
-	static constexpr int CLOCK_FREQ_DIV = 72;
-
-	// Bitmask for register 0x04
-	// Timer1 Start.
-	static constexpr int R04_ST1          = 0x01;
-	// Timer2 Start.
-	static constexpr int R04_ST2          = 0x02;
-	// not used
-	//static constexpr int R04            = 0x04;
-	// Mask 'Buffer Ready'.
-	static constexpr int R04_MASK_BUF_RDY = 0x08;
-	// Mask 'End of sequence'.
-	static constexpr int R04_MASK_EOS     = 0x10;
-	// Mask Timer2 flag.
-	static constexpr int R04_MASK_T2      = 0x20;
-	// Mask Timer1 flag.
-	static constexpr int R04_MASK_T1      = 0x40;
-	// IRQ RESET.
-	static constexpr int R04_IRQ_RESET    = 0x80;
-
-	// Bitmask for status register
-	static constexpr int STATUS_PCM_BSY = 0x01;
-	static constexpr int STATUS_EOS     = R04_MASK_EOS;
-	static constexpr int STATUS_BUF_RDY = R04_MASK_BUF_RDY;
-	static constexpr int STATUS_T2      = R04_MASK_T2;
-	static constexpr int STATUS_T1      = R04_MASK_T1;
-
-	Y8950(const std::string& name, const DeviceConfig& config,
-	      unsigned sampleRam, EmuTime::param time, MSXAudio& audio);
-	~Y8950();
-
-	void setEnabled(bool enabled, EmuTime::param time);
-	void clearRam();
-	void reset(EmuTime::param time);
-	void writeReg(byte rg, byte data, EmuTime::param time);
-	[[nodiscard]] byte readReg(byte rg, EmuTime::param time);
-	[[nodiscard]] byte peekReg(byte rg, EmuTime::param time) const;
-	[[nodiscard]] byte readStatus(EmuTime::param time) const;
-	[[nodiscard]] byte peekStatus(EmuTime::param time) const;
-
-	// for ADPCM
-	void setStatus(byte flags);
-	void resetStatus(byte flags);
-	[[nodiscard]] byte peekRawStatus() const;
-
+	Y8950Core();
+
+	/** Reset all channels and set all registers to zero.
+	  */
+	void reset();
+
+	/** Write a register, with immediate effect. Registers below 0x20 (the
+	  * ADPCM, timer and I/O registers) don't influence the FM sound, those
+	  * are only stored.
+	  */
+	void writeReg(byte rg, byte data);
+	[[nodiscard]] byte peekReg(byte rg) const { return reg[rg]; }
+
+	/** Generate 'num' samples for each of the 9 + 5 FM channels (so not
+	  * for the ADPCM channel), like SoundDevice::generateChannels().
+	  */
+	void generateChannels(float** bufs, unsigned num);
+	[[nodiscard]] bool isChannelIdle(unsigned channel) const;
+
+	/** This is serialized inline in Y8950, so 'version' is the version of
+	  * Y8950.
+	  */
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
-private:
-	// SoundDevice
-	[[nodiscard]] float getAmplificationFactorImpl() const override;
-	void generateChannels(float** bufs, unsigned num) override;
-
-	inline void keyOn_BD();
-	inline void keyOn_SD();
-	inline void keyOn_TOM();
-	inline void keyOn_HH();
-	inline void keyOn_CYM();
-	inline void keyOff_BD();
-	inline void keyOff_SD();
-	inline void keyOff_TOM();
-	inline void keyOff_HH();
-	inline void keyOff_CYM();
-	inline void setRythmMode(int data);
-	void update_key_status();
-
-	[[nodiscard]] bool checkMuteHelper();
-
-	void changeStatusMask(byte newMask);
-
-	void callback(byte flag) override;
-
 public:
 	// Dynamic range of envelope
 	static constexpr int EG_BITS = 9;
@@ -198,6 +155,102 @@ private:
 		bool alg;
 	};
 
+	inline void keyOn_BD();
+	inline void keyOn_SD();
+	inline void keyOn_TOM();
+	inline void keyOn_HH();
+	inline void keyOn_CYM();
+	inline void keyOff_BD();
+	inline void keyOff_SD();
+	inline void keyOff_TOM();
+	inline void keyOff_HH();
+	inline void keyOff_CYM();
+	inline void setRythmMode(int data);
+	void update_key_status();
+
+private:
+	byte reg[0x100];
+
+	Channel ch[9];
+
+	unsigned pm_phase; // Pitch Modulator
+	unsigned am_phase; // Amp Modulator
+
+	// Noise Generator
+	int noise_seed;
+	unsigned noiseA_phase;
+	unsigned noiseB_phase;
+	unsigned noiseA_dPhase;
+	unsigned noiseB_dPhase;
+
+	bool rythm_mode;
+	bool am_mode;
+	bool pm_mode;
+};
+
+class Y8950 final : private ResampledSoundDevice, private EmuTimerCallback
+{
+public:
+	static constexpr int CLOCK_FREQ     = 3579545;
+	static constexpr int CLOCK_FREQ_DIV = 72;
+
+	// Bitmask for register 0x04
+	// Timer1 Start.
+	static constexpr int R04_ST1          = 0x01;
+	// Timer2 Start.
+	static constexpr int R04_ST2          = 0x02;
+	// not used
+	//static constexpr int R04            = 0x04;
+	// Mask 'Buffer Ready'.
+	static constexpr int R04_MASK_BUF_RDY = 0x08;
+	// Mask 'End of sequence'.
+	static constexpr int R04_MASK_EOS     = 0x10;
+	// Mask Timer2 flag.
+	static constexpr int R04_MASK_T2      = 0x20;
+	// Mask Timer1 flag.
+	static constexpr int R04_MASK_T1      = 0x40;
+	// IRQ RESET.
+	static constexpr int R04_IRQ_RESET    = 0x80;
+
+	// Bitmask for status register
+	static constexpr int STATUS_PCM_BSY = 0x01;
+	static constexpr int STATUS_EOS     = R04_MASK_EOS;
+	static constexpr int STATUS_BUF_RDY = R04_MASK_BUF_RDY;
+	static constexpr int STATUS_T2      = R04_MASK_T2;
+	static constexpr int STATUS_T1      = R04_MASK_T1;
+
+	Y8950(const std::string& name, const DeviceConfig& config,
+	      unsigned sampleRam, EmuTime::param time, MSXAudio& audio);
+	~Y8950();
+
+	void setEnabled(bool enabled, EmuTime::param time);
+	void clearRam();
+	void reset(EmuTime::param time);
+	void writeReg(byte rg, byte data, EmuTime::param time);
+	[[nodiscard]] byte readReg(byte rg, EmuTime::param time);
+	[[nodiscard]] byte peekReg(byte rg, EmuTime::param time) const;
+	[[nodiscard]] byte readStatus(EmuTime::param time) const;
+	[[nodiscard]] byte peekStatus(EmuTime::param time) const;
+
+	// for ADPCM
+	void setStatus(byte flags);
+	void resetStatus(byte flags);
+	[[nodiscard]] byte peekRawStatus() const;
+
+	template<typename Archive>
+	void serialize(Archive& ar, unsigned version);
+
+private:
+	// SoundDevice
+	[[nodiscard]] float getAmplificationFactorImpl() const override;
+	void generateChannels(float** bufs, unsigned num) override;
+	[[nodiscard]] bool isChannelIdle(unsigned channel) const override;
+
+	void changeStatusMask(byte newMask);
+
+	void callback(byte flag) override;
+
+private:
 	MSXMotherBoard& motherBoard;
 	Y8950Periphery& periphery;
 	Y8950Adpcm adpcm;
@@ -214,25 +267,10 @@ private:
 	const std::unique_ptr<EmuTimer> timer2; // 320us timer
 	IRQHelper irq;
 
-	byte reg[0x100];
-
-	Channel ch[9];
-
-	unsigned pm_phase; // Pitch Modulator
-	unsigned am_phase; // Amp Modulator
-
-	// Noise Generator
-	int noise_seed;
-	unsigned noiseA_phase;
-	unsigned noiseB_phase;
-	unsigned noiseA_dPhase;
-	unsigned noiseB_dPhase;
+	Y8950Core core;
 
 	byte status;     // STATUS Register
 	byte statusMask; // bit=0 -> masked
-	bool rythm_mode;
-	bool am_mode;
-	bool pm_mode;
 	bool enabled;
 };
 
@@ -921,9 +921,11 @@ YM2151::~YM2151()
 	unregisterSound();
 }
 
-bool YM2151::checkMuteHelper()
+bool YM2151::isChannelIdle(unsigned channel) const
 {
-	return ranges::all_of(oper, [](auto& op) { return op.state == EG_OFF; });
+	return ranges::all_of(xrange(4), [&](auto i) {
+		return oper[4 * channel + i].state == EG_OFF;
+	});
 }
 
 void YM2151::reset(EmuTime::param time)
@@ -1511,11 +1513,10 @@ void YM2151::advance()
 
 void YM2151::generateChannels(float** bufs, unsigned num)
 {
-	if (checkMuteHelper()) {
-		// TODO update internal state, even if muted
-		std::fill_n(bufs, 8, nullptr);
-		return;
-	}
+	// Note: when all channels are idle this method isn't called at all.
+	// TODO update internal state, even then
+	// Idle channels are still calculated here: in CSM mode a key-on can
+	// happen in the middle of this call.
 
 	for (auto i : xrange(num)) {
 		advanceEG();
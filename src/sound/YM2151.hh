@@ -126,6 +126,7 @@ private:
 
 	// SoundDevice
 	void generateChannels(float** bufs, unsigned num) override;
+	[[nodiscard]] bool isChannelIdle(unsigned channel) const override;
 
 	void callback(byte flag) override;
 	void setStatus(byte flags);
@@ -147,8 +148,6 @@ private:
 	void advanceEG();
 	void advance();
 
-	[[nodiscard]] bool checkMuteHelper();
-
 	IRQHelper irq;
 
 	// Timers (see EmuTimer class for details about timing)
@@ -822,11 +822,97 @@ void YM2413::generateChannels(float* out_[9 + 5], uint32_t n)
 	if (unlikely(test_mode_active)) {
 		repeat(n, [&] { step18<true >(out); });
 	} else {
-		repeat(n, [&] { step18<false>(out); });
+		while (n) {
+			if (isIdle()) {
+				// stays idle until the next register write
+				stepIdle(n);
+				break;
+			}
+			step18<false>(out);
+			--n;
+		}
 	}
 	test_mode_active = testmode;
 }
 
+bool YM2413::isIdle() const
+{
+	// All slots are silent (and stay silent because none of them is
+	// keyed-on). The operator output of a silent slot is zero, so after
+	// a few rounds also the feedback and output-delay state is zero.
+	if (!ranges::all_of(eg_level, [](auto l) { return l == 0x7f; })) return false;
+	if (!ranges::all_of(eg_state, [](auto s) { return s == EgState::release; })) return false;
+	if (ranges::any_of(eg_dokon, [](auto b) { return b; })) return false;
+	if (ranges::any_of(sk_on, [](auto sk) { return sk & 1; })) return false;
+	if ((rhythm & 0x20) && (rhythm & 0x1f)) return false;
+	if (ranges::any_of(op_fb1, [](auto f) { return f != 0; })) return false;
+	if (ranges::any_of(op_fb2, [](auto f) { return f != 0; })) return false;
+	if (op_mod || delay6 || delay7 || delay10 || delay11 || delay12) return false;
+
+	// Only register writes can change any of the above.
+	if (write_fm_cycle != uint8_t(-1)) return false;
+	return ranges::all_of(writes, [](auto& w) { return w.port == uint8_t(-1); });
+}
+
+template<uint32_t... CYCLES>
+ALWAYS_INLINE void YM2413::calcPhaseIncrements(
+	uint32_t* incr, bool use_rm_patches, std::integer_sequence<uint32_t, CYCLES...>) const
+{
+	((incr[CYCLES] = phaseCalcIncrement<CYCLES>(preparePatch1<CYCLES>(use_rm_patches))), ...);
+}
+
+// Equivalent to 'n' times step18<false>(), but only valid while isIdle().
+// The output of all channels remains zero, so only update the state that
+// can still be observed after the next register write. In particular the
+// envelope generator and operator state of each slot remains unchanged,
+// except for the phase. (The only other state that does change,
+// like 'eg_rate', 'eg_sl', 'op_phase', is only used for non-silent slots
+// and will be recalculated before it's used again.)
+NEVER_INLINE void YM2413::stepIdle(uint32_t n)
+{
+	bool use_rm_patches = rhythm & 0x20;
+
+	// Phase increments only change when 'lfo_vib' changes (there are no
+	// register writes). In a round, cycles 0-16 use the value from before
+	// the LFO update in cycle 17, cycle 17 itself uses the new value.
+	uint32_t incr[18];
+	auto vib1 = lfo_vib;
+	auto vib2 = lfo_vib;
+	calcPhaseIncrements(incr, use_rm_patches, std::make_integer_sequence<uint32_t, 17>{});
+	incr[17] = phaseCalcIncrement<17>(preparePatch1<17>(use_rm_patches));
+
+	repeat(n, [&] {
+		if (unlikely(lfo_vib != vib1)) {
+			vib1 = lfo_vib;
+			calcPhaseIncrements(incr, use_rm_patches, std::make_integer_sequence<uint32_t, 17>{});
+		}
+
+		// cycle 0
+		envelopeTimer1<0>();
+		bool eg_timer_carry = false; // only used in test mode
+		envelopeTimer2<0, false>(eg_timer_carry);
+
+		// cycle 16, see getPhase()
+		if (use_rm_patches) rm_tc_bits = pg_phase[16] >> 8;
+
+		// cycle 17
+		bool lfo_am_car = false; // only used in test mode
+		doLFO<17, false>(lfo_am_car);
+		doRhythm<17, false>();
+		if (unlikely(lfo_vib != vib2)) {
+			vib2 = lfo_vib;
+			incr[17] = phaseCalcIncrement<17>(preparePatch1<17>(use_rm_patches));
+		}
+
+		// no key-on events, so no phase resets
+		for (auto i : xrange(18)) {
+			pg_phase[i] += incr[i];
+		}
+	});
+
+	allowed_offset = std::max<int>(0, allowed_offset - 18 * int(n)); // see writePort()
+}
+
 template<bool TEST_MODE>
 NEVER_INLINE void YM2413::step18(float* out[9 + 5])
 {
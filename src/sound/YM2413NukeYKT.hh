@@ -47,12 +47,16 @@
 *      * Move sub-operations in the pipeline (e.g. to eliminate temporary state)
 *        when this doesn't have an observable effect.
 *      * Lots of small tweak.
+*      * Bypass most of the emulation while the YM2413 is idle (see below).
 *      * ...
-*
-* TODO:
-* - In openMSX the YM2413 is often silent for large periods of time (e.g. maybe
-*   the emulated MSX program doesn't use the YM2413). Can we easily detect an
-*   idle YM2413 and then bypass large parts of the emulation?
+* - In openMSX the YM2413 is often silent for large periods of time (e.g. the
+*   emulated MSX program doesn't use the YM2413 at all). When all slots are
+*   silent and there are no pending register writes, the output remains zero
+*   until the next register write. We then only advance the state that is
+*   still observable later: the phase generators (all 18 slots at once), the
+*   LFO, the envelope timer and the noise generator. See isIdle() and
+*   stepIdle(). YM2413NukeYKT_test.cc checks that this still generates
+*   identical output.
 */
 
 #ifndef YM2413NUKEYKT_HH
@@ -61,6 +65,7 @@
 #include "YM2413Core.hh"
 #include "inline.hh"
 #include <array>
+#include <utility>
 
 namespace openmsx::YM2413NukeYKT {
 
@@ -160,6 +165,10 @@ private:
 
 private:
 	template<bool TEST_MODE> NEVER_INLINE void step18(float* out[9 + 5]);
+	[[nodiscard]] bool isIdle() const;
+	NEVER_INLINE void stepIdle(uint32_t n);
+	template<uint32_t... CYCLES> ALWAYS_INLINE void calcPhaseIncrements(
+		uint32_t* incr, bool use_rm_patches, std::integer_sequence<uint32_t, CYCLES...>) const;
 	template<uint32_t CYCLES, bool TEST_MODE> ALWAYS_INLINE void step(Locals& l);
 
 	template<uint32_t CYCLES>                 ALWAYS_INLINE uint32_t phaseCalcIncrement(const Patch& patch1) const;
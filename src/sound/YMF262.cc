@@ -38,13 +38,16 @@
  */
 
 #include "YMF262.hh"
+#include "FMOutput.hh"
 #include "DeviceConfig.hh"
 #include "MSXMotherBoard.hh"
 #include "Math.hh"
+#include "aligned.hh"
 #include "cstd.hh"
 #include "outer.hh"
 #include "serialize.hh"
 #include "xrange.hh"
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstring>
@@ -52,12 +55,12 @@
 
 namespace openmsx {
 
-[[nodiscard]] static constexpr YMF262::FreqIndex fnumToIncrement(unsigned block_fnum)
+[[nodiscard]] static constexpr YMF262Core::FreqIndex fnumToIncrement(unsigned block_fnum)
 {
 	// opn phase increment counter = 20bit
 	// chip works with 10.10 fixed point, while we use 16.16
 	unsigned block = (block_fnum & 0x1C00) >> 10;
-	return YMF262::FreqIndex(block_fnum & 0x03FF) >> (11 - block);
+	return YMF262Core::FreqIndex(block_fnum & 0x03FF) >> (11 - block);
 }
 
 // envelope output entries
@@ -481,13 +484,7 @@ static constexpr SinTab getSinTab()
 constexpr SinTab sin = getSinTab();
 
 
-// TODO clean this up
-static int phase_modulation;  // phase modulation input (SLOT 2)
-static int phase_modulation2; // phase modulation input (SLOT 3
-                              // in 4 operator channels)
-
-
-YMF262::Slot::Slot()
+YMF262Core::Slot::Slot()
 	: Cnt(0), Incr(0)
 {
 	ar = dr = rr = KSR = ksl = ksr = mul = 0;
@@ -502,7 +499,7 @@ YMF262::Slot::Slot()
 	wavetable = &sin.tab[0 * SIN_LEN];
 }
 
-YMF262::Channel::Channel()
+YMF262Core::Channel::Channel()
 {
 	block_fnum = ksl_base = kcode = 0;
 	extended = false;
@@ -552,7 +549,7 @@ void YMF262::changeStatusMask(byte flag)
 }
 
 
-void YMF262::Slot::advanceEnvelopeGenerator(unsigned egCnt)
+void YMF262Core::Slot::advanceEnvelopeGenerator(unsigned egCnt)
 {
 	switch (state) {
 	case EG_ATTACK:
@@ -611,7 +608,7 @@ void YMF262::Slot::advanceEnvelopeGenerator(unsigned egCnt)
 	}
 }
 
-void YMF262::Slot::advancePhaseGenerator(Channel& ch, unsigned lfo_pm)
+void YMF262Core::Slot::advancePhaseGenerator(Channel& ch, unsigned lfo_pm)
 {
 	if (vib) {
 		// LFO phase modulation active
@@ -626,7 +623,7 @@ void YMF262::Slot::advancePhaseGenerator(Channel& ch, unsigned lfo_pm)
 }
 
 // advance to next sample
-void YMF262::advance()
+void YMF262Core::advance()
 {
 	// Vibrato: 8 output levels (triangle waveform);
 	// 1 level takes 1024 samples
@@ -666,16 +663,24 @@ void YMF262::advance()
 	noise_rng >>= 1;
 }
 
-inline int YMF262::Slot::op_calc(unsigned phase, unsigned lfo_am) const
+inline int YMF262Core::Slot::op_calc(unsigned phase, unsigned lfo_am) const
 {
 	unsigned env = (TLL + volume + (lfo_am & AMmask)) << 4;
 	int p = env + wavetable[phase & SIN_MASK];
 	return (p < TL_TAB_LEN) ? tlTab[p] : 0;
 }
 
+// op_calc() returns zero for an idle slot, and it stays idle until the next
+// key-on or total-level change (both are register writes)
+inline bool YMF262Core::Slot::isIdle() const
+{
+	return (state == EG_OFF) ||
+	       ((state == EG_RELEASE) && ((TLL + volume) >= ENV_QUIET));
+}
+
 // calculate output of a standard 2 operator channel
 // (or 1st part of a 4-op channel)
-void YMF262::Channel::chan_calc(unsigned lfo_am)
+void YMF262Core::Channel::chan_calc(unsigned lfo_am, int& phase_modulation, int& phase_modulation2)
 {
 	// !! something is wrong with this, it caused bug
 	// !!    [2823673] moonsound 4 operator FM fail
@@ -714,7 +719,7 @@ void YMF262::Channel::chan_calc(unsigned lfo_am)
 }
 
 // calculate output of a 2nd part of 4-op channel
-void YMF262::Channel::chan_calc_ext(unsigned lfo_am)
+void YMF262Core::Channel::chan_calc_ext(unsigned lfo_am, int& phase_modulation, int& phase_modulation2)
 {
 	// !! see remark in chan_cal(), something is wrong with this
 	// !! optimization disabled for now
@@ -735,6 +740,16 @@ void YMF262::Channel::chan_calc_ext(unsigned lfo_am)
 	*car.connect += car.op_calc(car.Cnt.toInt() + phase_modulation, lfo_am);
 }
 
+// Same state change as chan_calc() (or chan_calc() plus chan_calc_ext() for a
+// 4-op channel), but only valid when all involved slots are idle. Then all
+// outputs are zero, so only the feedback history needs to be updated.
+inline void YMF262Core::Channel::chan_calc_idle()
+{
+	auto& mod = slot[MOD];
+	mod.op1_out[0] = mod.op1_out[1];
+	mod.op1_out[1] = 0;
+}
+
 // operators used in the rhythm sounds generation process:
 //
 // Envelope Generator:
@@ -770,7 +785,7 @@ void YMF262::Channel::chan_calc_ext(unsigned lfo_am)
 // The following formulas can be well optimized.
 // I leave them in direct form for now (in case I've missed something).
 
-inline int YMF262::genPhaseHighHat()
+inline int YMF262Core::genPhaseHighHat()
 {
 	// high hat phase generation (verified on real YM3812):
 	// phase = d0 or 234 (based on frequency only)
@@ -813,7 +828,7 @@ inline int YMF262::genPhaseHighHat()
 	return phase;
 }
 
-inline int YMF262::genPhaseSnare()
+inline int YMF262Core::genPhaseSnare()
 {
 	// verified on real YM3812
 	// base frequency derived from operator 1 in channel 7
@@ -822,7 +837,7 @@ inline int YMF262::genPhaseSnare()
 	     ^ ((noise_rng & 1) << 8);
 }
 
-inline int YMF262::genPhaseCymbal()
+inline int YMF262Core::genPhaseCymbal()
 {
 	// verified on real YM3812
 	// enable gate based on frequency of operator 2 in channel 8
@@ -842,7 +857,7 @@ inline int YMF262::genPhaseCymbal()
 }
 
 // calculate rhythm
-void YMF262::chan_calc_rhythm(unsigned lfo_am)
+void YMF262Core::chan_calc_rhythm(unsigned lfo_am)
 {
 	// Bass Drum (verified on real YM3812):
 	//  - depends on the channel 6 'connect' register:
@@ -882,7 +897,7 @@ void YMF262::chan_calc_rhythm(unsigned lfo_am)
 	chanout[8] += 2 * car8.op_calc(genPhaseCymbal(),  lfo_am);
 }
 
-void YMF262::Slot::FM_KEYON(byte key_set)
+void YMF262Core::Slot::FM_KEYON(byte key_set)
 {
 	if (!key) {
 		// restart Phase Generator
@@ -893,7 +908,7 @@ void YMF262::Slot::FM_KEYON(byte key_set)
 	key |= key_set;
 }
 
-void YMF262::Slot::FM_KEYOFF(byte key_clr)
+void YMF262Core::Slot::FM_KEYOFF(byte key_clr)
 {
 	if (key) {
 		key &= ~key_clr;
@@ -906,7 +921,7 @@ void YMF262::Slot::FM_KEYOFF(byte key_clr)
 	}
 }
 
-void YMF262::Slot::update_ar_dr()
+void YMF262Core::Slot::update_ar_dr()
 {
 	if ((ar + ksr) < 16 + 60) {
 		// verified on real YMF262 - all 15 x rates take "zero" time
@@ -921,7 +936,7 @@ void YMF262::Slot::update_ar_dr()
 	eg_sel_dr = eg_rate_select[dr + ksr];
 	eg_m_dr   = (1 << eg_sh_dr) - 1;
 }
-void YMF262::Slot::update_rr()
+void YMF262Core::Slot::update_rr()
 {
 	eg_sh_rr  = eg_rate_shift [rr + ksr];
 	eg_sel_rr = eg_rate_select[rr + ksr];
@@ -929,7 +944,7 @@ void YMF262::Slot::update_rr()
 }
 
 // update phase increment counter of operator (also update the EG rates if necessary)
-void YMF262::Slot::calc_fc(const Channel& ch)
+void YMF262Core::Slot::calc_fc(const Channel& ch)
 {
 	// (frequency) phase increment counter
 	Incr = ch.fc * mul;
@@ -947,7 +962,7 @@ static constexpr unsigned channelPairTab[18] = {
 	0,  1,  2,  0,  1,  2, unsigned(~0), unsigned(~0), unsigned(~0),
 	9, 10, 11,  9, 10, 11, unsigned(~0), unsigned(~0), unsigned(~0),
 };
-inline bool YMF262::isExtended(unsigned ch) const
+inline bool YMF262Core::isExtended(unsigned ch) const
 {
 	assert(ch < 18);
 	if (!OPL3_mode) return false;
@@ -959,17 +974,17 @@ static constexpr unsigned getFirstOfPairNum(unsigned ch)
 	assert((ch < 18) && (channelPairTab[ch] != unsigned(~0)));
 	return channelPairTab[ch];
 }
-inline YMF262::Channel& YMF262::getFirstOfPair(unsigned ch)
+inline YMF262Core::Channel& YMF262Core::getFirstOfPair(unsigned ch)
 {
 	return channel[getFirstOfPairNum(ch) + 0];
 }
-inline YMF262::Channel& YMF262::getSecondOfPair(unsigned ch)
+inline YMF262Core::Channel& YMF262Core::getSecondOfPair(unsigned ch)
 {
 	return channel[getFirstOfPairNum(ch) + 3];
 }
 
 // set multi,am,vib,EG-TYP,KSR,mul
-void YMF262::set_mul(unsigned sl, byte v)
+void YMF262Core::set_mul(unsigned sl, byte v)
 {
 	unsigned chan_no = sl / 2;
 	auto& ch = channel[chan_no];
@@ -992,7 +1007,7 @@ void YMF262::set_mul(unsigned sl, byte v)
 }
 
 // set ksl & tl
-void YMF262::set_ksl_tl(unsigned sl, byte v)
+void YMF262Core::set_ksl_tl(unsigned sl, byte v)
 {
 	unsigned chan_no = sl / 2;
 	auto& ch = channel[chan_no];
@@ -1016,7 +1031,7 @@ void YMF262::set_ksl_tl(unsigned sl, byte v)
 }
 
 // set attack rate & decay rate
-void YMF262::set_ar_dr(unsigned sl, byte v)
+void YMF262Core::set_ar_dr(unsigned sl, byte v)
 {
 	auto& ch = channel[sl / 2];
 	auto& slot = ch.slot[sl & 1];
@@ -1027,7 +1042,7 @@ void YMF262::set_ar_dr(unsigned sl, byte v)
 }
 
 // set sustain level & release rate
-void YMF262::set_sl_rr(unsigned sl, byte v)
+void YMF262Core::set_sl_rr(unsigned sl, byte v)
 {
 	auto& ch = channel[sl / 2];
 	auto& slot = ch.slot[sl & 1];
@@ -1045,12 +1060,12 @@ byte YMF262::readReg(unsigned r)
 
 byte YMF262::peekReg(unsigned r) const
 {
-	return reg[r];
+	return core.peekReg(r);
 }
 
 void YMF262::writeReg(unsigned r, byte v, EmuTime::param time)
 {
-	if (!OPL3_mode && (r != 0x105)) {
+	if (!core.isOPL3Mode() && (r != 0x105)) {
 		// in OPL2 mode the only accessible in set #2 is register 0x05
 		r &= ~0x100;
 	}
@@ -1062,6 +1077,43 @@ void YMF262::writeReg512(unsigned r, byte v, EmuTime::param time)
 	writeRegDirect(r, v, time);
 }
 void YMF262::writeRegDirect(unsigned r, byte v, EmuTime::param time)
+{
+	if (r == 0x105) {
+		// Verified on real YMF278: When NEW2 bit is first set, a read
+		// from the status register (once) returns bit 1 set (0x02).
+		// This only happens once after reset, so clearing NEW2 and
+		// setting it again doesn't cause another change in the status
+		// register. Also, only bit 1 changes.
+		if ((v & 0x02) && !alreadySignaledNEW2 && isYMF278) {
+			status2 = 0x02;
+			alreadySignaledNEW2 = true;
+		}
+	} else if ((r != 0x104) && ((r & 0xE0) == 0x00)) {
+		switch (r & 0x1F) {
+		case 0x02: // Timer 1
+			timer1->setValue(v);
+			break;
+
+		case 0x03: // Timer 2
+			timer2->setValue(v);
+			break;
+
+		case 0x04: // IRQ clear / mask and Timer enable
+			if (v & 0x80) {
+				// IRQ flags clear
+				resetStatus(0x60);
+			} else {
+				changeStatusMask((~v) & 0x60);
+				timer1->setStart((v & R04_ST1) != 0, time);
+				timer2->setStart((v & R04_ST2) != 0, time);
+			}
+			break;
+		}
+	}
+	core.writeReg(r, v);
+}
+
+void YMF262Core::writeReg(unsigned r, byte v)
 {
 	reg[r] = v;
 
@@ -1080,16 +1132,6 @@ void YMF262::writeRegDirect(unsigned r, byte v, EmuTime::param time)
 		// OPL3 mode when bit0=1 otherwise it is OPL2 mode
 		OPL3_mode = v & 0x01;
 
-		// Verified on real YMF278: When NEW2 bit is first set, a read
-		// from the status register (once) returns bit 1 set (0x02).
-		// This only happens once after reset, so clearing NEW2 and
-		// setting it again doesn't cause another change in the status
-		// register. Also, only bit 1 changes.
-		if ((v & 0x02) && !alreadySignaledNEW2 && isYMF278) {
-			status2 = 0x02;
-			alreadySignaledNEW2 = true;
-		}
-
 		// following behaviour was tested on real YMF262,
 		// switching OPL3/OPL2 modes on the fly:
 		//  - does not change the waveform previously selected
@@ -1110,22 +1152,9 @@ void YMF262::writeRegDirect(unsigned r, byte v, EmuTime::param time)
 			break;
 
 		case 0x02: // Timer 1
-			timer1->setValue(v);
-			break;
-
 		case 0x03: // Timer 2
-			timer2->setValue(v);
-			break;
-
 		case 0x04: // IRQ clear / mask and Timer enable
-			if (v & 0x80) {
-				// IRQ flags clear
-				resetStatus(0x60);
-			} else {
-				changeStatusMask((~v) & 0x60);
-				timer1->setStart((v & R04_ST1) != 0, time);
-				timer2->setStart((v & R04_ST2) != 0, time);
-			}
+			// handled in YMF262
 			break;
 
 		case 0x08: // x,NTS,x,x, x,x,x,x
@@ -1407,29 +1436,21 @@ void YMF262::writeRegDirect(unsigned r, byte v, EmuTime::param time)
 }
 
 
-void YMF262::reset(EmuTime::param time)
+void YMF262Core::reset()
 {
 	eg_cnt = 0;
 
 	noise_rng = 1; // noise shift register
 	nts = false; // note split
-	alreadySignaledNEW2 = false;
-	resetStatus(0x60);
-
-	// reset with register write
-	writeRegDirect(0x01, 0, time); // test register
-	writeRegDirect(0x02, 0, time); // Timer1
-	writeRegDirect(0x03, 0, time); // Timer2
-	writeRegDirect(0x04, 0, time); // IRQ mask clear
 
 	// FIX IT  registers 101, 104 and 105
 	// FIX IT (dont change CH.D, CH.C, CH.B and CH.A in C0-C8 registers)
 	for (int c = 0xFF; c >= 0x20; c--) {
-		writeRegDirect(c, 0, time);
+		writeReg(c, 0);
 	}
 	// FIX IT (dont change CH.D, CH.C, CH.B and CH.A in C0-C8 registers)
 	for (int c = 0x1FF; c >= 0x120; c--) {
-		writeRegDirect(c, 0, time);
+		writeReg(c, 0);
 	}
 
 	// reset operator parameters
@@ -1439,6 +1460,20 @@ void YMF262::reset(EmuTime::param time)
 			sl.volume = MAX_ATT_INDEX;
 		}
 	}
+}
+
+void YMF262::reset(EmuTime::param time)
+{
+	alreadySignaledNEW2 = false;
+	resetStatus(0x60);
+
+	// reset with register write
+	writeRegDirect(0x01, 0, time); // test register
+	writeRegDirect(0x02, 0, time); // Timer1
+	writeRegDirect(0x03, 0, time); // Timer2
+	writeRegDirect(0x04, 0, time); // IRQ mask clear
+
+	core.reset();
 
 	setMixLevel(0x1b, time); // -9dB left and right
 }
@@ -1448,26 +1483,13 @@ static unsigned calcInputRate(bool isYMF278)
 	return unsigned(lrintf(isYMF278 ?    33868800.0f / (19 * 36)
 	                                : 4 * 3579545.0f / ( 8 * 36)));
 }
-YMF262::YMF262(const std::string& name_,
-               const DeviceConfig& config, bool isYMF278_)
-	: ResampledSoundDevice(config.getMotherBoard(), name_, "MoonSound FM-part",
-	                       18, calcInputRate(isYMF278_), true)
-	, debuggable(config.getMotherBoard(), getName())
-	, timer1(isYMF278_
-	         ? EmuTimer::createOPL4_1(config.getScheduler(), *this)
-	         : EmuTimer::createOPL3_1(config.getScheduler(), *this))
-	, timer2(isYMF278_
-	         ? EmuTimer::createOPL4_2(config.getScheduler(), *this)
-	         : EmuTimer::createOPL3_2(config.getScheduler(), *this))
-	, irq(config.getMotherBoard(), getName() + ".IRQ")
-	, lfo_am_cnt(0), lfo_pm_cnt(0)
-	, isYMF278(isYMF278_)
+YMF262Core::YMF262Core()
+	: lfo_am_cnt(0), lfo_pm_cnt(0)
 {
 	lfo_am_depth = false;
 	lfo_pm_depth_range = 0;
 	rhythm = 0;
 	OPL3_mode = false;
-	status = status2 = statusMask = 0;
 
 	// avoid (harmless) UMR in serialize()
 	memset(chanout, 0, sizeof(chanout));
@@ -1481,6 +1503,25 @@ YMF262::YMF262(const std::string& name_,
 		for (const auto& e : sin.tab) std::cout << e << '\n';
 	}
 
+	reset();
+}
+
+YMF262::YMF262(const std::string& name_,
+               const DeviceConfig& config, bool isYMF278_)
+	: ResampledSoundDevice(config.getMotherBoard(), name_, "MoonSound FM-part",
+	                       18, calcInputRate(isYMF278_), true)
+	, debuggable(config.getMotherBoard(), getName())
+	, timer1(isYMF278_
+	         ? EmuTimer::createOPL4_1(config.getScheduler(), *this)
+	         : EmuTimer::createOPL3_1(config.getScheduler(), *this))
+	, timer2(isYMF278_
+	         ? EmuTimer::createOPL4_2(config.getScheduler(), *this)
+	         : EmuTimer::createOPL3_2(config.getScheduler(), *this))
+	, irq(config.getMotherBoard(), getName() + ".IRQ")
+	, isYMF278(isYMF278_)
+{
+	status = status2 = statusMask = 0;
+
 	registerSound(config);
 	reset(config.getMotherBoard().getCurrentTime()); // must come after registerSound() because of call to setSoftwareVolume() via setMixLevel()
 }
@@ -1503,19 +1544,25 @@ byte YMF262::peekStatus() const
 	return status | status2;
 }
 
-bool YMF262::checkMuteHelper()
+inline bool YMF262Core::slotsIdle(unsigned ch) const
 {
-	// TODO this doesn't always mute when possible
-	for (auto& ch : channel) {
-		for (auto& sl : ch.slot) {
-			if (!((sl.state == EG_OFF) ||
-			      ((sl.state == EG_RELEASE) &&
-			       ((sl.TLL + sl.volume) >= ENV_QUIET)))) {
-				return false;
-			}
-		}
-	}
-	return true;
+	return channel[ch].slot[MOD].isIdle() && channel[ch].slot[CAR].isIdle();
+}
+
+bool YMF262Core::isChannelIdle(unsigned ch) const
+{
+	if (!slotsIdle(ch)) return false;
+	if (channelPairTab[ch] == unsigned(~0)) return true;
+	// The output of a 4-op channel depends on the slots of both channels
+	// of the pair (same check as in generateChannels()).
+	unsigned first = channelPairTab[ch];
+	if (!channel[first].extended) return true;
+	return slotsIdle(first) && slotsIdle(first + 3);
+}
+
+bool YMF262::isChannelIdle(unsigned ch) const
+{
+	return core.isChannelIdle(ch);
 }
 
 void YMF262::setMixLevel(uint8_t x, EmuTime::param time)
@@ -1542,87 +1589,120 @@ float YMF262::getAmplificationFactorImpl() const
 
 void YMF262::generateChannels(float** bufs, unsigned num)
 {
-	// TODO implement per-channel mute (instead of all-or-nothing)
+	core.generateChannels(bufs, num);
+}
+
+void YMF262Core::generateChannels(float** bufs, unsigned num)
+{
 	// TODO output rhythm on separate channels?
-	if (checkMuteHelper()) {
-		// TODO update internal state, even if muted
-		std::fill_n(bufs, 18, nullptr);
-		return;
+	// Note: when all channels are idle this method isn't called at all,
+	// TODO update internal state in that case as well.
+
+	// A channel that is idle now stays idle during this whole call (going
+	// from idle to non-idle requires a register write). Skip calculating
+	// such channels and don't output anything for them.
+	bool idle[18];
+	for (auto i : xrange(18)) {
+		idle[i] = isChannelIdle(i);
+		if (idle[i]) bufs[i] = nullptr;
 	}
+	auto calc = [&](unsigned i, unsigned lfo_am) {
+		if (idle[i]) {
+			channel[i].chan_calc_idle();
+		} else {
+			channel[i].chan_calc(lfo_am, phase_modulation, phase_modulation2);
+		}
+	};
 
 	bool rhythmEnabled = (rhythm & 0x20) != 0;
 
-	for (auto j : xrange(num)) {
-		// Amplitude modulation: 27 output levels (triangle waveform);
-		// 1 level takes one of: 192, 256 or 448 samples
-		// One entry from LFO_AM_TABLE lasts for 64 samples
-		lfo_am_cnt.addQuantum();
-		if (lfo_am_cnt == LFOAMIndex(LFO_AM_TAB_ELEMENTS)) {
-			// lfo_am_table is 210 elements long
-			lfo_am_cnt = LFOAMIndex(0);
-		}
-		unsigned tmp = lfo_am_table[lfo_am_cnt.toInt()];
-		unsigned lfo_am = lfo_am_depth ? tmp : tmp / 4;
-
-		// clear channel outputs
-		memset(chanout, 0, sizeof(chanout));
-
-		// channels 0,3 1,4 2,5  9,12 10,13 11,14
-		// in either 2op or 4op mode
-		for (int k = 0; k <= 9; k += 9) {
-			for (auto i : xrange(3)) {
-				auto& ch0 = channel[k + i + 0];
-				auto& ch3 = channel[k + i + 3];
-				// extended 4op ch#0 part 1 or 2op ch#0
-				ch0.chan_calc(lfo_am);
-				if (ch0.extended) {
-					// extended 4op ch#0 part 2
-					ch3.chan_calc_ext(lfo_am);
-				} else {
-					// standard 2op ch#3
-					ch3.chan_calc(lfo_am);
+	// Calculate a block of samples for all channels, then add that block
+	// per channel to the output buffers (see FMOutput.hh).
+	constexpr unsigned BLOCK = 32;
+	ALIGNAS_SSE int out[18][BLOCK];
+	for (unsigned start = 0; start < num; start += BLOCK) {
+		unsigned n = std::min(BLOCK, num - start);
+		for (auto j : xrange(n)) {
+			// Amplitude modulation: 27 output levels (triangle waveform);
+			// 1 level takes one of: 192, 256 or 448 samples
+			// One entry from LFO_AM_TABLE lasts for 64 samples
+			lfo_am_cnt.addQuantum();
+			if (lfo_am_cnt == LFOAMIndex(LFO_AM_TAB_ELEMENTS)) {
+				// lfo_am_table is 210 elements long
+				lfo_am_cnt = LFOAMIndex(0);
+			}
+			unsigned tmp = lfo_am_table[lfo_am_cnt.toInt()];
+			unsigned lfo_am = lfo_am_depth ? tmp : tmp / 4;
+
+			// clear channel outputs
+			memset(chanout, 0, sizeof(chanout));
+
+			// channels 0,3 1,4 2,5  9,12 10,13 11,14
+			// in either 2op or 4op mode
+			for (int k = 0; k <= 9; k += 9) {
+				for (auto i : xrange(3)) {
+					auto& ch0 = channel[k + i + 0];
+					auto& ch3 = channel[k + i + 3];
+					if (ch0.extended) {
+						if (idle[k + i]) {
+							// all 4 slots idle
+							ch0.chan_calc_idle();
+						} else {
+							// extended 4op ch#0 part 1 and 2
+							ch0.chan_calc(lfo_am, phase_modulation, phase_modulation2);
+							ch3.chan_calc_ext(lfo_am, phase_modulation, phase_modulation2);
+						}
+					} else {
+						// standard 2op ch#0 and ch#3
+						calc(k + i + 0, lfo_am);
+						calc(k + i + 3, lfo_am);
+					}
 				}
 			}
-		}
 
-		// channels 6,7,8 rhythm or 2op mode
-		if (!rhythmEnabled) {
-			channel[6].chan_calc(lfo_am);
-			channel[7].chan_calc(lfo_am);
-			channel[8].chan_calc(lfo_am);
-		} else {
-			// Rhythm part
-			chan_calc_rhythm(lfo_am);
-		}
+			// channels 6,7,8 rhythm or 2op mode
+			if (!rhythmEnabled) {
+				calc(6, lfo_am);
+				calc(7, lfo_am);
+				calc(8, lfo_am);
+			} else {
+				// Rhythm part
+				chan_calc_rhythm(lfo_am);
+			}
 
-		// channels 15,16,17 are fixed 2-operator channels only
-		channel[15].chan_calc(lfo_am);
-		channel[16].chan_calc(lfo_am);
-		channel[17].chan_calc(lfo_am);
+			// channels 15,16,17 are fixed 2-operator channels only
+			calc(15, lfo_am);
+			calc(16, lfo_am);
+			calc(17, lfo_am);
 
+			for (auto i : xrange(18)) {
+				out[i][j] = chanout[i];
+			}
+
+			advance();
+		}
 		for (auto i : xrange(18)) {
-			bufs[i][2 * j + 0] += int(chanout[i] & pan[4 * i + 0]);
-			bufs[i][2 * j + 1] += int(chanout[i] & pan[4 * i + 1]);
-			// unused c        += int(chanout[i] & pan[4 * i + 2]);
-			// unused d        += int(chanout[i] & pan[4 * i + 3]);
+			if (idle[i]) continue;
+			FMOutput::addStereo(&bufs[i][2 * start], out[i], n,
+			                    pan[4 * i + 0], pan[4 * i + 1]);
+			// unused c: pan[4 * i + 2]
+			// unused d: pan[4 * i + 3]
 		}
-
-		advance();
 	}
 }
 
 
-static constexpr std::initializer_list<enum_string<YMF262::EnvelopeState>> envelopeStateInfo = {
-	{ "ATTACK",  YMF262::EG_ATTACK  },
-	{ "DECAY",   YMF262::EG_DECAY   },
-	{ "SUSTAIN", YMF262::EG_SUSTAIN },
-	{ "RELEASE", YMF262::EG_RELEASE },
-	{ "OFF",     YMF262::EG_OFF     }
+static constexpr std::initializer_list<enum_string<YMF262Core::EnvelopeState>> envelopeStateInfo = {
+	{ "ATTACK",  YMF262Core::EG_ATTACK  },
+	{ "DECAY",   YMF262Core::EG_DECAY   },
+	{ "SUSTAIN", YMF262Core::EG_SUSTAIN },
+	{ "RELEASE", YMF262Core::EG_RELEASE },
+	{ "OFF",     YMF262Core::EG_OFF     }
 };
-SERIALIZE_ENUM(YMF262::EnvelopeState, envelopeStateInfo);
+SERIALIZE_ENUM(YMF262Core::EnvelopeState, envelopeStateInfo);
 
 template<typename Archive>
-void YMF262::Slot::serialize(Archive& a, unsigned /*version*/)
+void YMF262Core::Slot::serialize(Archive& a, unsigned /*version*/)
 {
 	// wavetable
 	auto waveform = unsigned((wavetable - sin.tab) / SIN_LEN);
@@ -1666,7 +1746,7 @@ void YMF262::Slot::serialize(Archive& a, unsigned /*version*/)
 }
 
 template<typename Archive>
-void YMF262::Channel::serialize(Archive& a, unsigned /*version*/)
+void YMF262Core::Channel::serialize(Archive& a, unsigned /*version*/)
 {
 	a.serialize("slots",      slot,
 	            "block_fnum", block_fnum,
@@ -1676,15 +1756,10 @@ void YMF262::Channel::serialize(Archive& a, unsigned /*version*/)
 	            "extended",   extended);
 }
 
-// version 1: initial version
-// version 2: added alreadySignaledNEW2
 template<typename Archive>
-void YMF262::serialize(Archive& a, unsigned version)
+void YMF262Core::serialize(Archive& a, unsigned /*version*/)
 {
-	a.serialize("timer1",  *timer1,
-	            "timer2",  *timer2,
-	            "irq",     irq,
-	            "chanout", chanout);
+	a.serialize("chanout", chanout);
 	a.serialize_blob("registers", reg, sizeof(reg));
 	a.serialize("channels",           channel,
 	            "eg_cnt",             eg_cnt,
@@ -1695,10 +1770,29 @@ void YMF262::serialize(Archive& a, unsigned version)
 	            "lfo_pm_depth_range", lfo_pm_depth_range,
 	            "rhythm",             rhythm,
 	            "nts",                nts,
-	            "OPL3_mode",          OPL3_mode,
-	            "status",             status,
-	            "status2",            status2,
-	            "statusMask",         statusMask);
+	            "OPL3_mode",          OPL3_mode);
+
+	// TODO restore more state by rewriting register values
+	//   this handles pan
+	for (auto i : xrange(0xC0, 0xC9)) {
+		writeReg(i + 0x000, reg[i + 0x000]);
+		writeReg(i + 0x100, reg[i + 0x100]);
+	}
+}
+INSTANTIATE_SERIALIZE_METHODS(YMF262Core);
+
+// version 1: initial version
+// version 2: added alreadySignaledNEW2
+template<typename Archive>
+void YMF262::serialize(Archive& a, unsigned version)
+{
+	a.serialize("timer1",  *timer1,
+	            "timer2",  *timer2,
+	            "irq",     irq);
+	core.serialize(a, version);
+	a.serialize("status",     status,
+	            "status2",    status2,
+	            "statusMask", statusMask);
 	if (a.versionAtLeast(version, 2)) {
 		a.serialize("alreadySignaledNEW2", alreadySignaledNEW2);
 	} else {
@@ -1706,14 +1800,6 @@ void YMF262::serialize(Archive& a, unsigned version)
 		alreadySignaledNEW2 = true; // we can't know the actual value,
 									// but 'true' is the safest value
 	}
-
-	// TODO restore more state by rewriting register values
-	//   this handles pan
-	EmuTime::param time = timer1->getCurrentTime();
-	for (auto i : xrange(0xC0, 0xC9)) {
-		writeRegDirect(i + 0x000, reg[i + 0x000], time);
-		writeRegDirect(i + 0x100, reg[i + 0x100], time);
-	}
 }
 
 INSTANTIATE_SERIALIZE_METHODS(YMF262);
@@ -16,23 +16,36 @@ namespace openmsx {
 
 class DeviceConfig;
 
-class YMF262 final : private ResampledSoundDevice, private EmuTimerCallback
+/** The sound generation part of the YMF262: the operators, the channels,
+  * the LFOs and the rhythm section. It doesn't contain the timers, the status
+  * register and the IRQ, and it doesn't depend on a motherboard, so it can
+  * also be used standalone (e.g. in unit tests).
+  */
+class YMF262Core
 {
 public:
-	YMF262(const std::string& name, const DeviceConfig& config,
-	       bool isYMF278);
-	~YMF262();
-
-	void reset(EmuTime::param time);
-	void writeReg   (unsigned r, byte v, EmuTime::param time);
-	void writeReg512(unsigned r, byte v, EmuTime::param time);
-	[[nodiscard]] byte readReg(unsigned reg);
-	[[nodiscard]] byte peekReg(unsigned reg) const;
-	[[nodiscard]] byte readStatus();
-	[[nodiscard]] byte peekStatus() const;
-
-	void setMixLevel(uint8_t x, EmuTime::param time);
-
+	YMF262Core();
+
+	/** Write zero to (most of) the registers and switch off all operators.
+	  */
+	void reset();
+
+	/** Write a register (0-511), with immediate effect. Registers that don't
+	  * influence the sound (e.g. the timers) are only stored.
+	  */
+	void writeReg(unsigned r, byte v);
+	[[nodiscard]] byte peekReg(unsigned r) const { return reg[r]; }
+	[[nodiscard]] bool isOPL3Mode() const { return OPL3_mode; }
+
+	/** Generate 'num' stereo samples for each of the 18 channels, like
+	  * SoundDevice::generateChannels().
+	  */
+	void generateChannels(float** bufs, unsigned num);
+	[[nodiscard]] bool isChannelIdle(unsigned channel) const;
+
+	/** This is serialized inline in YMF262, so 'version' is the version of
+	  * YMF262.
+	  */
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -51,6 +64,7 @@ private:
 	public:
 		Slot();
 		[[nodiscard]] inline int op_calc(unsigned phase, unsigned lfo_am) const;
+		[[nodiscard]] inline bool isIdle() const;
 		inline void FM_KEYON(byte key_set);
 		inline void FM_KEYOFF(byte key_clr);
 		inline void advanceEnvelopeGenerator(unsigned egCnt);
@@ -115,8 +129,9 @@ private:
 	class Channel {
 	public:
 		Channel();
-		void chan_calc(unsigned lfo_am);
-		void chan_calc_ext(unsigned lfo_am);
+		void chan_calc(unsigned lfo_am, int& phase_modulation, int& phase_modulation2);
+		void chan_calc_ext(unsigned lfo_am, int& phase_modulation, int& phase_modulation2);
+		inline void chan_calc_idle();
 
 		template<typename Archive>
 		void serialize(Archive& ar, unsigned version);
@@ -141,18 +156,8 @@ private:
 			       // channels, ie 0,1,2 and 9,10,11)
 	};
 
-	// SoundDevice
-	[[nodiscard]] float getAmplificationFactorImpl() const override;
-	void generateChannels(float** bufs, unsigned num) override;
-
-	void callback(byte flag) override;
-
-	void writeRegDirect(unsigned r, byte v, EmuTime::param time);
-	void init_tables();
-	void setStatus(byte flag);
-	void resetStatus(byte flag);
-	void changeStatusMask(byte flag);
 	void advance();
+	[[nodiscard]] inline bool slotsIdle(unsigned ch) const;
 
 	[[nodiscard]] inline int genPhaseHighHat();
 	[[nodiscard]] inline int genPhaseSnare();
@@ -163,12 +168,71 @@ private:
 	void set_ksl_tl(unsigned sl, byte v);
 	void set_ar_dr(unsigned sl, byte v);
 	void set_sl_rr(unsigned sl, byte v);
-	bool checkMuteHelper();
 
 	[[nodiscard]] inline bool isExtended(unsigned ch) const;
 	[[nodiscard]] inline Channel& getFirstOfPair(unsigned ch);
 	[[nodiscard]] inline Channel& getSecondOfPair(unsigned ch);
 
+private:
+	int chanout[18]; // 18 channels
+	int phase_modulation;  // phase modulation input (SLOT 2)
+	int phase_modulation2; // phase modulation input (SLOT 3
+	                       // in 4 operator channels)
+
+	byte reg[512];
+	Channel channel[18];	// OPL3 chips have 18 channels
+
+	unsigned pan[18 * 4];		// channels output masks 4 per channel
+	                                //    0xffffffff = enable
+	unsigned eg_cnt;		// global envelope generator counter
+	unsigned noise_rng;		// 23 bit noise shift register
+
+	// LFO
+	using LFOAMIndex = FixedPoint< 6>;
+	using LFOPMIndex = FixedPoint<10>;
+	LFOAMIndex lfo_am_cnt;
+	LFOPMIndex lfo_pm_cnt;
+	bool lfo_am_depth;
+	byte lfo_pm_depth_range;
+
+	byte rhythm;			// Rhythm mode
+	bool nts;			// NTS (note select)
+	bool OPL3_mode;			// OPL3 extension enable flag
+};
+
+class YMF262 final : private ResampledSoundDevice, private EmuTimerCallback
+{
+public:
+	YMF262(const std::string& name, const DeviceConfig& config,
+	       bool isYMF278);
+	~YMF262();
+
+	void reset(EmuTime::param time);
+	void writeReg   (unsigned r, byte v, EmuTime::param time);
+	void writeReg512(unsigned r, byte v, EmuTime::param time);
+	[[nodiscard]] byte readReg(unsigned reg);
+	[[nodiscard]] byte peekReg(unsigned reg) const;
+	[[nodiscard]] byte readStatus();
+	[[nodiscard]] byte peekStatus() const;
+
+	void setMixLevel(uint8_t x, EmuTime::param time);
+
+	template<typename Archive>
+	void serialize(Archive& ar, unsigned version);
+
+private:
+	// SoundDevice
+	[[nodiscard]] float getAmplificationFactorImpl() const override;
+	void generateChannels(float** bufs, unsigned num) override;
+	[[nodiscard]] bool isChannelIdle(unsigned channel) const override;
+
+	void callback(byte flag) override;
+
+	void writeRegDirect(unsigned r, byte v, EmuTime::param time);
+	void setStatus(byte flag);
+	void resetStatus(byte flag);
+	void changeStatusMask(byte flag);
+
 	struct Debuggable final : SimpleDebuggable {
 		Debuggable(MSXMotherBoard& motherBoard, const std::string& name);
 		[[nodiscard]] byte read(unsigned address) override;
@@ -191,27 +255,7 @@ private:
 
 	IRQHelper irq;
 
-	int chanout[18]; // 18 channels
-
-	byte reg[512];
-	Channel channel[18];	// OPL3 chips have 18 channels
-
-	unsigned pan[18 * 4];		// channels output masks 4 per channel
-	                                //    0xffffffff = enable
-	unsigned eg_cnt;		// global envelope generator counter
-	unsigned noise_rng;		// 23 bit noise shift register
-
-	// LFO
-	using LFOAMIndex = FixedPoint< 6>;
-	using LFOPMIndex = FixedPoint<10>;
-	LFOAMIndex lfo_am_cnt;
-	LFOPMIndex lfo_pm_cnt;
-	bool lfo_am_depth;
-	byte lfo_pm_depth_range;
-
-	byte rhythm;			// Rhythm mode
-	bool nts;			// NTS (note select)
-	bool OPL3_mode;			// OPL3 extension enable flag
+	YMF262Core core;
 
 	byte status;			// status flag
 	byte status2;
@@ -24,6 +24,13 @@ uint64_t getTime()
 	return now;
 }
 
+uint64_t getTimeNs()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(
+		steady_clock::now().time_since_epoch()).count();
+}
+
 void sleep(uint64_t us)
 {
 	std::this_thread::sleep_for(std::chrono::microseconds(us));
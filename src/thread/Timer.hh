@@ -9,6 +9,12 @@ namespace openmsx::Timer {
 	  */
 	[[nodiscard]] uint64_t getTime();
 
+	/** Get current (real) time in ns. Absolute value has no meaning.
+	  * Meant for measuring (short) durations, e.g. for profiling. Unlike
+	  * getTime() this can be called from any thread.
+	  */
+	[[nodiscard]] uint64_t getTimeNs();
+
 	/** Sleep for the specified amount of time (in us). It is possible
 	  * that this method sleeps longer or shorter than the requested time.
 	  */
@@ -0,0 +1,78 @@
+#include "WorkerPool.hh"
+#include "xrange.hh"
+#include <cassert>
+
+namespace openmsx {
+
+WorkerPool::WorkerPool(unsigned numWorkers)
+{
+	workers.reserve(numWorkers);
+	for ([[maybe_unused]] auto i : xrange(numWorkers)) {
+		workers.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard lock(mutex);
+		stop = true;
+	}
+	startCond.notify_all();
+	for (auto& t : workers) t.join();
+}
+
+void WorkerPool::runImpl(unsigned num, TaskFunc func, const void* data)
+{
+	if (workers.empty() || (num <= 1)) {
+		for (auto i : xrange(num)) func(data, i);
+		return;
+	}
+
+	{
+		std::lock_guard lock(mutex);
+		assert(busyWorkers == 0);
+		taskFunc = func;
+		taskData = data;
+		numTasks = num;
+		nextTask = 0;
+		busyWorkers = getNumWorkers();
+		++batch;
+	}
+	startCond.notify_all();
+
+	executeTasks();
+
+	std::unique_lock lock(mutex);
+	doneCond.wait(lock, [&] { return busyWorkers == 0; });
+}
+
+void WorkerPool::workerLoop()
+{
+	uint64_t lastBatch = 0;
+	while (true) {
+		{
+			std::unique_lock lock(mutex);
+			startCond.wait(lock, [&] { return stop || (batch != lastBatch); });
+			if (stop) return;
+			lastBatch = batch;
+		}
+		executeTasks();
+		{
+			std::lock_guard lock(mutex);
+			--busyWorkers;
+		}
+		doneCond.notify_one();
+	}
+}
+
+void WorkerPool::executeTasks()
+{
+	while (true) {
+		unsigned i = nextTask++;
+		if (i >= numTasks) break;
+		taskFunc(taskData, i);
+	}
+}
+
+} // namespace openmsx
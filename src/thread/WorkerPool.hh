@@ -0,0 +1,70 @@
+#ifndef WORKERPOOL_HH
+#define WORKERPOOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace openmsx {
+
+/** A fixed set of worker threads to execute a batch of independent tasks in
+  * parallel.
+  *
+  * The thread calling run() also executes tasks, and run() only returns when
+  * all tasks of the batch are finished. So a pool with N workers uses up to
+  * N+1 threads. All results written by the tasks are visible to the caller
+  * once run() returns.
+  */
+class WorkerPool
+{
+public:
+	explicit WorkerPool(unsigned numWorkers);
+	~WorkerPool();
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	[[nodiscard]] unsigned getNumWorkers() const { return unsigned(workers.size()); }
+
+	/** Call 'task(i)' for all 'i' in the range [0, num). The order (and
+	  * the thread) in which these calls happen is unspecified. The tasks
+	  * must not throw.
+	  * Must always be called from the same thread (not re-entrant).
+	  */
+	template<typename Task> void run(unsigned num, const Task& task)
+	{
+		runImpl(num, [](const void* t, unsigned i) {
+			(*static_cast<const Task*>(t))(i);
+		}, &task);
+	}
+
+private:
+	using TaskFunc = void (*)(const void*, unsigned);
+
+	void runImpl(unsigned num, TaskFunc func, const void* data);
+	void workerLoop();
+	void executeTasks();
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable startCond;
+	std::condition_variable doneCond;
+
+	// current batch, only changed (under lock) while no worker is busy
+	TaskFunc taskFunc = nullptr;
+	const void* taskData = nullptr;
+	unsigned numTasks = 0;
+	std::atomic<unsigned> nextTask = 0;
+
+	uint64_t batch = 0; // incremented for each new batch
+	unsigned busyWorkers = 0;
+	bool stop = false;
+};
+
+} // namespace openmsx
+
+#endif
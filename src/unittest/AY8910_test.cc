@@ -0,0 +1,172 @@
+#include "catch.hpp"
+#include "AY8910.hh"
+#include "DeltaBlock.hh"
+#include "DynamicClock.hh"
+#include "serialize.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// AY8910 doesn't apply register writes immediately, instead it logs them
+// and applies them while generating sound (see SoundRegisterLog). Check that
+// this gives exactly the same output as applying the writes directly, right
+// before the first sample after the write (that's what the traditional
+// updateStream()-before-each-write approach does). Also check that saving
+// and loading a savestate doesn't change the output, not even when there
+// are pending writes.
+
+namespace {
+
+constexpr unsigned FREQ = 223722; // like AY8910, but the value doesn't matter
+
+struct Write {
+	uint32_t sample; // write happens right before this sample
+	uint8_t reg;     // 0..13
+	uint8_t value;
+};
+
+// Random writes to all sound registers, with periods of PSG sample playback
+// (rapid writes to a volume register) in between.
+std::vector<Write> makeStream(unsigned seed, uint32_t samples)
+{
+	std::mt19937 rng(seed);
+	std::vector<Write> result;
+	uint32_t s = 100;
+	while (s < samples) {
+		if ((rng() % 8) == 0) {
+			// sample playback, sometimes several writes per sample
+			auto chan = uint8_t(8 + rng() % 3);
+			repeat(200 + rng() % 2000, [&] {
+				result.push_back({s, chan, uint8_t(rng() & 0x0f)});
+				s += rng() % 4;
+			});
+		} else {
+			auto reg = uint8_t(rng() % 14);
+			result.push_back({s, reg, uint8_t(rng())});
+			s += rng() % 500;
+		}
+	}
+	return result;
+}
+
+// Generate sound in blocks of random size. The block boundaries only depend
+// on 'seed', so both runs below use the same boundaries.
+template<typename Generate>
+std::vector<float> run(unsigned seed, uint32_t samples, Generate generate)
+{
+	std::vector<float> result(3 * samples, 0.0f);
+	std::mt19937 rng(seed);
+	uint32_t pos = 0;
+	while (pos < samples) {
+		auto num = std::min<uint32_t>(1 + rng() % 1500, samples - pos);
+		float* bufs[3];
+		for (auto chan : xrange(3)) bufs[chan] = &result[chan * samples + pos];
+		generate(bufs, pos, num);
+		pos += num;
+	}
+	return result;
+}
+
+// Apply the writes directly, split the blocks at the positions of the writes.
+std::vector<float> runDirect(unsigned seed, const std::vector<Write>& writes, uint32_t samples)
+{
+	AY8910Core core(true);
+	DynamicClock clock(EmuTime::zero(), FREQ); // no logged writes
+	auto it = writes.begin();
+	return run(seed, samples, [&](float** bufs, uint32_t start, uint32_t num) {
+		uint32_t end = start + num;
+		uint32_t pos = start;
+		while (pos < end) {
+			for (; (it != writes.end()) && (it->sample == pos); ++it) {
+				core.writeRegister(it->reg, it->value);
+			}
+			uint32_t next = (it != writes.end()) ? std::min(it->sample, end) : end;
+			float* frag[3];
+			for (auto chan : xrange(3)) frag[chan] = bufs[chan] + (pos - start);
+			core.generateChannels(frag, next - pos, clock);
+			pos = next;
+		}
+	});
+}
+
+// Replace 'core' with a copy that went through a (in-memory) savestate.
+void saveLoad(std::unique_ptr<AY8910Core>& core)
+{
+	LastDeltaBlocks lastDeltaBlocks;
+	std::vector<std::shared_ptr<DeltaBlock>> deltaBlocks;
+	MemOutputArchive out(lastDeltaBlocks, deltaBlocks, false);
+	out.serialize("psg", *core);
+	size_t size;
+	auto buf = out.releaseBuffer(size);
+
+	auto loaded = std::make_unique<AY8910Core>(true);
+	MemInputArchive in(buf.data(), size, deltaBlocks);
+	in.serialize("psg", *loaded);
+	core = std::move(loaded);
+}
+
+// Log the writes, each block also logs the writes of the start of the next
+// block (those must remain pending). Optionally save and load the state
+// after each block, returns the number of times a write to the envelope
+// shape register was pending at that moment.
+std::vector<float> runLogged(unsigned seed, const std::vector<Write>& writes, uint32_t samples,
+                             uint32_t lookAhead = 10, unsigned* pendingShapes = nullptr)
+{
+	auto core = std::make_unique<AY8910Core>(true);
+	DynamicClock clock(EmuTime::zero(), FREQ); // time of the sample before 'pos'
+	auto start = clock;
+	auto it = writes.begin();
+	return run(seed, samples, [&](float** bufs, uint32_t pos, uint32_t num) {
+		uint32_t end = pos + num + lookAhead;
+		for (; (it != writes.end()) && (it->sample < end); ++it) {
+			// at the time of the sample before, so right before 'sample'
+			core->logWrite(start + it->sample, it->reg, it->value);
+		}
+		core->generateChannels(bufs, num, clock);
+		clock += num;
+		if (pendingShapes) {
+			*pendingShapes += unsigned(std::count_if(writes.begin(), it, [&](const Write& w) {
+				return (w.sample >= pos + num) && (w.reg == 13);
+			}));
+			saveLoad(core);
+		}
+	});
+}
+
+} // namespace
+
+TEST_CASE("AY8910: logged register writes")
+{
+	constexpr uint32_t SAMPLES = 500'000;
+	for (auto seed : xrange(1u, 4u)) {
+		auto writes = makeStream(seed, SAMPLES);
+		auto out1 = runDirect(seed, writes, SAMPLES);
+		auto out2 = runLogged(seed, writes, SAMPLES);
+		auto diff = std::mismatch(out1.begin(), out1.end(), out2.begin()).first - out1.begin();
+		INFO("seed " << seed << ": first difference in channel " << (diff / SAMPLES)
+		     << " at sample " << (diff % SAMPLES));
+		CHECK(size_t(diff) == out1.size());
+	}
+}
+
+TEST_CASE("AY8910: savestate with pending register writes")
+{
+	constexpr uint32_t SAMPLES = 200'000;
+	for (auto seed : xrange(1u, 4u)) {
+		auto writes = makeStream(seed, SAMPLES);
+		// with a large look-ahead there are lots of pending writes
+		unsigned pendingShapes = 0;
+		auto out1 = runLogged(seed, writes, SAMPLES, 1000);
+		auto out2 = runLogged(seed, writes, SAMPLES, 1000, &pendingShapes);
+		CHECK(pendingShapes != 0);
+		auto diff = std::mismatch(out1.begin(), out1.end(), out2.begin()).first - out1.begin();
+		INFO("seed " << seed << ": first difference in channel " << (diff / SAMPLES)
+		     << " at sample " << (diff % SAMPLES));
+		CHECK(size_t(diff) == out1.size());
+	}
+}
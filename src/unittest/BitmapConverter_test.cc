@@ -0,0 +1,206 @@
+#include "catch.hpp"
+#include "BitmapConverter.hh"
+#include "build-info.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+
+// Compare the (possibly SIMD) BitmapConverter against a straightforward
+// implementation, for all bitmap display modes and both pixel types.
+
+// Benchmarks are not run by default, run them with:
+//   unittests "[benchmark]"
+
+namespace {
+
+struct Mode {
+	const char* name;
+	byte mode;
+};
+constexpr Mode modes[] = {
+	{"screen 5",  DisplayMode::GRAPHIC4},
+	{"screen 6",  DisplayMode::GRAPHIC5},
+	{"screen 7",  DisplayMode::GRAPHIC6},
+	{"screen 8",  DisplayMode::GRAPHIC7},
+	{"screen 11", DisplayMode::GRAPHIC7 | DisplayMode::YJK | DisplayMode::YAE},
+	{"screen 12", DisplayMode::GRAPHIC7 | DisplayMode::YJK},
+};
+
+// DisplayMode(byte) is private, so go via the VDP registers
+DisplayMode makeMode(byte m)
+{
+	return DisplayMode(byte((m & 0x1C) >> 1),                       // reg0: M5..M3
+	                   byte(((m & 0x02) << 2) | ((m & 0x01) << 4)), // reg1: M2, M1
+	                   byte((m & 0x60) >> 2));                      // reg25: YAE, YJK
+}
+
+template<typename Pixel> struct Palettes
+{
+	explicit Palettes(std::mt19937& rng)
+		: palette32768(32768)
+	{
+		for (auto& p : palette16)    p = Pixel(rng());
+		for (auto& p : palette256)   p = Pixel(rng());
+		for (auto& p : palette32768) p = Pixel(rng());
+	}
+
+	Pixel palette16[16 * 2];
+	Pixel palette256[256];
+	std::vector<Pixel> palette32768;
+};
+
+struct VRAM
+{
+	explicit VRAM(std::mt19937& rng)
+	{
+		for (auto& b : data) b = byte(rng());
+	}
+
+	// 4 lines, each (at most) 256 bytes, in planar modes the second
+	// half of a line is the second plane
+	byte data[4 * 256];
+};
+
+template<typename Pixel>
+void convert(BitmapConverter<Pixel>& converter, DisplayMode mode,
+             Pixel* out, const byte* vram)
+{
+	if (mode.isPlanar()) {
+		converter.convertLinePlanar(out, vram, vram + 128);
+	} else {
+		converter.convertLine(out, vram);
+	}
+}
+
+template<typename Pixel>
+void reference(const Palettes<Pixel>& pal, DisplayMode mode,
+               Pixel* out, const byte* vram)
+{
+	const byte* vram0 = vram;
+	const byte* vram1 = vram + 128;
+	auto yjk = [&](int y, int j, int k) {
+		int r = std::clamp(y + j,                       0, 31);
+		int g = std::clamp(y + k,                       0, 31);
+		int b = std::clamp((5 * y - 2 * j - k + 2) / 4, 0, 31);
+		return pal.palette32768[(r << 10) + (g << 5) + b];
+	};
+	for (auto i : xrange(128)) {
+		unsigned d0 = vram0[i];
+		unsigned d1 = vram1[i];
+		switch (mode.getByte()) {
+		case DisplayMode::GRAPHIC4:
+			out[2 * i + 0] = pal.palette16[d0 >> 4];
+			out[2 * i + 1] = pal.palette16[d0 & 15];
+			break;
+		case DisplayMode::GRAPHIC5:
+			out[4 * i + 0] = pal.palette16[ 0 + ((d0 >> 6) & 3)];
+			out[4 * i + 1] = pal.palette16[16 + ((d0 >> 4) & 3)];
+			out[4 * i + 2] = pal.palette16[ 0 + ((d0 >> 2) & 3)];
+			out[4 * i + 3] = pal.palette16[16 + ((d0 >> 0) & 3)];
+			break;
+		case DisplayMode::GRAPHIC6:
+			out[4 * i + 0] = pal.palette16[d0 >> 4];
+			out[4 * i + 1] = pal.palette16[d0 & 15];
+			out[4 * i + 2] = pal.palette16[d1 >> 4];
+			out[4 * i + 3] = pal.palette16[d1 & 15];
+			break;
+		case DisplayMode::GRAPHIC7:
+			out[2 * i + 0] = pal.palette256[d0];
+			out[2 * i + 1] = pal.palette256[d1];
+			break;
+		default: { // YJK or YAE, per group of 4 pixels
+			if (i & 1) break;
+			unsigned p[4] = {vram0[i], vram1[i], vram0[i + 1], vram1[i + 1]};
+			auto sext6 = [](unsigned v) { return int(v ^ 32) - 32; };
+			int k = sext6((p[0] & 7) | ((p[1] & 7) << 3));
+			int j = sext6((p[2] & 7) | ((p[3] & 7) << 3));
+			for (auto n : xrange(4)) {
+				bool yae = (mode.getByte() & DisplayMode::YAE) && (p[n] & 8);
+				out[2 * i + n] = yae ? pal.palette16[p[n] >> 4]
+				                     : yjk(int(p[n] >> 3), j, k);
+			}
+		}
+		}
+	}
+}
+
+template<typename Pixel>
+void testConverter()
+{
+	std::mt19937 rng(42);
+	Palettes<Pixel> pal(rng);
+	BitmapConverter<Pixel> converter(pal.palette16, pal.palette256, pal.palette32768.data());
+	for (const auto& m : modes) {
+		DisplayMode mode = makeMode(m.mode);
+		INFO(m.name << ", " << 8 * sizeof(Pixel) << "bpp");
+		REQUIRE(mode.getByte() == m.mode);
+		converter.setDisplayMode(mode);
+		unsigned width = mode.getLineWidth();
+		repeat(20, [&] {
+			VRAM vram(rng);
+			// also at an odd offset (possibly not aligned for SIMD)
+			for (auto offset : {0, 1}) {
+				std::vector<Pixel> expected(width);
+				std::vector<Pixel> actual(width + 1);
+				reference(pal, mode, expected.data(), vram.data);
+				convert(converter, mode, actual.data() + offset, vram.data);
+				CHECK(std::equal(expected.begin(), expected.end(),
+				                 actual.begin() + offset));
+			}
+		});
+		// a palette change must be picked up
+		pal.palette16[3] = Pixel(rng());
+		converter.palette16Changed();
+	}
+}
+
+template<typename Pixel>
+void benchConverter()
+{
+	std::mt19937 rng(42);
+	Palettes<Pixel> pal(rng);
+	BitmapConverter<Pixel> converter(pal.palette16, pal.palette256, pal.palette32768.data());
+	VRAM vram(rng);
+	std::vector<Pixel> out(512);
+	// each run converts 1M pixels, so 'mean' is the time per megapixel
+	for (const auto& m : modes) {
+		DisplayMode mode = makeMode(m.mode);
+		converter.setDisplayMode(mode);
+		unsigned lines = (1024 * 1024) / mode.getLineWidth();
+		std::string name = std::string(m.name) + ", " +
+		                   std::to_string(8 * sizeof(Pixel)) + "bpp";
+		BENCHMARK(name.c_str()) {
+			for (auto i : xrange(lines)) {
+				convert(converter, mode, out.data(), &vram.data[256 * (i & 3)]);
+			}
+			return out[0];
+		};
+	}
+}
+
+} // namespace
+
+TEST_CASE("BitmapConverter")
+{
+#if HAVE_16BPP
+	testConverter<uint16_t>();
+#endif
+#if HAVE_32BPP
+	testConverter<uint32_t>();
+#endif
+}
+
+TEST_CASE("BitmapConverter: benchmark", "[.][benchmark]")
+{
+#if HAVE_16BPP
+	benchConverter<uint16_t>();
+#endif
+#if HAVE_32BPP
+	benchConverter<uint32_t>();
+#endif
+}
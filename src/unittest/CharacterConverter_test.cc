@@ -0,0 +1,110 @@
+#include "catch.hpp"
+#include "CharacterConverter.hh"
+#include "build-info.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+
+// Compare the (possibly SIMD) pattern drawing routines of CharacterConverter
+// against a straightforward implementation, for all patterns and both pixel
+// types.
+
+// Benchmarks are not run by default, run them with:
+//   unittests "[benchmark]"
+
+namespace {
+
+template<typename Pixel>
+void reference(Pixel* out, Pixel fg, Pixel bg, byte pattern, unsigned width)
+{
+	for (auto i : xrange(width)) {
+		out[i] = (pattern & (0x80 >> i)) ? fg : bg;
+	}
+}
+
+template<typename Pixel, unsigned WIDTH>
+void draw(Pixel* __restrict & pixelPtr, Pixel fg, Pixel bg, byte pattern)
+{
+	if constexpr (WIDTH == 6) {
+		CharacterConverter<Pixel>::draw6(pixelPtr, fg, bg, pattern);
+	} else {
+		CharacterConverter<Pixel>::draw8(pixelPtr, fg, bg, pattern);
+	}
+}
+
+template<typename Pixel, unsigned WIDTH>
+void testDraw()
+{
+	std::mt19937 rng(42);
+	INFO("draw" << WIDTH << ", " << 8 * sizeof(Pixel) << "bpp");
+	for (auto pattern : xrange(256)) {
+		auto fg = Pixel(rng());
+		auto bg = Pixel(rng());
+		// also at an odd offset (possibly not aligned for SIMD)
+		for (auto offset : {0, 1}) {
+			// one extra pixel on both sides, these must not be touched
+			auto guard = Pixel(rng());
+			std::vector<Pixel> expected(WIDTH + 3, guard);
+			std::vector<Pixel> actual  (WIDTH + 3, guard);
+			reference(&expected[offset + 1], fg, bg, byte(pattern), WIDTH);
+
+			Pixel* __restrict ptr = &actual[offset + 1];
+			draw<Pixel, WIDTH>(ptr, fg, bg, byte(pattern));
+			CHECK(ptr == &actual[offset + 1 + WIDTH]);
+			CHECK(expected == actual);
+		}
+	}
+}
+
+template<typename Pixel, unsigned WIDTH>
+void benchDraw()
+{
+	std::mt19937 rng(42);
+	std::vector<byte> patterns(256);
+	for (auto& p : patterns) p = byte(rng());
+	std::vector<Pixel> out(WIDTH * 256);
+	auto fg = Pixel(rng());
+	auto bg = Pixel(rng());
+	// each run draws 1M pixels, so 'mean' is the time per megapixel
+	unsigned lines = (1024 * 1024) / (WIDTH * 256);
+	std::string name = "draw" + std::to_string(WIDTH) + ", " +
+	                   std::to_string(8 * sizeof(Pixel)) + "bpp";
+	BENCHMARK(name.c_str()) {
+		repeat(lines, [&] {
+			Pixel* __restrict ptr = out.data();
+			for (auto p : patterns) draw<Pixel, WIDTH>(ptr, fg, bg, p);
+		});
+		return out[0];
+	};
+}
+
+} // namespace
+
+TEST_CASE("CharacterConverter")
+{
+#if HAVE_16BPP
+	testDraw<uint16_t, 6>();
+	testDraw<uint16_t, 8>();
+#endif
+#if HAVE_32BPP
+	testDraw<uint32_t, 6>();
+	testDraw<uint32_t, 8>();
+#endif
+}
+
+TEST_CASE("CharacterConverter: benchmark", "[.][benchmark]")
+{
+#if HAVE_16BPP
+	benchDraw<uint16_t, 6>();
+	benchDraw<uint16_t, 8>();
+#endif
+#if HAVE_32BPP
+	benchDraw<uint32_t, 6>();
+	benchDraw<uint32_t, 8>();
+#endif
+}
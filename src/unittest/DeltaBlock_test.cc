@@ -0,0 +1,123 @@
+#include "catch.hpp"
+#include "DeltaBlock.hh"
+#include "DirtyPages.hh"
+#include "xrange.hh"
+#include <cstring>
+#include <random>
+
+using namespace openmsx;
+
+static void check(const DeltaBlock& block, const std::vector<uint8_t>& expected)
+{
+	std::vector<uint8_t> buf(expected.size());
+	block.apply(buf.data(), buf.size());
+	CHECK(buf == expected);
+}
+
+TEST_CASE("DeltaBlock: dirty pages")
+{
+	constexpr size_t SIZE = 10 * DirtyPages::PAGE_SIZE + 100; // partial last page
+	std::mt19937 gen(1234);
+	std::uniform_int_distribution<size_t> addrDist(0, SIZE - 1);
+	std::uniform_int_distribution<int> valDist(0, 255);
+
+	std::vector<uint8_t> data(SIZE);
+	for (auto& d : data) d = uint8_t(valDist(gen));
+	DirtyPages dirty(SIZE);
+
+	LastDeltaBlocks lastBlocks;
+	std::vector<std::shared_ptr<DeltaBlock>> blocks;
+	std::vector<std::vector<uint8_t>> snapshots;
+	auto snapshot = [&] {
+		blocks.push_back(lastBlocks.createNew(data.data(), data.data(), SIZE, dirty));
+		snapshots.push_back(data);
+		dirty.clearAll();
+	};
+	snapshot();
+
+	for (auto i : xrange(100)) {
+		// no writes -> must return the same block
+		if ((i % 10) == 0) {
+			auto prev = blocks.back();
+			snapshot();
+			CHECK(blocks.back() == prev);
+			continue;
+		}
+		// a few (clustered) writes, sometimes to adjacent pages
+		auto n = i % 7;
+		for (auto j : xrange(n)) {
+			auto addr = addrDist(gen);
+			for (auto k : xrange(j + 1)) {
+				auto a = std::min(addr + k, SIZE - 1);
+				data[a] = uint8_t(valDist(gen));
+				dirty.set(unsigned(a));
+			}
+		}
+		// writing the same value also marks the page dirty
+		if ((i % 5) == 0) dirty.set(unsigned(addrDist(gen)));
+		snapshot();
+	}
+
+	REQUIRE(blocks.size() == snapshots.size());
+	for (auto i : xrange(blocks.size())) {
+		check(*blocks[i], snapshots[i]);
+	}
+}
+
+TEST_CASE("DeltaBlock: dirty pages, first and last byte")
+{
+	constexpr size_t SIZE = 3 * DirtyPages::PAGE_SIZE;
+	std::vector<uint8_t> data(SIZE, 0);
+	DirtyPages dirty(SIZE);
+	LastDeltaBlocks lastBlocks;
+
+	auto b0 = lastBlocks.createNew(data.data(), data.data(), SIZE, dirty);
+	auto s0 = data;
+	dirty.clearAll();
+
+	data[0] = 1;        dirty.set(0);
+	data[SIZE - 1] = 2; dirty.set(SIZE - 1);
+	auto b1 = lastBlocks.createNew(data.data(), data.data(), SIZE, dirty);
+	auto s1 = data;
+	dirty.clearAll();
+
+	// page 0 changed back, but it must still be compared against the
+	// reference block
+	data[0] = 0;        dirty.set(0);
+	data[SIZE / 2] = 3; dirty.set(SIZE / 2);
+	auto b2 = lastBlocks.createNew(data.data(), data.data(), SIZE, dirty);
+	auto s2 = data;
+
+	check(*b0, s0);
+	check(*b1, s1);
+	check(*b2, s2);
+}
+
+TEST_CASE("DeltaBlock: background compression")
+{
+	// Big changes in each step, so that regularly a new reference block
+	// is created (and the old one is compressed in the background).
+	constexpr size_t SIZE = 16 * 1024;
+	std::mt19937 gen(4321);
+	std::uniform_int_distribution<int> valDist(0, 3); // compressible
+	std::vector<uint8_t> data(SIZE);
+
+	std::vector<std::shared_ptr<DeltaBlock>> blocks;
+	std::vector<std::vector<uint8_t>> snapshots;
+	{
+		LastDeltaBlocks lastBlocks;
+		for (auto i : xrange(50)) {
+			auto start = (i * 1000) % (SIZE - 8000);
+			for (auto j : xrange(8000)) {
+				data[start + j] = uint8_t(valDist(gen));
+			}
+			blocks.push_back(lastBlocks.createNew(data.data(), data.data(), SIZE));
+			snapshots.push_back(data);
+		}
+		lastBlocks.clear();
+	} // blocks outlive 'lastBlocks'
+
+	for (auto i : xrange(blocks.size())) {
+		check(*blocks[i], snapshots[i]);
+	}
+}
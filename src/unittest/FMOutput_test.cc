@@ -0,0 +1,196 @@
+#include "catch.hpp"
+#include "FMOutput.hh"
+#include "Y8950.hh"
+#include "YMF262.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// YMF262 and Y8950 calculate a block of samples for all channels and then add
+// that block per channel to the output buffers (with FMOutput). Check that
+// this gives bit-identical output to generating one sample at a time.
+
+// Benchmarks are not run by default, run them with:
+//   unittests "[benchmark]"
+
+namespace {
+
+using Output = std::vector<std::vector<float>>;
+
+template<typename Chip> struct Traits;
+template<> struct Traits<YMF262Core> {
+	static constexpr unsigned CHANNELS = 18;
+	static constexpr unsigned STEREO = 2;
+};
+template<> struct Traits<Y8950Core> {
+	static constexpr unsigned CHANNELS = 9 + 5;
+	static constexpr unsigned STEREO = 1;
+};
+
+// Key on all (melodic) channels with random instruments, or (when 'sustain'
+// is set) with instruments that keep on sounding at a constant level.
+void setup(YMF262Core& chip, std::mt19937& rng, bool rhythm, bool sustain)
+{
+	chip.writeReg(0x105, 0x01); // OPL3 mode
+	chip.writeReg(0x104, byte(rng() & 0x3F)); // some 4-operator channels
+	for (unsigned bank : {0x000, 0x100}) {
+		for (auto i : xrange(0x00, 0x16)) {
+			auto r = bank + i;
+			chip.writeReg(r + 0x20, sustain ? byte(0x20 | (rng() & 0xCF)) : byte(rng()));
+			chip.writeReg(r + 0x40, sustain ? byte(0x00) : byte(rng()));
+			chip.writeReg(r + 0x60, sustain ? byte(0xF0) : byte(rng()));
+			chip.writeReg(r + 0x80, sustain ? byte(0x00) : byte(rng()));
+			chip.writeReg(r + 0xE0, byte(rng()));
+		}
+		for (auto i : xrange(9)) {
+			auto r = bank + i;
+			chip.writeReg(r + 0xC0, sustain ? byte(0x30 | (rng() & 0xCF)) : byte(rng()));
+			chip.writeReg(r + 0xA0, byte(rng()));
+			chip.writeReg(r + 0xB0, byte(0x20 | (rng() & 0x1F))); // key on
+		}
+	}
+	chip.writeReg(0xBD, byte((rng() & 0xC0) | (rhythm ? 0x3F : 0x00)));
+}
+
+void setup(Y8950Core& chip, std::mt19937& rng, bool rhythm, bool sustain)
+{
+	for (auto i : xrange(0x00, 0x16)) {
+		chip.writeReg(i + 0x20, sustain ? byte(0x20 | (rng() & 0xCF)) : byte(rng()));
+		chip.writeReg(i + 0x40, sustain ? byte(0x00) : byte(rng()));
+		chip.writeReg(i + 0x60, sustain ? byte(0xF0) : byte(rng()));
+		chip.writeReg(i + 0x80, sustain ? byte(0x00) : byte(rng()));
+	}
+	for (auto i : xrange(9)) {
+		chip.writeReg(i + 0xC0, byte(rng()));
+		chip.writeReg(i + 0xA0, byte(rng()));
+		chip.writeReg(i + 0xB0, byte(0x20 | (rng() & 0x1F))); // key on
+	}
+	chip.writeReg(0xBD, byte((rng() & 0xC0) | (rhythm ? 0x3F : 0x00)));
+}
+
+// Key off some of the channels (they go to the release phase and eventually
+// become idle).
+template<typename Chip>
+void keyOff(Chip& chip)
+{
+	for (unsigned r : {0xB0, 0xB3, 0xB4, 0xB8}) {
+		chip.writeReg(r, chip.peekReg(r) & ~0x20);
+	}
+	chip.writeReg(0xBD, chip.peekReg(0xBD) & ~0x0F);
+}
+
+template<typename Chip>
+Output makeOutput(unsigned num)
+{
+	return Output(Traits<Chip>::CHANNELS,
+	              std::vector<float>(Traits<Chip>::STEREO * num));
+}
+
+// Add samples [start, start + num) to 'output'. Channels the chip reports as
+// idle (nullptr) don't change the (zero-initialized) output.
+template<typename Chip>
+void generate(Chip& chip, Output& output, unsigned start, unsigned num)
+{
+	float* bufs[Traits<Chip>::CHANNELS];
+	for (auto i : xrange(Traits<Chip>::CHANNELS)) {
+		bufs[i] = &output[i][Traits<Chip>::STEREO * start];
+	}
+	chip.generateChannels(bufs, num);
+}
+
+bool bitIdentical(const Output& x, const Output& y)
+{
+	if (x.size() != y.size()) return false;
+	for (auto i : xrange(x.size())) {
+		if (x[i].size() != y[i].size()) return false;
+		if (memcmp(x[i].data(), y[i].data(), x[i].size() * sizeof(float))) return false;
+	}
+	return true;
+}
+
+bool allZero(const Output& x)
+{
+	return std::all_of(x.begin(), x.end(), [](auto& buf) {
+		return std::all_of(buf.begin(), buf.end(), [](float f) { return f == 0.0f; });
+	});
+}
+
+template<typename Chip>
+void testBlocking(unsigned seed, bool rhythm)
+{
+	INFO("seed " << seed << (rhythm ? ", rhythm mode" : ""));
+	constexpr unsigned NUM = 3000;
+	constexpr unsigned KEY_OFF = 1000;
+
+	// One sample per call, so no blocking at all.
+	Chip chip1;
+	std::mt19937 rng1(seed);
+	setup(chip1, rng1, rhythm, false);
+	auto out1 = makeOutput<Chip>(NUM);
+	for (auto j : xrange(NUM)) {
+		if (j == KEY_OFF) keyOff(chip1);
+		generate(chip1, out1, j, 1);
+	}
+	CHECK(!allZero(out1));
+
+	// Random sized calls, mostly several blocks, not a multiple of the
+	// block size.
+	Chip chip2;
+	std::mt19937 rng2(seed);
+	setup(chip2, rng2, rhythm, false);
+	auto out2 = makeOutput<Chip>(NUM);
+	std::uniform_int_distribution<unsigned> size(1, 300);
+	unsigned j = 0;
+	while (j < NUM) {
+		unsigned end = std::min(j + size(rng2), (j < KEY_OFF) ? KEY_OFF : NUM);
+		generate(chip2, out2, j, end - j);
+		j = end;
+		if (j == KEY_OFF) keyOff(chip2);
+	}
+	CHECK(bitIdentical(out1, out2));
+}
+
+template<typename Chip>
+void benchChip(const char* name, bool rhythm)
+{
+	constexpr unsigned NUM = 2048;
+	Chip chip;
+	std::mt19937 rng(42);
+	setup(chip, rng, rhythm, true);
+	auto out = makeOutput<Chip>(NUM);
+	// 'mean' is the time to generate 2048 samples (about 40ms of sound)
+	BENCHMARK(name) {
+		generate(chip, out, 0, NUM);
+		return out[0][0];
+	};
+}
+
+} // namespace
+
+TEST_CASE("FMOutput: YMF262, bit-identical with and without blocking")
+{
+	for (auto seed : xrange(5)) {
+		testBlocking<YMF262Core>(seed, false);
+		testBlocking<YMF262Core>(seed, true);
+	}
+}
+
+TEST_CASE("FMOutput: Y8950, bit-identical with and without blocking")
+{
+	for (auto seed : xrange(5)) {
+		testBlocking<Y8950Core>(seed, false);
+		testBlocking<Y8950Core>(seed, true);
+	}
+}
+
+TEST_CASE("FMOutput: benchmark", "[.][benchmark]")
+{
+	benchChip<YMF262Core>("YMF262, 18 channels", false);
+	benchChip<YMF262Core>("YMF262, rhythm mode", true);
+	benchChip<Y8950Core>("Y8950, 9 channels", false);
+	benchChip<Y8950Core>("Y8950, rhythm mode", true);
+}
@@ -0,0 +1,124 @@
+#include "catch.hpp"
+#include "ResamplePoly.hh"
+#include "ResampleFilter.hh"
+#include "xrange.hh"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// Compare the polyphase filter bank against a direct evaluation of the
+// (continuous) low-pass filter, and check its frequency response, for some
+// typical resample ratios (input rate / output rate).
+
+namespace {
+
+constexpr double ratios[] = {
+	0.5,                       // upsampling
+	1.0,
+	49716.0 / 44100.0,         // YM2413
+	3579545.0 / 32 / 44100.0,  // PSG, SCC
+	3579545.0 / 16 / 48000.0,
+};
+
+// Straightforward implementation of the filter, in double precision.
+double reference(double ratio, double dist)
+{
+	double floatIncr = (ratio > 1.0) ? INDEX_INC / ratio : INDEX_INC;
+	double index = std::abs(dist) * floatIncr;
+	if (index >= COEFF_HALF_LEN) return 0.0;
+	int i = int(index);
+	double fraction = index - i;
+	return (double(coeffs[i]) + fraction * (double(coeffs[i + 1]) - double(coeffs[i])))
+	       * (floatIncr / INDEX_INC);
+}
+
+template<unsigned CHANNELS>
+void testReference(double ratio)
+{
+	INFO("ratio " << ratio << ", " << CHANNELS << " channel(s)");
+	PolyphaseFilter<CHANNELS> filter(ratio);
+	unsigned len = filter.getLength();
+	unsigned delay = filter.getDelay();
+	// all non-zero coefficients must fit in the filter length
+	for (auto frac : {0.0, 0.999}) {
+		CHECK(reference(ratio, -1.0 - delay - frac) == 0.0);
+		CHECK(reference(ratio, double(len) - delay - frac) == 0.0);
+	}
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+	std::uniform_real_distribution<double> position(0.0, 1.0);
+	std::vector<float> buf(len * CHANNELS);
+	repeat(1000, [&] {
+		for (auto& b : buf) b = sample(rng);
+		double frac = position(rng);
+		float out[CHANNELS];
+		filter.calcOutput(buf.data(), frac, out);
+		for (auto ch : xrange(CHANNELS)) {
+			double expected = 0.0;
+			for (auto j : xrange(len)) {
+				expected += double(buf[j * CHANNELS + ch]) *
+				            reference(ratio, double(j) - delay - frac);
+			}
+			CHECK(std::abs(double(out[ch]) - expected) < 5e-5);
+		}
+	});
+}
+
+// Resample a sine with the given frequency (in cycles per input sample) and
+// return the RMS of the difference with the ideal (delayed) output, scaled
+// with 'gain'.
+double resampleSine(const PolyphaseFilter<1>& filter, double ratio, double freq, double gain)
+{
+	constexpr unsigned OUT = 2000;
+	unsigned inLen = unsigned(OUT * ratio) + filter.getLength() + 2;
+	std::vector<float> input(inLen);
+	for (auto i : xrange(inLen)) {
+		input[i] = float(std::sin(2 * M_PI * freq * i));
+	}
+	double sumSq = 0.0;
+	for (auto i : xrange(OUT)) {
+		double pos = i * ratio + 0.123;
+		auto n = unsigned(pos);
+		float out;
+		filter.calcOutput(&input[n], pos - n, &out);
+		double expected = gain * std::sin(2 * M_PI * freq * (pos + filter.getDelay()));
+		double diff = double(out) - expected;
+		sumSq += diff * diff;
+	}
+	return std::sqrt(sumSq / OUT);
+}
+
+} // namespace
+
+TEST_CASE("ResamplePoly: compare with reference filter")
+{
+	for (auto ratio : ratios) {
+		testReference<1>(ratio);
+		testReference<2>(ratio);
+	}
+}
+
+TEST_CASE("ResamplePoly: frequency response")
+{
+	for (auto ratio : ratios) {
+		INFO("ratio " << ratio);
+		PolyphaseFilter<1> filter(ratio);
+		double nyquist = 0.5 / std::max(ratio, 1.0); // of the lowest rate
+		// passband: the output is (almost) the input, only delayed
+		for (auto f : {0.02, 0.1, 0.4}) {
+			INFO("passband frequency " << f);
+			CHECK(resampleSine(filter, ratio, f * nyquist, 1.0) < 5e-5);
+		}
+		// stopband (only when downsampling): the output is (almost) zero
+		if (ratio > 1.0) {
+			for (auto f : {1.2, 1.5, 1.9}) {
+				if (f * nyquist >= 0.5) continue;
+				INFO("stopband frequency " << f);
+				CHECK(resampleSine(filter, ratio, f * nyquist, 0.0) < 2e-5);
+			}
+		}
+	}
+}
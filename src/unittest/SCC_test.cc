@@ -0,0 +1,207 @@
+#include "catch.hpp"
+#include "SCC.hh"
+#include "SoundDevice.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// SCCCycleCache replays a precomputed period of a channel's output, but it
+// should still generate bit-identical output (and channel state) as the
+// straightforward per-sample loop. Check this by running both on the same
+// stream of register changes. Also check the (SIMD) addFill() and
+// addSamples() helpers against a plain loop.
+
+// Benchmarks are not run by default, run them with:
+//   unittests "[benchmark]"
+
+namespace {
+
+struct Channel {
+	float wave[32]; // volume adjusted, ints stored as floats
+	unsigned period2 = 1;
+	unsigned incr = 0;
+	unsigned count = 0;
+	unsigned pos = 0;
+	float out = 0.0f;
+};
+
+// The channel loop from before SCCCycleCache was introduced.
+void generateDirect(Channel& ch, float* buf, unsigned num)
+{
+	auto out2 = ch.out;
+	unsigned count2 = ch.count;
+	unsigned pos2 = ch.pos;
+	for (auto j : xrange(num)) {
+		buf[j] += out2;
+		count2 += ch.incr;
+		while (count2 >= ch.period2) {
+			count2 -= ch.period2;
+			pos2 = (pos2 + 1) % 32;
+			out2 = ch.wave[pos2];
+		}
+	}
+	ch.out = out2;
+	ch.count = count2;
+	ch.pos = pos2;
+}
+
+// Same as SCC::generateChannels() does for a disabled channel.
+void generateMuted(Channel& ch, unsigned num)
+{
+	unsigned newCount = ch.count + num * ch.incr;
+	ch.count = newCount % ch.period2;
+	ch.pos = (ch.pos + newCount / ch.period2) % 32;
+	ch.out = 0.0f;
+}
+
+float randomSample(std::mt19937& rng, unsigned volume)
+{
+	return float((int(rng() % 256) - 128) * int(volume) / 16);
+}
+
+// Mimics the register changes of SCC (see SCC::writeWave() and
+// SCC::setFreqVol()), applied to both the direct and the cached channel.
+struct Stream {
+	explicit Stream(unsigned seed) : rng(seed) {}
+
+	std::mt19937 rng;
+	unsigned volume = 15;
+
+	template<typename Apply>
+	void change(Apply apply) {
+		switch (rng() % 8) {
+		case 0: { // wave, doesn't change 'out'
+			auto p = rng() % 32;
+			auto s = randomSample(rng, volume);
+			apply([&](Channel& ch) { ch.wave[p] = s; });
+			break;
+		}
+		case 1: { // volume, doesn't change 'out' either
+			volume = rng() % 16;
+			float w[32];
+			for (auto& s : w) s = randomSample(rng, volume);
+			apply([&](Channel& ch) { std::copy_n(w, 32, ch.wave); });
+			break;
+		}
+		case 2: case 3: { // frequency, mostly low, sometimes tiny
+			unsigned per = (rng() % 4) ? rng() % 1000
+			             : (rng() % 2) ? rng() % 12 : rng() % 4096;
+			bool resetPos = (rng() % 4) == 0; // rotation mode
+			apply([&](Channel& ch) {
+				ch.period2 = per + 1;
+				ch.incr = (per <= 8) ? 0 : 32;
+				ch.count = 0;
+				if (resetPos) ch.pos = 0;
+				ch.out = ch.wave[ch.pos];
+			});
+			break;
+		}
+		default: // no change, give the cache a chance to be used
+			break;
+		}
+	}
+};
+
+} // namespace
+
+TEST_CASE("SCC: cycle cache identical to direct loop")
+{
+	for (auto seed : xrange(1u, 6u)) {
+		INFO("seed " << seed);
+		Stream stream(seed);
+		Channel direct, cached;
+		for (auto& s : direct.wave) s = randomSample(stream.rng, stream.volume);
+		std::copy_n(direct.wave, 32, cached.wave);
+		SCCCycleCache cache;
+
+		std::vector<float> buf1, buf2;
+		repeat(3000, [&] {
+			stream.change([&](auto f) {
+				f(direct);
+				f(cached);
+				cache.invalidate();
+			});
+			unsigned num = 1 + stream.rng() % ((stream.rng() % 4) ? 1500 : 20);
+			if ((stream.rng() % 16) == 0) {
+				generateMuted(direct, num);
+				generateMuted(cached, num);
+				cache.invalidate();
+				return;
+			}
+			// start from the same (non-zero) buffer content
+			buf1.resize(num);
+			for (auto& s : buf1) s = float(int(stream.rng() % 1000) - 500);
+			buf2 = buf1;
+			generateDirect(direct, buf1.data(), num);
+			cache.generate(buf2.data(), num, cached.wave, cached.period2,
+			               cached.incr, cached.count, cached.pos, cached.out);
+			REQUIRE(buf1 == buf2);
+			REQUIRE(direct.count == cached.count);
+			REQUIRE(direct.pos   == cached.pos);
+			REQUIRE(direct.out   == cached.out);
+		});
+	}
+}
+
+TEST_CASE("SCC: addFill and addSamples")
+{
+	std::mt19937 rng(42);
+	std::vector<float> samples(64);
+	for (auto& s : samples) s = float(int(rng() % 1000) - 500);
+	for (auto offset : xrange(4u)) {
+		for (auto num : xrange(1u, 40u)) {
+			INFO("offset " << offset << ", num " << num);
+			auto value = float(int(rng() % 1000) - 500);
+			std::vector<float> orig(64);
+			for (auto& s : orig) s = float(int(rng() % 1000) - 500);
+
+			auto expected = orig;
+			for (auto i : xrange(num)) expected[offset + i] += value;
+			auto actual = orig;
+			float* buf = &actual[offset];
+			SoundDevice::addFill(buf, value, num);
+			CHECK(buf == &actual[offset + num]);
+			CHECK(actual == expected);
+
+			expected = orig;
+			for (auto i : xrange(num)) expected[offset + i] += samples[i + 3];
+			actual = orig;
+			buf = &actual[offset];
+			SoundDevice::addSamples(buf, &samples[3], num);
+			CHECK(buf == &actual[offset + num]);
+			CHECK(actual == expected);
+		}
+	}
+}
+
+TEST_CASE("SCC: benchmark", "[.][benchmark]")
+{
+	// a stable tone, generated in fragments of (roughly) 1ms
+	constexpr unsigned NUM = 112;
+	std::mt19937 rng(1);
+	Channel init;
+	for (auto& s : init.wave) s = randomSample(rng, 15);
+	init.period2 = 254 + 1;
+	init.incr = 32;
+	init.out = init.wave[0];
+	std::vector<float> buf(NUM);
+
+	BENCHMARK("direct") {
+		Channel ch = init;
+		repeat(1000, [&] { generateDirect(ch, buf.data(), NUM); });
+		return buf[0];
+	};
+	BENCHMARK("cached") {
+		Channel ch = init;
+		SCCCycleCache cache;
+		repeat(1000, [&] {
+			cache.generate(buf.data(), NUM, ch.wave, ch.period2, ch.incr,
+			               ch.count, ch.pos, ch.out);
+		});
+		return buf[0];
+	};
+}
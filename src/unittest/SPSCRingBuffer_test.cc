@@ -0,0 +1,64 @@
+#include "catch.hpp"
+#include "SPSCRingBuffer.hh"
+#include "xrange.hh"
+#include <thread>
+#include <vector>
+
+using namespace openmsx;
+
+TEST_CASE("SPSCRingBuffer: single thread")
+{
+	SPSCRingBuffer<int> rb(6); // rounded up to 8
+	CHECK(rb.capacity() == 8);
+	CHECK(rb.size() == 0);
+	CHECK(rb.free() == 8);
+
+	int in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+	int out[10] = {};
+	CHECK(rb.write(in, 5) == 5);
+	CHECK(rb.size() == 5);
+	CHECK(rb.read(out, 3) == 3);
+	CHECK(out[0] == 0); CHECK(out[2] == 2);
+	CHECK(rb.size() == 2);
+
+	// wraps around, and only partially fits
+	CHECK(rb.write(in, 10) == 6);
+	CHECK(rb.size() == 8);
+	CHECK(rb.free() == 0);
+	CHECK(rb.write(in, 1) == 0);
+
+	CHECK(rb.read(out, 10) == 8);
+	int expected[8] = {3, 4, 0, 1, 2, 3, 4, 5};
+	for (auto i : xrange(8)) CHECK(out[i] == expected[i]);
+	CHECK(rb.size() == 0);
+	CHECK(rb.read(out, 1) == 0);
+
+	rb.write(in, 4);
+	rb.clear();
+	CHECK(rb.size() == 0);
+}
+
+TEST_CASE("SPSCRingBuffer: producer and consumer thread")
+{
+	constexpr unsigned TOTAL = 100000;
+	SPSCRingBuffer<unsigned> rb(64);
+	std::thread producer([&] {
+		unsigned next = 0;
+		unsigned chunk[7];
+		while (next < TOTAL) {
+			unsigned num = std::min(7u, TOTAL - next);
+			for (auto i : xrange(num)) chunk[i] = next + i;
+			next += unsigned(rb.write(chunk, num));
+		}
+	});
+	unsigned expected = 0;
+	bool ok = true;
+	unsigned chunk[5];
+	while (expected < TOTAL) {
+		auto num = rb.read(chunk, 5);
+		for (auto i : xrange(num)) ok &= (chunk[i] == expected++);
+	}
+	producer.join();
+	CHECK(ok);
+	CHECK(rb.size() == 0);
+}
@@ -0,0 +1,155 @@
+#include "catch.hpp"
+#include "SchedulerQueue.hh"
+#include "SyncPointHeap.hh"
+#include "xrange.hh"
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Micro-benchmark for the two Scheduler backends (SchedulerQueue and
+// SyncPointHeap, see Scheduler.hh). It first records a trace of sync point
+// operations from a simulated machine and then replays that trace on both.
+//
+// Benchmarks are not run by default, run them with:
+//   unittests "[benchmark]"
+
+using namespace openmsx;
+
+namespace {
+
+struct BenchDev {};
+
+struct BenchSP
+{
+	[[nodiscard]] uint64_t getTime() const { return time; }
+	[[nodiscard]] BenchDev* getDevice() const { return dev; }
+	uint64_t time = 0;
+	BenchDev* dev = nullptr;
+};
+
+struct TraceOp
+{
+	enum Type { INSERT, REMOVE_FRONT, REMOVE } type;
+	BenchSP sp;
+};
+
+constexpr uint64_t INF = std::numeric_limits<uint64_t>::max();
+
+// Simulate 'numDevs' devices. Most are periodic (like VDP line/frame
+// interrupts, sound chip timers, ...), some regularly cancel and re-program
+// their sync point (like a timer that gets re-written by the MSX software).
+std::vector<TraceOp> recordTrace(std::vector<BenchDev>& devs, unsigned numOps)
+{
+	std::vector<TraceOp> trace;
+	std::minstd_rand rng(42);
+	std::vector<uint64_t> periods;
+	for (auto i : xrange(devs.size())) {
+		(void)i;
+		periods.push_back(100 + rng() % 20000);
+	}
+
+	SchedulerQueue<BenchSP> queue;
+	auto insert = [&](const BenchSP& sp) {
+		trace.push_back({TraceOp::INSERT, sp});
+		queue.insert(sp, [](BenchSP& s) { s.time = INF; },
+		             [](const BenchSP& x, const BenchSP& y) { return x.time < y.time; });
+	};
+	for (auto i : xrange(devs.size())) {
+		insert({periods[i], &devs[i]});
+	}
+	while (trace.size() < numOps) {
+		auto sp = queue.front();
+		queue.remove_front();
+		trace.push_back({TraceOp::REMOVE_FRONT, sp});
+		auto i = sp.dev - devs.data();
+		insert({sp.time + periods[i], sp.dev});
+
+		if ((rng() % 4) == 0) {
+			auto& dev = devs[rng() % devs.size()];
+			if (queue.remove([&](const BenchSP& s) { return s.dev == &dev; })) {
+				trace.push_back({TraceOp::REMOVE, {0, &dev}});
+				insert({sp.time + 1 + rng() % 1000, &dev});
+			}
+		}
+	}
+	return trace;
+}
+
+uint64_t replay(SchedulerQueue<BenchSP>& queue, const std::vector<TraceOp>& trace)
+{
+	uint64_t sum = 0;
+	for (const auto& op : trace) {
+		switch (op.type) {
+		case TraceOp::INSERT:
+			queue.insert(op.sp, [](BenchSP& s) { s.time = INF; },
+			             [](const BenchSP& x, const BenchSP& y) { return x.time < y.time; });
+			break;
+		case TraceOp::REMOVE_FRONT:
+			sum += queue.front().time;
+			queue.remove_front();
+			break;
+		case TraceOp::REMOVE:
+			queue.remove([&](const BenchSP& s) { return s.dev == op.sp.dev; });
+			break;
+		}
+	}
+	return sum;
+}
+
+uint64_t replay(SyncPointHeap<BenchSP>& heap, const std::vector<TraceOp>& trace)
+{
+	uint64_t sum = 0;
+	for (const auto& op : trace) {
+		switch (op.type) {
+		case TraceOp::INSERT:
+			heap.insert(op.sp);
+			break;
+		case TraceOp::REMOVE_FRONT:
+			sum += heap.front().time;
+			heap.remove_front();
+			break;
+		case TraceOp::REMOVE:
+			heap.remove(*op.sp.dev);
+			break;
+		}
+	}
+	return sum;
+}
+
+void benchmarkTrace(unsigned numDevs)
+{
+	std::vector<BenchDev> devs(numDevs);
+	auto trace = recordTrace(devs, 100000);
+
+	// both must give the same result
+	SchedulerQueue<BenchSP> q;
+	SyncPointHeap<BenchSP> h(BenchSP{INF, nullptr});
+	REQUIRE(replay(q, trace) == replay(h, trace));
+
+	BENCHMARK("SchedulerQueue") {
+		SchedulerQueue<BenchSP> queue;
+		return replay(queue, trace);
+	};
+	BENCHMARK("SyncPointHeap") {
+		SyncPointHeap<BenchSP> heap(BenchSP{INF, nullptr});
+		return replay(heap, trace);
+	};
+}
+
+} // namespace
+
+TEST_CASE("Scheduler backends: 8 devices", "[.][benchmark]")
+{
+	benchmarkTrace(8);
+}
+
+TEST_CASE("Scheduler backends: 32 devices", "[.][benchmark]")
+{
+	benchmarkTrace(32);
+}
+
+TEST_CASE("Scheduler backends: 128 devices", "[.][benchmark]")
+{
+	benchmarkTrace(128);
+}
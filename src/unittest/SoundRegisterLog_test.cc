@@ -0,0 +1,58 @@
+#include "catch.hpp"
+#include "SoundRegisterLog.hh"
+#include <string>
+
+using namespace openmsx;
+
+static std::string render(SoundRegisterLog& log, const DynamicClock& clock, unsigned num)
+{
+	std::string result;
+	log.render(clock, num,
+		[&](unsigned offset, unsigned length) {
+			result += 'G' + std::to_string(offset) + ',' + std::to_string(length) + ' ';
+		},
+		[&](unsigned reg, byte value) {
+			result += 'W' + std::to_string(reg) + '=' + std::to_string(value) + ' ';
+		});
+	return result;
+}
+
+TEST_CASE("SoundRegisterLog")
+{
+	DynamicClock clock(EmuTime::zero(), 1000); // 1 sample per ms
+	auto ms = [](unsigned n) { return EmuTime::zero() + EmuDuration::msec(n); };
+	SoundRegisterLog log;
+
+	// empty log: single fragment
+	CHECK(log.empty());
+	CHECK(render(log, clock, 10) == "G0,10 ");
+	clock += 10;
+
+	// write at the time of a sample belongs to the next sample
+	log.push(ms(12), 1, 11);
+	// multiple writes at the same position
+	log.push(ms(15), 2, 22);
+	log.push(ms(15), 3, 33);
+	// write that belongs to the next block
+	log.push(ms(20), 4, 44);
+	CHECK(!log.empty());
+	CHECK(render(log, clock, 10) == "G0,2 W1=11 G2,3 W2=22 W3=33 G5,5 ");
+	CHECK(!log.empty());
+	clock += 10;
+
+	// write left over from the previous block is applied first
+	log.push(ms(21), 5, 55);
+	CHECK(render(log, clock, 4) == "W4=44 G0,1 W5=55 G1,3 ");
+	CHECK(log.empty());
+	clock += 4;
+
+	// write at the time of the previous sample
+	log.push(ms(24), 6, 66);
+	CHECK(render(log, clock, 2) == "W6=66 G0,2 ");
+	CHECK(log.empty());
+
+	// clear discards pending writes
+	log.push(ms(100), 7, 77);
+	log.clear();
+	CHECK(log.empty());
+}
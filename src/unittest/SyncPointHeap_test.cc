@@ -0,0 +1,118 @@
+#include "catch.hpp"
+#include "SyncPointHeap.hh"
+#include "SchedulerQueue.hh"
+#include "ranges.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+struct Dev {};
+
+struct TestSP
+{
+	[[nodiscard]] uint64_t getTime() const { return time; }
+	[[nodiscard]] Dev* getDevice() const { return dev; }
+	uint64_t time = 0;
+	Dev* dev = nullptr;
+	int id = 0; // to check the order of elements with equal time
+};
+
+static bool operator==(const TestSP& x, const TestSP& y)
+{
+	return (x.time == y.time) && (x.dev == y.dev) && (x.id == y.id);
+}
+
+static constexpr uint64_t INF = std::numeric_limits<uint64_t>::max();
+
+TEST_CASE("SyncPointHeap: basic")
+{
+	Dev d1, d2;
+	SyncPointHeap<TestSP> heap(TestSP{INF, nullptr, -1});
+	CHECK(heap.empty());
+	CHECK(heap.front().time == INF); // sentinel
+
+	heap.insert({20, &d1, 1});
+	heap.insert({10, &d2, 2});
+	heap.insert({20, &d2, 3}); // equal time: after id=1
+	heap.insert({30, &d1, 4});
+	REQUIRE(heap.size() == 4);
+	CHECK(heap.front().id == 2);
+
+	CHECK(heap.find(d1)->id == 1); // earliest of d1
+	CHECK(heap.find(d2)->id == 2);
+	auto all1 = heap.getAll(d1);
+	REQUIRE(all1.size() == 2);
+	CHECK(all1[0].id == 1);
+	CHECK(all1[1].id == 4);
+
+	CHECK(heap.remove(d2)); // removes id=2
+	CHECK(heap.front().id == 1);
+	heap.remove_front();
+	CHECK(heap.front().id == 3);
+
+	heap.remove_all(d1);
+	CHECK(heap.find(d1) == nullptr);
+	CHECK(!heap.remove(d1));
+	REQUIRE(heap.size() == 1);
+	heap.remove_front();
+	CHECK(heap.empty());
+	CHECK(heap.front().time == INF);
+}
+
+TEST_CASE("SyncPointHeap: compare with SchedulerQueue")
+{
+	// Apply the same random sequence of operations on both containers,
+	// they must behave identically (including the order of elements with
+	// equal time).
+	std::vector<Dev> devs(13);
+	SyncPointHeap<TestSP> heap(TestSP{INF, nullptr, -1});
+	SchedulerQueue<TestSP> queue;
+	auto setSentinel = [](TestSP& sp) { sp.time = INF; };
+	auto less = [](const TestSP& x, const TestSP& y) { return x.time < y.time; };
+	auto equalDev = [](Dev& d) { return [&](const TestSP& sp) { return sp.dev == &d; }; };
+
+	std::minstd_rand rng(12345);
+	uint64_t now = 0;
+	for (auto i : xrange(20000)) {
+		auto& dev = devs[rng() % devs.size()];
+		switch (rng() % 8) {
+		case 0: case 1: case 2: case 3: {
+			TestSP sp{now + rng() % 50, &dev, i};
+			heap.insert(sp);
+			queue.insert(sp, setSentinel, less);
+			break;
+		}
+		case 4: case 5:
+			REQUIRE(heap.empty() == queue.empty());
+			if (!queue.empty()) {
+				CHECK(heap.front() == queue.front());
+				now = queue.front().time;
+				heap.remove_front();
+				queue.remove_front();
+			}
+			break;
+		case 6:
+			CHECK(heap.remove(dev) == queue.remove(equalDev(dev)));
+			break;
+		case 7:
+			if ((rng() % 8) == 0) {
+				heap.remove_all(dev);
+				queue.remove_all(equalDev(dev));
+			} else {
+				auto* sp = heap.find(dev);
+				auto it = ranges::find_if(queue, equalDev(dev));
+				REQUIRE((sp == nullptr) == (it == queue.end()));
+				if (sp) CHECK(*sp == *it);
+			}
+			break;
+		}
+		REQUIRE(heap.size() == queue.size());
+	}
+	auto all = heap.getAll();
+	CHECK(std::equal(all.begin(), all.end(), queue.begin(), queue.end()));
+}
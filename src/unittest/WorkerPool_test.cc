@@ -0,0 +1,23 @@
+#include "catch.hpp"
+#include "WorkerPool.hh"
+#include "xrange.hh"
+#include <vector>
+
+using namespace openmsx;
+
+TEST_CASE("WorkerPool")
+{
+	for (unsigned numWorkers : {0, 1, 3}) {
+		WorkerPool pool(numWorkers);
+		CHECK(pool.getNumWorkers() == numWorkers);
+
+		// several batches, each task is executed exactly once
+		for (unsigned num : {0, 1, 2, 7, 100}) {
+			std::vector<int> result(num, 0);
+			pool.run(num, [&](unsigned i) { result[i] += int(i) + 1; });
+			for (auto i : xrange(num)) {
+				CHECK(result[i] == int(i) + 1);
+			}
+		}
+	}
+}
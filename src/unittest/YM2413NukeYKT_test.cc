@@ -0,0 +1,127 @@
+#include "catch.hpp"
+#include "YM2413NukeYKT.hh"
+#include "YM2413OriginalNukeYKT.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// YM2413NukeYKT is a heavily transformed version of the original NukeYKT
+// code, but it should still generate bit-identical output. Check this by
+// running both cores on the same stream of register writes.
+
+// Benchmarks are not run by default, run them with:
+//   unittests "[benchmark]"
+
+namespace {
+
+struct Write {
+	uint32_t sample; // write happens right before this sample
+	int offset;      // 0..17, see YM2413Core::writePort()
+	bool port;
+	uint8_t value;
+};
+
+// A stream of writes that (roughly) respects the YM2413 timing constraints.
+// It contains long idle periods (e.g. at the start and after the drums),
+// register setup without key-on, the rhythm section and random writes to
+// all registers (except test mode).
+std::vector<Write> makeStream(unsigned seed, uint32_t samples)
+{
+	std::mt19937 rng(seed);
+	std::vector<Write> result;
+	uint32_t s = 2000;
+	auto write = [&](uint8_t reg, uint8_t value) {
+		int offset = rng() % 12;
+		result.push_back({s, offset,     false, reg});
+		result.push_back({s, offset + 6, true,  value});
+		s += 2 + rng() % 100;
+	};
+
+	// user patch with vibrato, block/fnum/instrument, but no key-on
+	write(0x00, 0x61); write(0x01, 0x41); write(0x06, 0xf8); write(0x07, 0xf8);
+	for (auto ch : xrange(uint8_t(9))) {
+		write(0x10 + ch, uint8_t(rng()));
+		write(0x20 + ch, uint8_t(rng() & 0x2f));
+		write(0x30 + ch, uint8_t(rng()));
+	}
+	write(0x0e, 0x20);
+	s += 5000;
+
+	// drums (not bass drum, that also keys-on a modulator, and those never
+	// become silent again)
+	repeat(40, [&] { write(0x0e, uint8_t(0x20 | (rng() & 0x0f))); });
+	write(0x0e, 0x20);
+	s += 30000;
+	write(0x0e, 0x00);
+	s += 3000;
+
+	while (true) {
+		s += rng() % 200;
+		if (s >= samples) break;
+		auto value = uint8_t(rng());
+		switch (rng() % 8) {
+		case 0: write(uint8_t(rng() % 8), value); break; // user patch
+		case 1: write(0x0e, value & 0x3f); break;
+		case 2: case 3: write(uint8_t(0x10 + rng() % 9), value); break;
+		case 4: case 5: write(uint8_t(0x20 + rng() % 9), value); break;
+		default: write(uint8_t(0x30 + rng() % 9), value); break;
+		}
+	}
+	return result;
+}
+
+std::vector<float> run(YM2413Core& core, const std::vector<Write>& writes, uint32_t samples)
+{
+	std::vector<float> result(14 * samples, 0.0f);
+	auto it = writes.begin();
+	uint32_t pos = 0;
+	while (pos < samples) {
+		for (; (it != writes.end()) && (it->sample == pos); ++it) {
+			core.writePort(it->port, it->value, it->offset);
+		}
+		uint32_t next = (it != writes.end()) ? std::min(it->sample, samples) : samples;
+		float* out[9 + 5];
+		for (auto i : xrange(9 + 5)) out[i] = &result[i * samples + pos];
+		core.generateChannels(out, next - pos);
+		pos = next;
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("YM2413NukeYKT: identical to original")
+{
+	constexpr uint32_t SAMPLES = 100'000;
+	for (auto seed : xrange(1u, 4u)) {
+		auto writes = makeStream(seed, SAMPLES);
+		YM2413NukeYKT::YM2413 nuke;
+		YM2413OriginalNukeYKT::YM2413 original;
+		auto out1 = run(nuke,     writes, SAMPLES);
+		auto out2 = run(original, writes, SAMPLES);
+		auto diff = std::mismatch(out1.begin(), out1.end(), out2.begin()).first - out1.begin();
+		INFO("seed " << seed << ": first difference in channel " << (diff / SAMPLES)
+		     << " at sample " << (diff % SAMPLES));
+		CHECK(size_t(diff) == out1.size());
+	}
+}
+
+TEST_CASE("YM2413NukeYKT: benchmark", "[.][benchmark]")
+{
+	constexpr uint32_t SAMPLES = 50'000; // about 1 second
+	std::vector<Write> idle;
+	auto busy = makeStream(1, SAMPLES);
+
+	BENCHMARK("idle") {
+		YM2413NukeYKT::YM2413 nuke;
+		return run(nuke, idle, SAMPLES);
+	};
+	BENCHMARK("busy") {
+		YM2413NukeYKT::YM2413 nuke;
+		return run(nuke, busy, SAMPLES);
+	};
+}
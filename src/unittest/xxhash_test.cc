@@ -0,0 +1,33 @@
+#include "catch.hpp"
+#include "xxhash.hh"
+#include "xrange.hh"
+#include <random>
+#include <string>
+
+TEST_CASE("xxhash: incremental")
+{
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<int> charDist(0, 255);
+	std::uniform_int_distribution<size_t> pieceDist(0, 40);
+
+	for (auto len : xrange(200)) {
+		std::string input;
+		for (auto i : xrange(len)) { (void)i; input += char(charDist(gen)); }
+		auto expected = xxhash(input);
+
+		// all in one piece
+		XXHash32 h1;
+		h1.update(input.data(), input.size());
+		CHECK(h1.digest() == expected);
+
+		// in random sized pieces (including empty ones)
+		XXHash32 h2;
+		size_t pos = 0;
+		while (pos < input.size()) {
+			auto n = std::min(pieceDist(gen), input.size() - pos);
+			h2.update(input.data() + pos, n);
+			pos += n;
+		}
+		CHECK(h2.digest() == expected);
+	}
+}
@@ -1,9 +1,15 @@
 #include "DeltaBlock.hh"
+#include "DirtyPages.hh"
 #include "likely.hh"
 #include "ranges.hh"
 #include "lz4.hh"
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <tuple>
 #include <utility>
 #if STATISTICS
@@ -174,17 +180,42 @@ end:	return std::mismatch(p, p_end, q);
 
 // --- delta (de)compression routines ---
 
-// Calculate a 'delta' between two binary buffers of equal size.
-// The result is a stream of:
-//   n1 number of bytes are equal
-//   n2 number of bytes are different, and here are the bytes
-//   n3 number of bytes are equal
-//   ...
-[[nodiscard]] static std::vector<uint8_t> calcDelta(
-	const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
+// Helper to build a 'delta' stream (see calcDelta() below). Consecutive
+// calls to addEqual() are merged. addDiff() may not be called twice in a row
+// (there must be at least one equal byte in between).
+class DeltaWriter
 {
+public:
+	void addEqual(size_t n) { equal += n; }
+
+	void addDiff(const uint8_t* data, size_t n)
+	{
+		assert(n != 0);
+		assert(result.empty() || (equal != 0));
+		storeUleb(result, equal);
+		storeUleb(result, n);
+		result.insert(result.end(), data, data + n);
+		equal = 0;
+	}
+
+	[[nodiscard]] std::vector<uint8_t> finish()
+	{
+		// The initial number of equal bytes is always stored (possibly
+		// zero), the trailing number only when it's not zero.
+		if (result.empty() || (equal != 0)) storeUleb(result, equal);
+		result.shrink_to_fit();
+		return std::move(result);
+	}
+
+private:
 	std::vector<uint8_t> result;
+	size_t equal = 0;
+};
 
+// Compare two (equally sized) regions and append the result to 'writer'.
+static void calcDeltaRegion(DeltaWriter& writer,
+	const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
+{
 	const auto* p = oldBuf;
 	const auto* q = newBuf;
 	const auto* p_end = p + size;
@@ -193,8 +224,7 @@ end:	return std::mismatch(p, p_end, q);
 	// scan equal bytes (possibly zero)
 	const auto* q1 = q;
 	std::tie(p, q) = scan_mismatch(p, p_end, q, q_end);
-	auto n1 = q - q1;
-	storeUleb(result, n1);
+	writer.addEqual(q - q1);
 
 	while (q != q_end) {
 		assert(*p != *q);
@@ -209,14 +239,50 @@ end:	return std::mismatch(p, p_end, q);
 		auto n3 = q - q3;
 		if ((q != q_end) && (n3 <= 2)) goto different;
 
-		storeUleb(result, n2);
-		result.insert(result.end(), q2, q3);
-
-		if (n3 != 0) storeUleb(result, n3);
+		writer.addDiff(q2, n2);
+		writer.addEqual(n3);
 	}
+}
 
-	result.shrink_to_fit();
-	return result;
+// Calculate a 'delta' between two binary buffers of equal size.
+// The result is a stream of:
+//   n1 number of bytes are equal
+//   n2 number of bytes are different, and here are the bytes
+//   n3 number of bytes are equal
+//   ...
+[[nodiscard]] static std::vector<uint8_t> calcDelta(
+	const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
+{
+	DeltaWriter writer;
+	calcDeltaRegion(writer, oldBuf, newBuf, size);
+	return writer.finish();
+}
+
+// Same as above, but only compare the dirty pages. The result is in the same
+// format (the clean pages are stored as 'equal' bytes).
+[[nodiscard]] static std::vector<uint8_t> calcDelta(
+	const uint8_t* oldBuf, const uint8_t* newBuf, size_t size,
+	span<const uint8_t> dirtyPages)
+{
+	assert(dirtyPages.size() == ((size + DirtyPages::PAGE_SIZE - 1) >> DirtyPages::PAGE_BITS));
+	DeltaWriter writer;
+	size_t numPages = dirtyPages.size();
+	size_t page = 0;
+	while (page != numPages) {
+		// find a run of clean pages, followed by a run of dirty pages
+		auto begin = page;
+		while ((page != numPages) && !dirtyPages[page]) ++page;
+		auto mid = page;
+		while ((page != numPages) && dirtyPages[page]) ++page;
+
+		auto b = mid  << DirtyPages::PAGE_BITS;
+		auto e = std::min(page << DirtyPages::PAGE_BITS, size);
+		writer.addEqual(std::min(b, size) - (begin << DirtyPages::PAGE_BITS));
+		if (b < e) {
+			calcDeltaRegion(writer, oldBuf + b, newBuf + b, e - b);
+		}
+	}
+	return writer.finish();
 }
 
 // Apply a previously calculated 'delta' to 'oldBuf' to get 'newbuf'.
@@ -252,7 +318,8 @@ DeltaBlock::~DeltaBlock()
 // class DeltaBlockCopy
 
 DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size)
-	: block(size)
+	: DeltaBlock(size)
+	, block(size)
 	, compressedSize(0)
 {
 #ifdef DEBUG
@@ -280,26 +347,51 @@ void DeltaBlockCopy::apply(uint8_t* dst, size_t size) const
 #endif
 }
 
+size_t DeltaBlockCopy::getAllocSize() const
+{
+	return compressed() ? compressedSize : getSize();
+}
+
 void DeltaBlockCopy::compress(size_t size)
 {
 	if (compressed()) return;
+	setCompressed(calcCompressed(size), size);
+}
 
+DeltaBlockCopy::Compressed DeltaBlockCopy::calcCompressed(size_t size) const
+{
+	assert(!compressed());
+	Compressed result;
 	size_t dstLen = LZ4::compressBound(int(size));
-	MemBuffer<uint8_t> buf2(dstLen);
-	dstLen = LZ4::compress(block.data(), buf2.data(), int(size));
+	result.buf.resize(dstLen);
+	dstLen = LZ4::compress(block.data(), result.buf.data(), int(size));
 
 	if (dstLen >= size) {
 		// compression isn't beneficial
-		return;
+		return {};
 	}
-	compressedSize = dstLen;
-	block.swap(buf2);
-	block.resize(compressedSize); // shrink to fit
+	result.size = dstLen;
+	result.buf.resize(dstLen); // shrink to fit
+	return result;
+}
+
+void DeltaBlockCopy::setCompressed(Compressed&& c, size_t size)
+{
+	assert(!compressed());
+	if (c.size == 0) return;
+#ifdef DEBUG
+	MemBuffer<uint8_t> orig(size);
+	memcpy(orig.data(), block.data(), size);
+#else
+	(void)size;
+#endif
+	compressedSize = c.size;
+	block.swap(c.buf);
 	assert(compressed());
 #ifdef DEBUG
 	MemBuffer<uint8_t> buf3(size);
 	apply(buf3.data(), size);
-	assert(memcmp(buf3.data(), buf2.data(), size) == 0);
+	assert(memcmp(buf3.data(), orig.data(), size) == 0);
 #endif
 #if STATISTICS
 	int delta = compressedSize - allocSize;
@@ -322,7 +414,8 @@ const uint8_t* DeltaBlockCopy::getData()
 DeltaBlockDiff::DeltaBlockDiff(
 		std::shared_ptr<DeltaBlockCopy> prev_,
 		const uint8_t* data, size_t size)
-	: prev(std::move(prev_))
+	: DeltaBlock(size)
+	, prev(std::move(prev_))
 	, delta(calcDelta(prev->getData(), data, size))
 {
 #ifdef DEBUG
@@ -340,6 +433,29 @@ DeltaBlockDiff::DeltaBlockDiff(
 #endif
 }
 
+DeltaBlockDiff::DeltaBlockDiff(
+		std::shared_ptr<DeltaBlockCopy> prev_,
+		const uint8_t* data, size_t size,
+		span<const uint8_t> dirtyPages)
+	: DeltaBlock(size)
+	, prev(std::move(prev_))
+	, delta(calcDelta(prev->getData(), data, size, dirtyPages))
+{
+#ifdef DEBUG
+	sha1 = SHA1::calc({data, size});
+
+	MemBuffer<uint8_t> buf(size);
+	apply(buf.data(), size);
+	assert(memcmp(buf.data(), data, size) == 0);
+#endif
+#if STATISTICS
+	allocSize = delta.size();
+	globalAllocSize += allocSize;
+	std::cout << "stat: DeltaBlockDiff " << globalAllocSize
+	          << " (+" << allocSize << ")\n";
+#endif
+}
+
 void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 {
 	prev->apply(dst, size);
@@ -349,16 +465,133 @@ void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 #endif
 }
 
+size_t DeltaBlockDiff::getAllocSize() const
+{
+	return delta.size();
+}
+
 size_t DeltaBlockDiff::getDeltaSize() const
 {
 	return delta.size();
 }
 
 
+// class DeltaBlockCompressor
+
+// Compresses DeltaBlockCopy objects in a background thread. The actual
+// compression (the expensive part) happens in the worker thread, the result
+// is installed in the block from the main thread (in update()).
+class DeltaBlockCompressor
+{
+public:
+	DeltaBlockCompressor()
+	{
+		thread = std::thread([this]() { run(); });
+	}
+
+	~DeltaBlockCompressor()
+	{
+		{
+			std::lock_guard lock(mutex);
+			exitLoop = true;
+		}
+		cond.notify_one();
+		thread.join();
+		// The blocks can outlive this object (e.g. after a history
+		// transfer), so don't throw away the finished work.
+		update();
+	}
+
+	// Returns false if the queue is full, then the caller should compress
+	// the block itself.
+	[[nodiscard]] bool add(std::shared_ptr<DeltaBlockCopy> block, size_t size)
+	{
+		{
+			std::lock_guard lock(mutex);
+			if ((todo.size() + busy) >= MAX_PENDING) return false;
+			todo.push_back(Job{std::move(block), size, {}});
+		}
+		cond.notify_one();
+		return true;
+	}
+
+	// Install the results of the finished jobs.
+	void update()
+	{
+		std::vector<Job> finished;
+		{
+			std::lock_guard lock(mutex);
+			swap(finished, done);
+		}
+		for (auto& job : finished) {
+			job.block->setCompressed(std::move(job.result), job.size);
+		}
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock lock(mutex);
+		while (true) {
+			cond.wait(lock, [&] { return exitLoop || !todo.empty(); });
+			if (todo.empty()) return; // only exit when all work is done
+
+			Job job = std::move(todo.front());
+			todo.pop_front();
+			++busy;
+			lock.unlock();
+			job.result = job.block->calcCompressed(job.size);
+			lock.lock();
+			--busy;
+			done.push_back(std::move(job));
+		}
+	}
+
+private:
+	// Limit the amount of (uncompressed) memory that can be waiting.
+	static constexpr size_t MAX_PENDING = 16;
+
+	struct Job {
+		std::shared_ptr<DeltaBlockCopy> block;
+		size_t size;
+		DeltaBlockCopy::Compressed result;
+	};
+
+	std::mutex mutex; // protects all members below
+	std::condition_variable cond;
+	std::deque<Job> todo;
+	std::vector<Job> done;
+	size_t busy = 0;
+	bool exitLoop = false;
+	std::thread thread;
+};
+
+
 // class LastDeltaBlocks
 
-std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
-		const void* id, const uint8_t* data, size_t size)
+LastDeltaBlocks::LastDeltaBlocks() = default;
+LastDeltaBlocks::~LastDeltaBlocks() = default;
+
+void LastDeltaBlocks::compress(std::shared_ptr<DeltaBlockCopy> block, size_t size)
+{
+	if (!compressor) {
+		compressor = std::make_unique<DeltaBlockCompressor>();
+	} else {
+		compressor->update();
+	}
+	if (!compressor->add(block, size)) {
+		block->compress(size);
+	}
+}
+
+void LastDeltaBlocks::installCompressed()
+{
+	if (compressor) compressor->update();
+}
+
+
+std::vector<LastDeltaBlocks::Info>::iterator LastDeltaBlocks::getInfo(
+		const void* id, size_t size)
 {
 	auto it = ranges::lower_bound(infos, std::tuple(id, size), {},
 		[](const Info& info) { return std::tuple(info.id, info.size); });
@@ -368,13 +601,20 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 	}
 	assert(it->id   == id);
 	assert(it->size == size);
+	return it;
+}
+
+std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
+		const void* id, const uint8_t* data, size_t size)
+{
+	auto it = getInfo(id, size);
 
 	auto ref = it->ref.lock();
 	if (it->accSize >= size || !ref) {
 		if (ref) {
 			// We will switch to a new DeltaBlockCopy object. So
 			// now is a good time to compress the old one.
-			ref->compress(size);
+			compress(std::move(ref), size);
 		}
 		// Heuristic: create a new block when too many small
 		// differences have accumulated.
@@ -382,6 +622,7 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
+		it->accDirty.clear();
 		return b;
 	} else {
 		// Create diff based on earlier reference block.
@@ -393,6 +634,45 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 	}
 }
 
+std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
+		const void* id, const uint8_t* data, size_t size,
+		const DirtyPages& dirty)
+{
+	if (!dirty.any()) return createNullDiff(id, data, size);
+
+	auto it = getInfo(id, size);
+	auto flags = dirty.getFlags();
+
+	auto ref = it->ref.lock();
+	if (it->accSize >= size || !ref) {
+		if (ref) compress(std::move(ref), size);
+		auto b = std::make_shared<DeltaBlockCopy>(data, size);
+		it->ref = b;
+		it->last = b;
+		it->accSize = 0;
+		it->accDirty.assign(flags.size(), 0);
+		return b;
+	} else if (it->accDirty.empty()) {
+		// Unknown which pages changed since 'ref', compare all.
+		auto b = std::make_shared<DeltaBlockDiff>(ref, data, size);
+		it->last = b;
+		it->accSize += b->getDeltaSize();
+		return b;
+	} else {
+		// The diff is relative to 'ref' (not to 'last'), so we need
+		// all pages that changed since 'ref' was created.
+		assert(it->accDirty.size() == flags.size());
+		for (size_t i = 0; i < flags.size(); ++i) {
+			it->accDirty[i] |= flags[i];
+		}
+		auto b = std::make_shared<DeltaBlockDiff>(
+			ref, data, size, it->accDirty);
+		it->last = b;
+		it->accSize += b->getDeltaSize();
+		return b;
+	}
+}
+
 std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 		const void* id, const uint8_t* data, size_t size)
 {
@@ -409,6 +689,7 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
+		it->accDirty.clear();
 		return b;
 	} else {
 #ifdef DEBUG
@@ -422,7 +703,7 @@ void LastDeltaBlocks::clear()
 {
 	for (const Info& info : infos) {
 		if (auto ref = info.ref.lock()) {
-			ref->compress(info.size);
+			compress(std::move(ref), info.size);
 		}
 	}
 	infos.clear();
@@ -4,6 +4,7 @@
 #define STATISTICS 0
 
 #include "MemBuffer.hh"
+#include "span.hh"
 #include <cstdint>
 #include <memory>
 #include <vector>
@@ -23,8 +24,18 @@ public:
 #endif
 	virtual void apply(uint8_t* dst, size_t size) const = 0;
 
+	// Size of the (uncompressed) data block.
+	[[nodiscard]] size_t getSize() const { return blockSize; }
+
+	// Amount of memory used by this object (not including blocks it
+	// refers to).
+	[[nodiscard]] virtual size_t getAllocSize() const = 0;
+
 protected:
-	DeltaBlock() = default;
+	explicit DeltaBlock(size_t size) : blockSize(size) {}
+
+private:
+	const size_t blockSize;
 
 #ifdef DEBUG
 public:
@@ -44,9 +55,21 @@ class DeltaBlockCopy final : public DeltaBlock
 public:
 	DeltaBlockCopy(const uint8_t* data, size_t size);
 	void apply(uint8_t* dst, size_t size) const override;
+	[[nodiscard]] size_t getAllocSize() const override;
 	void compress(size_t size);
 	[[nodiscard]] const uint8_t* getData();
 
+	// compress() split in two parts: calcCompressed() only reads the
+	// (uncompressed) block, so it can run in a different thread (also
+	// concurrently with apply()). setCompressed() actually replaces the
+	// block, this must happen in the main thread.
+	struct Compressed {
+		MemBuffer<uint8_t> buf;
+		size_t size = 0; // 0 if compression isn't beneficial
+	};
+	[[nodiscard]] Compressed calcCompressed(size_t size) const;
+	void setCompressed(Compressed&& c, size_t size);
+
 private:
 	[[nodiscard]] bool compressed() const { return compressedSize != 0; }
 
@@ -60,8 +83,16 @@ class DeltaBlockDiff final : public DeltaBlock
 public:
 	DeltaBlockDiff(std::shared_ptr<DeltaBlockCopy> prev_,
 	               const uint8_t* data, size_t size);
+	// Only compare the pages that are marked in 'dirtyPages' (see
+	// DirtyPages), the other pages must be equal to those in 'prev_'.
+	DeltaBlockDiff(std::shared_ptr<DeltaBlockCopy> prev_,
+	               const uint8_t* data, size_t size,
+	               span<const uint8_t> dirtyPages);
 	void apply(uint8_t* dst, size_t size) const override;
+	[[nodiscard]] size_t getAllocSize() const override;
 	[[nodiscard]] size_t getDeltaSize() const;
+	[[nodiscard]] const DeltaBlockCopy& getPrev() const { return *prev; }
+	[[nodiscard]] bool isPrevShared() const { return prev.use_count() > 1; }
 
 private:
 	const std::shared_ptr<DeltaBlockCopy> prev;
@@ -69,15 +100,30 @@ private:
 };
 
 
+class DirtyPages;
+class DeltaBlockCompressor;
+
 class LastDeltaBlocks
 {
 public:
+	LastDeltaBlocks();
+	~LastDeltaBlocks();
+
 	[[nodiscard]] std::shared_ptr<DeltaBlock> createNew(
 		const void* id, const uint8_t* data, size_t size);
+	// Like above, but only the pages that are marked in 'dirty' can have
+	// changed since the previous call (for the same 'id').
+	[[nodiscard]] std::shared_ptr<DeltaBlock> createNew(
+		const void* id, const uint8_t* data, size_t size,
+		const DirtyPages& dirty);
 	[[nodiscard]] std::shared_ptr<DeltaBlock> createNullDiff(
 		const void* id, const uint8_t* data, size_t size);
 	void clear();
 
+	// Replace the blocks that finished compressing in the background by
+	// their compressed version (until then both versions are in memory).
+	void installCompressed();
+
 private:
 	struct Info {
 		Info(const void* id_, size_t size_)
@@ -88,9 +134,19 @@ private:
 		std::weak_ptr<DeltaBlockCopy> ref;
 		std::weak_ptr<DeltaBlock> last;
 		size_t accSize;
+		// Pages that (possibly) changed since 'ref' was created. Empty
+		// when unknown (then all pages must be compared).
+		std::vector<uint8_t> accDirty;
 	};
 
+	[[nodiscard]] std::vector<Info>::iterator getInfo(
+		const void* id, size_t size);
+	void compress(std::shared_ptr<DeltaBlockCopy> block, size_t size);
+
 	std::vector<Info> infos;
+	// Compresses reference blocks that are no longer the most recent one
+	// in a background thread. Created on first use.
+	std::unique_ptr<DeltaBlockCompressor> compressor;
 };
 
 } // namespace openmsx
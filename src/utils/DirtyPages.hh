@@ -0,0 +1,56 @@
+#ifndef DIRTY_PAGES_HH
+#define DIRTY_PAGES_HH
+
+#include "span.hh"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace openmsx {
+
+// Keeps track of which (fixed size) pages of a memory block were written
+// since the last call to clearAll().
+//
+// This is used to speed up taking reverse snapshots: for big blocks (e.g.
+// VRAM) typically only a small part changes between two snapshots. When the
+// dirty pages are passed to serialize_blob(), the delta calculation (see
+// DeltaBlock) only needs to compare those pages instead of the whole block.
+class DirtyPages
+{
+public:
+	static constexpr unsigned PAGE_BITS = 8;
+	static constexpr unsigned PAGE_SIZE = 1 << PAGE_BITS;
+
+	// Initially all pages are dirty.
+	explicit DirtyPages(size_t size)
+		: flags((size + PAGE_SIZE - 1) >> PAGE_BITS, 1) {}
+
+	void set(unsigned addr) {
+		flags[addr >> PAGE_BITS] = 1;
+		anyDirty = true;
+	}
+
+	void setAll() {
+		std::fill(flags.begin(), flags.end(), 1);
+		anyDirty = true;
+	}
+
+	void clearAll() {
+		std::fill(flags.begin(), flags.end(), 0);
+		anyDirty = false;
+	}
+
+	// Is at least one page dirty?
+	[[nodiscard]] bool any() const { return anyDirty; }
+
+	// One entry per page, non-zero means dirty.
+	[[nodiscard]] span<const uint8_t> getFlags() const { return flags; }
+
+private:
+	std::vector<uint8_t> flags;
+	bool anyDirty = true;
+};
+
+} // namespace openmsx
+
+#endif
@@ -30,6 +30,8 @@ template<typename E> std::ostream& operator<<(std::ostream& os, EnumValueName<E>
 // A collection of (simple) profile counters:
 // - Counters start at zero.
 // - An individual counter can be incremented by 1 via 'tick(<counter-id>)'.
+// - The current value can be queried via 'getCount(<counter-id>)' and all
+//   counters can be set back to zero via 'resetCounters()'.
 // - When this 'ProfileCounters' object is destoyed it prints the value of each
 //   counter.
 //
@@ -99,6 +101,14 @@ public:
 		++counters[size_t(e)];
 	}
 
+	[[nodiscard]] unsigned getCount(ENUM e) const {
+		return counters[size_t(e)];
+	}
+
+	void resetCounters() {
+		for (auto& c : counters) c = 0;
+	}
+
 private:
 	static constexpr auto NUM = size_t(ENUM::NUM); // value 'ENUM::NUM' must exist
 	mutable unsigned counters[NUM] = {};
@@ -112,6 +122,8 @@ class ProfileCounters<false, ENUM>
 {
 public:
 	void tick(ENUM) const { /*nothing*/ }
+	[[nodiscard]] unsigned getCount(ENUM) const { return 0; }
+	void resetCounters() { /*nothing*/ }
 };
 
 #endif
@@ -0,0 +1,103 @@
+#ifndef SPSCRINGBUFFER_HH
+#define SPSCRINGBUFFER_HH
+
+#include "MemBuffer.hh"
+#include "Math.hh"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace openmsx {
+
+/** Lock-free ring buffer for exactly one producer and one consumer thread.
+  *
+  * write() may only be called from the producer thread, read() only from
+  * the consumer thread. size() and free() can be called from both threads,
+  * but the result is only a snapshot: from the producer's point of view
+  * the actual size can only have become smaller (and free() larger) by the
+  * time the result is used, and vice versa for the consumer.
+  *
+  * The capacity is rounded up to a power of two. The read and write
+  * positions are free running counters, so a completely full buffer can be
+  * distinguished from an empty one.
+  */
+template<typename T>
+class SPSCRingBuffer
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+	explicit SPSCRingBuffer(size_t capacity = 1) {
+		resize(capacity);
+	}
+
+	[[nodiscard]] size_t capacity() const { return mask + 1; }
+
+	[[nodiscard]] size_t size() const {
+		return writePos.load(std::memory_order_acquire) -
+		       readPos .load(std::memory_order_acquire);
+	}
+	[[nodiscard]] size_t free() const { return capacity() - size(); }
+
+	/** Append (a prefix of) the given elements. Producer thread only.
+	  * @return The number of elements that were written, this is
+	  *         'num' unless there's not enough free space.
+	  */
+	size_t write(const T* data, size_t num) {
+		size_t w = writePos.load(std::memory_order_relaxed);
+		size_t r = readPos .load(std::memory_order_acquire);
+		num = std::min(num, capacity() - (w - r));
+		size_t idx = w & mask;
+		size_t len1 = std::min(num, capacity() - idx);
+		memcpy(&buf[idx], data, len1 * sizeof(T));
+		memcpy(&buf[0], data + len1, (num - len1) * sizeof(T));
+		writePos.store(w + num, std::memory_order_release);
+		return num;
+	}
+
+	/** Remove (up to) 'num' elements from the front. Consumer thread only.
+	  * @return The number of elements that were read, this is 'num'
+	  *         unless the buffer didn't contain that many elements.
+	  */
+	size_t read(T* data, size_t num) {
+		size_t r = readPos .load(std::memory_order_relaxed);
+		size_t w = writePos.load(std::memory_order_acquire);
+		num = std::min(num, w - r);
+		size_t idx = r & mask;
+		size_t len1 = std::min(num, capacity() - idx);
+		memcpy(data, &buf[idx], len1 * sizeof(T));
+		memcpy(data + len1, &buf[0], (num - len1) * sizeof(T));
+		readPos.store(r + num, std::memory_order_release);
+		return num;
+	}
+
+	/** Discard all content. Only allowed while neither the producer nor
+	  * the consumer is accessing the buffer.
+	  */
+	void clear() {
+		readPos .store(0, std::memory_order_relaxed);
+		writePos.store(0, std::memory_order_relaxed);
+	}
+
+	/** Change the capacity, this also discards all content. Same
+	  * restrictions as for clear().
+	  */
+	void resize(size_t capacity) {
+		capacity = Math::ceil2(capacity);
+		buf.resize(capacity);
+		mask = capacity - 1;
+		clear();
+	}
+
+private:
+	MemBuffer<T> buf;
+	size_t mask;
+	// on different cache lines, each is mostly written by one thread
+	alignas(64) std::atomic<size_t> writePos = 0;
+	alignas(64) std::atomic<size_t> readPos = 0;
+};
+
+} // namespace openmsx
+
+#endif
@@ -145,6 +145,83 @@ template<uint8_t MASK8> [[nodiscard]] inline uint32_t xxhash_impl(std::string_vi
 	return xxhash_impl<static_cast<uint8_t>(~('a' - 'A'))>(key);
 }
 
+// Incremental variant of xxhash(): the input can be passed in several pieces
+// (e.g. while it is being produced), the result is the same as xxhash() on
+// the concatenation of all pieces. Small pieces are cheap: they are only
+// buffered until a full block of 16 bytes is available.
+class XXHash32
+{
+public:
+	void update(const void* data, size_t size)
+	{
+		const auto* p = static_cast<const uint8_t*>(data);
+		const uint8_t* const bEnd = p + size;
+		totalLen += size;
+
+		if ((memSize + size) < 16) {
+			if (size) memcpy(mem + memSize, p, size);
+			memSize += unsigned(size);
+			return;
+		}
+		if (memSize) {
+			unsigned n = 16 - memSize;
+			memcpy(mem + memSize, p, n);
+			round16(mem);
+			p += n;
+			memSize = 0;
+		}
+		while ((p + 16) <= bEnd) {
+			round16(p);
+			p += 16;
+		}
+		memSize = unsigned(bEnd - p);
+		if (memSize) memcpy(mem, p, memSize);
+	}
+
+	[[nodiscard]] uint32_t digest() const
+	{
+		uint32_t h32 = (totalLen >= 16)
+			? std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18)
+			: PRIME32_5;
+		h32 += uint32_t(totalLen);
+
+		const uint8_t* p = mem;
+		const uint8_t* const bEnd = mem + memSize;
+		while ((p + 4) <= bEnd) {
+			uint32_t r = read32<false>(p) * PRIME32_3;
+			h32  = std::rotl(h32 + r, 17) * PRIME32_4;
+			p += 4;
+		}
+		while (p < bEnd) {
+			uint32_t r = *p * PRIME32_5;
+			h32 = std::rotl(h32 + r, 11) * PRIME32_1;
+			p += 1;
+		}
+
+		h32  = (h32 ^ (h32 >> 15)) * PRIME32_2;
+		h32  = (h32 ^ (h32 >> 13)) * PRIME32_3;
+		return  h32 ^ (h32 >> 16);
+	}
+
+private:
+	void round16(const uint8_t* p)
+	{
+		v1 = std::rotl(v1 + read32<false>(p +  0) * PRIME32_2, 13) * PRIME32_1;
+		v2 = std::rotl(v2 + read32<false>(p +  4) * PRIME32_2, 13) * PRIME32_1;
+		v3 = std::rotl(v3 + read32<false>(p +  8) * PRIME32_2, 13) * PRIME32_1;
+		v4 = std::rotl(v4 + read32<false>(p + 12) * PRIME32_2, 13) * PRIME32_1;
+	}
+
+private:
+	uint32_t v1 = uint32_t(PRIME32_1 + uint64_t(PRIME32_2));
+	uint32_t v2 = PRIME32_2;
+	uint32_t v3 = 0;
+	uint32_t v4 = uint32_t(0 - PRIME32_1);
+	uint64_t totalLen = 0;
+	uint8_t mem[16];
+	unsigned memSize = 0;
+};
+
 struct XXHasher {
 	[[nodiscard]] uint32_t operator()(std::string_view key) const {
 		return xxhash(key);
@@ -6,6 +6,7 @@
 #include "FileContext.hh"
 #include "CommandException.hh"
 #include "Display.hh"
+#include "GlobalSettings.hh"
 #include "PostProcessor.hh"
 #include "Math.hh"
 #include "MSXMixer.hh"
@@ -14,6 +15,7 @@
 #include "FileOperations.hh"
 #include "TclArgParser.hh"
 #include "TclObject.hh"
+#include "ThrottleManager.hh"
 #include "outer.hh"
 #include "vla.hh"
 #include "xrange.hh"
@@ -39,7 +41,7 @@ AviRecorder::~AviRecorder()
 }
 
 void AviRecorder::start(bool recordAudio, bool recordVideo, bool recordMono,
-                        bool recordStereo, const Filename& filename)
+                        bool recordStereo, bool renderOffline, const Filename& filename)
 {
 	stop();
 	MSXMotherBoard* motherBoard = reactor.getMotherBoard();
@@ -97,7 +99,12 @@ void AviRecorder::start(bool recordAudio, bool recordVideo, bool recordMono,
 	for (auto* pp : postProcessors) {
 		pp->setRecorder(this);
 	}
-	if (mixer) mixer->setRecorder(this);
+	if (mixer) mixer->setRecorder(this, renderOffline);
+	if (renderOffline) {
+		// render as fast as possible, sound only goes to the file
+		offline = true;
+		reactor.getGlobalSettings().getThrottleManager().indicateOfflineState(true);
+	}
 }
 
 void AviRecorder::stop()
@@ -110,6 +117,10 @@ void AviRecorder::stop()
 		mixer->setRecorder(nullptr);
 		mixer = nullptr;
 	}
+	if (offline) {
+		offline = false;
+		reactor.getGlobalSettings().getThrottleManager().indicateOfflineState(false);
+	}
 	sampleRate = 0;
 	aviWriter.reset();
 	wavWriter.reset();
@@ -207,6 +218,7 @@ void AviRecorder::processStart(Interpreter& interp, span<const TclObject> tokens
 	bool recordStereo = false;
 	bool doubleSize   = false;
 	bool tripleSize   = false;
+	bool renderOffline = false;
 	ArgsInfo info[] = {
 		valueArg("-prefix", prefix),
 		flagArg("-audioonly", audioOnly),
@@ -215,6 +227,7 @@ void AviRecorder::processStart(Interpreter& interp, span<const TclObject> tokens
 		flagArg("-stereo",    recordStereo),
 		flagArg("-doublesize", doubleSize),
 		flagArg("-triplesize", tripleSize),
+		flagArg("-offline",    renderOffline),
 	};
 	auto arguments = parseTclArgs(interp, tokens.subspan(2), info);
 
@@ -262,7 +275,7 @@ void AviRecorder::processStart(Interpreter& interp, span<const TclObject> tokens
 		result = "Already recording.";
 	} else {
 		start(recordAudio, recordVideo, recordMono, recordStereo,
-				Filename(filename));
+				renderOffline, Filename(filename));
 		result = tmpStrCat("Recording to ", filename);
 	}
 }
@@ -322,7 +335,11 @@ std::string AviRecorder::Cmd::help(span<const TclObject> /*tokens*/) const
 	       "record status             Query recording state\n"
 	       "\n"
 	       "The start subcommand also accepts an optional -audioonly, -videoonly, "
-	       " -mono, -stereo, -doublesize, -triplesize flag.\n"
+	       " -mono, -stereo, -doublesize, -triplesize, -offline flag.\n"
+	       "With -offline the emulation runs as fast as possible (the throttle "
+	       "setting is ignored) and the sound is only written to the file, not "
+	       "played. Recording still happens in emulated time, so the result is "
+	       "the same as a realtime recording.\n"
 	       "Videos are recorded in a 320x240 size by default, at 640x480 when the "
 	       "-doublesize flag is used and at 960x720 when the -triplesize flag is used.";
 }
@@ -339,7 +356,7 @@ void AviRecorder::Cmd::tabCompletion(std::vector<std::string>& tokens) const
 		static constexpr std::array options = {
 			"-prefix"sv, "-videoonly"sv, "-audioonly"sv,
 			"-doublesize"sv, "-triplesize"sv,
-			"-mono"sv, "-stereo"sv,
+			"-mono"sv, "-stereo"sv, "-offline"sv,
 		};
 		completeFileName(tokens, userFileContext(), options);
 	}
@@ -33,7 +33,7 @@ public:
 
 private:
 	void start(bool recordAudio, bool recordVideo, bool recordMono,
-		   bool recordStereo, const Filename& filename);
+		   bool recordStereo, bool renderOffline, const Filename& filename);
 	void status(span<const TclObject> tokens, TclObject& result) const;
 
 	void processStart (Interpreter& interp, span<const TclObject> tokens, TclObject& result);
@@ -64,6 +64,7 @@ private:
 	bool warnedSampleRate;
 	bool warnedStereo;
 	bool stereo;
+	bool offline = false;
 };
 
 } // namespace openmsx
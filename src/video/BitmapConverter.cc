@@ -8,6 +8,16 @@
 #include <cstdint>
 #include <tuple>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 namespace openmsx {
 
 template<typename Pixel>
@@ -35,8 +45,116 @@ void BitmapConverter<Pixel>::calcDPalette()
 			dPalette[16 * i + j] = dp;
 		}
 	}
+#ifdef __SSSE3__
+	for (auto n : xrange(sizeof(Pixel))) {
+		for (auto i : xrange(16)) {
+			planes16[n][i] = byte(palette16[i] >> (8 * n));
+			unsigned g5 = (i < 4) ? i : (i < 8) ? (i + 12) : 0;
+			planesGraphic5[n][i] = byte(palette16[g5] >> (8 * n));
+		}
+	}
+#endif
 }
 
+#ifdef __SSSE3__
+// Converts 4-bit color indices (one per byte, in pixel order) to pixels,
+// using a 16 color palette that's split in byte planes. With AVX2 the
+// lookup is done for 32 pixels at once, otherwise per 16 pixels.
+template<typename Pixel> class PaletteLookup
+{
+public:
+	explicit PaletteLookup(const byte (&planes)[sizeof(Pixel)][16])
+	{
+		for (auto n : xrange(sizeof(Pixel))) {
+			auto p = _mm_load_si128(reinterpret_cast<const __m128i*>(planes[n]));
+#ifdef __AVX2__
+			plane[n] = _mm256_broadcastsi128_si256(p);
+#else
+			plane[n] = p;
+#endif
+		}
+	}
+
+	// Convert 32 indices: 'idx0' for the first 16 pixels, 'idx1' for the
+	// next 16.
+	inline void operator()(Pixel* out, __m128i idx0, __m128i idx1) const
+	{
+#ifdef __AVX2__
+		// PSHUFB and the unpack instructions work per 128-bit lane,
+		// so in the end the lanes must be recombined.
+		__m256i idx = _mm256_inserti128_si256(_mm256_castsi128_si256(idx0), idx1, 1);
+		auto* o = reinterpret_cast<__m256i*>(out);
+		__m256i b0 = _mm256_shuffle_epi8(plane[0], idx);
+		__m256i b1 = _mm256_shuffle_epi8(plane[1], idx);
+		__m256i lo01 = _mm256_unpacklo_epi8(b0, b1);
+		__m256i hi01 = _mm256_unpackhi_epi8(b0, b1);
+		if constexpr (sizeof(Pixel) == 2) {
+			_mm256_storeu_si256(o + 0, _mm256_permute2x128_si256(lo01, hi01, 0x20));
+			_mm256_storeu_si256(o + 1, _mm256_permute2x128_si256(lo01, hi01, 0x31));
+		} else {
+			__m256i b2 = _mm256_shuffle_epi8(plane[2], idx);
+			__m256i b3 = _mm256_shuffle_epi8(plane[3], idx);
+			__m256i lo23 = _mm256_unpacklo_epi8(b2, b3);
+			__m256i hi23 = _mm256_unpackhi_epi8(b2, b3);
+			__m256i q0 = _mm256_unpacklo_epi16(lo01, lo23);
+			__m256i q1 = _mm256_unpackhi_epi16(lo01, lo23);
+			__m256i q2 = _mm256_unpacklo_epi16(hi01, hi23);
+			__m256i q3 = _mm256_unpackhi_epi16(hi01, hi23);
+			_mm256_storeu_si256(o + 0, _mm256_permute2x128_si256(q0, q1, 0x20));
+			_mm256_storeu_si256(o + 1, _mm256_permute2x128_si256(q2, q3, 0x20));
+			_mm256_storeu_si256(o + 2, _mm256_permute2x128_si256(q0, q1, 0x31));
+			_mm256_storeu_si256(o + 3, _mm256_permute2x128_si256(q2, q3, 0x31));
+		}
+#else
+		lookup16(out +  0, idx0);
+		lookup16(out + 16, idx1);
+#endif
+	}
+
+private:
+#ifndef __AVX2__
+	inline void lookup16(Pixel* out, __m128i idx) const
+	{
+		auto* o = reinterpret_cast<__m128i*>(out);
+		__m128i b0 = _mm_shuffle_epi8(plane[0], idx);
+		__m128i b1 = _mm_shuffle_epi8(plane[1], idx);
+		__m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+		__m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+		if constexpr (sizeof(Pixel) == 2) {
+			_mm_storeu_si128(o + 0, lo01);
+			_mm_storeu_si128(o + 1, hi01);
+		} else {
+			__m128i b2 = _mm_shuffle_epi8(plane[2], idx);
+			__m128i b3 = _mm_shuffle_epi8(plane[3], idx);
+			__m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+			__m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+			_mm_storeu_si128(o + 0, _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi01, hi23));
+		}
+	}
+#endif
+
+private:
+#ifdef __AVX2__
+	__m256i plane[sizeof(Pixel)];
+#else
+	__m128i plane[sizeof(Pixel)];
+#endif
+};
+
+// Split 16 bytes, each containing 2 4-bit color indices, in 32 indices.
+static inline void splitNibbles(__m128i data, __m128i& idx0, __m128i& idx1)
+{
+	__m128i mask = _mm_set1_epi8(0x0F);
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(data, 4), mask);
+	__m128i lo = _mm_and_si128(data, mask);
+	idx0 = _mm_unpacklo_epi8(hi, lo);
+	idx1 = _mm_unpackhi_epi8(hi, lo);
+}
+#endif
+
 template<typename Pixel>
 void BitmapConverter<Pixel>::convertLine(
 	Pixel* linePtr, const byte* vramPtr)
@@ -126,6 +244,16 @@ void BitmapConverter<Pixel>::renderGraphic4(
 		calcDPalette();
 	}
 
+#ifdef __SSSE3__
+	PaletteLookup<Pixel> lookup(planes16);
+	const auto* vin = reinterpret_cast<const __m128i*>(vramPtr0);
+	for (auto i : xrange(128 / 16)) {
+		// 32 pixels per iteration
+		__m128i idx0, idx1;
+		splitNibbles(_mm_loadu_si128(vin + i), idx0, idx1);
+		lookup(pixelPtr + 32 * i, idx0, idx1);
+	}
+#else
 	if ((sizeof(Pixel) == 2) && ((uintptr_t(pixelPtr) & 1) == 1)) {
 		// Its 16 bit destination but currently not aligned on a word boundary
 		// First write one pixel to get aligned
@@ -199,6 +327,7 @@ void BitmapConverter<Pixel>::renderGraphic4(
 			out[4 * i + 3] = dPalette[(data >> 24) & 0xFF];
 		}
 	}
+#endif
 }
 
 template<typename Pixel>
@@ -206,6 +335,31 @@ void BitmapConverter<Pixel>::renderGraphic5(
 	Pixel*      __restrict pixelPtr,
 	const byte* __restrict vramPtr0)
 {
+#ifdef __SSSE3__
+	if (unlikely(!dPaletteValid)) {
+		calcDPalette();
+	}
+	PaletteLookup<Pixel> lookup(planesGraphic5);
+	const auto* vin = reinterpret_cast<const __m128i*>(vramPtr0);
+	__m128i mask = _mm_set1_epi8(3);
+	__m128i odd = _mm_set1_epi8(4); // odd pixels use colors 4..7
+	for (auto i : xrange(128 / 16)) {
+		// 64 pixels per iteration
+		__m128i data = _mm_loadu_si128(vin + i);
+		__m128i a = _mm_and_si128(_mm_srli_epi16(data, 6), mask);
+		__m128i b = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(data, 4), mask), odd);
+		__m128i c = _mm_and_si128(_mm_srli_epi16(data, 2), mask);
+		__m128i d = _mm_or_si128(_mm_and_si128(data, mask), odd);
+		__m128i abLo = _mm_unpacklo_epi8(a, b);
+		__m128i abHi = _mm_unpackhi_epi8(a, b);
+		__m128i cdLo = _mm_unpacklo_epi8(c, d);
+		__m128i cdHi = _mm_unpackhi_epi8(c, d);
+		lookup(pixelPtr + 64 * i +  0, _mm_unpacklo_epi16(abLo, cdLo),
+		                               _mm_unpackhi_epi16(abLo, cdLo));
+		lookup(pixelPtr + 64 * i + 32, _mm_unpacklo_epi16(abHi, cdHi),
+		                               _mm_unpackhi_epi16(abHi, cdHi));
+	}
+#else
 	for (auto i : xrange(128)) {
 		unsigned data = vramPtr0[i];
 		pixelPtr[4 * i + 0] = palette16[ 0 +  (data >> 6)     ];
@@ -213,6 +367,7 @@ void BitmapConverter<Pixel>::renderGraphic5(
 		pixelPtr[4 * i + 2] = palette16[ 0 + ((data >> 2) & 3)];
 		pixelPtr[4 * i + 3] = palette16[16 + ((data >> 0) & 3)];
 	}
+#endif
 }
 
 template<typename Pixel>
@@ -232,6 +387,22 @@ void BitmapConverter<Pixel>::renderGraphic6(
 	if (unlikely(!dPaletteValid)) {
 		calcDPalette();
 	}
+
+#ifdef __SSSE3__
+	PaletteLookup<Pixel> lookup(planes16);
+	const auto* vin0 = reinterpret_cast<const __m128i*>(vramPtr0);
+	const auto* vin1 = reinterpret_cast<const __m128i*>(vramPtr1);
+	for (auto i : xrange(128 / 16)) {
+		// 64 pixels per iteration
+		__m128i data0 = _mm_loadu_si128(vin0 + i);
+		__m128i data1 = _mm_loadu_si128(vin1 + i);
+		__m128i idx0, idx1, idx2, idx3;
+		splitNibbles(_mm_unpacklo_epi8(data0, data1), idx0, idx1);
+		splitNibbles(_mm_unpackhi_epi8(data0, data1), idx2, idx3);
+		lookup(pixelPtr + 64 * i +  0, idx0, idx1);
+		lookup(pixelPtr + 64 * i + 32, idx2, idx3);
+	}
+#else
 	      auto* out = reinterpret_cast<DPixel*>(pixelPtr);
 	const auto* in0 = reinterpret_cast<const unsigned*>(vramPtr0);
 	const auto* in1 = reinterpret_cast<const unsigned*>(vramPtr1);
@@ -259,6 +430,7 @@ void BitmapConverter<Pixel>::renderGraphic6(
 			out[8 * i + 7] = dPalette[(data1 >> 24) & 0xFF];
 		}
 	}
+#endif
 }
 
 template<typename Pixel>
@@ -286,12 +458,78 @@ static constexpr std::tuple<int, int, int> yjk2rgb(int y, int j, int k)
 	return {r, g, b};
 }
 
+#ifdef __SSE2__
+// Vectorized version of yjk2rgb() for 32 pixels, stored as 15-bit
+// palette32768 indices. With 'yae' set, pixels that have the YAE bit set
+// are instead stored as '0x8000 | palette16-index'.
+template<bool yae>
+static inline void yjk2col32(const byte* vramPtr0, const byte* vramPtr1,
+                             uint16_t* __restrict cols)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i data0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vramPtr0));
+	__m128i data1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vramPtr1));
+	// in pixel order, 4 bytes per group of 4 pixels
+	__m128i bytes[2] = {_mm_unpacklo_epi8(data0, data1),
+	                    _mm_unpackhi_epi8(data0, data1)};
+	for (auto i : xrange(4)) {
+		// 8 pixels (2 groups) as 16-bit values
+		__m128i p = (i & 1) ? _mm_unpackhi_epi8(bytes[i / 2], zero)
+		                    : _mm_unpacklo_epi8(bytes[i / 2], zero);
+		// per 32-bit lane the (sign extended) 6-bit K (even lanes)
+		// or J (odd lanes) value
+		__m128i kj = _mm_or_si128(
+			_mm_and_si128(p, _mm_set1_epi32(7)),
+			_mm_and_si128(_mm_srli_epi32(p, 13), _mm_set1_epi32(0x38)));
+		kj = _mm_sub_epi32(_mm_xor_si128(kj, _mm_set1_epi32(32)), _mm_set1_epi32(32));
+		__m128i pk = _mm_packs_epi32(kj, kj); // k0 j0 k1 j1 k0 j0 k1 j1
+		__m128i k = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pk, 0x00), 0xAA);
+		__m128i j = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pk, 0x55), 0xFF);
+
+		__m128i y = _mm_srli_epi16(p, 3);
+		__m128i max = _mm_set1_epi16(31);
+		auto clamp = [&](__m128i x) {
+			return _mm_min_epi16(_mm_max_epi16(x, zero), max);
+		};
+		__m128i r = clamp(_mm_add_epi16(y, j));
+		__m128i g = clamp(_mm_add_epi16(y, k));
+		// (5 * y - 2 * j - k + 2) / 4, the division rounds towards
+		// zero but that only matters for negative values, and those
+		// are clamped to zero anyway
+		__m128i b5 = _mm_add_epi16(_mm_slli_epi16(y, 2), y);
+		__m128i b4 = _mm_sub_epi16(b5, _mm_add_epi16(_mm_add_epi16(j, j), k));
+		__m128i b = clamp(_mm_srai_epi16(_mm_add_epi16(b4, _mm_set1_epi16(2)), 2));
+		__m128i col = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 10),
+		                                        _mm_slli_epi16(g, 5)),
+		                           b);
+		if constexpr (yae) {
+			__m128i isYae = _mm_cmpeq_epi16(_mm_and_si128(p, _mm_set1_epi16(8)),
+			                                _mm_set1_epi16(8));
+			__m128i idx16 = _mm_or_si128(_mm_srli_epi16(p, 4), _mm_set1_epi16(-0x8000));
+			col = _mm_or_si128(_mm_and_si128(isYae, idx16),
+			                   _mm_andnot_si128(isYae, col));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(cols + 8 * i), col);
+	}
+}
+#endif
+
 template<typename Pixel>
 void BitmapConverter<Pixel>::renderYJK(
 	Pixel*      __restrict pixelPtr,
 	const byte* __restrict vramPtr0,
 	const byte* __restrict vramPtr1)
 {
+#ifdef __SSE2__
+	// The YJK->RGB calculation is vectorized, the palette lookup isn't.
+	for (auto i : xrange(128 / 16)) {
+		uint16_t cols[32];
+		yjk2col32<false>(vramPtr0 + 16 * i, vramPtr1 + 16 * i, cols);
+		for (auto n : xrange(32)) {
+			pixelPtr[32 * i + n] = palette32768[cols[n]];
+		}
+	}
+#else
 	for (auto i : xrange(64)) {
 		unsigned p[4];
 		p[0] = vramPtr0[2 * i + 0];
@@ -309,6 +547,7 @@ void BitmapConverter<Pixel>::renderYJK(
 			pixelPtr[4 * i + n] = palette32768[col];
 		}
 	}
+#endif
 }
 
 template<typename Pixel>
@@ -317,6 +556,17 @@ void BitmapConverter<Pixel>::renderYAE(
 	const byte* __restrict vramPtr0,
 	const byte* __restrict vramPtr1)
 {
+#ifdef __SSE2__
+	for (auto i : xrange(128 / 16)) {
+		uint16_t cols[32];
+		yjk2col32<true>(vramPtr0 + 16 * i, vramPtr1 + 16 * i, cols);
+		for (auto n : xrange(32)) {
+			unsigned c = cols[n];
+			pixelPtr[32 * i + n] = (c & 0x8000) ? palette16[c & 15]
+			                                    : palette32768[c];
+		}
+	}
+#else
 	for (auto i : xrange(64)) {
 		unsigned p[4];
 		p[0] = vramPtr0[2 * i + 0];
@@ -341,6 +591,7 @@ void BitmapConverter<Pixel>::renderYAE(
 			pixelPtr[4 * i + n] = pix;
 		}
 	}
+#endif
 }
 
 template<typename Pixel>
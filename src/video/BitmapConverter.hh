@@ -73,6 +73,16 @@ public:
 		dPaletteValid = false;
 	}
 
+	/** Update the (lazily calculated) internal palette tables. After
+	  * this, and as long as the palettes don't change, convertLine() and
+	  * convertLinePlanar() don't modify this object. So then they can be
+	  * called from multiple threads in parallel.
+	  */
+	inline void prepareConvert()
+	{
+		if (!dPaletteValid) calcDPalette();
+	}
+
 private:
 	void calcDPalette();
 
@@ -95,6 +105,13 @@ private:
 
 	using DPixel = typename DoublePixel<sizeof(Pixel)>::type;
 	DPixel dPalette[16 * 16];
+#ifdef __SSSE3__
+	// The 16-color palettes split in byte planes: plane 'n' contains byte
+	// 'n' of each color. Used as tables for (V)PSHUFB. For Graphic5 the
+	// first 4 colors are used for the even pixels, the next 4 for the odd.
+	alignas(16) byte planes16[sizeof(Pixel)][16];
+	alignas(16) byte planesGraphic5[sizeof(Pixel)][16];
+#endif
 	DisplayMode mode;
 	bool dPaletteValid;
 };
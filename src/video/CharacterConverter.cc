@@ -18,6 +18,9 @@ TODO:
 #ifdef __SSE2__
 #include "emmintrin.h" // SSE2
 #endif
+#ifdef __AVX2__
+#include "immintrin.h" // AVX2
+#endif
 
 namespace openmsx {
 
@@ -90,7 +93,8 @@ static inline __m128i select(__m128i a0, __m128i a1, __m128i mask)
 }
 #endif
 
-template<typename Pixel> static inline void draw6(
+template<typename Pixel>
+void CharacterConverter<Pixel>::draw6(
 	Pixel* __restrict & pixelPtr, Pixel fg, Pixel bg, byte pattern)
 {
 	pixelPtr[0] = (pattern & 0x80) ? fg : bg;
@@ -102,12 +106,28 @@ template<typename Pixel> static inline void draw6(
 	pixelPtr += 6;
 }
 
-template<typename Pixel> static inline void draw8(
+template<typename Pixel>
+void CharacterConverter<Pixel>::draw8(
 	Pixel* __restrict & pixelPtr, Pixel fg, Pixel bg, byte pattern)
 {
-#ifdef __SSE2__
-	// SSE2 version, 32bpp  (16bpp is possible, but not worth it anymore)
+#if defined(__AVX2__) || defined(__SSE2__)
 	if constexpr (sizeof(Pixel) == 4) {
+#ifdef __AVX2__
+		// AVX2 version, 32bpp: all 8 pixels in one go
+		const __m256i m70 = _mm256_set_epi32(
+			0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+
+		__m256i fg8 = _mm256_set1_epi32(fg);
+		__m256i bg8 = _mm256_set1_epi32(bg);
+		__m256i pat = _mm256_set1_epi32(pattern);
+
+		__m256i b70 = _mm256_cmpeq_epi32(_mm256_and_si256(pat, m70),
+		                                 _mm256_setzero_si256());
+
+		auto* out = reinterpret_cast<__m256i*>(pixelPtr);
+		_mm256_storeu_si256(out, _mm256_blendv_epi8(fg8, bg8, b70));
+#else
+		// SSE2 version, 32bpp  (16bpp is possible, but not worth it anymore)
 		const __m128i m74 = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
 		const __m128i m30 = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
 		const __m128i zero = _mm_setzero_si128();
@@ -122,20 +142,20 @@ template<typename Pixel> static inline void draw8(
 		auto* out = reinterpret_cast<__m128i*>(pixelPtr);
 		_mm_storeu_si128(out + 0, select(fg4, bg4, b74));
 		_mm_storeu_si128(out + 1, select(fg4, bg4, b30));
-		pixelPtr += 8;
-		return;
-	}
 #endif
-
-	// C++ version
-	pixelPtr[0] = (pattern & 0x80) ? fg : bg;
-	pixelPtr[1] = (pattern & 0x40) ? fg : bg;
-	pixelPtr[2] = (pattern & 0x20) ? fg : bg;
-	pixelPtr[3] = (pattern & 0x10) ? fg : bg;
-	pixelPtr[4] = (pattern & 0x08) ? fg : bg;
-	pixelPtr[5] = (pattern & 0x04) ? fg : bg;
-	pixelPtr[6] = (pattern & 0x02) ? fg : bg;
-	pixelPtr[7] = (pattern & 0x01) ? fg : bg;
+	} else
+#endif
+	{
+		// C++ version
+		pixelPtr[0] = (pattern & 0x80) ? fg : bg;
+		pixelPtr[1] = (pattern & 0x40) ? fg : bg;
+		pixelPtr[2] = (pattern & 0x20) ? fg : bg;
+		pixelPtr[3] = (pattern & 0x10) ? fg : bg;
+		pixelPtr[4] = (pattern & 0x08) ? fg : bg;
+		pixelPtr[5] = (pattern & 0x04) ? fg : bg;
+		pixelPtr[6] = (pattern & 0x02) ? fg : bg;
+		pixelPtr[7] = (pattern & 0x01) ? fg : bg;
+	}
 	pixelPtr += 8;
 }
 
@@ -41,6 +41,13 @@ public:
 	  */
 	void setDisplayMode(DisplayMode mode);
 
+	// for unittest
+	/** Draw 6 or 8 pixels of a pattern, the most significant bit is the
+	  * leftmost pixel. Advances 'pixelPtr' past the drawn pixels.
+	  */
+	static void draw6(Pixel* __restrict & pixelPtr, Pixel fg, Pixel bg, byte pattern);
+	static void draw8(Pixel* __restrict & pixelPtr, Pixel fg, Pixel bg, byte pattern);
+
 private:
 	inline void renderText1   (Pixel* pixelPtr, int line);
 	inline void renderText1Q  (Pixel* pixelPtr, int line);
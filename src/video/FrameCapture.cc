@@ -0,0 +1,344 @@
+#include "FrameCapture.hh"
+#include "CliComm.hh"
+#include "CommandException.hh"
+#include "Display.hh"
+#include "FileContext.hh"
+#include "GlobalSettings.hh"
+#include "MSXException.hh"
+#include "PNG.hh"
+#include "PixelFormat.hh"
+#include "PostProcessor.hh"
+#include "RawFrame.hh"
+#include "Reactor.hh"
+#include "TclArgParser.hh"
+#include "TclObject.hh"
+#include "ThrottleManager.hh"
+#include "aligned.hh"
+#include "outer.hh"
+#include "ranges.hh"
+#include "strCat.hh"
+#include "xrange.hh"
+#include "xxhash.hh"
+#include "build-info.hh"
+#include "components.hh"
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+
+namespace openmsx {
+
+// More frames than this waiting for the capture thread are dropped. At
+// 32bpp this limits the memory use to about 40MB.
+constexpr size_t MAX_QUEUED_FRAMES = 64;
+
+FrameCapture::FrameCapture(Reactor& reactor_)
+	: reactor(reactor_)
+	, captureCommand(reactor.getCommandController())
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	assert(!thread.joinable());
+}
+
+void FrameCapture::start(const std::string& filename, bool savePng, bool renderOffline)
+{
+	stop();
+	for (auto* l : reactor.getDisplay().getAllLayers()) {
+		if (auto* pp = dynamic_cast<PostProcessor*>(l)) {
+			postProcessors.push_back(pp);
+		}
+	}
+	if (postProcessors.empty()) {
+		throw CommandException(
+			"Current renderer doesn't support frame capture.");
+	}
+	hashFile = FileOperations::openFile(filename, "w");
+	if (!hashFile) {
+		postProcessors.clear();
+		throw CommandException("Can't open ", filename, " for writing.");
+	}
+	pngPrefix = savePng ? std::string(FileOperations::stripExtension(filename))
+	                    : std::string{};
+	numFrames = 0;
+	numDropped = 0;
+	numFinished = 0;
+	error.clear();
+	stopThread = false;
+	thread = std::thread([this] { run(); });
+
+	// only set capture when all errors are checked for
+	for (auto* pp : postProcessors) {
+		pp->setFrameCapture(this);
+	}
+	if (renderOffline) {
+		offline = true;
+		reactor.getGlobalSettings().getThrottleManager().indicateOfflineState(true);
+	}
+}
+
+void FrameCapture::stop()
+{
+	for (auto* pp : postProcessors) {
+		pp->setFrameCapture(nullptr);
+	}
+	postProcessors.clear();
+	if (offline) {
+		offline = false;
+		reactor.getGlobalSettings().getThrottleManager().indicateOfflineState(false);
+	}
+	if (!thread.joinable()) return;
+
+	// Let the capture thread finish the queued frames. This is the only
+	// place where the emulation thread waits for it.
+	{
+		std::lock_guard lock(mutex);
+		stopThread = true;
+	}
+	cond.notify_one();
+	thread.join();
+
+	submitted.clear();
+	retired.clear();
+	hashFile.reset();
+	auto& cliComm = reactor.getCliComm();
+	if (numDropped) {
+		cliComm.printWarning(
+			"Frame capture dropped ", numDropped, " of ", numFrames,
+			" frames, because they couldn't be processed fast enough.");
+	}
+	if (!error.empty()) {
+		cliComm.printWarning(error);
+	}
+}
+
+void FrameCapture::addFrame(const RawFrame& frame)
+{
+	assert(thread.joinable());
+	unsigned number = numFrames++;
+	{
+		std::lock_guard lock(mutex);
+		if (queue.size() >= MAX_QUEUED_FRAMES) {
+			++numDropped;
+			return;
+		}
+		queue.push_back({&frame, number});
+	}
+	cond.notify_one();
+
+	// Forget about jobs that are finished.
+	unsigned finished = numFinished.load(std::memory_order_acquire);
+	submitted.erase(ranges::remove_if(submitted, [&](const Job& job) {
+		return job.number < finished;
+	}), end(submitted));
+	submitted.push_back({&frame, number});
+}
+
+std::unique_ptr<RawFrame> FrameCapture::recycle(
+	const PostProcessor& owner, std::unique_ptr<RawFrame> frame)
+{
+	if (!frame) return frame;
+	unsigned finished = numFinished.load(std::memory_order_acquire);
+	auto job = ranges::find_if(submitted, [&](const Job& j) {
+		return (j.frame == frame.get()) && (j.number >= finished);
+	});
+	if (job == end(submitted)) return frame; // not (or no longer) in use
+
+	// The capture thread still uses this frame, keep it until it's done
+	// and hand out a retired frame that's no longer in use instead. The
+	// PostProcessors (e.g. of VDP and V9990) use frames of different sizes,
+	// so only frames of the same PostProcessor can be reused.
+	auto isFree = [&](const Retired& r) { return r.number < finished; };
+	std::unique_ptr<RawFrame> result;
+	if (auto it = ranges::find_if(retired, [&](const Retired& r) {
+			return (r.owner == &owner) && isFree(r);
+		}); it != end(retired)) {
+		result = std::move(it->frame);
+		// its content is from an older frame, the producer may not rely
+		// on it (see RawFrame::getFrameNumber())
+		result->setFrameNumber(0);
+	}
+	retired.erase(ranges::remove_if(retired, isFree), end(retired));
+	retired.push_back({&owner, job->number, std::move(frame)});
+	return result;
+}
+
+void FrameCapture::run()
+{
+	while (true) {
+		Job job;
+		{
+			std::unique_lock lock(mutex);
+			cond.wait(lock, [&] { return stopThread || !queue.empty(); });
+			if (queue.empty()) return; // only when stopping
+			job = queue.front();
+			queue.pop_front();
+		}
+#if HAVE_32BPP || COMPONENT_GL
+		if (job.frame->getPixelFormat().getBytesPerPixel() == 4) {
+			process<uint32_t>(*job.frame, job.number);
+		} else
+#endif
+		{
+#if HAVE_16BPP
+			process<uint16_t>(*job.frame, job.number);
+#endif
+		}
+		numFinished.store(job.number + 1, std::memory_order_release);
+	}
+}
+
+template<typename Pixel>
+void FrameCapture::process(const RawFrame& frame, unsigned number)
+{
+	// Convert to 640x480 RGB, for 240 line frames each line is used twice.
+	constexpr unsigned WIDTH = 640;
+	constexpr unsigned HEIGHT = 480;
+	const auto& format = frame.getPixelFormat();
+	assert((frame.getHeight() == 240) || (frame.getHeight() == 480));
+	unsigned step = HEIGHT / frame.getHeight();
+	std::vector<uint8_t> rgb(HEIGHT * WIDTH * 3);
+	const void* rows[HEIGHT];
+	ALIGNAS_SSE Pixel buf[WIDTH];
+	for (unsigned y = 0; y < HEIGHT; y += step) {
+		const Pixel* line = frame.getLinePtr640_480(y, buf);
+		uint8_t* out = &rgb[y * WIDTH * 3];
+		for (auto x : xrange(WIDTH)) {
+			uint32_t p = line[x];
+			out[3 * x + 0] = uint8_t(((p & format.getRmask()) >> format.getRshift()) << format.getRloss());
+			out[3 * x + 1] = uint8_t(((p & format.getGmask()) >> format.getGshift()) << format.getGloss());
+			out[3 * x + 2] = uint8_t(((p & format.getBmask()) >> format.getBshift()) << format.getBloss());
+		}
+		for (auto i : xrange(step)) {
+			rows[y + i] = out;
+		}
+	}
+
+	XXHash32 hash;
+	for (const auto* row : rows) {
+		hash.update(row, WIDTH * 3);
+	}
+	fprintf(hashFile.get(), "%u %08x\n", number, hash.digest());
+
+	if (!pngPrefix.empty()) {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "-%06u.png", number);
+		try {
+			PNG::save(WIDTH, HEIGHT, rows, strCat(pngPrefix, suffix));
+		} catch (MSXException& e) {
+			// only report the first error, and stop writing images
+			std::lock_guard lock(mutex);
+			error = strCat("Frame capture stopped writing PNG files: ",
+			               e.getMessage());
+			pngPrefix.clear();
+		}
+	}
+}
+
+void FrameCapture::processStart(Interpreter& interp, span<const TclObject> tokens, TclObject& result)
+{
+	std::string_view prefix = "openmsx";
+	bool savePng = false;
+	bool renderOffline = false;
+	ArgsInfo info[] = {
+		valueArg("-prefix", prefix),
+		flagArg("-png", savePng),
+		flagArg("-offline", renderOffline),
+	};
+	auto arguments = parseTclArgs(interp, tokens.subspan(2), info);
+
+	std::string_view filenameArg;
+	switch (arguments.size()) {
+	case 0:
+		// nothing
+		break;
+	case 1:
+		filenameArg = arguments[0].getString();
+		break;
+	default:
+		throw SyntaxError();
+	}
+	auto filename = FileOperations::parseCommandFileArgument(
+		filenameArg, "captures", prefix, ".txt");
+
+	if (thread.joinable()) {
+		result = "Already capturing.";
+	} else {
+		start(filename, savePng, renderOffline);
+		result = tmpStrCat("Capturing to ", filename);
+	}
+}
+
+void FrameCapture::status(TclObject& result) const
+{
+	result.addDictKeyValue("status", thread.joinable() ? "capturing" : "idle");
+	result.addDictKeyValue("frames", numFrames);
+	result.addDictKeyValue("dropped", numDropped);
+	std::lock_guard lock(mutex);
+	if (!error.empty()) {
+		result.addDictKeyValue("error", error);
+	}
+}
+
+// class FrameCapture::Cmd
+
+FrameCapture::Cmd::Cmd(CommandController& commandController_)
+	: Command(commandController_, "capture_frames")
+{
+}
+
+void FrameCapture::Cmd::execute(span<const TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() < 2) {
+		throw CommandException("Missing argument");
+	}
+	auto& capture = OUTER(FrameCapture, captureCommand);
+	executeSubCommand(tokens[1].getString(),
+		"start",  [&]{ capture.processStart(getInterpreter(), tokens, result); },
+		"stop",   [&]{
+			checkNumArgs(tokens, 2, Prefix{2}, nullptr);
+			capture.stop(); },
+		"status", [&]{
+			checkNumArgs(tokens, 2, Prefix{2}, nullptr);
+			capture.status(result); });
+}
+
+std::string FrameCapture::Cmd::help(span<const TclObject> /*tokens*/) const
+{
+	return "Captures every VDP frame, e.g. to compare with known good images.\n"
+	       "capture_frames start              Capture to file 'openmsxNNNN.txt'\n"
+	       "capture_frames start <filename>   Capture to given file\n"
+	       "capture_frames start -prefix foo  Capture to file 'fooNNNN.txt'\n"
+	       "capture_frames stop               Stop capturing\n"
+	       "capture_frames status             Query capture state\n"
+	       "\n"
+	       "For each frame a line '<frame number> <hash>' is written to the "
+	       "file. The hash is the xxhash of the frame as 640x480 RGB pixels "
+	       "(3 bytes per pixel, row by row), so it depends on the render "
+	       "settings (e.g. gamma). Frame numbers start at 0.\n"
+	       "With -png each frame is also saved as '<filename>-NNNNNN.png'.\n"
+	       "With -offline the emulation runs as fast as possible (the throttle "
+	       "setting is ignored).\n"
+	       "The frames are processed on a separate thread. When it can't keep "
+	       "up, frames are dropped: those numbers are missing in the file.";
+}
+
+void FrameCapture::Cmd::tabCompletion(std::vector<std::string>& tokens) const
+{
+	using namespace std::literals;
+	if (tokens.size() == 2) {
+		static constexpr std::array cmds = {
+			"start"sv, "stop"sv, "status"sv,
+		};
+		completeString(tokens, cmds);
+	} else if ((tokens.size() >= 3) && (tokens[1] == "start")) {
+		static constexpr std::array options = {
+			"-prefix"sv, "-png"sv, "-offline"sv,
+		};
+		completeFileName(tokens, userFileContext(), options);
+	}
+}
+
+} // namespace openmsx
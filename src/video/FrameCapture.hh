@@ -0,0 +1,115 @@
+#ifndef FRAMECAPTURE_HH
+#define FRAMECAPTURE_HH
+
+#include "Command.hh"
+#include "FileOperations.hh"
+#include "span.hh"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace openmsx {
+
+class Interpreter;
+class PostProcessor;
+class RawFrame;
+class Reactor;
+class TclObject;
+
+/** Captures every finished VDP frame, e.g. to compare the output of an
+  * automated test against known good (golden) images.
+  *
+  * The frames are processed on a separate thread: for each frame an xxhash
+  * of its image is written to a text file, and optionally the image itself
+  * is saved as PNG. The image is the frame scaled to 640x480 RGB pixels,
+  * the same as 'screenshot -raw -doublesize'.
+  *
+  * The emulation thread never waits for this thread. PostProcessor only
+  * passes a reference to its RawFrame. When it wants to recycle a frame
+  * that is still being processed, that frame is kept alive here and
+  * PostProcessor gets another one instead. When the capture thread falls
+  * too far behind, frames are dropped (and counted).
+  */
+class FrameCapture
+{
+public:
+	explicit FrameCapture(Reactor& reactor);
+	~FrameCapture();
+
+	/** Capture the given frame. Called by PostProcessor on the emulation
+	  * thread. The frame may not be changed before it is passed to
+	  * recycle().
+	  */
+	void addFrame(const RawFrame& frame);
+
+	/** PostProcessor wants to reuse the given frame (can be nullptr) to
+	  * render a new frame in. When the capture thread is still using it,
+	  * it's kept alive here and a frame that is no longer in use (or
+	  * nullptr, then the caller must allocate a new one) is returned.
+	  * Each PostProcessor only gets back frames it passed in itself
+	  * (these have the right size and pixel format).
+	  */
+	[[nodiscard]] std::unique_ptr<RawFrame> recycle(
+		const PostProcessor& owner, std::unique_ptr<RawFrame> frame);
+
+	void stop();
+
+private:
+	void start(const std::string& filename, bool savePng, bool renderOffline);
+	void status(TclObject& result) const;
+	void processStart(Interpreter& interp, span<const TclObject> tokens, TclObject& result);
+
+	void run();
+	template<typename Pixel> void process(const RawFrame& frame, unsigned number);
+
+private:
+	Reactor& reactor;
+
+	struct Cmd final : Command {
+		explicit Cmd(CommandController& commandController);
+		void execute(span<const TclObject> tokens, TclObject& result) override;
+		[[nodiscard]] std::string help(span<const TclObject> tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} captureCommand;
+
+	std::vector<PostProcessor*> postProcessors;
+
+	struct Job {
+		const RawFrame* frame;
+		unsigned number; // frames are numbered from 0 since start()
+	};
+
+	// Only accessed by the emulation thread.
+	std::vector<Job> submitted; // jobs that were maybe not yet finished
+	struct Retired {
+		const PostProcessor* owner;
+		unsigned number; // the last job that uses this frame
+		std::unique_ptr<RawFrame> frame;
+	};
+	std::vector<Retired> retired;
+	unsigned numFrames = 0; // including dropped frames
+	unsigned numDropped = 0;
+	bool offline = false;
+
+	// Only accessed by the capture thread (while it's running).
+	FileOperations::FILE_t hashFile;
+	std::string pngPrefix; // empty when not saving PNG files
+
+	// Shared between both threads.
+	std::thread thread;
+	mutable std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<Job> queue;       // protected by mutex
+	std::string error;           // protected by mutex
+	bool stopThread = false;     // protected by mutex
+	std::atomic<unsigned> numFinished = 0; // jobs are finished in order
+};
+
+} // namespace openmsx
+
+#endif
@@ -167,6 +167,7 @@ void GLPostProcessor::paint(OutputSurface& /*output*/)
 		// Re-uploading the first is not strictly needed. But switching
 		// scalers doesn't happen that often, so it also doesn't hurt
 		// and it keeps the code simpler.
+		uploadedLastFrame = false;
 		uploadFrame();
 	}
 
@@ -264,17 +265,45 @@ void GLPostProcessor::update(const Setting& setting) noexcept
 
 void GLPostProcessor::uploadFrame()
 {
+	auto prevRegions = regions;
 	createRegions();
 
+	// When the textures hold the previous frame and the layout didn't
+	// change, only the lines that differ from the previous frame need to
+	// be uploaded (plus the neighbouring lines, the edge data of the hq
+	// scalers depends on two consecutive lines).
+	const auto* frame = lastFrames[0].get();
+	bool incremental = uploadedLastFrame && (paintFrame == frame) &&
+	                   (regions == prevRegions);
+	uploadedLastFrame = (paintFrame == frame);
+
 	const unsigned srcHeight = paintFrame->getHeight();
 	for (auto& r : regions) {
 		// upload data
 		// TODO get before/after data from scaler
 		unsigned before = 1;
 		unsigned after  = 1;
-		uploadBlock(std::max<int>(0,         r.srcStartY - before),
-		            std::min<int>(srcHeight, r.srcEndY   + after),
-		            r.lineWidth);
+		unsigned startY = std::max<int>(0,         r.srcStartY - before);
+		unsigned endY   = std::min<int>(srcHeight, r.srcEndY   + after);
+		if (!incremental) {
+			uploadBlock(startY, endY, r.lineWidth);
+			continue;
+		}
+		unsigned y = startY;
+		while (y < endY) {
+			if (frame->isLineUnchanged(y)) {
+				++y;
+				continue;
+			}
+			unsigned runEnd = y + 1;
+			while ((runEnd < endY) && !frame->isLineUnchanged(runEnd)) {
+				++runEnd;
+			}
+			uploadBlock((y > startY) ? y - 1 : y,
+			            std::min(endY, runEnd + 1),
+			            r.lineWidth);
+			y = runEnd;
+		}
 	}
 
 	if (superImposeVideoFrame) {
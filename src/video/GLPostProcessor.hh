@@ -79,6 +79,7 @@ private:
 			, dstStartY(dstStartY_)
 			, dstEndY(dstEndY_)
 			, lineWidth(lineWidth_) {}
+		[[nodiscard]] bool operator==(const Region&) const = default;
 		unsigned srcStartY;
 		unsigned srcEndY;
 		unsigned dstStartY;
@@ -87,6 +88,11 @@ private:
 	};
 	std::vector<Region> regions;
 
+	/** Do the textures hold the data of the previous lastFrames[0]? Only
+	  * then uploadFrame() can skip lines that didn't change.
+	  */
+	bool uploadedLastFrame = false;
+
 	unsigned height;
 	unsigned frameCounter;
 
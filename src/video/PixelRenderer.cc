@@ -512,6 +512,8 @@ inline bool PixelRenderer::checkSync(int offset, EmuTime::param time)
 
 void PixelRenderer::updateVRAM(unsigned offset, EmuTime::param time)
 {
+	rasterizer->updateVRAM(offset);
+
 	// Note: No need to sync if display is disabled, because then the
 	//       output does not depend on VRAM (only on background color).
 	if (renderFrame && displayEnabled && checkSync(offset, time)) {
@@ -25,6 +25,22 @@ class VideoSourceSetting;
 
 /** Generic implementation of a pixel-based Renderer.
   * Uses a Rasterizer to plot actual pixels for a specific video system.
+  *
+  * Rendering happens synchronously on the emulation thread, there's no
+  * separate render thread that replays a queue of VDP changes:
+  * - The rasterizer (and the Character/Bitmap/SpriteConverter) read the
+  *   live state of the VDP, VDPVRAM and SpriteChecker while drawing. A
+  *   render thread would need its own copy of all of that. So each sync()
+  *   would have to copy the VRAM window(s), the sprite lines and the VDP
+  *   registers (or log every VRAM write plus every register change and
+  *   replay them exactly). That costs about as much as rendering the
+  *   (usually small) area between two syncs.
+  * - sync() is already limited to changes that can affect the output (see
+  *   checkSync()). With 'accuracy screen' most syncs become no-ops.
+  * - When emulation speed matters most (fast-forward, or throttle off and
+  *   not recording) most frames aren't rendered at all, see frameStart().
+  * Multiple cores are instead used inside a single draw request: large
+  * line ranges are converted in parallel.
   */
 class PixelRenderer final : public Renderer, private Observer<Setting>
 {
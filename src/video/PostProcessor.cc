@@ -9,6 +9,7 @@
 #include "RenderSettings.hh"
 #include "RawFrame.hh"
 #include "AviRecorder.hh"
+#include "FrameCapture.hh"
 #include "CliComm.hh"
 #include "MSXMotherBoard.hh"
 #include "Reactor.hh"
@@ -37,6 +38,7 @@ PostProcessor::PostProcessor(MSXMotherBoard& motherBoard_,
 	, screen(screen_)
 	, paintFrame(nullptr)
 	, recorder(nullptr)
+	, capture(nullptr)
 	, superImposeVideoFrame(nullptr)
 	, superImposeVdpFrame(nullptr)
 	, interleaveCount(0)
@@ -75,6 +77,13 @@ PostProcessor::~PostProcessor()
 			"during recording.");
 		recorder->stop();
 	}
+	if (capture) {
+		getCliComm().printWarning(
+			"Frame capture stopped, because you "
+			"changed machine or changed a video setting "
+			"during capturing.");
+		capture->stop();
+	}
 }
 
 CliComm& PostProcessor::getCliComm()
@@ -193,16 +202,26 @@ std::unique_ptr<RawFrame> PostProcessor::rotateFrames(
 		}
 	}
 
+	// Possibly capture this frame. The capture thread reads it while we
+	// keep using it, so it may not be handed out for rendering until the
+	// capture thread is done with it.
+	if (capture && needRecord()) {
+		capture->addFrame(*lastFrames[0]);
+	}
+
 	// Return recycled frame to the caller
-	if (canDoInterlace) {
-		if (unlikely(!recycleFrame)) {
-			recycleFrame = std::make_unique<RawFrame>(
-				screen.getPixelFormat(), maxWidth, height);
-		}
-		return recycleFrame;
-	} else {
-		return std::move(lastFrames[0]);
+	if (capture) {
+		// Also without interlace, keep the finished frame: the capture
+		// thread may still be reading the frame that's recycled.
+		recycleFrame = capture->recycle(*this, std::move(recycleFrame));
+	} else if (!canDoInterlace) {
+		recycleFrame = std::move(lastFrames[0]);
+	}
+	if (unlikely(!recycleFrame)) {
+		recycleFrame = std::make_unique<RawFrame>(
+			screen.getPixelFormat(), maxWidth, height);
 	}
+	return recycleFrame;
 }
 
 void PostProcessor::executeUntil(EmuTime::param /*time*/)
@@ -15,6 +15,7 @@ class DeinterlacedFrame;
 class Display;
 class DoubledFrame;
 class EventDistributor;
+class FrameCapture;
 class FrameSource;
 class RawFrame;
 class RenderSettings;
@@ -70,10 +71,19 @@ public:
 	  */
 	void setRecorder(AviRecorder* recorder_) { recorder = recorder_; }
 
-	/** Is recording active.
+	/** Start/stop capturing frames.
+	  * @param capture_ Finished frames should be passed to this
+	  *                 FrameCapture. Can also be nullptr, meaning
+	  *                 capturing is stopped.
+	  */
+	void setFrameCapture(FrameCapture* capture_) { capture = capture_; }
+
+	/** Is recording (or capturing) active.
 	  * ATM used to keep frameskip constant during recording.
 	  */
-	[[nodiscard]] bool isRecording() const { return recorder != nullptr; }
+	[[nodiscard]] bool isRecording() const {
+		return (recorder != nullptr) || (capture != nullptr);
+	}
 
 	/** Get the number of bits per pixel for the pixels in these frames.
 	  * @return Possible values are 15, 16 or 32
@@ -132,6 +142,9 @@ protected:
 	/** Video recorder, nullptr when not recording. */
 	AviRecorder* recorder;
 
+	/** Frame capture, nullptr when not capturing. */
+	FrameCapture* capture;
+
 	/** Video frame on which to superimpose the (VDP) output.
 	  * nullptr when not superimposing. */
 	const RawFrame* superImposeVideoFrame;
@@ -62,6 +62,13 @@ public:
 	virtual void setTransparency(bool enabled) = 0;
 	virtual void setSuperimposeVideoFrame(const RawFrame* videoSource) = 0;
 
+	/** Informs the rasterizer of a VRAM change, also when the current
+	  * frame is not rendered. Called right before the new value is
+	  * written.
+	  * @param address The (physical) VRAM address that changes.
+	  */
+	virtual void updateVRAM(unsigned address) = 0;
+
 	/** Render a rectangle of border pixels on the host screen.
 	  * The units are absolute lines (Y) and VDP clockticks (X).
 	  * @param fromX X coordinate of render start (inclusive).
@@ -8,6 +8,7 @@ RawFrame::RawFrame(
 		const PixelFormat& format, unsigned maxWidth_, unsigned height_)
 	: FrameSource(format)
 	, lineWidths(height_)
+	, lineUnchanged(height_)
 	, maxWidth(maxWidth_)
 {
 	setHeight(height_);
@@ -24,6 +25,7 @@ RawFrame::RawFrame(
 	// Start with a black frame.
 	init(FIELD_NONINTERLACED);
 	for (auto line : xrange(height_)) {
+		lineUnchanged[line] = false;
 		if (bytesPerPixel == 2) {
 			setBlank(line, static_cast<uint16_t>(0));
 		} else {
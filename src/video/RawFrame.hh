@@ -38,6 +38,28 @@ public:
 		lineWidths[line] = 1;
 	}
 
+	/** Is this line identical to the same line in the previous frame
+	  * that was handed to the post processor? This is only a hint, when
+	  * in doubt the producer marks the line as changed. Post processors
+	  * can use it to skip work for unchanged lines.
+	  */
+	[[nodiscard]] bool isLineUnchanged(unsigned line) const {
+		assert(line < getHeight());
+		return lineUnchanged[line];
+	}
+	void setLineUnchanged(unsigned line, bool unchanged) {
+		assert(line < getHeight());
+		lineUnchanged[line] = unchanged;
+	}
+
+	/** Number of the frame that was last rendered in this buffer, as
+	  * chosen by the producer. 0 means the content is unknown (e.g. a new
+	  * buffer). When a buffer is recycled, the producer can use this to
+	  * find out which lines still hold the right content.
+	  */
+	[[nodiscard]] unsigned getFrameNumber() const { return frameNumber; }
+	void setFrameNumber(unsigned number) { frameNumber = number; }
+
 	[[nodiscard]] unsigned getRowLength() const override;
 
 protected:
@@ -50,8 +72,10 @@ protected:
 private:
 	MemBuffer<char, 64> data;
 	MemBuffer<unsigned> lineWidths;
+	MemBuffer<bool> lineUnchanged;
 	unsigned maxWidth;
 	unsigned pitch;
+	unsigned frameNumber = 0;
 };
 
 } // namespace openmsx
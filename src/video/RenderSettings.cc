@@ -67,6 +67,12 @@ RenderSettings::RenderSettings(CommandController& commandController)
 	, minFrameSkipSetting(commandController,
 		"minframeskip", "set the min amount of frameskip", 0, 0, 100)
 
+	, renderThreadsSetting(commandController,
+		"render_threads",
+		"number of extra threads used to convert large areas of the "
+		"screen in parallel, 0 means all rendering is done on the "
+		"emulation thread", 0, 0, 16)
+
 	, fullScreenSetting(commandController,
 		"fullscreen", "full screen display on/off", false)
 
@@ -63,6 +63,10 @@ public:
 	[[nodiscard]] IntegerSetting& getMinFrameSkipSetting() { return minFrameSkipSetting; }
 	[[nodiscard]] int getMinFrameSkip() const { return minFrameSkipSetting.getInt(); }
 
+	/** The number of extra threads used to convert VRAM to pixels. */
+	[[nodiscard]] IntegerSetting& getRenderThreadsSetting() { return renderThreadsSetting; }
+	[[nodiscard]] int getRenderThreads() const { return renderThreadsSetting.getInt(); }
+
 	/** Full screen [on, off]. */
 	[[nodiscard]] BooleanSetting& getFullScreenSetting() { return fullScreenSetting; }
 	[[nodiscard]] bool getFullScreen() const { return fullScreenSetting.getBoolean(); }
@@ -129,6 +133,7 @@ public:
 
 	/** Disable sprite rendering? */
 	[[nodiscard]] bool getDisableSprites() const { return disableSpritesSetting.getBoolean(); }
+	[[nodiscard]] BooleanSetting& getDisableSpritesSetting() { return disableSpritesSetting; }
 
 	/** CmdTiming [real, broken].
 	  * This setting is intended for debugging only, not for users. */
@@ -209,6 +214,7 @@ private:
 	BooleanSetting deflickerSetting;
 	IntegerSetting maxFrameSkipSetting;
 	IntegerSetting minFrameSkipSetting;
+	IntegerSetting renderThreadsSetting;
 	BooleanSetting fullScreenSetting;
 	FloatSetting gammaSetting;
 	FloatSetting brightnessSetting;
@@ -8,8 +8,10 @@
 #include "PostProcessor.hh"
 #include "MemoryOps.hh"
 #include "OutputSurface.hh"
+#include "WorkerPool.hh"
 #include "enumerate.hh"
 #include "one_of.hh"
+#include "ranges.hh"
 #include "xrange.hh"
 #include "build-info.hh"
 #include "components.hh"
@@ -80,7 +82,11 @@ SDLRasterizer<Pixel>::SDLRasterizer(
 	, characterConverter(vdp, palFg, palBg)
 	, bitmapConverter(palFg, PALETTE256, V9958_COLORS)
 	, spriteConverter(vdp.getSpriteChecker())
+	, vdpChangeCount(vdp.getDisplayChangeCount())
 {
+	ranges::fill(vramRowChanged, 0);
+	ranges::fill(lineState, UNTOUCHED);
+
 	// Init the palette.
 	precalcPalette();
 
@@ -96,11 +102,18 @@ SDLRasterizer<Pixel>::SDLRasterizer(
 	renderSettings.getBrightnessSetting() .attach(*this);
 	renderSettings.getContrastSetting()   .attach(*this);
 	renderSettings.getColorMatrixSetting().attach(*this);
+	renderSettings.getRenderThreadsSetting().attach(*this);
+	renderSettings.getLimitSpritesSetting().attach(*this);
+	renderSettings.getDisableSpritesSetting().attach(*this);
+	recreateWorkerPool();
 }
 
 template<typename Pixel>
 SDLRasterizer<Pixel>::~SDLRasterizer()
 {
+	renderSettings.getDisableSpritesSetting().detach(*this);
+	renderSettings.getLimitSpritesSetting().detach(*this);
+	renderSettings.getRenderThreadsSetting().detach(*this);
 	renderSettings.getColorMatrixSetting().detach(*this);
 	renderSettings.getGammaSetting()      .detach(*this);
 	renderSettings.getBrightnessSetting() .detach(*this);
@@ -129,6 +142,9 @@ void SDLRasterizer<Pixel>::reset()
 	spriteConverter.setTransparency(vdp.getTransparency());
 
 	resetPalette();
+
+	// e.g. after loading a savestate, VRAM changed without notifications
+	lastGlobalChange = frameNumber;
 }
 
 template<typename Pixel>
@@ -148,6 +164,77 @@ void SDLRasterizer<Pixel>::setSuperimposeVideoFrame(const RawFrame* videoSource)
 	postProcessor->setSuperimposeVideoFrame(videoSource);
 	precalcColorIndex0(vdp.getDisplayMode(), vdp.getTransparency(),
 	                   videoSource, vdp.getBackgroundColor());
+	lastGlobalChange = frameNumber;
+}
+
+template<typename Pixel>
+void SDLRasterizer<Pixel>::updateVRAM(unsigned address)
+{
+	if (address < 0x20000) {
+		vramRowChanged[address >> 7] = frameNumber;
+	}
+	// Sprites, and in character modes all of the display, don't map to
+	// VRAM rows, so changes in those tables affect all lines.
+	if (vram.spriteAttribTable .isInside(address) ||
+	    vram.spritePatternTable.isInside(address) ||
+	    (!vdp.getDisplayMode().isBitmapMode() &&
+	     (vram.nameTable   .isInside(address) ||
+	      vram.colorTable  .isInside(address) ||
+	      vram.patternTable.isInside(address)))) {
+		lastGlobalChange = frameNumber;
+	}
+}
+
+template<typename Pixel>
+void SDLRasterizer<Pixel>::checkVDPChanges()
+{
+	unsigned count = vdp.getDisplayChangeCount();
+	if (count != vdpChangeCount) {
+		vdpChangeCount = count;
+		lastGlobalChange = frameNumber;
+	}
+}
+
+template<typename Pixel>
+bool SDLRasterizer<Pixel>::canReuseFrame() const
+{
+	// Some VDP changes only take effect at the next line (possibly in the
+	// next frame), so also require that nothing changed in the frame
+	// before the recycled one. A new frame buffer has number 0, so it's
+	// never reused. Even/odd page and fast blink alternate the content
+	// between frames.
+	return ((lastGlobalChange + 1) < reuseFrameNumber) &&
+	       !vdp.isEvenOddEnabled() && !vdp.isFastBlinkEnabled();
+}
+
+template<typename Pixel>
+bool SDLRasterizer<Pixel>::isBitmapLineUnchanged(unsigned vramLine) const
+{
+	// The rows of smaller VRAMs are mirrored, don't bother with those.
+	if (vram.getSize() < 0x20000) return false;
+	if (vdp.getDisplayMode().isPlanar()) {
+		// even bytes in the 1st 64kB, odd bytes in the 2nd 64kB
+		return (vramRowChanged[vramLine]       < reuseFrameNumber) &&
+		       (vramRowChanged[vramLine + 512] < reuseFrameNumber);
+	} else {
+		return vramRowChanged[vramLine] < reuseFrameNumber;
+	}
+}
+
+template<typename Pixel>
+void SDLRasterizer<Pixel>::markReused(int startY, int endY)
+{
+	for (auto y : xrange(startY, endY)) {
+		if (lineState[y] == UNTOUCHED) lineState[y] = REUSED;
+	}
+}
+
+template<typename Pixel>
+void SDLRasterizer<Pixel>::markDrawn(int startY, int endY)
+{
+	for (auto y : xrange(startY, endY)) {
+		lineState[y] = DRAWN;
+	}
 }
 
 template<typename Pixel>
@@ -165,11 +252,25 @@ void SDLRasterizer<Pixel>::frameStart(EmuTime::param time)
 	// NTSC: display at [32..244),
 	// PAL:  display at [59..271).
 	lineRenderTop = vdp.isPalTiming() ? 59 - 14 : 32 - 14;
+
+	++frameNumber;
+	checkVDPChanges();
+	reuseFrameNumber = workFrame->getFrameNumber();
+	workFrame->setFrameNumber(frameNumber);
+	ranges::fill(lineState, UNTOUCHED);
+	for (auto y : xrange(240)) {
+		workFrame->setLineUnchanged(y, false);
+	}
 }
 
 template<typename Pixel>
 void SDLRasterizer<Pixel>::frameEnd()
 {
+	// Only lines that were left as they were in the recycled frame are
+	// for sure the same as in the previous frame.
+	for (auto y : xrange(240)) {
+		workFrame->setLineUnchanged(y, lineState[y] == REUSED);
+	}
 }
 
 template<typename Pixel>
@@ -391,6 +492,34 @@ std::pair<Pixel, Pixel> SDLRasterizer<Pixel>::getBorderColors()
 	return {col, col};
 }
 
+template<typename Pixel>
+void SDLRasterizer<Pixel>::recreateWorkerPool()
+{
+	auto num = unsigned(renderSettings.getRenderThreads());
+	workerPool.reset();
+	if (num) workerPool = std::make_unique<WorkerPool>(num);
+}
+
+template<typename Pixel>
+template<typename DrawLines>
+void SDLRasterizer<Pixel>::forLines(int startY, int endY, const DrawLines& drawLines)
+{
+	// Each line only depends on VRAM and on the VDP state, which don't
+	// change during a draw call, so lines can be converted in any order
+	// and in parallel. But a few lines are not worth waking up the
+	// worker threads.
+	constexpr int CHUNK = 16;
+	int num = endY - startY;
+	if (!workerPool || (num < 2 * CHUNK)) {
+		drawLines(startY, endY);
+		return;
+	}
+	workerPool->run(unsigned((num + CHUNK - 1) / CHUNK), [&](unsigned i) {
+		int begin = startY + int(i) * CHUNK;
+		drawLines(begin, std::min(begin + CHUNK, endY));
+	});
+}
+
 template<typename Pixel>
 void SDLRasterizer<Pixel>::drawBorder(
 	int fromX, int fromY, int limitX, int limitY)
@@ -399,6 +528,12 @@ void SDLRasterizer<Pixel>::drawBorder(
 
 	int startY = std::max(fromY - lineRenderTop, 0);
 	int endY = std::min(limitY - lineRenderTop, 240);
+	checkVDPChanges();
+	if (canReuseFrame()) {
+		markReused(startY, endY);
+		return;
+	}
+	markDrawn(startY, endY);
 	if ((fromX == 0) && (limitX == VDP::TICKS_PER_LINE) &&
 	    (border0 == border1)) {
 		// complete lines, non striped
@@ -459,6 +594,13 @@ void SDLRasterizer<Pixel>::drawDisplay(
 	displayHeight = screenLimitY - screenY;
 	if (displayHeight <= 0) return;
 
+	checkVDPChanges();
+	bool reuse = canReuseFrame();
+	if (reuse && !mode.isBitmapMode()) {
+		markReused(screenY, screenLimitY);
+		return;
+	}
+
 	int leftBackground =
 		translateX(vdp.getLeftBackground(), lineWidth == 512);
 	// TODO: Find out why this causes 1-pixel jitter:
@@ -474,15 +616,12 @@ void SDLRasterizer<Pixel>::drawDisplay(
 	// Note that it is possible for pageBorder to be to the left of displayX,
 	// in that case only the second page should be drawn.
 	int pageBorder = displayX + displayWidth;
-	auto [scrollPage1, scrollPage2] = [&]() -> std::pair<int, int> {
-		if (vdp.isMultiPageScrolling()) {
-			int p1 = vdp.getHorizontalScrollHigh() >> 5;
-			int p2 = p1 ^ 1;
-			return {p1, p2};
-		} else {
-			return {0, 0};
-		}
-	}();
+	int scrollPage1 = 0;
+	int scrollPage2 = 0;
+	if (vdp.isMultiPageScrolling()) {
+		scrollPage1 = vdp.getHorizontalScrollHigh() >> 5;
+		scrollPage2 = scrollPage1 ^ 1;
+	}
 	// Because SDL blits do not wrap, unlike GL textures, the pageBorder is
 	// also used if multi page is disabled.
 	int pageSplit = lineWidth - hScroll;
@@ -491,74 +630,90 @@ void SDLRasterizer<Pixel>::drawDisplay(
 	}
 
 	if (mode.isBitmapMode()) {
-		for (auto y : xrange(screenY, screenLimitY)) {
-			// Which bits in the name mask determine the page?
-			// TODO optimize this?
-			//   Calculating pageMaskOdd/Even is a non-trivial amount
-			//   of work. We used to do this per frame (more or less)
-			//   but now do it per line. Per-line is actually only
-			//   needed when vdp.isFastBlinkEnabled() is true.
-			//   Idea: can be cheaply calculated incrementally.
-			int pageMaskOdd = (mode.isPlanar() ? 0x000 : 0x200) |
-				vdp.getEvenOddMask(y);
-			int pageMaskEven = vdp.isMultiPageScrolling()
-				? (pageMaskOdd & ~0x100)
-				: pageMaskOdd;
-			const int vramLine[2] = {
-				(vram.nameTable.getMask() >> 7) & (pageMaskEven | displayY),
-				(vram.nameTable.getMask() >> 7) & (pageMaskOdd  | displayY)
-			};
-
-			Pixel buf[512];
-			int lineInBuf = -1; // buffer data not valid
-			Pixel* dst = workFrame->getLinePtrDirect<Pixel>(y)
-			           + leftBackground + displayX;
-			int firstPageWidth = pageBorder - displayX;
-			if (firstPageWidth > 0) {
-				if (((displayX + hScroll) == 0) &&
-				    (firstPageWidth == lineWidth)) {
-					// fast-path, directly render to destination
-					renderBitmapLine(dst, vramLine[scrollPage1]);
+		bitmapConverter.prepareConvert();
+		forLines(screenY, screenLimitY, [&](int startY, int endY) {
+			int dispY = (displayY + startY - screenY) & 255;
+			for (auto y : xrange(startY, endY)) {
+				// Which bits in the name mask determine the page?
+				// TODO optimize this?
+				//   Calculating pageMaskOdd/Even is a non-trivial amount
+				//   of work. We used to do this per frame (more or less)
+				//   but now do it per line. Per-line is actually only
+				//   needed when vdp.isFastBlinkEnabled() is true.
+				//   Idea: can be cheaply calculated incrementally.
+				int pageMaskOdd = (mode.isPlanar() ? 0x000 : 0x200) |
+					vdp.getEvenOddMask(y);
+				int pageMaskEven = vdp.isMultiPageScrolling()
+					? (pageMaskOdd & ~0x100)
+					: pageMaskOdd;
+				const int vramLine[2] = {
+					(vram.nameTable.getMask() >> 7) & (pageMaskEven | dispY),
+					(vram.nameTable.getMask() >> 7) & (pageMaskOdd  | dispY)
+				};
+				if (reuse &&
+				    isBitmapLineUnchanged(vramLine[scrollPage1]) &&
+				    isBitmapLineUnchanged(vramLine[scrollPage2])) {
+					markReused(y, y + 1);
+					dispY = (dispY + 1) & 255;
+					continue;
+				}
+				lineState[y] = DRAWN;
+
+				Pixel buf[512];
+				int lineInBuf = -1; // buffer data not valid
+				Pixel* dst = workFrame->getLinePtrDirect<Pixel>(y)
+					   + leftBackground + displayX;
+				int firstPageWidth = pageBorder - displayX;
+				if (firstPageWidth > 0) {
+					if (((displayX + hScroll) == 0) &&
+					    (firstPageWidth == lineWidth)) {
+						// fast-path, directly render to destination
+						renderBitmapLine(dst, vramLine[scrollPage1]);
+					} else {
+						lineInBuf = vramLine[scrollPage1];
+						renderBitmapLine(buf, vramLine[scrollPage1]);
+						const Pixel* src = buf + displayX + hScroll;
+						memcpy(dst, src, firstPageWidth * sizeof(Pixel));
+					}
 				} else {
-					lineInBuf = vramLine[scrollPage1];
-					renderBitmapLine(buf, vramLine[scrollPage1]);
-					const Pixel* src = buf + displayX + hScroll;
-					memcpy(dst, src, firstPageWidth * sizeof(Pixel));
+					firstPageWidth = 0;
 				}
-			} else {
-				firstPageWidth = 0;
-			}
-			if (firstPageWidth < displayWidth) {
-				if (lineInBuf != vramLine[scrollPage2]) {
-					renderBitmapLine(buf, vramLine[scrollPage2]);
+				if (firstPageWidth < displayWidth) {
+					if (lineInBuf != vramLine[scrollPage2]) {
+						renderBitmapLine(buf, vramLine[scrollPage2]);
+					}
+					unsigned x = displayX < pageBorder
+						   ? 0 : displayX + hScroll - lineWidth;
+					memcpy(dst + firstPageWidth,
+					       buf + x,
+					       (displayWidth - firstPageWidth) * sizeof(Pixel));
 				}
-				unsigned x = displayX < pageBorder
-					   ? 0 : displayX + hScroll - lineWidth;
-				memcpy(dst + firstPageWidth,
-				       buf + x,
-				       (displayWidth - firstPageWidth) * sizeof(Pixel));
-			}
 
-			displayY = (displayY + 1) & 255;
-		}
+				dispY = (dispY + 1) & 255;
+			}
+		});
 	} else {
+		markDrawn(screenY, screenLimitY);
 		// horizontal scroll (high) is implemented in CharacterConverter
-		for (auto y : xrange(screenY, screenLimitY)) {
-			assert(!vdp.isMSX1VDP() || displayY < 192);
+		forLines(screenY, screenLimitY, [&](int startY, int endY) {
+			int dispY = (displayY + startY - screenY) & 255;
+			for (auto y : xrange(startY, endY)) {
+				assert(!vdp.isMSX1VDP() || dispY < 192);
+
+				Pixel* dst = workFrame->getLinePtrDirect<Pixel>(y)
+					   + leftBackground + displayX;
+				if ((displayX == 0) && (displayWidth == lineWidth)){
+					characterConverter.convertLine(dst, dispY);
+				} else {
+					Pixel buf[512];
+					characterConverter.convertLine(buf, dispY);
+					const Pixel* src = buf + displayX;
+					memcpy(dst, src, displayWidth * sizeof(Pixel));
+				}
 
-			Pixel* dst = workFrame->getLinePtrDirect<Pixel>(y)
-			           + leftBackground + displayX;
-			if ((displayX == 0) && (displayWidth == lineWidth)){
-				characterConverter.convertLine(dst, displayY);
-			} else {
-				Pixel buf[512];
-				characterConverter.convertLine(buf, displayY);
-				const Pixel* src = buf + displayX;
-				memcpy(dst, src, displayWidth * sizeof(Pixel));
+				dispY = (dispY + 1) & 255;
 			}
-
-			displayY = (displayY + 1) & 255;
-		}
+		});
 	}
 }
 
@@ -581,6 +736,11 @@ void SDLRasterizer<Pixel>::drawSprites(
 	displayHeight = screenLimitY - screenY;
 	if (displayHeight <= 0) return;
 
+	// Sprites are already present in reused lines, but must be redrawn
+	// on top of lines that were drawn again.
+	checkVDPChanges();
+	bool reuse = canReuseFrame();
+
 	// Render sprites.
 	// TODO: Call different SpriteConverter methods depending on narrow/wide
 	//       pixels in this display mode?
@@ -590,31 +750,42 @@ void SDLRasterizer<Pixel>::drawSprites(
 	int screenX = translateX(
 		vdp.getLeftSprites(),
 		vdp.getDisplayMode().getLineWidth() == 512);
+	auto drawLines = [&](auto drawLine) {
+		forLines(fromY, limitY, [&](int startY, int endY) {
+			for (auto y : xrange(startY, endY)) {
+				int line = screenY + (y - fromY);
+				if (reuse && (lineState[line] != DRAWN)) {
+					lineState[line] = REUSED;
+					continue;
+				}
+				lineState[line] = DRAWN;
+				Pixel* pixelPtr = workFrame->getLinePtrDirect<Pixel>(
+					line) + screenX;
+				drawLine(y, pixelPtr);
+			}
+		});
+	};
 	if (spriteMode == 1) {
-		for (int y = fromY; y < limitY; y++, screenY++) {
-			Pixel* pixelPtr = workFrame->getLinePtrDirect<Pixel>(screenY) + screenX;
+		drawLines([&](int y, Pixel* pixelPtr) {
 			spriteConverter.drawMode1(y, displayX, displayLimitX, pixelPtr);
-		}
+		});
 	} else {
 		byte mode = vdp.getDisplayMode().getByte();
 		if (mode == DisplayMode::GRAPHIC5) {
-			for (int y = fromY; y < limitY; y++, screenY++) {
-				Pixel* pixelPtr = workFrame->getLinePtrDirect<Pixel>(screenY) + screenX;
+			drawLines([&](int y, Pixel* pixelPtr) {
 				spriteConverter.template drawMode2<DisplayMode::GRAPHIC5>(
 					y, displayX, displayLimitX, pixelPtr);
-			}
+			});
 		} else if (mode == DisplayMode::GRAPHIC6) {
-			for (int y = fromY; y < limitY; y++, screenY++) {
-				Pixel* pixelPtr = workFrame->getLinePtrDirect<Pixel>(screenY) + screenX;
+			drawLines([&](int y, Pixel* pixelPtr) {
 				spriteConverter.template drawMode2<DisplayMode::GRAPHIC6>(
 					y, displayX, displayLimitX, pixelPtr);
-			}
+			});
 		} else {
-			for (int y = fromY; y < limitY; y++, screenY++) {
-				Pixel* pixelPtr = workFrame->getLinePtrDirect<Pixel>(screenY) + screenX;
+			drawLines([&](int y, Pixel* pixelPtr) {
 				spriteConverter.template drawMode2<DisplayMode::GRAPHIC4>(
 					y, displayX, displayLimitX, pixelPtr);
-			}
+			});
 		}
 	}
 }
@@ -634,6 +805,13 @@ void SDLRasterizer<Pixel>::update(const Setting& setting) noexcept
 	                       &renderSettings.getColorMatrixSetting())) {
 		precalcPalette();
 		resetPalette();
+		lastGlobalChange = frameNumber;
+	} else if (&setting == &renderSettings.getRenderThreadsSetting()) {
+		recreateWorkerPool();
+	} else if (&setting == one_of(&renderSettings.getLimitSpritesSetting(),
+	                              &renderSettings.getDisableSpritesSetting())) {
+		// Other (not VDP register) inputs of the rendered image.
+		lastGlobalChange = frameNumber;
 	}
 }
 
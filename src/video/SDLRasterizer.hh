@@ -19,6 +19,7 @@ class RawFrame;
 class RenderSettings;
 class Setting;
 class PostProcessor;
+class WorkerPool;
 
 /** Rasterizer using a frame buffer approach: it writes pixels to a single
   * rectangular pixel buffer.
@@ -50,6 +51,7 @@ public:
 	void setBorderMask(bool masked) override;
 	void setTransparency(bool enabled) override;
 	void setSuperimposeVideoFrame(const RawFrame* videoSource) override;
+	void updateVRAM(unsigned address) override;
 	void drawBorder(int fromX, int fromY, int limitX, int limitY) override;
 	void drawDisplay(
 		int fromX, int fromY,
@@ -84,6 +86,35 @@ private:
 	// Get the border color(s). These are 16bpp or 32bpp host pixels.
 	std::pair<Pixel, Pixel> getBorderColors();
 
+	void recreateWorkerPool();
+
+	/** Pick up changes in VDP state that happened since the last call.
+	  */
+	void checkVDPChanges();
+
+	/** Can lines that don't depend on VRAM, or that depend only on
+	  * unchanged VRAM rows, be left as they are in the recycled workFrame?
+	  */
+	[[nodiscard]] bool canReuseFrame() const;
+
+	/** Did the VRAM data for the given bitmap line stay the same since
+	  * the recycled workFrame was rendered?
+	  */
+	[[nodiscard]] bool isBitmapLineUnchanged(unsigned vramLine) const;
+
+	/** Mark the lines [startY, endY) as left unchanged, unless they were
+	  * already (partly) drawn in this frame.
+	  */
+	void markReused(int startY, int endY);
+	void markDrawn(int startY, int endY);
+
+	/** Calls 'drawLines(begin, end)' for sub-ranges that together cover
+	  * the lines [startY, endY). Large ranges are drawn in parallel (when
+	  * the 'render_threads' setting is non-zero).
+	  */
+	template<typename DrawLines>
+	void forLines(int startY, int endY, const DrawLines& drawLines);
+
 	// Observer<Setting>
 	void update(const Setting& setting) noexcept override;
 
@@ -156,6 +187,40 @@ private:
 	/** Host colors corresponding to each possible V9958 color.
 	  */
 	Pixel V9958_COLORS[32768];
+
+	/** Threads to convert large line ranges in parallel, nullptr when
+	  * everything is drawn on the emulation thread.
+	  */
+	std::unique_ptr<WorkerPool> workerPool;
+
+	// Recycled frames often still hold the right content (e.g. a static
+	// screen, or a bitmap screen where only a small part changes). Each
+	// rendered frame gets a number, and we remember the (frame) number of
+	// the last change that can affect any line, and per 128-byte row of
+	// VRAM the number of the last change to that row.
+
+	/** Number of the frame that is currently rendered, starts at 1.
+	  */
+	unsigned frameNumber = 0;
+
+	/** Frame number of the last change that can affect any line.
+	  */
+	unsigned lastGlobalChange = 0;
+
+	/** Frame number of the last change, per row of 128 bytes.
+	  */
+	unsigned vramRowChanged[0x20000 / 128];
+
+	/** Number of the frame that was previously rendered in workFrame.
+	  */
+	unsigned reuseFrameNumber = 0;
+
+	/** Last seen value of VDP::getDisplayChangeCount().
+	  */
+	unsigned vdpChangeCount;
+
+	enum LineState : byte { UNTOUCHED, REUSED, DRAWN };
+	LineState lineState[240];
 };
 
 } // namespace openmsx
@@ -357,6 +357,7 @@ void VDP::execVSync(EmuTime::param time)
 		auto next = calculateLineBlinkState(getLinesPerFrame());
 		blinkState = next.state;
 		blinkCount = next.count;
+		++displayChangeCount;
 	}
 
 	// Finish the previous frame, because access-slot calculations work within a frame.
@@ -607,6 +608,7 @@ void VDP::frameStart(EmuTime::param time)
 		if (blinkCount == 0) {
 			renderer->updateBlinkState(!blinkState, time);
 			blinkState = !blinkState;
+			++displayChangeCount;
 			blinkCount = (blinkState
 				? controlRegs[13] >> 4 : controlRegs[13] & 0x0F) * 10;
 		}
@@ -740,6 +742,7 @@ void VDP::setPalette(int index, word grb, EmuTime::param time)
 	if (palette[index] != grb) {
 		renderer->updatePalette(index, grb, time);
 		palette[index] = grb;
+		++displayChangeCount;
 	}
 }
 
@@ -1011,6 +1014,7 @@ void VDP::changeRegister(byte reg, byte val, EmuTime::param time)
 		if (blinkState == ((val & 0xF0) == 0)) {
 			renderer->updateBlinkState(!blinkState, time);
 			blinkState = !blinkState;
+			++displayChangeCount;
 		}
 
 		if ((val & 0xF0) && (val & 0x0F)) {
@@ -1028,6 +1032,13 @@ void VDP::changeRegister(byte reg, byte val, EmuTime::param time)
 
 	if (!change) return;
 
+	// The VRAM access page (14), status register pointer (15), palette
+	// pointer (16) and control register pointer (17) don't affect the
+	// image. Games often change them, e.g. to poll a status register.
+	if ((reg < 14) || (reg > 17)) {
+		++displayChangeCount;
+	}
+
 	// Perform additional tasks before new value becomes active.
 	switch (reg) {
 	case 0:
@@ -240,6 +240,15 @@ public:
 		return palette[index];
 	}
 
+	/** Counts the changes in VDP state (registers, palette, blink state)
+	  * that can affect the rendered image. Renderers compare two values to
+	  * find out whether anything changed in between. VRAM changes are not
+	  * included, those are reported via VRAMObserver::updateVRAM().
+	  */
+	[[nodiscard]] inline unsigned getDisplayChangeCount() const {
+		return displayChangeCount;
+	}
+
 	/** Is the display enabled?
 	  * Both the regular border and forced blanking by clearing
 	  * the display enable bit are considered disabled display.
@@ -1195,6 +1204,10 @@ private:
 	  */
 	bool blinkState;
 
+	/** See getDisplayChangeCount(). Not serialized.
+	  */
+	unsigned displayChangeCount = 0;
+
 	/** First byte written through port #99, #9A or #9B.
 	  */
 	byte dataLatch;
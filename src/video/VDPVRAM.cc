@@ -108,6 +108,7 @@ static constexpr unsigned bufferSize(unsigned size)
 VDPVRAM::VDPVRAM(VDP& vdp_, unsigned size, EmuTime::param time)
 	: vdp(vdp_)
 	, data(*vdp_.getDeviceConfig2().getXML(), bufferSize(size))
+	, dirty(size)
 	, logicalVRAMDebug (vdp)
 	, physicalVRAMDebug(vdp, size)
 	#ifdef DEBUG
@@ -137,6 +138,7 @@ void VDPVRAM::clear()
 {
 	// Initialise VRAM data array.
 	data.clear(0); // fill with zeros (unless initialContent is specified)
+	dirty.setAll();
 	if (data.getSize() != actualSize) {
 		assert(data.getSize() > actualSize);
 		// Read from unconnected VRAM returns random data.
@@ -207,6 +209,7 @@ void VDPVRAM::updateVRMode(bool newVRmode, EmuTime::param time)
 	}
 	vrMode = newVRmode;
 	setSizeMask(time);
+	dirty.setAll();
 
 	if (vrMode) {
 		// switch from VR=0 to VR=1
@@ -301,6 +304,7 @@ void VDPVRAM::change4k8kMapping(bool mapping8k)
 		}
 	}
 	memcpy(&data[0], tmp, sizeof(tmp));
+	dirty.setAll();
 }
 
 
@@ -325,7 +329,15 @@ void VDPVRAM::serialize(Archive& ar, unsigned /*version*/)
 		setSizeMask(static_cast<MSXDevice&>(vdp).getCurrentTime());
 	}
 
-	ar.serialize_blob("data", &data[0], actualSize);
+	if constexpr (Archive::IS_LOADER) {
+		ar.serialize_blob("data", &data[0], actualSize);
+		dirty.setAll();
+	} else if (ar.isReverseSnapshot()) {
+		ar.serialize_blob("data", &data[0], actualSize, dirty);
+		dirty.clearAll();
+	} else {
+		ar.serialize_blob("data", &data[0], actualSize);
+	}
 	ar.serialize("cmdReadWindow",       cmdReadWindow,
 	             "cmdWriteWindow",      cmdWriteWindow,
 	             "nameTable",           nameTable,
@@ -6,6 +6,7 @@
 #include "VDPCmdEngine.hh"
 #include "SimpleDebuggable.hh"
 #include "Ram.hh"
+#include "DirtyPages.hh"
 #include "Math.hh"
 #include "openmsx.hh"
 #include "likely.hh"
@@ -570,6 +571,7 @@ private:
 		spritePatternTable.notify(address, time);
 
 		data[address] = value;
+		dirty.set(address);
 
 		// Cache dirty marking should happen after the commit,
 		// otherwise the cache could be re-validated based on old state.
@@ -608,6 +610,10 @@ private:
 	  */
 	Ram data;
 
+	/** Pages of 'data' that were written since the last reverse snapshot.
+	  */
+	DirtyPages dirty;
+
 	/** Debuggable with mode dependend view on the vram
 	  *   Screen7/8 are not interleaved in this mode.
 	  *   This debuggable is also at least 128kB in size (it possibly